@@ -1,10 +1,30 @@
-#version 400
-#extension GL_ARB_separate_shader_objects : enable
-#extension GL_ARB_shading_language_420pack : enable
+#version 450
+
+// Set per pipeline with specialization constants, so disabled features cost nothing.
+layout(constant_id = 0) const int LIGHTING = 0; // 0: unlit, 1: Lambert.
+layout(constant_id = 1) const bool FOG = false;
+layout(constant_id = 2) const float FOG_DENSITY = 0.05;
+layout(constant_id = 3) const bool VERTEX_NORMALS = false; // Light with interpolated normals instead of faces.
+
+const vec3 LIGHT_DIRECTION = vec3(0.37, -0.84, -0.40);
+const vec4 FOG_COLOR = vec4(0.0, 0.0, 0.0, 0.0);
 
 layout (location = 0) in vec4 color;
+layout (location = 1) in vec3 position;
+layout (location = 2) in vec3 vertex_normal;
 layout (location = 0) out vec4 out_color;
 
 void main() {
-    out_color = color;
+    vec4 shaded = color;
+    if (LIGHTING == 1) {
+        // Object-space normal, from the vertices or else the face normal from screen-space
+        // derivatives. Two-sided, since winding isn't known.
+        vec3 normal = VERTEX_NORMALS ? normalize(vertex_normal) : normalize(cross(dFdx(position), dFdy(position)));
+        shaded.rgb *= 0.2 + 0.8 * abs(dot(normal, LIGHT_DIRECTION));
+    }
+    if (FOG) {
+        float depth = 1.0 / gl_FragCoord.w;
+        shaded = mix(FOG_COLOR, shaded, exp(-FOG_DENSITY * depth));
+    }
+    out_color = shaded;
 }
@@ -1,6 +1,8 @@
-#version 400
-#extension GL_ARB_separate_shader_objects : enable
-#extension GL_ARB_shading_language_420pack : enable
+#version 450
+
+// Set per pipeline with specialization constants.
+layout(constant_id = 0) const int VERTEX_FORMAT = 0; // 0: vec4 positions, 1: vec3 positions with w = 1.
+layout(constant_id = 1) const int NORMAL_FORMAT = 0; // 0: none, 1: vec3, 2: octahedral in two snorm components.
 
 layout(push_constant) uniform PushConstants {
 	mat4 mvp;
@@ -8,9 +10,22 @@ layout(push_constant) uniform PushConstants {
 
 layout(location = 0) in vec4 position;
 layout(location = 1) in vec4 color;
+layout(location = 2) in vec4 normal;
 layout(location = 0) out vec4 out_color;
+layout(location = 1) out vec3 out_position;
+layout(location = 2) out vec3 out_normal;
+
+vec3 decode_oct(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main() {
-    gl_Position = mvp * position;
+    vec4 p = VERTEX_FORMAT == 1 ? vec4(position.xyz, 1.0) : position;
+    gl_Position = mvp * p;
     out_color = color;
+    out_position = p.xyz;
+    out_normal = NORMAL_FORMAT == 2 ? decode_oct(normal.xy) : NORMAL_FORMAT == 1 ? normal.xyz : vec3(0.0);
 }
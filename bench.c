@@ -0,0 +1,200 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+static const char* METRIC_NAMES[BENCH_METRIC_COUNT] = {
+    [BENCH_CPU_FRAME]    = "cpu_frame_ms",
+    [BENCH_GPU_FRAME]    = "gpu_frame_ms",
+    [BENCH_ACQUIRE_WAIT] = "acquire_wait_ms",
+    [BENCH_PRESENT_WAIT] = "present_wait_ms",
+};
+
+uint64_t bench_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+double bench_elapsed_ms(uint64_t start_ns) {
+    return (double) (bench_time_ns() - start_ns) * 1e-6;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile, so every reported value is an actual sample.
+static double percentile(const double* sorted, uint32_t count, double p) {
+    uint32_t rank = (uint32_t) ceil(p * count);
+    return sorted[rank ? rank - 1 : 0];
+}
+
+Stats stats_compute(const double* samples, uint32_t count) {
+    Stats   stats  = {};
+    double* sorted = malloc(sizeof(*sorted) * (count ? count : 1));
+    double  sum    = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (samples[i] < 0.0) {
+            continue;
+        }
+        sorted[stats.count++] = samples[i];
+        sum += samples[i];
+    }
+
+    if (stats.count) {
+        qsort(sorted, stats.count, sizeof(*sorted), compare_doubles);
+        stats.mean   = sum / stats.count;
+        stats.median = percentile(sorted, stats.count, 0.50);
+        stats.p95    = percentile(sorted, stats.count, 0.95);
+        stats.p99    = percentile(sorted, stats.count, 0.99);
+        stats.max    = sorted[stats.count - 1];
+    }
+
+    free(sorted);
+    return stats;
+}
+
+void stats_print_header(const char* unit) {
+    printf("%-20s %10s %10s %10s %10s %10s %8s\n", unit, "mean", "median", "p95", "p99", "max", "samples");
+}
+
+void stats_print(const char* name, const Stats* stats) {
+    if (!stats->count) {
+        printf("%-20s %10s %10s %10s %10s %10s %8u\n", name, "n/a", "n/a", "n/a", "n/a", "n/a", 0);
+        return;
+    }
+    printf("%-20s %10.4f %10.4f %10.4f %10.4f %10.4f %8u\n", name, stats->mean, stats->median, stats->p95, stats->p99,
+           stats->max, stats->count);
+}
+
+Bench bench_create(BenchOptions options) {
+    Bench bench = {
+        .options  = options,
+        .capacity = options.frames ? options.frames : 1024,
+    };
+    for (uint32_t i = 0; i < BENCH_METRIC_COUNT; i++) {
+        bench.samples[i] = malloc(sizeof(double) * bench.capacity);
+    }
+    return bench;
+}
+
+void bench_destroy(Bench* bench) {
+    for (uint32_t i = 0; i < BENCH_METRIC_COUNT; i++) {
+        free(bench->samples[i]);
+    }
+}
+
+int bench_done(Bench* bench, uint32_t frame) {
+    const BenchOptions* options = &bench->options;
+    if (frame < options->warmup_frames) {
+        return 0;
+    }
+    if (frame == options->warmup_frames) {
+        bench->start_ns = bench_time_ns();
+    }
+    if (options->frames) {
+        return frame - options->warmup_frames >= options->frames;
+    }
+    return bench_elapsed_ms(bench->start_ns) >= options->seconds * 1000.0;
+}
+
+void bench_record(Bench* bench, uint32_t frame, BenchMetric metric, double ms) {
+    if (frame < bench->options.warmup_frames) {
+        return;
+    }
+    uint32_t index = frame - bench->options.warmup_frames;
+
+    while (index >= bench->capacity) {
+        bench->capacity *= 2;
+        for (uint32_t i = 0; i < BENCH_METRIC_COUNT; i++) {
+            bench->samples[i] = realloc(bench->samples[i], sizeof(double) * bench->capacity);
+        }
+    }
+    while (bench->count <= index) {
+        for (uint32_t i = 0; i < BENCH_METRIC_COUNT; i++) {
+            bench->samples[i][bench->count] = -1.0;
+        }
+        bench->count++;
+    }
+
+    bench->samples[metric][index] = ms;
+}
+
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static float unit_float(uint64_t bits) {
+    return (float) (bits >> 40) / (float) (1 << 24);
+}
+
+// The camera is fixed and the cube spins about a seed-derived axis at a fixed rate per frame, so
+// the sequence of MVPs depends only on the seed and the frame number, never on wall-clock time.
+Mat4 bench_mvp(const Bench* bench, uint32_t frame, float aspect) {
+    uint64_t h0   = splitmix64(bench->options.seed);
+    uint64_t h1   = splitmix64(h0);
+    Vec3     axis = { unit_float(h0) - 0.5f, 1.0f, unit_float(h1) - 0.5f };
+
+    Mat4 projection = mat4_perspective(M_PI / 4.0f, aspect, 0.1f, 100.0f);
+    Mat4 view       = mat4_look_at((Vec3){ -5, 3, -10 }, (Vec3){ 0, 0, 0 }, (Vec3){ 0, -1, 0 });
+    Mat4 model      = mat4_rotate(axis, (float) (frame % 360) * (float) (M_PI / 180.0));
+
+    Mat4 view_projection = mat4_mul(&projection, &view);
+    return mat4_mul(&view_projection, &model);
+}
+
+static void write_csv(const Bench* bench, FILE* file) {
+    fprintf(file, "frame");
+    for (uint32_t m = 0; m < BENCH_METRIC_COUNT; m++) {
+        fprintf(file, ",%s", METRIC_NAMES[m]);
+    }
+    fprintf(file, "\n");
+
+    for (uint32_t i = 0; i < bench->count; i++) {
+        fprintf(file, "%u", i);
+        for (uint32_t m = 0; m < BENCH_METRIC_COUNT; m++) {
+            double ms = bench->samples[m][i];
+            if (ms < 0.0) {
+                fprintf(file, ",");
+            } else {
+                fprintf(file, ",%.4f", ms);
+            }
+        }
+        fprintf(file, "\n");
+    }
+}
+
+void bench_report(const Bench* bench, const char* device_name, uint32_t width, uint32_t height) {
+    printf("bench: device=\"%s\" extent=%ux%u warmup=%u frames=%u seed=0x%08x\n", device_name, width, height,
+           bench->options.warmup_frames, bench->count, bench->options.seed);
+
+    stats_print_header("metric");
+    for (uint32_t m = 0; m < BENCH_METRIC_COUNT; m++) {
+        Stats stats = stats_compute(bench->samples[m], bench->count);
+        stats_print(METRIC_NAMES[m], &stats);
+    }
+
+    if (!bench->options.csv_path) {
+        printf("csv:\n");
+        write_csv(bench, stdout);
+        return;
+    }
+
+    FILE* file = fopen(bench->options.csv_path, "w");
+    if (!file) {
+        fprintf(stderr, "bench: could not open '%s' for writing\n", bench->options.csv_path);
+        return;
+    }
+    write_csv(bench, file);
+    fclose(file);
+    printf("csv: %s\n", bench->options.csv_path);
+}
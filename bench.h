@@ -0,0 +1,54 @@
+#ifndef bench_h
+#define bench_h
+#include <stdint.h>
+#include "linalg.h"
+
+#define BENCH_DEFAULT_SEED 0x3d3d3d3du
+
+typedef struct {
+    double   mean;
+    double   median;
+    double   p95;
+    double   p99;
+    double   max;
+    uint32_t count;
+} Stats;
+
+typedef enum {
+    BENCH_CPU_FRAME,
+    BENCH_GPU_FRAME,
+    BENCH_ACQUIRE_WAIT,
+    BENCH_PRESENT_WAIT,
+    BENCH_METRIC_COUNT,
+} BenchMetric;
+
+typedef struct {
+    uint32_t    warmup_frames;
+    uint32_t    frames; // Zero means run for `seconds` instead of a fixed frame count.
+    double      seconds;
+    uint32_t    seed;
+    const char* csv_path; // NULL prints the CSV to stdout after the summary.
+} BenchOptions;
+
+typedef struct {
+    BenchOptions options;
+    uint64_t     start_ns;
+    uint32_t     count;
+    uint32_t     capacity;
+    double*      samples[BENCH_METRIC_COUNT]; // Milliseconds, indexed by measured frame. Negative means missing.
+} Bench;
+
+uint64_t bench_time_ns();
+double   bench_elapsed_ms(uint64_t start_ns);
+Stats    stats_compute(const double* samples, uint32_t count);
+void     stats_print_header(const char* unit);
+void     stats_print(const char* name, const Stats* stats);
+
+Bench bench_create(BenchOptions options);
+void  bench_destroy(Bench* bench);
+int   bench_done(Bench* bench, uint32_t frame);
+void  bench_record(Bench* bench, uint32_t frame, BenchMetric metric, double ms);
+Mat4  bench_mvp(const Bench* bench, uint32_t frame, float aspect);
+void  bench_report(const Bench* bench, const char* device_name, uint32_t width, uint32_t height);
+
+#endif
@@ -0,0 +1,402 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bvh.h"
+
+#define BIN_COUNT 16
+// Nodes this small become leaves, and bigger ones only when splitting wouldn't be cheaper.
+#define LEAF_MIN 2
+#define LEAF_MAX 8
+// Past this depth nodes are split in half by count, bounding the depth for degenerate inputs.
+#define DEPTH_MAX 48
+// Queries push at most one node per level beyond the one they visit.
+#define STACK_SIZE 128
+// Traversing a node against testing an object, in the cost model.
+#define TRAVERSAL_COST 1.0f
+
+// What the build sorts: a copy of each object's bounds next to its index, so partitioning moves
+// them together and binning reads memory in order rather than indexing the caller's array.
+typedef struct {
+    Aabb     bounds;
+    Vec3     centroid;
+    uint32_t object;
+} BuildRef;
+
+static Aabb aabb_empty() {
+    return (Aabb){ { 1e30f, 1e30f, 1e30f }, { -1e30f, -1e30f, -1e30f } };
+}
+
+static Aabb aabb_union(Aabb a, Aabb b) {
+    return (Aabb){
+        { fminf(a.min.x, b.min.x), fminf(a.min.y, b.min.y), fminf(a.min.z, b.min.z) },
+        { fmaxf(a.max.x, b.max.x), fmaxf(a.max.y, b.max.y), fmaxf(a.max.z, b.max.z) },
+    };
+}
+
+static Aabb aabb_add_point(Aabb a, Vec3 p) {
+    return aabb_union(a, (Aabb){ p, p });
+}
+
+static float aabb_area(Aabb a) {
+    float x = a.max.x - a.min.x;
+    float y = a.max.y - a.min.y;
+    float z = a.max.z - a.min.z;
+    return x < 0.0f ? 0.0f : 2.0f * (x * y + y * z + z * x);
+}
+
+static float axis_of(Vec3 v, int axis) {
+    return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+static Aabb node_bounds(const BvhNode* node) {
+    return (Aabb){ node->min, node->max };
+}
+
+static void set_node_bounds(BvhNode* node, Aabb bounds) {
+    node->min = bounds.min;
+    node->max = bounds.max;
+}
+
+static uint32_t bin_of(float centroid, float min, float scale, uint32_t bin_count) {
+    int bin = (int) ((centroid - min) * scale);
+    return bin < 0 ? 0 : bin >= (int) bin_count ? bin_count - 1 : (uint32_t) bin;
+}
+
+// Fills nodes[index] with refs [begin, end), then its subtrees after it.
+static void build_node(Bvh* bvh, BuildRef* refs, uint32_t index, uint32_t begin, uint32_t end, uint32_t depth) {
+    Aabb bounds  = aabb_empty();
+    Aabb centers = aabb_empty();
+    for (uint32_t i = begin; i < end; i++) {
+        bounds  = aabb_union(bounds, refs[i].bounds);
+        centers = aabb_add_point(centers, refs[i].centroid);
+    }
+    BvhNode* node = &bvh->nodes[index];
+    set_node_bounds(node, bounds);
+    node->offset = begin;
+    node->count  = end - begin;
+    if (end - begin <= LEAF_MIN) {
+        return;
+    }
+
+    // Bin every ref on all three axes in one pass, then sweep each axis's bins from both sides for
+    // the split with the least area-weighted object count. Small nodes, which are most of them, use
+    // fewer bins than objects.
+    uint32_t bin_count = end - begin < BIN_COUNT ? end - begin : BIN_COUNT;
+    float    mins[3]   = { centers.min.x, centers.min.y, centers.min.z };
+    float    scales[3] = {};
+    Aabb     bin_bounds[3][BIN_COUNT];
+    uint32_t bin_counts[3][BIN_COUNT] = {};
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = axis_of(centers.max, axis) - mins[axis];
+        scales[axis] = extent > 0.0f && depth < DEPTH_MAX ? bin_count / extent : 0.0f;
+        for (uint32_t b = 0; b < bin_count; b++) {
+            bin_bounds[axis][b] = aabb_empty();
+        }
+    }
+    for (uint32_t i = begin; i < end; i++) {
+        const float* centroid = &refs[i].centroid.x;
+        for (int axis = 0; axis < 3; axis++) {
+            uint32_t b          = bin_of(centroid[axis], mins[axis], scales[axis], bin_count);
+            bin_bounds[axis][b] = aabb_union(bin_bounds[axis][b], refs[i].bounds);
+            bin_counts[axis][b]++;
+        }
+    }
+    float    best_cost  = 1e30f;
+    int      best_axis  = -1;
+    uint32_t best_split = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        if (scales[axis] == 0.0f) {
+            continue;
+        }
+        float    right_area[BIN_COUNT];
+        uint32_t right_count[BIN_COUNT];
+        Aabb     right = aabb_empty();
+        uint32_t count = 0;
+        for (uint32_t b = bin_count - 1; b > 0; b--) {
+            right          = aabb_union(right, bin_bounds[axis][b]);
+            count         += bin_counts[axis][b];
+            right_area[b]  = aabb_area(right);
+            right_count[b] = count;
+        }
+        Aabb left = aabb_empty();
+        count     = 0;
+        for (uint32_t split = 1; split < bin_count; split++) {
+            left   = aabb_union(left, bin_bounds[axis][split - 1]);
+            count += bin_counts[axis][split - 1];
+            float cost = count * aabb_area(left) + right_count[split] * right_area[split];
+            if (count && right_count[split] && cost < best_cost) {
+                best_cost  = cost;
+                best_axis  = axis;
+                best_split = split;
+            }
+        }
+    }
+
+    uint32_t middle = begin + (end - begin) / 2;
+    if (best_axis >= 0) {
+        float area = aabb_area(bounds);
+        if (area > 0.0f && TRAVERSAL_COST + best_cost / area >= end - begin && end - begin <= LEAF_MAX) {
+            return;
+        }
+        BuildRef* left  = refs + begin;
+        BuildRef* right = refs + end;
+        while (left < right) {
+            uint32_t bin = bin_of(axis_of(left->centroid, best_axis), mins[best_axis], scales[best_axis], bin_count);
+            if (bin < best_split) {
+                left++;
+            } else {
+                BuildRef swap = *left;
+                *left         = *--right;
+                *right        = swap;
+            }
+        }
+        middle = (uint32_t) (left - refs);
+    } else if (end - begin <= LEAF_MAX) {
+        // Every centroid is in one place, so no split separates them.
+        return;
+    }
+
+    node->count = 0;
+    build_node(bvh, refs, bvh->node_count++, begin, middle, depth + 1);
+    bvh->nodes[index].offset = bvh->node_count++;
+    build_node(bvh, refs, bvh->nodes[index].offset, middle, end, depth + 1);
+}
+
+void bvh_build(Bvh* bvh, const Aabb* bounds, uint32_t count) {
+    *bvh = (Bvh){
+        .nodes        = malloc(sizeof(BvhNode) * (count ? 2 * count - 1 : 1)),
+        .objects      = malloc(sizeof(uint32_t) * (count ? count : 1)),
+        .bounds       = malloc(sizeof(Aabb) * (count ? count : 1)),
+        .object_count = count,
+    };
+    BuildRef* refs = malloc(sizeof(BuildRef) * (count ? count : 1));
+    for (uint32_t i = 0; i < count; i++) {
+        Vec3 centroid = {
+            0.5f * (bounds[i].min.x + bounds[i].max.x),
+            0.5f * (bounds[i].min.y + bounds[i].max.y),
+            0.5f * (bounds[i].min.z + bounds[i].max.z),
+        };
+        refs[i] = (BuildRef){ bounds[i], centroid, i };
+    }
+    bvh->node_count = 1;
+    build_node(bvh, refs, 0, 0, count, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        bvh->objects[i] = refs[i].object;
+        bvh->bounds[i]  = refs[i].bounds;
+    }
+    free(refs);
+}
+
+void bvh_destroy(Bvh* bvh) {
+    free(bvh->nodes);
+    free(bvh->objects);
+    free(bvh->bounds);
+    *bvh = (Bvh){};
+}
+
+// Children come after their parent, so walking backwards sees both children before each parent.
+void bvh_refit(Bvh* bvh, const Aabb* bounds) {
+    if (!bvh->object_count) {
+        return;
+    }
+    for (uint32_t i = 0; i < bvh->object_count; i++) {
+        bvh->bounds[i] = bounds[bvh->objects[i]];
+    }
+    for (uint32_t i = bvh->node_count; i-- > 0;) {
+        BvhNode* node = &bvh->nodes[i];
+        Aabb     box  = aabb_empty();
+        if (node->count) {
+            for (uint32_t j = 0; j < node->count; j++) {
+                box = aabb_union(box, bvh->bounds[node->offset + j]);
+            }
+        } else {
+            box = aabb_union(node_bounds(&bvh->nodes[i + 1]), node_bounds(&bvh->nodes[node->offset]));
+        }
+        set_node_bounds(node, box);
+    }
+}
+
+float bvh_cost(const Bvh* bvh) {
+    float root = aabb_area(node_bounds(&bvh->nodes[0]));
+    if (root <= 0.0f) {
+        return 0.0f;
+    }
+    float cost = 0.0f;
+    for (uint32_t i = 0; i < bvh->node_count; i++) {
+        const BvhNode* node = &bvh->nodes[i];
+        cost += aabb_area(node_bounds(node)) / root * (node->count ? node->count : TRAVERSAL_COST);
+    }
+    return cost;
+}
+
+// Which side of the plane the box is on: -1 entirely outside, 1 entirely inside, 0 straddling. The
+// corner furthest along the normal decides outside, the nearest one inside.
+static int classify(Vec3 min, Vec3 max, const float plane[4]) {
+    float far  = plane[0] * (plane[0] > 0.0f ? max.x : min.x) + plane[1] * (plane[1] > 0.0f ? max.y : min.y)
+              + plane[2] * (plane[2] > 0.0f ? max.z : min.z) + plane[3];
+    float near = plane[0] * (plane[0] > 0.0f ? min.x : max.x) + plane[1] * (plane[1] > 0.0f ? min.y : max.y)
+               + plane[2] * (plane[2] > 0.0f ? min.z : max.z) + plane[3];
+    return far < 0.0f ? -1 : near >= 0.0f ? 1 : 0;
+}
+
+uint32_t bvh_cull(const Bvh* bvh, const float planes[6][4], uint32_t* visible, BvhStats* stats) {
+    if (!bvh->object_count) {
+        return 0;
+    }
+    // Each entry carries the planes its box isn't yet known to be inside of, as a bit mask.
+    uint32_t stack[STACK_SIZE];
+    uint8_t  masks[STACK_SIZE];
+    uint32_t top   = 0;
+    uint32_t count = 0;
+    uint64_t nodes = 0;
+    uint64_t tests = 0;
+    stack[top]     = 0;
+    masks[top++]   = 0x3f;
+    while (top) {
+        top--;
+        const BvhNode* node = &bvh->nodes[stack[top]];
+        uint32_t       mask = masks[top];
+        nodes++;
+        int outside = 0;
+        for (int p = 0; p < 6 && !outside; p++) {
+            if (mask & (1u << p)) {
+                int side = classify(node->min, node->max, planes[p]);
+                outside  = side < 0;
+                mask    &= side > 0 ? ~(1u << p) : ~0u;
+            }
+        }
+        if (outside) {
+            continue;
+        }
+        if (!mask) {
+            // Inside every plane: the subtree's objects are one contiguous run from its leftmost leaf
+            // to its rightmost, found by walking down its two edges.
+            const BvhNode* first = node;
+            const BvhNode* last  = node;
+            while (!first->count) {
+                first++;
+            }
+            while (!last->count) {
+                last = &bvh->nodes[last->offset];
+            }
+            uint32_t run = last->offset + last->count - first->offset;
+            memcpy(visible + count, bvh->objects + first->offset, sizeof(uint32_t) * run);
+            count += run;
+            continue;
+        }
+        if (!node->count) {
+            stack[top]   = node->offset;
+            masks[top++] = mask;
+            stack[top]   = (uint32_t) (node - bvh->nodes) + 1;
+            masks[top++] = mask;
+            continue;
+        }
+        for (uint32_t i = node->offset; i < node->offset + node->count; i++) {
+            int inside = 1;
+            for (int p = 0; p < 6 && inside; p++) {
+                inside = !(mask & (1u << p)) || classify(bvh->bounds[i].min, bvh->bounds[i].max, planes[p]) >= 0;
+            }
+            tests++;
+            if (inside) {
+                visible[count++] = bvh->objects[i];
+            }
+        }
+    }
+    if (stats) {
+        stats->nodes_visited  += nodes;
+        stats->objects_tested += tests;
+    }
+    return count;
+}
+
+// The distance at which the ray enters the box, or a negative number if it misses it or enters
+// beyond `max_distance`.
+static float ray_box(Vec3 min, Vec3 max, Vec3 origin, Vec3 inverse, float max_distance) {
+    float tx0   = (min.x - origin.x) * inverse.x;
+    float tx1   = (max.x - origin.x) * inverse.x;
+    float ty0   = (min.y - origin.y) * inverse.y;
+    float ty1   = (max.y - origin.y) * inverse.y;
+    float tz0   = (min.z - origin.z) * inverse.z;
+    float tz1   = (max.z - origin.z) * inverse.z;
+    float enter = fmaxf(fmaxf(fminf(tx0, tx1), fminf(ty0, ty1)), fmaxf(fminf(tz0, tz1), 0.0f));
+    float exit  = fminf(fminf(fmaxf(tx0, tx1), fmaxf(ty0, ty1)), fminf(fmaxf(tz0, tz1), max_distance));
+    return enter <= exit ? enter : -1.0f;
+}
+
+// Builds run with -ffast-math, which assumes no infinities, so axis-parallel rays get a huge finite
+// reciprocal instead.
+static float safe_inverse(float d) {
+    return 1.0f / (fabsf(d) > 1e-20f ? d : copysignf(1e-20f, d));
+}
+
+// Nearer children are visited first and anything entered beyond the best hit so far is skipped, so
+// a ray that hits something early visits few nodes.
+uint32_t bvh_raycast(const Bvh* bvh, Vec3 origin, Vec3 direction, float max_distance, BvhRayTest test, void* data,
+                     float* distance, BvhStats* stats) {
+    Vec3     inverse = { safe_inverse(direction.x), safe_inverse(direction.y), safe_inverse(direction.z) };
+    uint32_t best    = BVH_NONE;
+    float    nearest = max_distance;
+    uint64_t nodes   = 0;
+    uint64_t tests   = 0;
+    // Each entry carries the distance its box is entered at, which a hit found since may be nearer.
+    uint32_t stack[STACK_SIZE];
+    float    entries[STACK_SIZE];
+    uint32_t top = 0;
+    float    t   = bvh->object_count ? ray_box(bvh->nodes[0].min, bvh->nodes[0].max, origin, inverse, nearest) : -1.0f;
+    if (t >= 0.0f) {
+        stack[top]     = 0;
+        entries[top++] = t;
+    }
+    while (top) {
+        top--;
+        if (entries[top] > nearest) {
+            continue;
+        }
+        uint32_t       index = stack[top];
+        const BvhNode* node  = &bvh->nodes[index];
+        nodes++;
+        if (node->count) {
+            for (uint32_t i = node->offset; i < node->offset + node->count; i++) {
+                t = ray_box(bvh->bounds[i].min, bvh->bounds[i].max, origin, inverse, nearest);
+                if (t < 0.0f) {
+                    continue;
+                }
+                tests++;
+                t = test ? test(data, bvh->objects[i], origin, direction) : t;
+                if (t >= 0.0f && t < nearest) {
+                    nearest = t;
+                    best    = bvh->objects[i];
+                }
+            }
+            continue;
+        }
+        uint32_t near   = index + 1;
+        uint32_t far    = node->offset;
+        float    t_near = ray_box(bvh->nodes[near].min, bvh->nodes[near].max, origin, inverse, nearest);
+        float    t_far  = ray_box(bvh->nodes[far].min, bvh->nodes[far].max, origin, inverse, nearest);
+        if (t_far >= 0.0f && (t_near < 0.0f || t_far < t_near)) {
+            uint32_t swap = near;
+            near          = far;
+            far           = swap;
+            t             = t_near;
+            t_near        = t_far;
+            t_far         = t;
+        }
+        if (t_far >= 0.0f) {
+            stack[top]     = far;
+            entries[top++] = t_far;
+        }
+        if (t_near >= 0.0f) {
+            stack[top]     = near;
+            entries[top++] = t_near;
+        }
+    }
+    if (distance) {
+        *distance = nearest;
+    }
+    if (stats) {
+        stats->nodes_visited  += nodes;
+        stats->objects_tested += tests;
+    }
+    return best;
+}
@@ -0,0 +1,65 @@
+#ifndef bvh_h
+#define bvh_h
+#include <stdint.h>
+#include "linalg.h"
+
+#define BVH_NONE UINT32_MAX
+
+typedef struct {
+    Vec3 min;
+    Vec3 max;
+} Aabb;
+
+// 32 bytes, two to a cache line. Nodes are stored depth first, so an interior node's first child is
+// the next node and only the second needs an index; subtrees are contiguous and children always come
+// after their parent.
+typedef struct {
+    Vec3     min;
+    uint32_t offset; // Second child of an interior node, or a leaf's first entry in Bvh.objects.
+    Vec3     max;
+    uint32_t count; // Objects in a leaf, zero for interior nodes.
+} BvhNode;
+
+// A bounding volume hierarchy over object bounds. Leaves hold their objects' indices and a copy of
+// their bounds in leaf order, so testing a leaf reads contiguous memory.
+typedef struct {
+    BvhNode*  nodes;
+    uint32_t  node_count;
+    uint32_t* objects;
+    Aabb*     bounds; // Of objects[i], for each i.
+    uint32_t  object_count;
+} Bvh;
+
+// Work done by queries, accumulated over every query it's passed to.
+typedef struct {
+    uint64_t nodes_visited;
+    uint64_t objects_tested;
+} BvhStats;
+
+// Returns the distance along the ray to where it hits `object`, or a negative number for a miss.
+typedef float (*BvhRayTest)(void* data, uint32_t object, Vec3 origin, Vec3 direction);
+
+// Builds top down, splitting each node at the best of 16 bins per axis by the surface area
+// heuristic. Objects are indexed by their position in `bounds`.
+void bvh_build(Bvh* bvh, const Aabb* bounds, uint32_t count);
+void bvh_destroy(Bvh* bvh);
+
+// Updates every node's bounds for objects that have moved, keeping the tree. Much cheaper than a
+// build, but the tree gets worse as objects move away from where it was built; bvh_cost tracks that.
+void bvh_refit(Bvh* bvh, const Aabb* bounds);
+
+// The surface area heuristic cost of the tree: the expected number of nodes visited and objects
+// tested by a random ray that hits the root.
+float bvh_cost(const Bvh* bvh);
+
+// Writes the objects whose bounds aren't entirely outside one of `planes` (normalized, pointing
+// inwards) to `visible`, in no particular order, and returns how many there are. Subtrees entirely
+// inside a plane stop testing it, and subtrees inside all six are taken whole.
+uint32_t bvh_cull(const Bvh* bvh, const float planes[6][4], uint32_t* visible, BvhStats* stats);
+
+// The nearest object along the ray within `max_distance`, or BVH_NONE. Objects whose bounds the ray
+// hits are passed to `test`, or, if it's NULL, hit at their bounds. `distance` may be NULL.
+uint32_t bvh_raycast(const Bvh* bvh, Vec3 origin, Vec3 direction, float max_distance, BvhRayTest test, void* data,
+                     float* distance, BvhStats* stats);
+
+#endif
@@ -0,0 +1,177 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "capture.h"
+
+// BT.601 limited range, in 8.8 fixed point.
+static void write_y4m_frame(Capture* capture, const uint8_t* bgra, uint8_t* planes) {
+    uint32_t pixel_count = capture->width * capture->height;
+    uint8_t* y_plane     = planes;
+    uint8_t* u_plane     = planes + pixel_count;
+    uint8_t* v_plane     = planes + 2 * pixel_count;
+    for (uint32_t i = 0; i < pixel_count; i++) {
+        int b = bgra[4 * i + 0];
+        int g = bgra[4 * i + 1];
+        int r = bgra[4 * i + 2];
+
+        y_plane[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        u_plane[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+        v_plane[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    }
+
+    fputs("FRAME\n", capture->file);
+    fwrite(planes, 1, 3 * pixel_count, capture->file);
+    capture->bytes_written += 6 + 3 * pixel_count;
+}
+
+static void write_bgra_frame(Capture* capture, const uint8_t* bgra) {
+    size_t size = (size_t) capture->width * capture->height * 4;
+    fwrite(bgra, 1, size, capture->file);
+    capture->bytes_written += size;
+}
+
+static void* writer_main(void* arg) {
+    Capture* capture = arg;
+    uint8_t* planes  = NULL;
+    if (capture->options.format == CAPTURE_Y4M) {
+        planes = malloc((size_t) capture->width * capture->height * 3);
+    }
+
+    pthread_mutex_lock(&capture->mutex);
+    for (;;) {
+        while (!capture->count && !capture->quit) {
+            pthread_cond_wait(&capture->queued, &capture->mutex);
+        }
+        if (!capture->count) {
+            break;
+        }
+        ReadbackSlot* slot = capture->queue[capture->head];
+        capture->head      = (capture->head + 1) % READBACK_MAX_SLOTS;
+        capture->count--;
+        pthread_mutex_unlock(&capture->mutex);
+
+        uint64_t start = bench_time_ns();
+        if (capture->options.format == CAPTURE_Y4M) {
+            write_y4m_frame(capture, slot->memory.mapped, planes);
+        } else {
+            write_bgra_frame(capture, slot->memory.mapped);
+        }
+        capture->write_ns += bench_time_ns() - start;
+
+        pthread_mutex_lock(&capture->mutex);
+        readback_release(slot);
+        capture->frames_written++;
+        pthread_cond_signal(&capture->released);
+    }
+    pthread_mutex_unlock(&capture->mutex);
+
+    free(planes);
+    return NULL;
+}
+
+int capture_start(GPU* gpu, Capture* capture, CaptureOptions options, uint32_t width, uint32_t height,
+                  uint32_t frames_in_flight) {
+    memset(capture, 0, sizeof(*capture));
+    capture->options = options;
+    capture->width   = width;
+    capture->height  = height;
+
+    capture->file = fopen(options.path, "wb");
+    if (!capture->file) {
+        fprintf(stderr, "capture: could not open '%s' for writing\n", options.path);
+        return 0;
+    }
+    if (options.format == CAPTURE_Y4M) {
+        fprintf(capture->file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n", width, height, options.fps);
+    }
+
+    // Every frame in flight can hold a slot that is waiting on its fence, and the writer may hold up
+    // to `queue_depth` more. With that many slots, blocking only ever waits on the writer.
+    uint32_t slot_count = frames_in_flight + options.queue_depth;
+    if (slot_count > READBACK_MAX_SLOTS) {
+        slot_count = READBACK_MAX_SLOTS;
+    }
+    capture->readback = readback_create(gpu, slot_count, width, height);
+
+    pthread_mutex_init(&capture->mutex, NULL);
+    pthread_cond_init(&capture->queued, NULL);
+    pthread_cond_init(&capture->released, NULL);
+    pthread_create(&capture->thread, NULL, writer_main, capture);
+
+    return 1;
+}
+
+// Records a copy of the finished frame. Must be called after the render pass, before submission.
+void capture_frame(Capture* capture, VkCommandBuffer cmd, VkImage image, VkImageLayout layout, uint32_t frame) {
+    uint64_t start = bench_time_ns();
+
+    int recorded = readback_copy_image(&capture->readback, cmd, image, layout, capture->width, capture->height, frame);
+    if (!recorded && capture->options.policy == CAPTURE_BLOCK) {
+        uint64_t block_start = bench_time_ns();
+        pthread_mutex_lock(&capture->mutex);
+        while (!(recorded = readback_copy_image(&capture->readback, cmd, image, layout, capture->width,
+                                                capture->height, frame))) {
+            pthread_cond_wait(&capture->released, &capture->mutex);
+        }
+        pthread_mutex_unlock(&capture->mutex);
+        capture->blocked_ns += bench_time_ns() - block_start;
+    }
+
+    if (recorded) {
+        capture->frames_captured++;
+    } else {
+        capture->frames_dropped++;
+    }
+    capture->overhead_ns += bench_time_ns() - start;
+}
+
+// Called after waiting on the fence of `frame`; hands its copy to the writer thread.
+void capture_frame_complete(GPU* gpu, Capture* capture, uint32_t frame) {
+    uint64_t start = bench_time_ns();
+
+    readback_frame_complete(gpu, &capture->readback, frame);
+    ReadbackSlot* slot = readback_acquire(&capture->readback);
+    if (slot) {
+        pthread_mutex_lock(&capture->mutex);
+        assert(capture->count < READBACK_MAX_SLOTS);
+        capture->queue[(capture->head + capture->count) % READBACK_MAX_SLOTS] = slot;
+        capture->count++;
+        pthread_cond_signal(&capture->queued);
+        pthread_mutex_unlock(&capture->mutex);
+    }
+
+    capture->overhead_ns += bench_time_ns() - start;
+}
+
+// The device must be idle and every frame in flight passed to capture_frame_complete.
+void capture_stop(GPU* gpu, Capture* capture, uint32_t frames_rendered) {
+    pthread_mutex_lock(&capture->mutex);
+    capture->quit = 1;
+    pthread_cond_signal(&capture->queued);
+    pthread_mutex_unlock(&capture->mutex);
+    pthread_join(capture->thread, NULL);
+
+    pthread_mutex_destroy(&capture->mutex);
+    pthread_cond_destroy(&capture->queued);
+    pthread_cond_destroy(&capture->released);
+    readback_destroy(gpu, &capture->readback);
+    fclose(capture->file);
+
+    double frames = frames_rendered ? frames_rendered : 1;
+    printf("capture: path='%s' format=%s policy=%s frames=%u dropped=%u written=%u\n", capture->options.path,
+           capture->options.format == CAPTURE_Y4M ? "y4m" : "bgra",
+           capture->options.policy == CAPTURE_DROP ? "drop" : "block", capture->frames_captured,
+           capture->frames_dropped, capture->frames_written);
+    printf("capture: render thread overhead %.4f ms/frame (%.4f ms/frame blocked on the writer)\n",
+           capture->overhead_ns * 1e-6 / frames, capture->blocked_ns * 1e-6 / frames);
+    if (capture->write_ns) {
+        printf("capture: writer %.1f MiB/s, %.4f ms/frame\n",
+               capture->bytes_written / (1024.0 * 1024.0) / (capture->write_ns * 1e-9),
+               capture->write_ns * 1e-6 / (capture->frames_written ? capture->frames_written : 1));
+    }
+    if (capture->options.format == CAPTURE_RAW_BGRA) {
+        printf("capture: play with `ffplay -f rawvideo -pixel_format bgra -video_size %ux%u %s`\n", capture->width,
+               capture->height, capture->options.path);
+    }
+}
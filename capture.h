@@ -0,0 +1,55 @@
+#ifndef capture_h
+#define capture_h
+#include <pthread.h>
+#include <stdio.h>
+#include "readback.h"
+
+typedef enum {
+    CAPTURE_Y4M,      // YUV 4:4:4, playable with most video tools.
+    CAPTURE_RAW_BGRA, // Frames exactly as read back, back to back.
+} CaptureFormat;
+
+typedef enum {
+    CAPTURE_DROP,  // Skip frames when the writer falls behind, so frame pacing is unaffected.
+    CAPTURE_BLOCK, // Wait for the writer, so no frame is lost.
+} CapturePolicy;
+
+typedef struct {
+    const char*   path;
+    CaptureFormat format;
+    CapturePolicy policy;
+    uint32_t      queue_depth; // Completed frames that may wait for the writer.
+    uint32_t      fps;         // Only recorded in the Y4M header.
+} CaptureOptions;
+
+typedef struct {
+    CaptureOptions  options;
+    FILE*           file;
+    Readback        readback;
+    uint32_t        width;
+    uint32_t        height;
+    pthread_t       thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t  queued;
+    pthread_cond_t  released;
+    ReadbackSlot*   queue[READBACK_MAX_SLOTS];
+    uint32_t        head;
+    uint32_t        count;
+    int             quit;
+
+    uint32_t frames_captured;
+    uint32_t frames_dropped;
+    uint32_t frames_written;
+    uint64_t bytes_written;
+    uint64_t overhead_ns; // Render thread time spent in capture calls, including blocking.
+    uint64_t blocked_ns;
+    uint64_t write_ns;
+} Capture;
+
+int  capture_start(GPU* gpu, Capture* capture, CaptureOptions options, uint32_t width, uint32_t height,
+                   uint32_t frames_in_flight);
+void capture_frame(Capture* capture, VkCommandBuffer cmd, VkImage image, VkImageLayout layout, uint32_t frame);
+void capture_frame_complete(GPU* gpu, Capture* capture, uint32_t frame);
+void capture_stop(GPU* gpu, Capture* capture, uint32_t frames_rendered);
+
+#endif
@@ -0,0 +1,273 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cull.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CULL_X86 1
+#include <immintrin.h>
+#endif
+
+// Padding spheres fail every plane test, whatever the plane.
+#define PADDING_RADIUS -1e30f
+// Objects per job. Enough that queueing a job is noise, and a multiple of CULL_BATCH.
+#define CHUNK_MIN 16384
+
+const char* const CULL_KERNEL_NAMES[CULL_KERNEL_COUNT] = { "scalar", "sse", "avx2", "avx512" };
+
+typedef uint32_t (*CullFunction)(const CullSpheres* spheres, const float planes[6][4], uint32_t begin, uint32_t end,
+                                 uint32_t* visible);
+
+static float* allocate_array(uint32_t capacity, float value) {
+    float* array = aligned_alloc(64, sizeof(float) * capacity);
+    for (uint32_t i = 0; i < capacity; i++) {
+        array[i] = value;
+    }
+    return array;
+}
+
+void cull_spheres_create(CullSpheres* spheres, uint32_t count) {
+    uint32_t capacity = count ? (count + CULL_BATCH - 1) / CULL_BATCH * CULL_BATCH : CULL_BATCH;
+    *spheres          = (CullSpheres){
+        .x        = allocate_array(capacity, 0.0f),
+        .y        = allocate_array(capacity, 0.0f),
+        .z        = allocate_array(capacity, 0.0f),
+        .radius   = allocate_array(capacity, PADDING_RADIUS),
+        .count    = count,
+        .capacity = capacity,
+    };
+    memset(spheres->radius, 0, sizeof(float) * count);
+}
+
+void cull_spheres_destroy(CullSpheres* spheres) {
+    free(spheres->x);
+    free(spheres->y);
+    free(spheres->z);
+    free(spheres->radius);
+    *spheres = (CullSpheres){};
+}
+
+void cull_spheres_set(CullSpheres* spheres, uint32_t index, Vec3 center, float radius) {
+    assert(index < spheres->count);
+    spheres->x[index]      = center.x;
+    spheres->y[index]      = center.y;
+    spheres->z[index]      = center.z;
+    spheres->radius[index] = radius;
+}
+
+// Kernels test [begin, end), both multiples of CULL_BATCH, and append the visible indices to `visible`.
+// A sphere is visible when dot(plane.xyz, center) + plane.w + radius >= 0 for all six planes.
+
+static uint32_t cull_scalar(const CullSpheres* spheres, const float planes[6][4], uint32_t begin, uint32_t end,
+                            uint32_t* visible) {
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i++) {
+        int inside = 1;
+        for (int p = 0; p < 6; p++) {
+            float d = planes[p][0] * spheres->x[i] + planes[p][1] * spheres->y[i] + planes[p][2] * spheres->z[i]
+                    + planes[p][3] + spheres->radius[i];
+            inside &= d >= 0.0f;
+        }
+        if (inside) {
+            visible[count++] = i;
+        }
+    }
+    return count;
+}
+
+#ifdef CULL_X86
+static uint32_t append_mask(uint32_t* visible, uint32_t count, uint32_t base, uint32_t mask) {
+    while (mask) {
+        visible[count++] = base + __builtin_ctz(mask);
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+static uint32_t cull_sse(const CullSpheres* spheres, const float planes[6][4], uint32_t begin, uint32_t end,
+                         uint32_t* visible) {
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; p++) {
+        px[p] = _mm_set1_ps(planes[p][0]);
+        py[p] = _mm_set1_ps(planes[p][1]);
+        pz[p] = _mm_set1_ps(planes[p][2]);
+        pw[p] = _mm_set1_ps(planes[p][3]);
+    }
+    __m128   zero  = _mm_setzero_ps();
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i += 8) {
+        uint32_t mask = 0;
+        for (uint32_t half = 0; half < 8; half += 4) {
+            __m128 x      = _mm_load_ps(spheres->x + i + half);
+            __m128 y      = _mm_load_ps(spheres->y + i + half);
+            __m128 z      = _mm_load_ps(spheres->z + i + half);
+            __m128 r      = _mm_load_ps(spheres->radius + i + half);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; p++) {
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+                                      _mm_add_ps(_mm_mul_ps(pz[p], z), _mm_add_ps(pw[p], r)));
+                inside   = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+            }
+            mask |= (uint32_t) _mm_movemask_ps(inside) << half;
+        }
+        count = append_mask(visible, count, i, mask);
+    }
+    return count;
+}
+
+__attribute__((target("avx2,fma"))) static uint32_t cull_avx2(const CullSpheres* spheres, const float planes[6][4],
+                                                              uint32_t begin, uint32_t end, uint32_t* visible) {
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; p++) {
+        px[p] = _mm256_set1_ps(planes[p][0]);
+        py[p] = _mm256_set1_ps(planes[p][1]);
+        pz[p] = _mm256_set1_ps(planes[p][2]);
+        pw[p] = _mm256_set1_ps(planes[p][3]);
+    }
+    __m256   zero  = _mm256_setzero_ps();
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i += 8) {
+        __m256 x      = _mm256_load_ps(spheres->x + i);
+        __m256 y      = _mm256_load_ps(spheres->y + i);
+        __m256 z      = _mm256_load_ps(spheres->z + i);
+        __m256 r      = _mm256_load_ps(spheres->radius + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 d = _mm256_add_ps(pw[p], r);
+            d        = _mm256_fmadd_ps(pz[p], z, d);
+            d        = _mm256_fmadd_ps(py[p], y, d);
+            d        = _mm256_fmadd_ps(px[p], x, d);
+            inside   = _mm256_and_ps(inside, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+        }
+        count = append_mask(visible, count, i, (uint32_t) _mm256_movemask_ps(inside));
+    }
+    return count;
+}
+
+__attribute__((target("avx512f"))) static uint32_t cull_avx512(const CullSpheres* spheres, const float planes[6][4],
+                                                               uint32_t begin, uint32_t end, uint32_t* visible) {
+    __m512 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; p++) {
+        px[p] = _mm512_set1_ps(planes[p][0]);
+        py[p] = _mm512_set1_ps(planes[p][1]);
+        pz[p] = _mm512_set1_ps(planes[p][2]);
+        pw[p] = _mm512_set1_ps(planes[p][3]);
+    }
+    __m512   zero  = _mm512_setzero_ps();
+    __m512i  lanes = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i += 16) {
+        __m512    x      = _mm512_load_ps(spheres->x + i);
+        __m512    y      = _mm512_load_ps(spheres->y + i);
+        __m512    z      = _mm512_load_ps(spheres->z + i);
+        __m512    r      = _mm512_load_ps(spheres->radius + i);
+        __mmask16 inside = 0xffff;
+        for (int p = 0; p < 6; p++) {
+            __m512 d = _mm512_add_ps(pw[p], r);
+            d        = _mm512_fmadd_ps(pz[p], z, d);
+            d        = _mm512_fmadd_ps(py[p], y, d);
+            d        = _mm512_fmadd_ps(px[p], x, d);
+            inside   = _mm512_mask_cmp_ps_mask(inside, d, zero, _CMP_GE_OQ);
+        }
+        _mm512_mask_compressstoreu_epi32(visible + count, inside, _mm512_add_epi32(_mm512_set1_epi32(i), lanes));
+        count += __builtin_popcount(inside);
+    }
+    return count;
+}
+#endif
+
+static const CullFunction KERNELS[CULL_KERNEL_COUNT] = {
+    cull_scalar,
+#ifdef CULL_X86
+    cull_sse,
+    cull_avx2,
+    cull_avx512,
+#endif
+};
+
+int cull_kernel_supported(CullKernel kernel) {
+    switch (kernel) {
+    case CULL_KERNEL_SCALAR:
+        return 1;
+#ifdef CULL_X86
+    case CULL_KERNEL_SSE:
+        return __builtin_cpu_supports("sse2");
+    case CULL_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case CULL_KERNEL_AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return 0;
+    }
+}
+
+CullKernel cull_kernel_best() {
+    CullKernel best = CULL_KERNEL_SCALAR;
+    for (CullKernel kernel = CULL_KERNEL_SCALAR; kernel < CULL_KERNEL_COUNT; kernel++) {
+        best = cull_kernel_supported(kernel) ? kernel : best;
+    }
+    return best;
+}
+
+static CullFunction kernel_function(CullKernel kernel) {
+    return KERNELS[cull_kernel_supported(kernel) ? kernel : cull_kernel_best()];
+}
+
+uint32_t cull_spheres(const CullSpheres* spheres, const float planes[6][4], CullKernel kernel, uint32_t* visible) {
+    return kernel_function(kernel)(spheres, planes, 0, spheres->capacity, visible);
+}
+
+typedef struct {
+    Job                job;
+    CullFunction       function;
+    const CullSpheres* spheres;
+    const float        (*planes)[4];
+    uint32_t           begin;
+    uint32_t           end;
+    uint32_t*          visible; // The chunk's results start at visible + begin.
+    uint32_t           count;
+} CullChunk;
+
+static void run_chunk(void* data) {
+    CullChunk* chunk = data;
+    chunk->count     = chunk->function(chunk->spheres, chunk->planes, chunk->begin, chunk->end,
+                                       chunk->visible + chunk->begin);
+}
+
+// Each chunk writes its visible indices where its own objects would go, so chunks never overlap, and
+// the results are then moved down behind each other. About four chunks per thread even out chunks
+// that cull more or less than others.
+uint32_t cull_spheres_parallel(JobSystem* jobs, const CullSpheres* spheres, const float planes[6][4],
+                               CullKernel kernel, uint32_t* visible) {
+    CullFunction function   = kernel_function(kernel);
+    uint32_t     chunk_size = spheres->capacity / (4 * (jobs->thread_count + 1));
+    chunk_size              = (chunk_size + CULL_BATCH - 1) / CULL_BATCH * CULL_BATCH;
+    chunk_size              = chunk_size > CHUNK_MIN ? chunk_size : CHUNK_MIN;
+    uint32_t chunk_count    = (spheres->capacity + chunk_size - 1) / chunk_size;
+    if (chunk_count == 1) {
+        return function(spheres, planes, 0, spheres->capacity, visible);
+    }
+
+    CullChunk* chunks = malloc(sizeof(CullChunk) * chunk_count);
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        uint32_t end = (i + 1) * chunk_size;
+        chunks[i]    = (CullChunk){
+            .function = function,
+            .spheres  = spheres,
+            .planes   = planes,
+            .begin    = i * chunk_size,
+            .end      = end < spheres->capacity ? end : spheres->capacity,
+            .visible  = visible,
+        };
+        job_submit(jobs, &chunks[i].job, run_chunk, &chunks[i]);
+    }
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        job_wait(jobs, &chunks[i].job);
+        memmove(visible + count, visible + chunks[i].begin, sizeof(uint32_t) * chunks[i].count);
+        count += chunks[i].count;
+    }
+    free(chunks);
+    return count;
+}
@@ -0,0 +1,52 @@
+#ifndef cull_h
+#define cull_h
+#include <stdint.h>
+#include "job.h"
+#include "linalg.h"
+
+// Arrays are padded to a multiple of this, the widest kernel's batch, so no kernel has a tail.
+#define CULL_BATCH 16
+
+typedef enum {
+    CULL_KERNEL_SCALAR,
+    CULL_KERNEL_SSE,    // Eight objects per iteration in two 4-wide halves.
+    CULL_KERNEL_AVX2,   // Eight objects per iteration, with FMA.
+    CULL_KERNEL_AVX512, // Sixteen objects per iteration, compacted with a compress store.
+    CULL_KERNEL_COUNT,
+} CullKernel;
+
+extern const char* const CULL_KERNEL_NAMES[CULL_KERNEL_COUNT];
+
+// Bounding spheres in structure-of-arrays form, each array 64-byte aligned so a batch is one aligned
+// load per component. Padding entries have a negative radius and are never visible.
+typedef struct {
+    float*   x;
+    float*   y;
+    float*   z;
+    float*   radius;
+    uint32_t count;
+    uint32_t capacity; // `count` rounded up to CULL_BATCH.
+} CullSpheres;
+
+// All spheres start at the origin with zero radius.
+void cull_spheres_create(CullSpheres* spheres, uint32_t count);
+void cull_spheres_destroy(CullSpheres* spheres);
+
+void cull_spheres_set(CullSpheres* spheres, uint32_t index, Vec3 center, float radius);
+
+// Whether this CPU and OS run `kernel`, and the widest kernel they run. Culling with an unsupported
+// kernel uses the widest one instead.
+int        cull_kernel_supported(CullKernel kernel);
+CullKernel cull_kernel_best();
+
+// Writes the indices of the spheres not entirely outside one of `planes` (normalized, pointing
+// inwards, e.g. from mat4_frustum_planes) to `visible` in ascending order and returns how many there
+// are. `visible` must have room for every sphere.
+uint32_t cull_spheres(const CullSpheres* spheres, const float planes[6][4], CullKernel kernel, uint32_t* visible);
+
+// cull_spheres split into chunks on the job system, with the calling thread helping. The result is
+// the same, in the same order.
+uint32_t cull_spheres_parallel(JobSystem* jobs, const CullSpheres* spheres, const float planes[6][4],
+                               CullKernel kernel, uint32_t* visible);
+
+#endif
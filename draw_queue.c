@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+#include "draw_queue.h"
+
+#define RADIX_BITS   8
+#define RADIX_SIZE   (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+// Keys per job. Below this a pass is quicker on one thread than queueing jobs.
+#define CHUNK_MIN 16384
+
+#define PASS_SHIFT     60
+#define PIPELINE_SHIFT 48
+#define MATERIAL_SHIFT 32
+#define DEPTH_SHIFT    8
+
+uint64_t draw_key(DrawPass pass, uint32_t pipeline, uint32_t material, float depth) {
+    uint32_t bits;
+    depth = depth > 0.0f ? depth : 0.0f;
+    memcpy(&bits, &depth, sizeof(bits));
+    bits >>= 8;
+    if (pass == DRAW_PASS_TRANSPARENT) {
+        bits = ~bits & 0xffffff;
+    }
+    return (uint64_t) (pass & 0xf) << PASS_SHIFT | (uint64_t) (pipeline & 0xfff) << PIPELINE_SHIFT
+         | (uint64_t) (material & 0xffff) << MATERIAL_SHIFT | (uint64_t) bits << DEPTH_SHIFT;
+}
+
+static void reserve(DrawQueue* queue, uint32_t capacity) {
+    if (capacity <= queue->capacity) {
+        return;
+    }
+    queue->packets       = realloc(queue->packets, sizeof(DrawPacket) * capacity);
+    queue->keys          = realloc(queue->keys, sizeof(uint64_t) * capacity);
+    queue->order         = realloc(queue->order, sizeof(uint32_t) * capacity);
+    queue->scratch_keys  = realloc(queue->scratch_keys, sizeof(uint64_t) * capacity);
+    queue->scratch_order = realloc(queue->scratch_order, sizeof(uint32_t) * capacity);
+    queue->capacity      = capacity;
+}
+
+void draw_queue_create(DrawQueue* queue, uint32_t capacity) {
+    *queue = (DrawQueue){};
+    reserve(queue, capacity ? capacity : 1);
+}
+
+void draw_queue_destroy(DrawQueue* queue) {
+    free(queue->packets);
+    free(queue->keys);
+    free(queue->order);
+    free(queue->scratch_keys);
+    free(queue->scratch_order);
+    *queue = (DrawQueue){};
+}
+
+void draw_queue_reset(DrawQueue* queue) {
+    queue->count = 0;
+}
+
+void draw_queue_push(DrawQueue* queue, uint64_t key, const DrawPacket* packet) {
+    if (queue->count == queue->capacity) {
+        reserve(queue, 2 * queue->capacity);
+    }
+    queue->packets[queue->count] = *packet;
+    queue->keys[queue->count]    = key;
+    queue->order[queue->count]   = queue->count;
+    queue->count++;
+}
+
+// A contiguous range of the keys being sorted. Its histogram of the current digit becomes, after
+// the prefix sum, where its first key with each digit goes, so chunks scatter independently and
+// the sort stays stable.
+typedef struct {
+    Job             job;
+    const uint64_t* keys;
+    const uint32_t* order;
+    uint64_t*       out_keys;
+    uint32_t*       out_order;
+    uint32_t        begin;
+    uint32_t        end;
+    uint32_t        shift;
+    uint64_t        varying; // Bits that differ from the first key.
+    uint32_t        offsets[RADIX_SIZE];
+} SortChunk;
+
+static void find_varying(void* data) {
+    SortChunk* chunk   = data;
+    uint64_t   first   = chunk->keys[0];
+    uint64_t   varying = 0;
+    for (uint32_t i = chunk->begin; i < chunk->end; i++) {
+        varying |= chunk->keys[i] ^ first;
+    }
+    chunk->varying = varying;
+}
+
+static void count_digits(void* data) {
+    SortChunk* chunk = data;
+    memset(chunk->offsets, 0, sizeof(chunk->offsets));
+    for (uint32_t i = chunk->begin; i < chunk->end; i++) {
+        chunk->offsets[(chunk->keys[i] >> chunk->shift) & (RADIX_SIZE - 1)]++;
+    }
+}
+
+static void scatter(void* data) {
+    SortChunk* chunk = data;
+    for (uint32_t i = chunk->begin; i < chunk->end; i++) {
+        uint32_t slot          = chunk->offsets[(chunk->keys[i] >> chunk->shift) & (RADIX_SIZE - 1)]++;
+        chunk->out_keys[slot]  = chunk->keys[i];
+        chunk->out_order[slot] = chunk->order[i];
+    }
+}
+
+// The calling thread runs a lone chunk itself, and helps with the rest through job_wait.
+static void run_chunks(JobSystem* jobs, SortChunk* chunks, uint32_t chunk_count, JobFunction function) {
+    if (chunk_count == 1) {
+        function(&chunks[0]);
+        return;
+    }
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        job_submit(jobs, &chunks[i].job, function, &chunks[i]);
+    }
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        job_wait(jobs, &chunks[i].job);
+    }
+}
+
+void draw_queue_sort(DrawQueue* queue, JobSystem* jobs) {
+    uint32_t count = queue->count;
+    if (count < 2) {
+        return;
+    }
+    uint32_t chunk_count = jobs ? jobs->thread_count + 1 : 1;
+    uint32_t max_chunks  = (count + CHUNK_MIN - 1) / CHUNK_MIN;
+    chunk_count          = chunk_count < max_chunks ? chunk_count : max_chunks;
+    uint32_t chunk_size  = (count + chunk_count - 1) / chunk_count;
+
+    SortChunk* chunks = malloc(sizeof(SortChunk) * chunk_count);
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        uint32_t end = (i + 1) * chunk_size;
+        chunks[i]    = (SortChunk){
+            .keys  = queue->keys,
+            .begin = i * chunk_size,
+            .end   = end < count ? end : count,
+        };
+    }
+    run_chunks(jobs, chunks, chunk_count, find_varying);
+    uint64_t varying = 0;
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        varying |= chunks[i].varying;
+    }
+
+    for (uint32_t pass = 0; pass < RADIX_PASSES; pass++) {
+        uint32_t shift = pass * RADIX_BITS;
+        if (!((varying >> shift) & (RADIX_SIZE - 1))) {
+            continue;
+        }
+        for (uint32_t i = 0; i < chunk_count; i++) {
+            chunks[i].keys      = queue->keys;
+            chunks[i].order     = queue->order;
+            chunks[i].out_keys  = queue->scratch_keys;
+            chunks[i].out_order = queue->scratch_order;
+            chunks[i].shift     = shift;
+        }
+        run_chunks(jobs, chunks, chunk_count, count_digits);
+
+        // Keys with a smaller digit go first, and within a digit earlier chunks go first.
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < RADIX_SIZE; digit++) {
+            for (uint32_t i = 0; i < chunk_count; i++) {
+                uint32_t digit_count     = chunks[i].offsets[digit];
+                chunks[i].offsets[digit] = offset;
+                offset += digit_count;
+            }
+        }
+        run_chunks(jobs, chunks, chunk_count, scatter);
+
+        uint64_t* keys       = queue->keys;
+        uint32_t* order      = queue->order;
+        queue->keys          = queue->scratch_keys;
+        queue->order         = queue->scratch_order;
+        queue->scratch_keys  = keys;
+        queue->scratch_order = order;
+    }
+    free(chunks);
+}
+
+// Walks the packets in `order`, or pushed order if it's NULL, recording them into `cmd` unless
+// it's NULL.
+static DrawQueueStats submit(const DrawQueue* queue, const uint32_t* order, VkCommandBuffer cmd) {
+    DrawQueueStats stats = { .draws = queue->count };
+    DrawPacket     bound = {};
+    for (uint32_t i = 0; i < queue->count; i++) {
+        const DrawPacket* packet = &queue->packets[order ? order[i] : i];
+        if (packet->pipeline != bound.pipeline) {
+            if (cmd) {
+                vk_cmd_bind_pipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, packet->pipeline);
+            }
+            bound.pipeline = packet->pipeline;
+            stats.pipelines++;
+        }
+        // A set stays bound across pipelines with the same layout.
+        if (packet->set && (packet->set != bound.set || packet->layout != bound.layout)) {
+            if (cmd) {
+                vk_cmd_bind_descriptor_sets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, packet->layout, 0, 1, &packet->set,
+                                            0, NULL);
+            }
+            bound.set    = packet->set;
+            bound.layout = packet->layout;
+            stats.descriptor_sets++;
+        }
+        if (packet->vertex_buffer != bound.vertex_buffer) {
+            VkDeviceSize offset = 0;
+            if (cmd) {
+                vk_cmd_bind_vertex_buffers(cmd, 0, 1, &packet->vertex_buffer, &offset);
+            }
+            bound.vertex_buffer = packet->vertex_buffer;
+            stats.vertex_buffers++;
+        }
+        if (packet->index_buffer != bound.index_buffer || packet->index_type != bound.index_type) {
+            if (cmd) {
+                vk_cmd_bind_index_buffer(cmd, packet->index_buffer, 0, packet->index_type);
+            }
+            bound.index_buffer = packet->index_buffer;
+            bound.index_type   = packet->index_type;
+            stats.index_buffers++;
+        }
+        if (cmd) {
+            vk_cmd_draw_indexed(cmd, packet->index_count, packet->instance_count, packet->first_index,
+                                packet->vertex_offset, packet->first_instance);
+        }
+    }
+    return stats;
+}
+
+DrawQueueStats draw_queue_record(const DrawQueue* queue, VkCommandBuffer cmd) {
+    return submit(queue, queue->order, cmd);
+}
+
+DrawQueueStats draw_queue_unsorted_stats(const DrawQueue* queue) {
+    return submit(queue, NULL, VK_NULL_HANDLE);
+}
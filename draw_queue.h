@@ -0,0 +1,79 @@
+#ifndef draw_queue_h
+#define draw_queue_h
+#include <stdint.h>
+#include "gpu.h"
+#include "job.h"
+
+// Passes draw in this order. Opaque draws go front to back so early depth testing rejects what's
+// hidden; transparent ones back to front so they blend correctly.
+typedef enum {
+    DRAW_PASS_OPAQUE,
+    DRAW_PASS_TRANSPARENT,
+    DRAW_PASS_COUNT,
+} DrawPass;
+
+// Everything one draw binds and draws. Draws that share a pipeline, descriptor set, vertex buffer
+// or index buffer with the draw recorded before them don't bind it again.
+typedef struct {
+    VkPipeline       pipeline;
+    VkPipelineLayout layout;
+    VkDescriptorSet  set; // Bound at set 0, or VK_NULL_HANDLE for none.
+    VkBuffer         vertex_buffer;
+    VkBuffer         index_buffer;
+    VkIndexType      index_type;
+    uint32_t         index_count;
+    uint32_t         first_index;
+    int32_t          vertex_offset;
+    uint32_t         first_instance;
+    uint32_t         instance_count;
+} DrawPacket;
+
+// Draws to record, each with a 64-bit sort key. Sorting by key groups draws by pass, then
+// pipeline, then material, then depth, so each kind of state changes as rarely as its cost
+// warrants.
+typedef struct {
+    DrawPacket* packets; // In the order they were pushed.
+    uint64_t*   keys;
+    uint32_t*   order; // Indices into packets, in recording order.
+    uint64_t*   scratch_keys;
+    uint32_t*   scratch_order;
+    uint32_t    count;
+    uint32_t    capacity;
+} DrawQueue;
+
+// The commands recording a queue issues, or would issue, besides the draws themselves.
+typedef struct {
+    uint32_t draws;
+    uint32_t pipelines;
+    uint32_t descriptor_sets;
+    uint32_t vertex_buffers;
+    uint32_t index_buffers;
+} DrawQueueStats;
+
+// From the most significant bits: 4 of pass, 12 of pipeline, 16 of material, then 24 of depth and
+// 8 unused. The depth is the view distance, or anything else that grows away from the eye; it keeps
+// the top bits of its float representation, which order like the value itself for positive numbers,
+// so no range is needed. Transparent draws invert it.
+uint64_t draw_key(DrawPass pass, uint32_t pipeline, uint32_t material, float depth);
+
+void draw_queue_create(DrawQueue* queue, uint32_t capacity);
+void draw_queue_destroy(DrawQueue* queue);
+
+// Empties the queue, keeping its memory.
+void draw_queue_reset(DrawQueue* queue);
+void draw_queue_push(DrawQueue* queue, uint64_t key, const DrawPacket* packet);
+
+// Orders the packets by key with a least significant digit radix sort of 8-bit digits. Digits that
+// are the same in every key are skipped, so unused key bits cost nothing. Large queues are split
+// into chunks on the job system (which may be NULL) for counting and scattering each digit. Equal
+// keys keep the order they were pushed in.
+void draw_queue_sort(DrawQueue* queue, JobSystem* jobs);
+
+// Records the draws in sorted order, or pushed order if the queue hasn't been sorted, binding only
+// state that changes. Returns what it recorded.
+DrawQueueStats draw_queue_record(const DrawQueue* queue, VkCommandBuffer cmd);
+
+// What recording in pushed order would have cost, with the same redundant binds left out.
+DrawQueueStats draw_queue_unsorted_stats(const DrawQueue* queue);
+
+#endif
@@ -22,8 +22,14 @@ static VkInstance create_instance() {
         "VK_KHR_surface",
         WINDOW_SURFACE_EXTENSION,
     };
+    VkApplicationInfo app_info = {
+        .s_type             = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .p_application_name = "3d",
+        .api_version        = VK_API_VERSION_1_1,
+    };
     VkInstanceCreateInfo info = {
         .s_type                     = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .p_application_info         = &app_info,
         .enabled_extension_count    = ARRAY_SIZE(extensions),
         .pp_enabled_extension_names = extensions,
     };
@@ -47,6 +53,19 @@ static VkPhysicalDevice select_physical_device(VkInstance instance) {
     return physical_device;
 }
 
+static VkQueueFamilyProperties get_queue_family_properties(VkPhysicalDevice physical_device, uint32_t queue_family) {
+    uint32_t count = 0;
+    vk_get_physical_device_queue_family_properties(physical_device, &count, NULL);
+    assert(queue_family < count);
+
+    VkQueueFamilyProperties* queue_families = malloc(sizeof(*queue_families) * count);
+    vk_get_physical_device_queue_family_properties(physical_device, &count, queue_families);
+    VkQueueFamilyProperties properties = queue_families[queue_family];
+    free(queue_families);
+
+    return properties;
+}
+
 static uint32_t select_queue_family(VkPhysicalDevice physical_device) {
     uint32_t count = 0;
     vk_get_physical_device_queue_family_properties(physical_device, &count, NULL);
@@ -59,7 +78,8 @@ static uint32_t select_queue_family(VkPhysicalDevice physical_device) {
     uint32_t queue_family = UINT32_MAX;
     for (uint32_t i = 0; i < count; i++) {
         VkQueueFlagBits flags = queue_families[i].queue_flags;
-        if (flags & VK_QUEUE_GRAPHICS_BIT && flags && VK_QUEUE_TRANSFER_BIT) {
+        // Graphics and compute queues support transfers implicitly.
+        if (flags & VK_QUEUE_GRAPHICS_BIT && flags & VK_QUEUE_COMPUTE_BIT) {
             assert(queue_families[i].queue_count);
             queue_family = i;
             break;
@@ -73,10 +93,25 @@ static uint32_t select_queue_family(VkPhysicalDevice physical_device) {
 
 #define DECL_PFN(func) pfn_##func func
 
-static struct { pfn_vk_debug_marker_set_object_name_ext vk_debug_marker_set_object_name_ext; } pfn;
+static struct {
+    DECL_PFN(vk_debug_marker_set_object_name_ext);
+    DECL_PFN(vk_cmd_set_cull_mode_ext);
+    DECL_PFN(vk_cmd_set_front_face_ext);
+    DECL_PFN(vk_cmd_set_primitive_topology_ext);
+    DECL_PFN(vk_cmd_set_depth_test_enable_ext);
+    DECL_PFN(vk_cmd_set_depth_write_enable_ext);
+    DECL_PFN(vk_cmd_draw_indexed_indirect_count_khr);
+} pfn;
 
 static void init_fn_ptrs(VkDevice device) {
     pfn.vk_debug_marker_set_object_name_ext = (void*) vk_get_device_proc_addr(device, "vkDebugMarkerSetObjectNameEXT");
+    pfn.vk_cmd_set_cull_mode_ext            = (void*) vk_get_device_proc_addr(device, "vkCmdSetCullModeEXT");
+    pfn.vk_cmd_set_front_face_ext           = (void*) vk_get_device_proc_addr(device, "vkCmdSetFrontFaceEXT");
+    pfn.vk_cmd_set_primitive_topology_ext = (void*) vk_get_device_proc_addr(device, "vkCmdSetPrimitiveTopologyEXT");
+    pfn.vk_cmd_set_depth_test_enable_ext  = (void*) vk_get_device_proc_addr(device, "vkCmdSetDepthTestEnableEXT");
+    pfn.vk_cmd_set_depth_write_enable_ext = (void*) vk_get_device_proc_addr(device, "vkCmdSetDepthWriteEnableEXT");
+    pfn.vk_cmd_draw_indexed_indirect_count_khr =
+        (void*) vk_get_device_proc_addr(device, "vkCmdDrawIndexedIndirectCountKHR");
 }
 
 void gpu_set_debug_name_(const GPU* gpu, VkDebugReportObjectTypeEXT type, uint64_t object, const char* name) {
@@ -89,14 +124,110 @@ void gpu_set_debug_name_(const GPU* gpu, VkDebugReportObjectTypeEXT type, uint64
     pfn.vk_debug_marker_set_object_name_ext(gpu->device, &object_name);
 }
 
-static VkDevice create_logical_device(VkPhysicalDevice physical_device, uint32_t queue_family) {
+static int has_device_extension(VkPhysicalDevice physical_device, const char* name) {
+    uint32_t count = 0;
+    vk_enumerate_device_extension_properties(physical_device, NULL, &count, NULL);
+    VkExtensionProperties* extensions = malloc(sizeof(*extensions) * count);
+    vk_enumerate_device_extension_properties(physical_device, NULL, &count, extensions);
+
+    int found = 0;
+    for (uint32_t i = 0; i < count && !found; i++) {
+        found = !strcmp(extensions[i].extension_name, name);
+    }
+    free(extensions);
+
+    return found;
+}
+
+typedef struct {
+    int extended_dynamic_state;
+    int graphics_pipeline_library;
+    int fast_linking;
+    int draw_indirect_count;
+} DeviceFeatures;
+
+// Extension features can only be queried through vkGetPhysicalDeviceFeatures2, which needs a 1.1
+// device.
+static DeviceFeatures query_device_features(VkPhysicalDevice physical_device) {
+    DeviceFeatures             supported = {};
+    VkPhysicalDeviceProperties properties;
+    vk_get_physical_device_properties(physical_device, &properties);
+    if (properties.api_version < VK_API_VERSION_1_1) {
+        return supported;
+    }
+
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extended_dynamic_state = {
+        .s_type = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+    };
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphics_pipeline_library = {
+        .s_type = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+        .p_next = &extended_dynamic_state,
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .s_type = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .p_next = &graphics_pipeline_library,
+    };
+    vk_get_physical_device_features2(physical_device, &features);
+
+    VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT graphics_pipeline_library_properties = {
+        .s_type = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT,
+    };
+    VkPhysicalDeviceProperties2 properties2 = {
+        .s_type = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .p_next = &graphics_pipeline_library_properties,
+    };
+    vk_get_physical_device_properties2(physical_device, &properties2);
+
+    // Feature structs of unsupported extensions are left untouched, i.e. false.
+    supported.extended_dynamic_state =
+        has_device_extension(physical_device, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)
+        && extended_dynamic_state.extended_dynamic_state;
+    supported.graphics_pipeline_library =
+        has_device_extension(physical_device, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)
+        && has_device_extension(physical_device, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)
+        && graphics_pipeline_library.graphics_pipeline_library;
+    supported.fast_linking = supported.graphics_pipeline_library
+                             && graphics_pipeline_library_properties.graphics_pipeline_library_fast_linking;
+    // Has no features of its own, only commands.
+    supported.draw_indirect_count = has_device_extension(physical_device, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+    return supported;
+}
+
+static VkDevice create_logical_device(VkPhysicalDevice physical_device, uint32_t queue_family,
+                                      const DeviceFeatures* enabled) {
     VkPhysicalDeviceFeatures features;
     vk_get_physical_device_features(physical_device, &features);
 
-    const char* extensions[] = {
+    const char* extensions[6] = {
         "VK_KHR_swapchain",
         "VK_EXT_debug_marker",
     };
+    uint32_t extension_count = 2;
+    void*    features_chain  = NULL;
+
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extended_dynamic_state_features = {
+        .s_type                 = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+        .extended_dynamic_state = VK_TRUE,
+    };
+    if (enabled->extended_dynamic_state) {
+        extensions[extension_count++] = VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME;
+        extended_dynamic_state_features.p_next = features_chain;
+        features_chain                         = &extended_dynamic_state_features;
+    }
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphics_pipeline_library_features = {
+        .s_type                    = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+        .graphics_pipeline_library = VK_TRUE,
+    };
+    if (enabled->graphics_pipeline_library) {
+        extensions[extension_count++]             = VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME;
+        extensions[extension_count++]             = VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME;
+        graphics_pipeline_library_features.p_next = features_chain;
+        features_chain                            = &graphics_pipeline_library_features;
+    }
+    if (enabled->draw_indirect_count) {
+        extensions[extension_count++] = VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+    }
     float                   queue_priority = 0.0f;
     VkDeviceQueueCreateInfo queue_info     = {
         .s_type             = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
@@ -107,9 +238,10 @@ static VkDevice create_logical_device(VkPhysicalDevice physical_device, uint32_t
 
     VkDeviceCreateInfo info = {
         .s_type                     = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .p_next                     = features_chain,
         .queue_create_info_count    = 1,
         .p_queue_create_infos       = &queue_info,
-        .enabled_extension_count    = ARRAY_SIZE(extensions),
+        .enabled_extension_count    = extension_count,
         .pp_enabled_extension_names = extensions,
         .p_enabled_features         = &features,
     };
@@ -123,13 +255,32 @@ static VkDevice create_logical_device(VkPhysicalDevice physical_device, uint32_t
     return device;
 }
 
+// Sets the fixed-function state that pipelines leave dynamic when extended dynamic state is enabled.
+void gpu_cmd_set_extended_dynamic_state(const GPU* gpu, VkCommandBuffer cmd, VkCullModeFlags cull_mode,
+                                        VkFrontFace front_face, VkPrimitiveTopology topology, VkBool32 depth_test) {
+    assert(gpu->extended_dynamic_state);
+    pfn.vk_cmd_set_cull_mode_ext(cmd, cull_mode);
+    pfn.vk_cmd_set_front_face_ext(cmd, front_face);
+    pfn.vk_cmd_set_primitive_topology_ext(cmd, topology);
+    pfn.vk_cmd_set_depth_test_enable_ext(cmd, depth_test);
+    pfn.vk_cmd_set_depth_write_enable_ext(cmd, depth_test);
+}
+
+void gpu_cmd_draw_indexed_indirect_count(const GPU* gpu, VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset,
+                                         VkBuffer count_buffer, VkDeviceSize count_offset, uint32_t max_draw_count,
+                                         uint32_t stride) {
+    assert(gpu->draw_indirect_count);
+    pfn.vk_cmd_draw_indexed_indirect_count_khr(cmd, buffer, offset, count_buffer, count_offset, max_draw_count,
+                                               stride);
+}
+
 VkRenderPass gpu_create_render_pass(GPU* gpu) {
     VkAttachmentDescription color_attachment = {
         .flags            = 0,
         .format           = VK_FORMAT_B8G8R8A8_UNORM,
         .samples          = VK_SAMPLE_COUNT_1_BIT,
         .load_op          = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .store_op         = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .store_op         = VK_ATTACHMENT_STORE_OP_STORE,
         .stencil_load_op  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencil_store_op = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initial_layout   = VK_IMAGE_LAYOUT_UNDEFINED,
@@ -141,7 +292,7 @@ VkRenderPass gpu_create_render_pass(GPU* gpu) {
         .format           = VK_FORMAT_D16_UNORM,
         .samples          = VK_SAMPLE_COUNT_1_BIT,
         .load_op          = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .store_op         = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .store_op         = VK_ATTACHMENT_STORE_OP_STORE, // The Hi-Z pass reduces it after the render pass.
         .stencil_load_op  = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencil_store_op = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initial_layout   = VK_IMAGE_LAYOUT_UNDEFINED,
@@ -192,7 +343,18 @@ VkRenderPass gpu_create_render_pass(GPU* gpu) {
         .dependency_flags = VK_DEPENDENCY_BY_REGION_BIT,
     };
 
-    VkSubpassDependency dependencies[] = { bottom_of_pipe_dependency, top_of_pipe_dependency };
+    // The previous frame's Hi-Z pass may still be reading the depth attachment.
+    VkSubpassDependency depth_dependency = {
+        .src_subpass      = VK_SUBPASS_EXTERNAL,
+        .dst_subpass      = 0,
+        .src_stage_mask   = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        .dst_stage_mask   = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .src_access_mask  = 0,
+        .dst_access_mask  = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dependency_flags = 0,
+    };
+
+    VkSubpassDependency dependencies[] = { bottom_of_pipe_dependency, top_of_pipe_dependency, depth_dependency };
 
     VkRenderPassCreateInfo info = {
         .s_type           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
@@ -212,45 +374,76 @@ VkRenderPass gpu_create_render_pass(GPU* gpu) {
     return render_pass;
 }
 
-static uint32_t find_memory_type(VkPhysicalDevice physical_device, VkMemoryPropertyFlags desired) {
+static MemoryHeap create_memory_heap(VkPhysicalDevice physical_device, VkMemoryPropertyFlags desired,
+                                     VkMemoryPropertyFlags fallback) {
     VkPhysicalDeviceMemoryProperties properties = {};
     vk_get_physical_device_memory_properties(physical_device, &properties);
 
-    for (uint32_t i = 0; i < properties.memory_type_count; i++) {
-        VkMemoryPropertyFlags flags = properties.memory_types[i].property_flags;
-        if ((flags & desired) == desired) {
-            return i;
+    VkMemoryPropertyFlags candidates[] = { desired, fallback };
+    for (uint32_t c = 0; c < ARRAY_SIZE(candidates); c++) {
+        if (!candidates[c]) {
+            continue;
+        }
+        for (uint32_t i = 0; i < properties.memory_type_count; i++) {
+            VkMemoryPropertyFlags flags = properties.memory_types[i].property_flags;
+            if ((flags & candidates[c]) == candidates[c]) {
+                return (MemoryHeap){ .memory_type = i, .flags = flags };
+            }
         }
     }
 
-    return UINT32_MAX;
+    return (MemoryHeap){ .memory_type = UINT32_MAX };
 }
 
 GPU gpu_create() {
     VkInstance       instance        = create_instance();
     VkPhysicalDevice physical_device = select_physical_device(instance);
     uint32_t         queue_family    = select_queue_family(physical_device);
-    VkDevice         device          = create_logical_device(physical_device, queue_family);
+    DeviceFeatures   features        = query_device_features(physical_device);
+    VkDevice         device          = create_logical_device(physical_device, queue_family, &features);
+    printf("Extended dynamic state %s\n", features.extended_dynamic_state ? "enabled" : "not supported");
+    printf("Graphics pipeline library %s\n", !features.graphics_pipeline_library ? "not supported"
+                                               : features.fast_linking             ? "enabled with fast linking"
+                                                                                   : "enabled");
+    printf("Draw indirect count %s\n", features.draw_indirect_count ? "enabled" : "not supported");
 
     VkQueue queue;
     vk_get_device_queue(device, queue_family, 0, &queue);
 
-    uint32_t device_local_memory = find_memory_type(physical_device, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    uint32_t host_visible_memory =
-        find_memory_type(physical_device, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    printf("Device local memory type index %u\n", device_local_memory);
-    printf("Host visible memory type index %u\n", host_visible_memory);
-
-    MemoryHeap device_local_heap = {
-        .memory_type = device_local_memory,
-    };
-    MemoryHeap host_visible_heap = {
-        .memory_type = host_visible_memory,
-    };
+    MemoryHeap device_local_heap = create_memory_heap(physical_device, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+    MemoryHeap host_visible_heap = create_memory_heap(
+        physical_device, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0);
+    // Readback wants cached memory so the CPU doesn't read from write-combined pages, but any
+    // host visible type will do.
+    MemoryHeap host_cached_heap =
+        create_memory_heap(physical_device, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    printf("Device local memory type index %u\n", device_local_heap.memory_type);
+    printf("Host visible memory type index %u\n", host_visible_heap.memory_type);
+    printf("Host cached memory type index %u\n", host_cached_heap.memory_type);
 
     GPU gpu = {
-        instance, physical_device, queue_family, device, queue, device_local_heap, host_visible_heap,
+        .instance          = instance,
+        .physical_device   = physical_device,
+        .queue_family      = queue_family,
+        .device            = device,
+        .queue             = queue,
+        .device_local_heap = device_local_heap,
+        .host_visible_heap = host_visible_heap,
+        .host_cached_heap  = host_cached_heap,
+
+        .extended_dynamic_state    = features.extended_dynamic_state,
+        .graphics_pipeline_library = features.graphics_pipeline_library,
+        .draw_indirect_count       = features.draw_indirect_count,
     };
+    vk_get_physical_device_properties(physical_device, &gpu.properties);
+    // create_logical_device enables every core feature the device supports.
+    VkPhysicalDeviceFeatures core_features;
+    vk_get_physical_device_features(physical_device, &core_features);
+    gpu.pipeline_statistics          = core_features.pipeline_statistics_query;
+    gpu.multi_draw_indirect          = core_features.multi_draw_indirect;
+    gpu.draw_indirect_first_instance = core_features.draw_indirect_first_instance;
+    gpu.timestamp_valid_bits         = get_queue_family_properties(physical_device, queue_family).timestamp_valid_bits;
 
     gpu_set_debug_name(&gpu, INSTANCE, gpu.instance, "Instance");
     gpu_set_debug_name(&gpu, PHYSICAL_DEVICE, gpu.physical_device, "Physical device");
@@ -268,6 +461,7 @@ static void gpu_destroy_memory_heap(GPU* gpu, MemoryHeap* heap) {
 void gpu_destroy(GPU* gpu) {
     gpu_destroy_memory_heap(gpu, &gpu->device_local_heap);
     gpu_destroy_memory_heap(gpu, &gpu->host_visible_heap);
+    gpu_destroy_memory_heap(gpu, &gpu->host_cached_heap);
 
     vk_destroy_device(gpu->device, NULL);
     vk_destroy_instance(gpu->instance, NULL);
@@ -277,13 +471,18 @@ static MemoryBlock split_block(MemoryBlock* block, VkDeviceSize offset) {
     assert(block->length >= offset);
 
     MemoryBlock left = {
-        .memory = block->memory,
-        .offset = block->offset,
-        .length = offset,
+        .memory      = block->memory,
+        .offset      = block->offset,
+        .length      = offset,
+        .memory_size = block->memory_size,
+        .mapped      = block->mapped,
     };
 
     block->offset += offset;
     block->length -= offset;
+    if (block->mapped) {
+        block->mapped = (char*) block->mapped + offset;
+    }
 
     return left;
 }
@@ -309,6 +508,9 @@ MemoryBlock gpu_allocate_memory(GPU* gpu, MemoryHeap* heap, const VkMemoryRequir
 
         MemoryBlock left = split_block(block, aligned_size);
         left.offset      = aligned_offset;
+        if (left.mapped) {
+            left.mapped = (char*) left.mapped + padding;
+        }
 
         // Note: the right side of the block, which remains in the heap, may have zero bytes free
         // now. Regardless, we leave it in the heap. Fine-grained deallocation is not supported
@@ -318,19 +520,33 @@ MemoryBlock gpu_allocate_memory(GPU* gpu, MemoryHeap* heap, const VkMemoryRequir
         return left;
     }
 
+    // Blocks are usually 256 MiB, but one larger request, such as a big mesh's vertices, gets a block
+    // of its own that's large enough, since no number of 256 MiB blocks would fit it.
+    VkDeviceSize         size = requirements->size + requirements->alignment;
     VkMemoryAllocateInfo info = {
         .s_type            = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocation_size   = 256 * MiB,
+        .allocation_size   = size > 256 * MiB ? size : 256 * MiB,
         .memory_type_index = heap->memory_type,
     };
     VkDeviceMemory memory;
-    vk_allocate_memory(gpu->device, &info, NULL, &memory);
+    if (vk_allocate_memory(gpu->device, &info, NULL, &memory) != VK_SUCCESS) {
+        fprintf(stderr, "Could not allocate %.1f MiB of memory type %u\n", info.allocation_size / (double) MiB,
+                heap->memory_type);
+        abort();
+    }
 
     MemoryBlock block = {
-        .memory = memory,
-        .offset = 0,
-        .length = info.allocation_size,
+        .memory      = memory,
+        .offset      = 0,
+        .length      = info.allocation_size,
+        .memory_size = info.allocation_size,
     };
+    // Host visible allocations stay mapped for their whole lifetime. A VkDeviceMemory can only be
+    // mapped once, and it is shared by every block carved out of it.
+    if (heap->flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        vk_map_memory(gpu->device, memory, 0, VK_WHOLE_SIZE, 0, &block.mapped);
+    }
+    assert(heap->block_count < MAX_BLOCKS);
     heap->blocks[heap->block_count++] = block;
 
     static uint32_t i = 0;
@@ -341,3 +557,38 @@ MemoryBlock gpu_allocate_memory(GPU* gpu, MemoryHeap* heap, const VkMemoryRequir
 
     return gpu_allocate_memory(gpu, heap, requirements);
 }
+
+VkBuffer gpu_create_buffer(GPU* gpu, MemoryHeap* heap, VkDeviceSize size, VkBufferUsageFlags usage,
+                           MemoryBlock* memory, const char* name) {
+    VkBufferCreateInfo info = {
+        .s_type       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size         = size,
+        .usage        = usage,
+        .sharing_mode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer buffer;
+    vk_create_buffer(gpu->device, &info, NULL, &buffer);
+    gpu_set_debug_name(gpu, BUFFER, buffer, name);
+
+    VkMemoryRequirements requirements;
+    vk_get_buffer_memory_requirements(gpu->device, buffer, &requirements);
+    *memory = gpu_allocate_memory(gpu, heap, &requirements);
+    vk_bind_buffer_memory(gpu->device, buffer, memory->memory, memory->offset);
+    return buffer;
+}
+
+void gpu_invalidate_memory(GPU* gpu, const MemoryBlock* block, VkDeviceSize offset, VkDeviceSize size) {
+    VkDeviceSize atom  = gpu->properties.limits.non_coherent_atom_size;
+    VkDeviceSize start = (block->offset + offset) / atom * atom;
+    VkDeviceSize end   = round_up(block->offset + offset + size, atom);
+    // The last atom of an allocation may be partial, so a range rounded past the end stops there.
+    end = end < block->memory_size ? end : block->memory_size;
+
+    VkMappedMemoryRange range = {
+        .s_type = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = block->memory,
+        .offset = start,
+        .size   = end - start,
+    };
+    vk_invalidate_mapped_memory_ranges(gpu->device, 1, &range);
+}
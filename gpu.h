@@ -1,6 +1,7 @@
 #ifndef gpu_h
 #define gpu_h
 #include "vulkan.h"
+#include "vulkan_pipeline_library.h"
 
 #define set_debug_name(device, type, object, name)                                                                     \
     gpu_set_debug_name_(device, VK_DEBUG_REPORT_OBJECT_TYPE_##type##_EXT, (uint64_t) object, name)
@@ -10,14 +11,17 @@ typedef struct {
     VkDeviceMemory memory;
     VkDeviceSize   offset;
     VkDeviceSize   length;
+    VkDeviceSize   memory_size; // Of the whole allocation, which flushes and invalidates must stay inside.
+    void*          mapped;      // Host address of `offset`, or NULL if the heap isn't host visible.
 } MemoryBlock;
 
 #define MAX_BLOCKS 8
 
 typedef struct {
-    uint32_t    memory_type;
-    MemoryBlock blocks[MAX_BLOCKS];
-    uint32_t    block_count;
+    uint32_t              memory_type;
+    VkMemoryPropertyFlags flags;
+    MemoryBlock           blocks[MAX_BLOCKS];
+    uint32_t              block_count;
 } MemoryHeap;
 
 typedef struct {
@@ -29,12 +33,33 @@ typedef struct {
 
     MemoryHeap device_local_heap;
     MemoryHeap host_visible_heap;
+    MemoryHeap host_cached_heap;
+
+    VkPhysicalDeviceProperties properties;
+    uint32_t                   timestamp_valid_bits;
+
+    int extended_dynamic_state;       // VK_EXT_extended_dynamic_state is enabled.
+    int graphics_pipeline_library;    // VK_EXT_graphics_pipeline_library is enabled.
+    int pipeline_statistics;          // Pipeline statistics queries are supported.
+    int draw_indirect_count;          // VK_KHR_draw_indirect_count is enabled.
+    int multi_draw_indirect;          // Indirect draws may have a draw count above one.
+    int draw_indirect_first_instance; // Indirect draws may start at an instance other than zero.
 } GPU;
 
 GPU          gpu_create();
 void         gpu_destroy(GPU* gpu);
 void         gpu_set_debug_name_(const GPU* gpu, VkDebugReportObjectTypeEXT type, uint64_t object, const char* name);
 MemoryBlock  gpu_allocate_memory(GPU* gpu, MemoryHeap* heap, const VkMemoryRequirements* requirements);
+// Creates a buffer named `name` and binds it to memory allocated from `heap`, returned in `memory`.
+VkBuffer     gpu_create_buffer(GPU* gpu, MemoryHeap* heap, VkDeviceSize size, VkBufferUsageFlags usage,
+                               MemoryBlock* memory, const char* name);
+void         gpu_invalidate_memory(GPU* gpu, const MemoryBlock* block, VkDeviceSize offset, VkDeviceSize size);
+void         gpu_cmd_set_extended_dynamic_state(const GPU* gpu, VkCommandBuffer cmd, VkCullModeFlags cull_mode,
+                                                VkFrontFace front_face, VkPrimitiveTopology topology,
+                                                VkBool32 depth_test);
+void         gpu_cmd_draw_indexed_indirect_count(const GPU* gpu, VkCommandBuffer cmd, VkBuffer buffer,
+                                                 VkDeviceSize offset, VkBuffer count_buffer, VkDeviceSize count_offset,
+                                                 uint32_t max_draw_count, uint32_t stride);
 VkRenderPass gpu_create_render_pass(GPU* gpu);
 
 #endif
@@ -0,0 +1,291 @@
+#include <assert.h>
+#include <stdio.h>
+#include "hiz.h"
+#include "pipeline.h"
+
+#include "hiz.comp.in"
+
+#define ARRAY_SIZE(a)  (sizeof(a) / sizeof(a[0]))
+#define WORKGROUP_SIZE 8
+
+enum { BINDING_SOURCE, BINDING_LEVEL, BINDING_COUNT };
+
+// Matches the push constant block in hiz.comp.
+typedef struct {
+    int32_t source_size[2];
+    int32_t size[2];
+} ReduceConstants;
+
+static VkImageView create_view(GPU* gpu, VkImage image, uint32_t base_level, uint32_t level_count,
+                               const char* name) {
+    VkImageViewCreateInfo info = {
+        .s_type            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image             = image,
+        .view_type         = VK_IMAGE_VIEW_TYPE_2D,
+        .format            = VK_FORMAT_R32_SFLOAT,
+        .components        = {
+            .r = VK_COMPONENT_SWIZZLE_R,
+            .g = VK_COMPONENT_SWIZZLE_G,
+            .b = VK_COMPONENT_SWIZZLE_B,
+            .a = VK_COMPONENT_SWIZZLE_A,
+        },
+        .subresource_range = {
+            .aspect_mask      = VK_IMAGE_ASPECT_COLOR_BIT,
+            .base_mip_level   = base_level,
+            .level_count      = level_count,
+            .base_array_layer = 0,
+            .layer_count      = 1,
+        },
+    };
+    VkImageView view;
+    vk_create_image_view(gpu->device, &info, NULL, &view);
+    gpu_set_debug_name(gpu, IMAGE_VIEW, view, name);
+    return view;
+}
+
+void hiz_create(GPU* gpu, VkPipelineCache cache, HiZ* hiz, const Attachment* depth, uint32_t width,
+                uint32_t height) {
+    *hiz = (HiZ){
+        .depth        = depth->image,
+        .depth_width  = width,
+        .depth_height = height,
+        .width        = (width + 1) / 2,
+        .height       = (height + 1) / 2,
+        .level_count  = 1,
+    };
+    for (uint32_t size = hiz->width > hiz->height ? hiz->width : hiz->height; size > 1; size = (size + 1) / 2) {
+        hiz->level_count++;
+    }
+    assert(hiz->level_count <= HIZ_MAX_LEVELS);
+
+    VkImageCreateInfo image_info = {
+        .s_type         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .image_type     = VK_IMAGE_TYPE_2D,
+        .format         = VK_FORMAT_R32_SFLOAT,
+        .extent         = (VkExtent3D){ hiz->width, hiz->height, 1 },
+        .mip_levels     = hiz->level_count,
+        .array_layers   = 1,
+        .samples        = VK_SAMPLE_COUNT_1_BIT,
+        .tiling         = VK_IMAGE_TILING_OPTIMAL,
+        .usage          = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .initial_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    vk_create_image(gpu->device, &image_info, NULL, &hiz->image);
+    gpu_set_debug_name(gpu, IMAGE, hiz->image, "Hi-Z image");
+
+    VkMemoryRequirements requirements;
+    vk_get_image_memory_requirements(gpu->device, hiz->image, &requirements);
+    hiz->memory = gpu_allocate_memory(gpu, &gpu->device_local_heap, &requirements);
+    vk_bind_image_memory(gpu->device, hiz->image, hiz->memory.memory, hiz->memory.offset);
+
+    hiz->view = create_view(gpu, hiz->image, 0, hiz->level_count, "Hi-Z view");
+    for (uint32_t i = 0; i < hiz->level_count; i++) {
+        char name[32];
+        sprintf(name, "Hi-Z level view %u", i);
+        hiz->level_views[i] = create_view(gpu, hiz->image, i, 1, name);
+    }
+
+    // Only ever read with texelFetch, which ignores filtering.
+    VkSamplerCreateInfo sampler_info = {
+        .s_type         = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .mag_filter     = VK_FILTER_NEAREST,
+        .min_filter     = VK_FILTER_NEAREST,
+        .mipmap_mode    = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .address_mode_u = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .address_mode_v = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .address_mode_w = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .max_lod        = (float) hiz->level_count,
+    };
+    vk_create_sampler(gpu->device, &sampler_info, NULL, &hiz->sampler);
+
+    VkDescriptorSetLayoutBinding bindings[BINDING_COUNT] = {
+        [BINDING_SOURCE] = {
+            .binding          = BINDING_SOURCE,
+            .descriptor_type  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptor_count = 1,
+            .stage_flags      = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+        [BINDING_LEVEL] = {
+            .binding          = BINDING_LEVEL,
+            .descriptor_type  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptor_count = 1,
+            .stage_flags      = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+    };
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .s_type        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .binding_count = BINDING_COUNT,
+        .p_bindings    = bindings,
+    };
+    vk_create_descriptor_set_layout(gpu->device, &set_layout_info, NULL, &hiz->set_layout);
+
+    VkPushConstantRange push_constant_range = {
+        .stage_flags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .size        = sizeof(ReduceConstants),
+    };
+    VkPipelineLayoutCreateInfo layout_info = {
+        .s_type                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .set_layout_count          = 1,
+        .p_set_layouts             = &hiz->set_layout,
+        .push_constant_range_count = 1,
+        .p_push_constant_ranges    = &push_constant_range,
+    };
+    vk_create_pipeline_layout(gpu->device, &layout_info, NULL, &hiz->layout);
+    gpu_set_debug_name(gpu, PIPELINE_LAYOUT, hiz->layout, "Hi-Z pipeline layout");
+
+    hiz->shader                      = gpu_create_shader(gpu, HIZ_COMP, sizeof(HIZ_COMP));
+    VkComputePipelineCreateInfo info = {
+        .s_type = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage  = {
+            .s_type = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = hiz->shader,
+            .p_name = "main",
+        },
+        .layout = hiz->layout,
+    };
+    vk_create_compute_pipelines(gpu->device, cache, 1, &info, NULL, &hiz->pipeline);
+    gpu_set_debug_name(gpu, PIPELINE, hiz->pipeline, "Hi-Z pipeline");
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, hiz->level_count },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, hiz->level_count },
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .s_type          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .max_sets        = hiz->level_count,
+        .pool_size_count = ARRAY_SIZE(pool_sizes),
+        .p_pool_sizes    = pool_sizes,
+    };
+    vk_create_descriptor_pool(gpu->device, &pool_info, NULL, &hiz->pool);
+
+    // Level 0 reads the depth attachment and every other level the one before it.
+    for (uint32_t i = 0; i < hiz->level_count; i++) {
+        VkDescriptorSetAllocateInfo set_info = {
+            .s_type               = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptor_pool      = hiz->pool,
+            .descriptor_set_count = 1,
+            .p_set_layouts        = &hiz->set_layout,
+        };
+        vk_allocate_descriptor_sets(gpu->device, &set_info, &hiz->sets[i]);
+
+        VkDescriptorImageInfo source = { hiz->sampler, depth->view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        if (i) {
+            source = (VkDescriptorImageInfo){ hiz->sampler, hiz->level_views[i - 1], VK_IMAGE_LAYOUT_GENERAL };
+        }
+        VkDescriptorImageInfo level    = { VK_NULL_HANDLE, hiz->level_views[i], VK_IMAGE_LAYOUT_GENERAL };
+        VkWriteDescriptorSet  writes[] = {
+            {
+                .s_type           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dst_set          = hiz->sets[i],
+                .dst_binding      = BINDING_SOURCE,
+                .descriptor_count = 1,
+                .descriptor_type  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .p_image_info     = &source,
+            },
+            {
+                .s_type           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dst_set          = hiz->sets[i],
+                .dst_binding      = BINDING_LEVEL,
+                .descriptor_count = 1,
+                .descriptor_type  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .p_image_info     = &level,
+            },
+        };
+        vk_update_descriptor_sets(gpu->device, ARRAY_SIZE(writes), writes, 0, NULL);
+    }
+}
+
+void hiz_destroy(GPU* gpu, HiZ* hiz) {
+    vk_destroy_descriptor_pool(gpu->device, hiz->pool, NULL);
+    vk_destroy_pipeline(gpu->device, hiz->pipeline, NULL);
+    vk_destroy_shader_module(gpu->device, hiz->shader, NULL);
+    vk_destroy_pipeline_layout(gpu->device, hiz->layout, NULL);
+    vk_destroy_descriptor_set_layout(gpu->device, hiz->set_layout, NULL);
+    vk_destroy_sampler(gpu->device, hiz->sampler, NULL);
+    for (uint32_t i = 0; i < hiz->level_count; i++) {
+        vk_destroy_image_view(gpu->device, hiz->level_views[i], NULL);
+    }
+    vk_destroy_image_view(gpu->device, hiz->view, NULL);
+    vk_destroy_image(gpu->device, hiz->image, NULL);
+}
+
+void hiz_record_clear(const HiZ* hiz, VkCommandBuffer cmd) {
+    VkImageSubresourceRange range = {
+        .aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .level_count = VK_REMAINING_MIP_LEVELS,
+        .layer_count = 1,
+    };
+    VkImageMemoryBarrier barrier = {
+        .s_type                 = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .src_access_mask        = 0,
+        .dst_access_mask        = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .old_layout             = VK_IMAGE_LAYOUT_UNDEFINED,
+        .new_layout             = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .src_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .dst_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .image                  = hiz->image,
+        .subresource_range      = range,
+    };
+    vk_cmd_pipeline_barrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0,
+                            NULL, 1, &barrier);
+
+    VkClearColorValue far = { .float32 = { 1.0f, 1.0f, 1.0f, 1.0f } };
+    vk_cmd_clear_color_image(cmd, hiz->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &far, 1, &range);
+
+    barrier.src_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dst_access_mask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.old_layout      = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.new_layout      = VK_IMAGE_LAYOUT_GENERAL;
+    vk_cmd_pipeline_barrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                            NULL, 1, &barrier);
+}
+
+void hiz_record(const HiZ* hiz, VkCommandBuffer cmd) {
+    // The depth attachment's contents are only needed by the first level, and the render pass
+    // discards them when it next starts. The previous pyramid's readers, e.g. the culling pass
+    // earlier in the frame, must be done before it is overwritten.
+    VkImageMemoryBarrier depth_barrier = {
+        .s_type                 = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .src_access_mask        = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dst_access_mask        = VK_ACCESS_SHADER_READ_BIT,
+        .old_layout             = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .new_layout             = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .src_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .dst_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .image                  = hiz->depth,
+        .subresource_range      = {
+            .aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT,
+            .level_count = 1,
+            .layer_count = 1,
+        },
+    };
+    vk_cmd_pipeline_barrier(cmd, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &depth_barrier);
+
+    VkMemoryBarrier level_barrier = {
+        .s_type          = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .src_access_mask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dst_access_mask = VK_ACCESS_SHADER_READ_BIT,
+    };
+    vk_cmd_bind_pipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, hiz->pipeline);
+    uint32_t source_width  = hiz->depth_width;
+    uint32_t source_height = hiz->depth_height;
+    for (uint32_t i = 0; i < hiz->level_count; i++) {
+        uint32_t        width     = (source_width + 1) / 2;
+        uint32_t        height    = (source_height + 1) / 2;
+        ReduceConstants constants = {
+            .source_size = { (int32_t) source_width, (int32_t) source_height },
+            .size        = { (int32_t) width, (int32_t) height },
+        };
+        vk_cmd_bind_descriptor_sets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, hiz->layout, 0, 1, &hiz->sets[i], 0, NULL);
+        vk_cmd_push_constants(cmd, hiz->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vk_cmd_dispatch(cmd, (width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                        (height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+        // Also makes the finished pyramid visible to whatever reads it next.
+        vk_cmd_pipeline_barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                                &level_barrier, 0, NULL, 0, NULL);
+        source_width  = width;
+        source_height = height;
+    }
+}
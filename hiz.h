@@ -0,0 +1,46 @@
+#ifndef hiz_h
+#define hiz_h
+#include "gpu.h"
+#include "swapchain.h"
+
+#define HIZ_MAX_LEVELS 16
+
+// A hierarchical depth pyramid: each texel of level n holds the farthest depth of the texels it covers
+// in the depth attachment, halved n + 1 times. A bounds rectangle covers at most 2x2 texels of a
+// level that's coarse enough, so four fetches tell whether anything drawn could be behind it.
+// Built by a compute pass per level from the depth attachment after the frame's render pass.
+typedef struct {
+    VkImage               image; // R32_SFLOAT, kept in VK_IMAGE_LAYOUT_GENERAL once cleared.
+    MemoryBlock           memory;
+    VkImageView           view; // Every level, for sampling.
+    VkImageView           level_views[HIZ_MAX_LEVELS];
+    VkSampler             sampler;
+    VkDescriptorSetLayout set_layout;
+    VkPipelineLayout      layout;
+    VkShaderModule        shader;
+    VkPipeline            pipeline;
+    VkDescriptorPool      pool;
+    VkDescriptorSet       sets[HIZ_MAX_LEVELS];
+    VkImage               depth;
+    uint32_t              depth_width;
+    uint32_t              depth_height;
+    uint32_t              width; // Of level 0.
+    uint32_t              height;
+    uint32_t              level_count;
+} HiZ;
+
+// `depth` must have been created with VK_IMAGE_USAGE_SAMPLED_BIT and be stored by the render pass.
+void hiz_create(GPU* gpu, VkPipelineCache cache, HiZ* hiz, const Attachment* depth, uint32_t width,
+                uint32_t height);
+void hiz_destroy(GPU* gpu, HiZ* hiz);
+
+// Clears every level to the far plane, so nothing tests as occluded, and leaves the pyramid in the
+// layout it's read in. Must be recorded before the pyramid is first read or built.
+void hiz_record_clear(const HiZ* hiz, VkCommandBuffer cmd);
+
+// Rebuilds the pyramid from the depth attachment, which must be in
+// VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL after a render pass that wrote it, and leaves the
+// result readable by compute shaders. Must be outside a render pass.
+void hiz_record(const HiZ* hiz, VkCommandBuffer cmd);
+
+#endif
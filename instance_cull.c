@@ -0,0 +1,280 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "instance_cull.h"
+#include "pipeline.h"
+
+#include "instance_cull.comp.in"
+
+#define WORKGROUP_SIZE 64
+#define WORKGROUP_MAX  65535
+#define COUNT_SIZE     (4 * sizeof(uint32_t))
+
+enum { FLAG_COMPACT = 1, FLAG_OCCLUSION = 2 };
+enum {
+    BINDING_OBJECTS,
+    BINDING_DRAWS,
+    BINDING_COMMANDS,
+    BINDING_COUNT_BUFFER,
+    BINDING_STORAGE_COUNT,
+    BINDING_PYRAMID = BINDING_STORAGE_COUNT,
+    BINDING_OCCLUSION,
+    BINDING_COUNT,
+};
+
+// Matches the push constant block in instance_cull.comp; exactly the 128 bytes every device allows.
+typedef struct {
+    float    planes[6][4];
+    float    clip_w[4];
+    float    lod_scale;
+    float    model_scale;
+    uint32_t object_count;
+    uint32_t flags;
+} CullConstants;
+
+// Matches the Occlusion uniform block in instance_cull.comp.
+typedef struct {
+    Mat4  view_projection;
+    float depth_size[2];
+    float pad[2];
+} OcclusionConstants;
+
+int instance_cull_supported(const GPU* gpu) {
+    return gpu->multi_draw_indirect && gpu->draw_indirect_first_instance;
+}
+
+void instance_cull_create(GPU* gpu, VkPipelineCache cache, InstanceCull* cull, const InstanceCullObject* objects,
+                          uint32_t object_count, const InstanceCullDraw* draws, uint32_t draw_count,
+                          uint32_t frame_count, const HiZ* hiz) {
+    assert(instance_cull_supported(gpu));
+    assert(frame_count <= INSTANCE_CULL_MAX_FRAMES);
+    *cull = (InstanceCull){
+        .frame_count  = frame_count,
+        .object_count = object_count,
+        .compact      = gpu->draw_indirect_count,
+        .depth_width  = hiz->depth_width,
+        .depth_height = hiz->depth_height,
+    };
+
+    VkDescriptorSetLayoutBinding bindings[BINDING_COUNT];
+    for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+        bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding          = i,
+            .descriptor_type  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptor_count = 1,
+            .stage_flags      = VK_SHADER_STAGE_COMPUTE_BIT,
+        };
+    }
+    bindings[BINDING_PYRAMID].descriptor_type   = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[BINDING_OCCLUSION].descriptor_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .s_type        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .binding_count = BINDING_COUNT,
+        .p_bindings    = bindings,
+    };
+    vk_create_descriptor_set_layout(gpu->device, &set_layout_info, NULL, &cull->set_layout);
+
+    VkPushConstantRange push_constant_range = {
+        .stage_flags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .size        = sizeof(CullConstants),
+    };
+    VkPipelineLayoutCreateInfo layout_info = {
+        .s_type                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .set_layout_count          = 1,
+        .p_set_layouts             = &cull->set_layout,
+        .push_constant_range_count = 1,
+        .p_push_constant_ranges    = &push_constant_range,
+    };
+    vk_create_pipeline_layout(gpu->device, &layout_info, NULL, &cull->layout);
+    gpu_set_debug_name(gpu, PIPELINE_LAYOUT, cull->layout, "Instance cull pipeline layout");
+
+    cull->shader                     = gpu_create_shader(gpu, INSTANCE_CULL_COMP, sizeof(INSTANCE_CULL_COMP));
+    VkComputePipelineCreateInfo info = {
+        .s_type = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage  = {
+            .s_type = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = cull->shader,
+            .p_name = "main",
+        },
+        .layout = cull->layout,
+    };
+    vk_create_compute_pipelines(gpu->device, cache, 1, &info, NULL, &cull->pipeline);
+    gpu_set_debug_name(gpu, PIPELINE, cull->pipeline, "Instance cull pipeline");
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, BINDING_STORAGE_COUNT * frame_count },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frame_count },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame_count },
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .s_type          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .max_sets        = frame_count,
+        .pool_size_count = sizeof(pool_sizes) / sizeof(pool_sizes[0]),
+        .p_pool_sizes    = pool_sizes,
+    };
+    vk_create_descriptor_pool(gpu->device, &pool_info, NULL, &cull->pool);
+
+    cull->objects = gpu_create_buffer(gpu, &gpu->host_visible_heap,
+                                      sizeof(InstanceCullObject) * (VkDeviceSize) object_count,
+                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &cull->object_memory, "Cull object buffer");
+    memcpy(cull->object_memory.mapped, objects, sizeof(InstanceCullObject) * object_count);
+    cull->draws = gpu_create_buffer(gpu, &gpu->host_visible_heap, sizeof(InstanceCullDraw) * draw_count,
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &cull->draw_memory, "Cull draw record buffer");
+    memcpy(cull->draw_memory.mapped, draws, sizeof(InstanceCullDraw) * draw_count);
+
+    for (uint32_t i = 0; i < frame_count; i++) {
+        InstanceCullFrame* frame = &cull->frames[i];
+        char               name[48];
+        sprintf(name, "Indirect command buffer %u", i);
+        frame->commands = gpu_create_buffer(gpu, &gpu->device_local_heap,
+                                            sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize) object_count,
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                            &frame->command_memory, name);
+        // Host visible so the counts can be read back for the statistics.
+        sprintf(name, "Indirect count buffer %u", i);
+        frame->count = gpu_create_buffer(gpu, &gpu->host_visible_heap, COUNT_SIZE,
+                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                                             | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                         &frame->count_memory, name);
+        memset(frame->count_memory.mapped, 0, COUNT_SIZE);
+        sprintf(name, "Occlusion uniform buffer %u", i);
+        frame->occlusion = gpu_create_buffer(gpu, &gpu->host_visible_heap, sizeof(OcclusionConstants),
+                                             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &frame->occlusion_memory, name);
+
+        VkDescriptorSetAllocateInfo set_info = {
+            .s_type               = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptor_pool      = cull->pool,
+            .descriptor_set_count = 1,
+            .p_set_layouts        = &cull->set_layout,
+        };
+        vk_allocate_descriptor_sets(gpu->device, &set_info, &frame->set);
+
+        VkDescriptorBufferInfo buffers[BINDING_COUNT] = {
+            [BINDING_OBJECTS]      = { cull->objects, 0, VK_WHOLE_SIZE },
+            [BINDING_DRAWS]        = { cull->draws, 0, VK_WHOLE_SIZE },
+            [BINDING_COMMANDS]     = { frame->commands, 0, VK_WHOLE_SIZE },
+            [BINDING_COUNT_BUFFER] = { frame->count, 0, VK_WHOLE_SIZE },
+            [BINDING_OCCLUSION]    = { frame->occlusion, 0, VK_WHOLE_SIZE },
+        };
+        VkDescriptorImageInfo pyramid = { hiz->sampler, hiz->view, VK_IMAGE_LAYOUT_GENERAL };
+        VkWriteDescriptorSet  writes[BINDING_COUNT];
+        for (uint32_t b = 0; b < BINDING_COUNT; b++) {
+            writes[b] = (VkWriteDescriptorSet){
+                .s_type           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dst_set          = frame->set,
+                .dst_binding      = b,
+                .descriptor_count = 1,
+                .descriptor_type  = bindings[b].descriptor_type,
+                .p_buffer_info    = &buffers[b],
+            };
+        }
+        writes[BINDING_PYRAMID].p_buffer_info = NULL;
+        writes[BINDING_PYRAMID].p_image_info  = &pyramid;
+        vk_update_descriptor_sets(gpu->device, BINDING_COUNT, writes, 0, NULL);
+    }
+}
+
+void instance_cull_destroy(GPU* gpu, InstanceCull* cull) {
+    for (uint32_t i = 0; i < cull->frame_count; i++) {
+        vk_destroy_buffer(gpu->device, cull->frames[i].commands, NULL);
+        vk_destroy_buffer(gpu->device, cull->frames[i].count, NULL);
+        vk_destroy_buffer(gpu->device, cull->frames[i].occlusion, NULL);
+    }
+    vk_destroy_buffer(gpu->device, cull->objects, NULL);
+    vk_destroy_buffer(gpu->device, cull->draws, NULL);
+    vk_destroy_descriptor_pool(gpu->device, cull->pool, NULL);
+    vk_destroy_pipeline(gpu->device, cull->pipeline, NULL);
+    vk_destroy_shader_module(gpu->device, cull->shader, NULL);
+    vk_destroy_pipeline_layout(gpu->device, cull->layout, NULL);
+    vk_destroy_descriptor_set_layout(gpu->device, cull->set_layout, NULL);
+}
+
+void instance_cull_record(InstanceCull* cull, VkCommandBuffer cmd, uint32_t frame_index, const Mat4* view_projection,
+                          float model_scale, float height, float threshold,
+                          const Mat4* occlusion_view_projection) {
+    InstanceCullFrame* frame = &cull->frames[frame_index];
+
+    // The previous draw from this buffer finished before its frame's fence was signaled.
+    uint32_t reset[COUNT_SIZE / sizeof(uint32_t)] = {};
+    vk_cmd_update_buffer(cmd, frame->count, 0, COUNT_SIZE, reset);
+
+    VkBufferMemoryBarrier to_compute = {
+        .s_type                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .src_access_mask        = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dst_access_mask        = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        .src_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .dst_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .buffer                 = frame->count,
+        .size                   = VK_WHOLE_SIZE,
+    };
+    vk_cmd_pipeline_barrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 1,
+                            &to_compute, 0, NULL);
+
+    // Pixels per world unit at a distance w, as in mesh_lod_pixels_per_unit, divided by w in the shader.
+    const Mat4*   m         = view_projection;
+    float         y_scale   = sqrtf(m->xy * m->xy + m->yy * m->yy + m->zy * m->zy);
+    CullConstants constants = {
+        .clip_w       = { m->xw, m->yw, m->zw, m->ww },
+        .lod_scale    = y_scale * 0.5f * height / threshold,
+        .model_scale  = model_scale,
+        .object_count = cull->object_count,
+        .flags        = cull->compact ? FLAG_COMPACT : 0,
+    };
+    // The frame's fence has been waited on, so its uniform buffer is free to write.
+    if (occlusion_view_projection) {
+        OcclusionConstants* occlusion = frame->occlusion_memory.mapped;
+        *occlusion                    = (OcclusionConstants){
+            .view_projection = *occlusion_view_projection,
+            .depth_size      = { (float) cull->depth_width, (float) cull->depth_height },
+        };
+        constants.flags |= FLAG_OCCLUSION;
+    }
+    mat4_frustum_planes(view_projection, constants.planes);
+    vk_cmd_bind_pipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull->pipeline);
+    vk_cmd_bind_descriptor_sets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull->layout, 0, 1, &frame->set, 0, NULL);
+    vk_cmd_push_constants(cmd, cull->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    uint32_t groups   = (cull->object_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+    uint32_t groups_x = groups < WORKGROUP_MAX ? groups : WORKGROUP_MAX;
+    if (groups_x) {
+        vk_cmd_dispatch(cmd, groups_x, (groups + groups_x - 1) / groups_x, 1);
+    }
+
+    VkBufferMemoryBarrier to_draw[2] = { to_compute, to_compute };
+    to_draw[0].src_access_mask       = VK_ACCESS_SHADER_WRITE_BIT;
+    to_draw[0].dst_access_mask       = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    to_draw[1].src_access_mask       = VK_ACCESS_SHADER_WRITE_BIT;
+    to_draw[1].dst_access_mask       = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    to_draw[1].buffer                = frame->commands;
+    vk_cmd_pipeline_barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 2, to_draw,
+                            0, NULL);
+}
+
+void instance_cull_draw(const InstanceCull* cull, const GPU* gpu, VkCommandBuffer cmd, uint32_t frame_index) {
+    const InstanceCullFrame* frame  = &cull->frames[frame_index];
+    uint32_t                 stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (cull->compact) {
+        gpu_cmd_draw_indexed_indirect_count(gpu, cmd, frame->commands, 0, frame->count, 0, cull->object_count,
+                                            stride);
+        return;
+    }
+    // Draw counts are only guaranteed up to maxDrawIndirectCount per call.
+    uint32_t max_count = gpu->properties.limits.max_draw_indirect_count;
+    for (uint32_t first = 0; first < cull->object_count; first += max_count) {
+        uint32_t count = cull->object_count - first < max_count ? cull->object_count - first : max_count;
+        vk_cmd_draw_indexed_indirect(cmd, frame->commands, (VkDeviceSize) first * stride, count, stride);
+    }
+}
+
+InstanceCullStats instance_cull_read_stats(const InstanceCull* cull, uint32_t frame_index) {
+    // Host coherent, so nothing needs invalidating.
+    const uint32_t* count = cull->frames[frame_index].count_memory.mapped;
+    return (InstanceCullStats){
+        .tested    = cull->object_count,
+        .visible   = count[0],
+        .occluded  = count[3],
+        .triangles = count[1] | (uint64_t) count[2] << 32,
+    };
+}
@@ -0,0 +1,98 @@
+#ifndef instance_cull_h
+#define instance_cull_h
+#include "gpu.h"
+#include "hiz.h"
+#include "linalg.h"
+
+#define INSTANCE_CULL_MAX_FRAMES 8
+
+// A culled object, laid out for std430. Its draws are `draw_count` records from `draw_offset`,
+// finest first, and its index in the object array is the instance it draws.
+typedef struct {
+    Vec3     center; // World space.
+    float    radius;
+    uint32_t draw_offset;
+    uint32_t draw_count;
+    float    error_scale; // Converts its draw records' errors to world units.
+    uint32_t pad;
+} InstanceCullObject;
+
+// One way to draw an object, e.g. one LOD of its mesh. `error` is in the mesh's units.
+typedef struct {
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t  vertex_offset;
+    float    error;
+} InstanceCullDraw;
+
+// Per frame in flight, so a frame's commands aren't overwritten while an earlier one still draws them.
+typedef struct {
+    VkBuffer        commands; // One VkDrawIndexedIndirectCommand per object.
+    MemoryBlock     command_memory;
+    VkBuffer        count; // Visible objects, the 64-bit count of triangles they draw, then occluded objects.
+    MemoryBlock     count_memory;
+    VkBuffer        occlusion; // The view-projection the Hi-Z pyramid was rendered with.
+    MemoryBlock     occlusion_memory;
+    VkDescriptorSet set;
+} InstanceCullFrame;
+
+// GPU-driven drawing of instances: a compute pass culls every object against the frustum, selects
+// its LOD and writes its draw command, so the CPU records the same dispatch and draw whatever the
+// object count. With VK_KHR_draw_indirect_count the visible commands are compacted and drawn with
+// vkCmdDrawIndexedIndirectCount; without it every object keeps a slot, culled ones drawing zero
+// instances, and a plain vkCmdDrawIndexedIndirect draws them all. Both need multi-draw indirect and
+// draw indirect first instance, see instance_cull_supported.
+//
+// Objects can also be tested against a Hi-Z pyramid built from the previous frame's depth. Each
+// object's bounds are projected with that frame's view-projection, so the test asks whether the
+// object was hidden behind what was drawn then. Occluders are themselves drawn, so their depth is
+// always in the pyramid, but an object the camera has just uncovered appears a frame late.
+typedef struct {
+    VkDescriptorSetLayout set_layout;
+    VkPipelineLayout      layout;
+    VkShaderModule        shader;
+    VkPipeline            pipeline;
+    VkDescriptorPool      pool;
+    VkBuffer              objects;
+    MemoryBlock           object_memory;
+    VkBuffer              draws;
+    MemoryBlock           draw_memory;
+    InstanceCullFrame     frames[INSTANCE_CULL_MAX_FRAMES];
+    uint32_t              frame_count;
+    uint32_t              object_count;
+    int                   compact;
+    uint32_t              depth_width;
+    uint32_t              depth_height;
+} InstanceCull;
+
+typedef struct {
+    uint32_t tested;
+    uint32_t visible;
+    uint32_t occluded; // Inside the frustum but hidden, and not drawn.
+    uint64_t triangles;
+} InstanceCullStats;
+
+int instance_cull_supported(const GPU* gpu);
+
+// `hiz` is the pyramid the occlusion test reads, which it only does when instance_cull_record asks.
+void instance_cull_create(GPU* gpu, VkPipelineCache cache, InstanceCull* cull, const InstanceCullObject* objects,
+                          uint32_t object_count, const InstanceCullDraw* draws, uint32_t draw_count,
+                          uint32_t frame_count, const HiZ* hiz);
+void instance_cull_destroy(GPU* gpu, InstanceCull* cull);
+
+// Records the culling of every object under `view_projection`. Radii and errors are multiplied by
+// `model_scale`; LODs are selected so their error stays under `threshold` pixels on a viewport
+// `height` pixels high. With `occlusion_view_projection`, the view-projection the pyramid's depth was
+// rendered with, objects hidden in the pyramid are culled too; the pyramid must have been cleared or
+// built by then. Must be outside a render pass.
+void instance_cull_record(InstanceCull* cull, VkCommandBuffer cmd, uint32_t frame_index, const Mat4* view_projection,
+                          float model_scale, float height, float threshold, const Mat4* occlusion_view_projection);
+
+// Draws the visible objects. The index and vertex buffers, the pipeline and its instance data are
+// the caller's.
+void instance_cull_draw(const InstanceCull* cull, const GPU* gpu, VkCommandBuffer cmd, uint32_t frame_index);
+
+// What the pass recorded for `frame_index` kept, once that frame's fence has been waited on.
+InstanceCullStats instance_cull_read_stats(const InstanceCull* cull, uint32_t frame_index);
+
+#endif
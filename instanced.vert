@@ -0,0 +1,49 @@
+#version 450
+
+// basic.vert for many copies of one mesh in one draw. Each instance's transform and color come from
+// storage buffers indexed by gl_InstanceIndex, which includes the draw's first instance.
+layout(constant_id = 0) const int VERTEX_FORMAT = 0; // 0: vec4 positions, 1: vec3 positions with w = 1.
+layout(constant_id = 1) const int NORMAL_FORMAT = 0; // 0: none, 1: vec3, 2: octahedral in two snorm components.
+
+layout(std140, set = 0, binding = 0) uniform View {
+    mat4 view_projection;
+    mat4 model; // Mesh to instance space, shared by every instance.
+};
+// The top three rows of each instance's affine transform, three vec4s per instance.
+layout(std430, set = 0, binding = 1) readonly buffer Transforms {
+    vec4 transforms[];
+};
+// RGBA8, multiplied with the vertex color.
+layout(std430, set = 0, binding = 2) readonly buffer Colors {
+    uint colors[];
+};
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec4 normal;
+layout(location = 0) out vec4 out_color;
+layout(location = 1) out vec3 out_position;
+layout(location = 2) out vec3 out_normal;
+
+vec3 decode_oct(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main() {
+    vec4 p = model * (VERTEX_FORMAT == 1 ? vec4(position.xyz, 1.0) : position);
+    uint base = 3u * uint(gl_InstanceIndex);
+    vec4 x = transforms[base];
+    vec4 y = transforms[base + 1u];
+    vec4 z = transforms[base + 2u];
+    vec3 world = vec3(dot(x, p), dot(y, p), dot(z, p));
+    gl_Position = view_projection * vec4(world, 1.0);
+    out_color = color * unpackUnorm4x8(colors[gl_InstanceIndex]);
+    // World space, so the fragment shader's lighting turns with each instance. Instance scales are
+    // uniform and the fragment shader normalizes, so the rotation rows transform normals as they are.
+    out_position = world;
+    vec3 n = NORMAL_FORMAT == 2 ? decode_oct(normal.xy) : NORMAL_FORMAT == 1 ? normal.xyz : vec3(0.0);
+    out_normal = vec3(dot(x.xyz, n), dot(y.xyz, n), dot(z.xyz, n));
+}
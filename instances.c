@@ -0,0 +1,153 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "instances.h"
+
+enum { BINDING_VIEW, BINDING_TRANSFORMS, BINDING_COLORS, BINDING_COUNT };
+
+void instances_create(GPU* gpu, Instances* instances, uint32_t count, uint32_t frame_count) {
+    assert(count && count <= INSTANCES_MAX);
+    assert(frame_count <= INSTANCES_MAX_FRAMES);
+    VkDeviceSize alignment = gpu->properties.limits.min_uniform_buffer_offset_alignment;
+    *instances             = (Instances){
+        .view_stride = (sizeof(InstanceView) + alignment - 1) / alignment * alignment,
+        .frame_count = frame_count,
+        .count       = count,
+        .scale       = 1.0f,
+    };
+
+    VkDescriptorSetLayoutBinding bindings[BINDING_COUNT];
+    for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+        bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding          = i,
+            .descriptor_type  = i == BINDING_VIEW ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                                  : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptor_count = 1,
+            .stage_flags      = VK_SHADER_STAGE_VERTEX_BIT,
+        };
+    }
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .s_type        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .binding_count = BINDING_COUNT,
+        .p_bindings    = bindings,
+    };
+    vk_create_descriptor_set_layout(gpu->device, &set_layout_info, NULL, &instances->set_layout);
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame_count },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * frame_count },
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .s_type          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .max_sets        = frame_count,
+        .pool_size_count = 2,
+        .p_pool_sizes    = pool_sizes,
+    };
+    vk_create_descriptor_pool(gpu->device, &pool_info, NULL, &instances->pool);
+
+    // Every buffer is written by the CPU.
+    MemoryHeap* heap      = &gpu->host_visible_heap;
+    instances->transforms = gpu_create_buffer(gpu, heap, sizeof(InstanceTransform) * (VkDeviceSize) count,
+                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &instances->transform_memory,
+                                              "Instance transform buffer");
+    instances->colors     = gpu_create_buffer(gpu, heap, sizeof(uint32_t) * (VkDeviceSize) count,
+                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &instances->color_memory,
+                                              "Instance color buffer");
+    instances->views      = gpu_create_buffer(gpu, heap, instances->view_stride * frame_count,
+                                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &instances->view_memory,
+                                              "Instance view buffer");
+
+    for (uint32_t i = 0; i < frame_count; i++) {
+        VkDescriptorSetAllocateInfo set_info = {
+            .s_type               = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptor_pool      = instances->pool,
+            .descriptor_set_count = 1,
+            .p_set_layouts        = &instances->set_layout,
+        };
+        vk_allocate_descriptor_sets(gpu->device, &set_info, &instances->sets[i]);
+
+        VkDescriptorBufferInfo buffers[BINDING_COUNT] = {
+            [BINDING_VIEW]       = { instances->views, instances->view_stride * i, sizeof(InstanceView) },
+            [BINDING_TRANSFORMS] = { instances->transforms, 0, VK_WHOLE_SIZE },
+            [BINDING_COLORS]     = { instances->colors, 0, VK_WHOLE_SIZE },
+        };
+        VkWriteDescriptorSet writes[BINDING_COUNT];
+        for (uint32_t b = 0; b < BINDING_COUNT; b++) {
+            writes[b] = (VkWriteDescriptorSet){
+                .s_type           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dst_set          = instances->sets[i],
+                .dst_binding      = b,
+                .descriptor_count = 1,
+                .descriptor_type  = bindings[b].descriptor_type,
+                .p_buffer_info    = &buffers[b],
+            };
+        }
+        vk_update_descriptor_sets(gpu->device, BINDING_COUNT, writes, 0, NULL);
+    }
+}
+
+void instances_destroy(GPU* gpu, Instances* instances) {
+    vk_destroy_buffer(gpu->device, instances->transforms, NULL);
+    vk_destroy_buffer(gpu->device, instances->colors, NULL);
+    vk_destroy_buffer(gpu->device, instances->views, NULL);
+    vk_destroy_descriptor_pool(gpu->device, instances->pool, NULL);
+    vk_destroy_descriptor_set_layout(gpu->device, instances->set_layout, NULL);
+}
+
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static float unit_float(uint64_t bits) {
+    return (float) (bits >> 40) / (float) (1 << 24);
+}
+
+void instances_fill_grid(Instances* instances, float extent, float object_radius, uint64_t seed, Vec3* centers) {
+    uint32_t side = 1;
+    while ((uint64_t) side * side * side < instances->count) {
+        side++;
+    }
+    float spacing    = 2.0f * extent / side;
+    instances->scale = 0.4f * spacing / object_radius;
+
+    InstanceTransform* transforms = instances->transform_memory.mapped;
+    uint32_t*          colors     = instances->color_memory.mapped;
+    for (uint32_t i = 0; i < instances->count; i++) {
+        uint64_t h0     = splitmix64(seed + i);
+        uint64_t h1     = splitmix64(h0);
+        uint64_t h2     = splitmix64(h1);
+        uint64_t h3     = splitmix64(h2);
+        Vec3     axis   = { unit_float(h0) - 0.5f, unit_float(h1) - 0.5f, unit_float(h2) - 0.5f };
+        Mat4     rotate = mat4_rotate(axis, unit_float(h3) * 2.0f * (float) M_PI);
+        Vec3     center = {
+            -extent + (i % side + 0.5f) * spacing,
+            -extent + (i / side % side + 0.5f) * spacing,
+            -extent + (i / side / side + 0.5f) * spacing,
+        };
+        float s       = instances->scale;
+        transforms[i] = (InstanceTransform){ {
+            { s * rotate.xx, s * rotate.yx, s * rotate.zx, center.x },
+            { s * rotate.xy, s * rotate.yy, s * rotate.zy, center.y },
+            { s * rotate.xz, s * rotate.yz, s * rotate.zz, center.z },
+        } };
+        if (centers) {
+            centers[i] = center;
+        }
+        // Bright enough to stay visible unlit: every channel in [64, 255].
+        colors[i] = (uint32_t) (64 + h3 % 192) | (uint32_t) (64 + (h3 >> 8) % 192) << 8
+                  | (uint32_t) (64 + (h3 >> 16) % 192) << 16 | 0xffu << 24;
+    }
+}
+
+void instances_set_view(Instances* instances, uint32_t frame_index, const InstanceView* view) {
+    // Host coherent, so the write is visible to the frame's submit without a flush.
+    memcpy((char*) instances->view_memory.mapped + instances->view_stride * frame_index, view, sizeof(*view));
+}
+
+void instances_bind(Instances* instances, VkCommandBuffer cmd, VkPipelineLayout layout, uint32_t frame_index) {
+    vk_cmd_bind_descriptor_sets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &instances->sets[frame_index], 0,
+                                NULL);
+}
@@ -0,0 +1,57 @@
+#ifndef instances_h
+#define instances_h
+#include "gpu.h"
+#include "linalg.h"
+
+#define INSTANCES_MAX_FRAMES 8
+// Keeps the transform array within the 128 MiB every device allows a storage buffer binding.
+#define INSTANCES_MAX (1u << 21)
+
+// The top three rows of an affine object-to-world matrix, so a point transforms as
+// `world.x = dot(rows[0], vec4(p, 1))` and so on: 48 bytes instead of a Mat4's 64.
+typedef struct {
+    float rows[3][4];
+} InstanceTransform;
+
+// Matches the View uniform block in instanced.vert.
+typedef struct {
+    Mat4 view_projection;
+    Mat4 model; // Mesh to instance space, shared by every instance.
+} InstanceView;
+
+// Many copies of one mesh drawn by a single vkCmdDrawIndexed. Transforms and RGBA8 colors are
+// separate storage buffers indexed by gl_InstanceIndex, so per-instance data costs 52 bytes and
+// nothing goes through the vertex input state; the view is a uniform with one copy per frame in
+// flight, so updating it never waits on the GPU.
+typedef struct {
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool      pool;
+    VkBuffer              transforms;
+    MemoryBlock           transform_memory;
+    VkBuffer              colors;
+    MemoryBlock           color_memory;
+    VkBuffer              views;
+    MemoryBlock           view_memory;
+    VkDeviceSize          view_stride;
+    VkDescriptorSet       sets[INSTANCES_MAX_FRAMES];
+    uint32_t              frame_count;
+    uint32_t              count;
+    float                 scale; // Of every instance, as placed by instances_fill_grid.
+} Instances;
+
+void instances_create(GPU* gpu, Instances* instances, uint32_t count, uint32_t frame_count);
+void instances_destroy(GPU* gpu, Instances* instances);
+
+// Places the instances on a cubic grid filling [-extent, extent] in every axis, each turned about a
+// random axis and given a random color, all derived from `seed`. Objects are assumed to fit in a
+// sphere of `object_radius` and are scaled to leave a gap between neighbours. Each instance's
+// position is also written to `centers` unless it's NULL, sparing callers reads of mapped memory.
+void instances_fill_grid(Instances* instances, float extent, float object_radius, uint64_t seed, Vec3* centers);
+
+// Writes `frame_index`'s view. The frame's previous commands must have completed.
+void instances_set_view(Instances* instances, uint32_t frame_index, const InstanceView* view);
+
+// Binds `frame_index`'s set, which `layout` must have been created with as set 0.
+void instances_bind(Instances* instances, VkCommandBuffer cmd, VkPipelineLayout layout, uint32_t frame_index);
+
+#endif
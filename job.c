@@ -0,0 +1,118 @@
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include "job.h"
+
+// Must be called with the mutex held.
+static Job* pop_job(JobSystem* jobs) {
+    Job* job = jobs->head;
+    if (job) {
+        jobs->head = job->next;
+        if (!jobs->head) {
+            jobs->tail = NULL;
+        }
+    }
+    return job;
+}
+
+static void run_job(JobSystem* jobs, Job* job) {
+    job->function(job->data);
+
+    pthread_mutex_lock(&jobs->mutex);
+    atomic_store_explicit(&job->done, 1, memory_order_release);
+    pthread_cond_broadcast(&jobs->finished);
+    pthread_mutex_unlock(&jobs->mutex);
+}
+
+static void* worker_main(void* arg) {
+    JobSystem* jobs = arg;
+
+    pthread_mutex_lock(&jobs->mutex);
+    for (;;) {
+        Job* job;
+        while (!(job = pop_job(jobs)) && !jobs->quit) {
+            pthread_cond_wait(&jobs->queued, &jobs->mutex);
+        }
+        if (!job) {
+            break;
+        }
+        pthread_mutex_unlock(&jobs->mutex);
+        run_job(jobs, job);
+        pthread_mutex_lock(&jobs->mutex);
+    }
+    pthread_mutex_unlock(&jobs->mutex);
+
+    return NULL;
+}
+
+void job_system_create(JobSystem* jobs, uint32_t thread_count) {
+    memset(jobs, 0, sizeof(*jobs));
+    if (!thread_count) {
+        long cores   = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cores > 1 ? cores - 1 : 1;
+    }
+    if (thread_count > JOB_MAX_THREADS) {
+        thread_count = JOB_MAX_THREADS;
+    }
+
+    pthread_mutex_init(&jobs->mutex, NULL);
+    pthread_cond_init(&jobs->queued, NULL);
+    pthread_cond_init(&jobs->finished, NULL);
+    jobs->thread_count = thread_count;
+    for (uint32_t i = 0; i < thread_count; i++) {
+        pthread_create(&jobs->threads[i], NULL, worker_main, jobs);
+    }
+}
+
+// Queued jobs are still run before the workers exit.
+void job_system_destroy(JobSystem* jobs) {
+    pthread_mutex_lock(&jobs->mutex);
+    jobs->quit = 1;
+    pthread_cond_broadcast(&jobs->queued);
+    pthread_mutex_unlock(&jobs->mutex);
+
+    for (uint32_t i = 0; i < jobs->thread_count; i++) {
+        pthread_join(jobs->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&jobs->mutex);
+    pthread_cond_destroy(&jobs->queued);
+    pthread_cond_destroy(&jobs->finished);
+}
+
+void job_submit(JobSystem* jobs, Job* job, JobFunction function, void* data) {
+    job->function = function;
+    job->data     = data;
+    job->next     = NULL;
+    atomic_init(&job->done, 0);
+
+    pthread_mutex_lock(&jobs->mutex);
+    if (jobs->tail) {
+        jobs->tail->next = job;
+    } else {
+        jobs->head = job;
+    }
+    jobs->tail = job;
+    pthread_cond_signal(&jobs->queued);
+    pthread_mutex_unlock(&jobs->mutex);
+}
+
+int job_done(const Job* job) {
+    return atomic_load_explicit(&job->done, memory_order_acquire);
+}
+
+// Runs queued jobs on the calling thread while waiting, so waiting on a job that hasn't started
+// yet doesn't leave this thread idle.
+void job_wait(JobSystem* jobs, Job* job) {
+    pthread_mutex_lock(&jobs->mutex);
+    while (!job_done(job)) {
+        Job* other = pop_job(jobs);
+        if (other) {
+            pthread_mutex_unlock(&jobs->mutex);
+            run_job(jobs, other);
+            pthread_mutex_lock(&jobs->mutex);
+        } else {
+            pthread_cond_wait(&jobs->finished, &jobs->mutex);
+        }
+    }
+    pthread_mutex_unlock(&jobs->mutex);
+}
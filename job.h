@@ -0,0 +1,38 @@
+#ifndef job_h
+#define job_h
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define JOB_MAX_THREADS 64
+
+typedef void (*JobFunction)(void* data);
+
+// Jobs are owned by the caller and must stay alive until they are done. A job doubles as the
+// future for its result: poll job_done or block in job_wait.
+typedef struct Job {
+    JobFunction function;
+    void*       data;
+    atomic_int  done;
+    struct Job* next;
+} Job;
+
+typedef struct {
+    pthread_t       threads[JOB_MAX_THREADS];
+    uint32_t        thread_count;
+    pthread_mutex_t mutex;
+    pthread_cond_t  queued;
+    pthread_cond_t  finished;
+    Job*            head;
+    Job*            tail;
+    int             quit;
+} JobSystem;
+
+// A thread count of zero uses one thread per core, minus the render thread.
+void job_system_create(JobSystem* jobs, uint32_t thread_count);
+void job_system_destroy(JobSystem* jobs);
+void job_submit(JobSystem* jobs, Job* job, JobFunction function, void* data);
+int  job_done(const Job* job);
+void job_wait(JobSystem* jobs, Job* job);
+
+#endif
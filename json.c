@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <string.h>
+#include "json.h"
+
+// Nesting deeper than this is rejected rather than risking the stack.
+#define JSON_MAX_DEPTH 64
+
+typedef struct {
+    const char* text;
+    size_t      length;
+    size_t      at;
+    JsonToken*  tokens;
+    uint32_t    count;
+    uint32_t    capacity;
+} Parser;
+
+static void skip_space(Parser* p) {
+    while (p->at < p->length
+           && (p->text[p->at] == ' ' || p->text[p->at] == '\t' || p->text[p->at] == '\n' || p->text[p->at] == '\r')) {
+        p->at++;
+    }
+}
+
+static uint32_t push_token(Parser* p, JsonType type, size_t start) {
+    if (p->count == p->capacity) {
+        p->capacity = p->capacity ? 2 * p->capacity : 256;
+        p->tokens   = realloc(p->tokens, sizeof(JsonToken) * p->capacity);
+    }
+    p->tokens[p->count] = (JsonToken){ .type = type, .start = (uint32_t) start };
+    return p->count++;
+}
+
+static int parse_literal(Parser* p, const char* literal) {
+    size_t length = strlen(literal);
+    if (p->length - p->at < length || memcmp(p->text + p->at, literal, length)) {
+        return 0;
+    }
+    p->at += length;
+    return 1;
+}
+
+static int parse_string(Parser* p) {
+    p->at++; // Opening quote.
+    uint32_t token = push_token(p, JSON_STRING, p->at);
+    while (p->at < p->length && p->text[p->at] != '"') {
+        if (p->text[p->at] == '\\') {
+            p->at++;
+        }
+        p->at++;
+    }
+    if (p->at >= p->length) {
+        return 0;
+    }
+    p->tokens[token].length = (uint32_t) (p->at - p->tokens[token].start);
+    p->tokens[token].next   = token + 1;
+    p->at++;
+    return 1;
+}
+
+static int parse_value(Parser* p, uint32_t depth);
+
+static int parse_container(Parser* p, JsonType type, char close, uint32_t depth) {
+    uint32_t token = push_token(p, type, p->at);
+    p->at++;
+    skip_space(p);
+    if (p->at < p->length && p->text[p->at] == close) {
+        p->at++;
+        return 1;
+    }
+    for (;;) {
+        if (type == JSON_OBJECT) {
+            skip_space(p);
+            if (p->at >= p->length || p->text[p->at] != '"' || !parse_string(p)) {
+                return 0;
+            }
+            skip_space(p);
+            if (p->at >= p->length || p->text[p->at] != ':') {
+                return 0;
+            }
+            p->at++;
+            p->tokens[token].count++;
+        }
+        if (!parse_value(p, depth + 1)) {
+            return 0;
+        }
+        p->tokens[token].count++;
+        skip_space(p);
+        if (p->at >= p->length) {
+            return 0;
+        }
+        if (p->text[p->at] == close) {
+            p->at++;
+            return 1;
+        }
+        if (p->text[p->at] != ',') {
+            return 0;
+        }
+        p->at++;
+    }
+}
+
+static int parse_value(Parser* p, uint32_t depth) {
+    skip_space(p);
+    if (p->at >= p->length || depth > JSON_MAX_DEPTH) {
+        return 0;
+    }
+
+    uint32_t token = p->count;
+    int      ok;
+    char     c = p->text[p->at];
+    if (c == '{') {
+        ok = parse_container(p, JSON_OBJECT, '}', depth);
+    } else if (c == '[') {
+        ok = parse_container(p, JSON_ARRAY, ']', depth);
+    } else if (c == '"') {
+        ok = parse_string(p);
+    } else if (c == 't' || c == 'f') {
+        push_token(p, JSON_BOOL, p->at);
+        ok = parse_literal(p, c == 't' ? "true" : "false");
+    } else if (c == 'n') {
+        push_token(p, JSON_NULL, p->at);
+        ok = parse_literal(p, "null");
+    } else {
+        size_t start = p->at;
+        while (p->at < p->length && p->text[p->at] && strchr("+-0123456789.eE", p->text[p->at])) {
+            p->at++;
+        }
+        push_token(p, JSON_NUMBER, start);
+        ok = p->at > start;
+    }
+    if (!ok) {
+        return 0;
+    }
+    if (p->tokens[token].type != JSON_STRING) {
+        p->tokens[token].length = (uint32_t) (p->at - p->tokens[token].start);
+    }
+    p->tokens[token].next = p->count;
+    return 1;
+}
+
+int json_parse(Json* json, const char* text, size_t length) {
+    Parser p = { .text = text, .length = length };
+    int    ok = parse_value(&p, 0);
+    skip_space(&p);
+    ok = ok && p.at == p.length;
+    if (!ok) {
+        free(p.tokens);
+        *json = (Json){};
+        return 0;
+    }
+    *json = (Json){ .text = text, .tokens = p.tokens, .count = p.count };
+    return 1;
+}
+
+void json_destroy(Json* json) {
+    free(json->tokens);
+    *json = (Json){};
+}
+
+uint32_t json_get(const Json* json, uint32_t object, const char* key) {
+    if (object == JSON_NONE || json->tokens[object].type != JSON_OBJECT) {
+        return JSON_NONE;
+    }
+    size_t   key_length = strlen(key);
+    uint32_t child      = object + 1;
+    for (uint32_t i = 0; i < json->tokens[object].count; i += 2) {
+        const JsonToken* name  = &json->tokens[child];
+        uint32_t         value = child + 1;
+        if (name->length == key_length && !memcmp(json->text + name->start, key, key_length)) {
+            return value;
+        }
+        child = json->tokens[value].next;
+    }
+    return JSON_NONE;
+}
+
+uint32_t json_at(const Json* json, uint32_t array, uint32_t index) {
+    if (array == JSON_NONE || json->tokens[array].type != JSON_ARRAY || index >= json->tokens[array].count) {
+        return JSON_NONE;
+    }
+    uint32_t child = array + 1;
+    for (uint32_t i = 0; i < index; i++) {
+        child = json->tokens[child].next;
+    }
+    return child;
+}
+
+uint32_t json_count(const Json* json, uint32_t array) {
+    if (array == JSON_NONE || json->tokens[array].type != JSON_ARRAY) {
+        return 0;
+    }
+    return json->tokens[array].count;
+}
+
+double json_number(const Json* json, uint32_t token, double fallback) {
+    if (token == JSON_NONE || json->tokens[token].type != JSON_NUMBER || json->tokens[token].length >= 64) {
+        return fallback;
+    }
+    // The source text isn't terminated, so strtod gets a copy.
+    char number[64];
+    memcpy(number, json->text + json->tokens[token].start, json->tokens[token].length);
+    number[json->tokens[token].length] = 0;
+    return strtod(number, NULL);
+}
+
+uint32_t json_index(const Json* json, uint32_t token, uint32_t fallback) {
+    if (token == JSON_NONE) {
+        return fallback;
+    }
+    // Range checked before converting, since a double outside uint32_t doesn't convert to one.
+    double value = json_number(json, token, -1.0);
+    if (!(value >= 0.0 && value < (double) JSON_NONE) || value != (double) (uint32_t) value) {
+        return JSON_NONE;
+    }
+    return (uint32_t) value;
+}
+
+int json_equals(const Json* json, uint32_t string, const char* value) {
+    if (string == JSON_NONE || json->tokens[string].type != JSON_STRING) {
+        return 0;
+    }
+    size_t length = strlen(value);
+    return json->tokens[string].length == length && !memcmp(json->text + json->tokens[string].start, value, length);
+}
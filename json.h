@@ -0,0 +1,47 @@
+#ifndef json_h
+#define json_h
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_NONE UINT32_MAX
+
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT,
+} JsonType;
+
+// One token per value, in document order. Strings span their contents in the source text, without
+// quotes and with escapes left in place. An object's children alternate key and value.
+typedef struct {
+    JsonType type;
+    uint32_t start;
+    uint32_t length;
+    uint32_t count; // Array elements, or object keys plus values.
+    uint32_t next;  // The token after this value and everything nested in it.
+} JsonToken;
+
+typedef struct {
+    const char* text;
+    JsonToken*  tokens;
+    uint32_t    count;
+} Json;
+
+// Tokenizes the whole document. Returns 0 on a syntax error. The text must outlive the tokens.
+int  json_parse(Json* json, const char* text, size_t length);
+void json_destroy(Json* json);
+
+// Lookups return JSON_NONE when the value is missing or has the wrong type, and accept JSON_NONE,
+// so they chain.
+uint32_t json_get(const Json* json, uint32_t object, const char* key);
+uint32_t json_at(const Json* json, uint32_t array, uint32_t index);
+uint32_t json_count(const Json* json, uint32_t array);
+double   json_number(const Json* json, uint32_t token, double fallback);
+// `fallback` when the value is missing, or JSON_NONE when it isn't a whole number below JSON_NONE.
+uint32_t json_index(const Json* json, uint32_t token, uint32_t fallback);
+int      json_equals(const Json* json, uint32_t string, const char* value);
+
+#endif
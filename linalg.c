@@ -0,0 +1,150 @@
+#include <math.h>
+#include "linalg.h"
+
+Vec3 vec3_sub(Vec3 a, Vec3 b) {
+    return (Vec3){ a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+Vec3 vec3_cross(Vec3 a, Vec3 b) {
+    return (Vec3){ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+float vec3_dot(Vec3 a, Vec3 b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+Vec3 vec3_normalize(Vec3 v) {
+    float inv = 1.0f / sqrtf(vec3_dot(v, v));
+    return (Vec3){ v.x * inv, v.y * inv, v.z * inv };
+}
+
+Mat4 mat4_identity() {
+    return (Mat4){
+        1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1,
+    };
+}
+
+Mat4 mat4_scale(float s) {
+    return (Mat4){
+        s, 0, 0, 0, 0, s, 0, 0, 0, 0, s, 0, 0, 0, 0, 1,
+    };
+}
+
+Mat4 mat4_mul(const Mat4* a, const Mat4* b) {
+    const float* l = &a->xx;
+    const float* r = &b->xx;
+    Mat4         m;
+    float*       out = &m.xx;
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                sum += l[k * 4 + row] * r[col * 4 + k];
+            }
+            out[col * 4 + row] = sum;
+        }
+    }
+    return m;
+}
+
+Mat4 mat4_rotate(Vec3 axis, float radians) {
+    Vec3  n = vec3_normalize(axis);
+    float c = cosf(radians);
+    float s = sinf(radians);
+    float t = 1.0f - c;
+    return (Mat4){
+        t * n.x * n.x + c,       t * n.x * n.y + s * n.z, t * n.x * n.z - s * n.y, 0,
+        t * n.x * n.y - s * n.z, t * n.y * n.y + c,       t * n.y * n.z + s * n.x, 0,
+        t * n.x * n.z + s * n.y, t * n.y * n.z - s * n.x, t * n.z * n.z + c,       0,
+        0,                       0,                       0,                       1,
+    };
+}
+
+// Right-handed view matrix: the camera looks down -z.
+Mat4 mat4_look_at(Vec3 eye, Vec3 center, Vec3 up) {
+    Vec3 f = vec3_normalize(vec3_sub(center, eye));
+    Vec3 s = vec3_normalize(vec3_cross(f, up));
+    Vec3 u = vec3_cross(s, f);
+    return (Mat4){
+        s.x, u.x, -f.x, 0, s.y, u.y, -f.y, 0, s.z, u.z, -f.z, 0, -vec3_dot(s, eye), -vec3_dot(u, eye), vec3_dot(f, eye),
+        1,
+    };
+}
+
+// Projection into Vulkan clip space: y points down and depth maps to [0, 1].
+Mat4 mat4_perspective(float fovy, float aspect, float near, float far) {
+    float f = 1.0f / tanf(fovy * 0.5f);
+    return (Mat4){
+        f / aspect, 0, 0, 0, 0, -f, 0, 0, 0, 0, -far / (far - near), -1, 0, 0, -far * near / (far - near), 0,
+    };
+}
+
+// Cofactors over the determinant. The matrix must be invertible. The same expansion works on either
+// storage order, since the inverse of the transpose is the transpose of the inverse.
+Mat4 mat4_inverse(const Mat4* matrix) {
+    const float* m = &matrix->xx;
+    Mat4         result;
+    float*       inv = &result.xx;
+    inv[0]  = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14]
+           + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4]  = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14]
+           - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8]  = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13]
+           + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13]
+            - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1]  = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14]
+           - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5]  = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14]
+           + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9]  = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13]
+           - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13]
+            + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2]  = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14]
+           + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6]  = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14]
+           - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13]
+            + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13]
+            - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3]  = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10]
+           - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7]  = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10]
+           + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9]
+            - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9]
+            + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float scale = 1.0f / (m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12]);
+    for (int i = 0; i < 16; i++) {
+        inv[i] *= scale;
+    }
+    return result;
+}
+
+// Gribb and Hartmann: each clip-space bound, -w <= x <= w, -w <= y <= w and 0 <= z <= w, is a sum
+// or difference of rows of the matrix, which gives the plane in the matrix's source space,
+// normalized and pointing inwards.
+void mat4_frustum_planes(const Mat4* m, float planes[6][4]) {
+    float x[4] = { m->xx, m->yx, m->zx, m->wx };
+    float y[4] = { m->xy, m->yy, m->zy, m->wy };
+    float z[4] = { m->xz, m->yz, m->zz, m->wz };
+    float w[4] = { m->xw, m->yw, m->zw, m->ww };
+    for (int i = 0; i < 4; i++) {
+        planes[0][i] = w[i] + x[i];
+        planes[1][i] = w[i] - x[i];
+        planes[2][i] = w[i] + y[i];
+        planes[3][i] = w[i] - y[i];
+        planes[4][i] = z[i];
+        planes[5][i] = w[i] - z[i];
+    }
+    for (int p = 0; p < 6; p++) {
+        float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        for (int i = 0; i < 4; i++) {
+            planes[p][i] /= length;
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef linalg_h
+#define linalg_h
+
+typedef struct {
+    float x, y, z;
+} Vec3;
+
+// Column-major, matching GLSL's mat4 layout: `xy` is column x, row y.
+typedef struct {
+    float xx, xy, xz, xw;
+    float yx, yy, yz, yw;
+    float zx, zy, zz, zw;
+    float wx, wy, wz, ww;
+} Mat4;
+
+Vec3  vec3_sub(Vec3 a, Vec3 b);
+Vec3  vec3_cross(Vec3 a, Vec3 b);
+float vec3_dot(Vec3 a, Vec3 b);
+Vec3  vec3_normalize(Vec3 v);
+
+Mat4 mat4_identity();
+Mat4 mat4_scale(float s);
+Mat4 mat4_mul(const Mat4* a, const Mat4* b);
+Mat4 mat4_rotate(Vec3 axis, float radians);
+Mat4 mat4_look_at(Vec3 eye, Vec3 center, Vec3 up);
+Mat4 mat4_perspective(float fovy, float aspect, float near, float far);
+Mat4 mat4_inverse(const Mat4* m);
+void mat4_frustum_planes(const Mat4* m, float planes[6][4]);
+
+#endif
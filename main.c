@@ -1,267 +1,1492 @@
+#include <math.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "window.h"
 #include "gpu.h"
 #include "swapchain.h"
+#include "linalg.h"
+#include "bench.h"
+#include "readback.h"
+#include "screenshot.h"
+#include "capture.h"
+#include "pipeline_cache.h"
+#include "pipeline.h"
+#include "pipeline_registry.h"
+#include "job.h"
+#include "shader_watch.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "mesh_load.h"
+#include "mesh_lod.h"
+#include "mesh_meshlet.h"
+#include "mesh_optimize.h"
+#include "meshlet_cull.h"
+#include "instances.h"
+#include "hiz.h"
+#include "instance_cull.h"
+#include "cull.h"
+#include "bvh.h"
+#include "draw_queue.h"
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
 
-typedef struct {
-    float x, y, z, w;
-    float r, g, b, a;
-} Vertex;
-
-#define XYZ1(x, y, z) x, y, z, 1.0f
-
-const Vertex CUBE_VERTEX_LIST[] = {
-    // red face
-    { XYZ1(-1, -1, 1), XYZ1(1.f, 0.f, 0.f) },
-    { XYZ1(-1, 1, 1), XYZ1(1.f, 0.f, 0.f) },
-    { XYZ1(1, -1, 1), XYZ1(1.f, 0.f, 0.f) },
-    { XYZ1(1, -1, 1), XYZ1(1.f, 0.f, 0.f) },
-    { XYZ1(-1, 1, 1), XYZ1(1.f, 0.f, 0.f) },
-    { XYZ1(1, 1, 1), XYZ1(1.f, 0.f, 0.f) },
-    // green face
-    { XYZ1(-1, -1, -1), XYZ1(0.f, 1.f, 0.f) },
-    { XYZ1(1, -1, -1), XYZ1(0.f, 1.f, 0.f) },
-    { XYZ1(-1, 1, -1), XYZ1(0.f, 1.f, 0.f) },
-    { XYZ1(-1, 1, -1), XYZ1(0.f, 1.f, 0.f) },
-    { XYZ1(1, -1, -1), XYZ1(0.f, 1.f, 0.f) },
-    { XYZ1(1, 1, -1), XYZ1(0.f, 1.f, 0.f) },
-    // blue face
-    { XYZ1(-1, 1, 1), XYZ1(0.f, 0.f, 1.f) },
-    { XYZ1(-1, -1, 1), XYZ1(0.f, 0.f, 1.f) },
-    { XYZ1(-1, 1, -1), XYZ1(0.f, 0.f, 1.f) },
-    { XYZ1(-1, 1, -1), XYZ1(0.f, 0.f, 1.f) },
-    { XYZ1(-1, -1, 1), XYZ1(0.f, 0.f, 1.f) },
-    { XYZ1(-1, -1, -1), XYZ1(0.f, 0.f, 1.f) },
-    // yellow face
-    { XYZ1(1, 1, 1), XYZ1(1.f, 1.f, 0.f) },
-    { XYZ1(1, 1, -1), XYZ1(1.f, 1.f, 0.f) },
-    { XYZ1(1, -1, 1), XYZ1(1.f, 1.f, 0.f) },
-    { XYZ1(1, -1, 1), XYZ1(1.f, 1.f, 0.f) },
-    { XYZ1(1, 1, -1), XYZ1(1.f, 1.f, 0.f) },
-    { XYZ1(1, -1, -1), XYZ1(1.f, 1.f, 0.f) },
-    // magenta face
-    { XYZ1(1, 1, 1), XYZ1(1.f, 0.f, 1.f) },
-    { XYZ1(-1, 1, 1), XYZ1(1.f, 0.f, 1.f) },
-    { XYZ1(1, 1, -1), XYZ1(1.f, 0.f, 1.f) },
-    { XYZ1(1, 1, -1), XYZ1(1.f, 0.f, 1.f) },
-    { XYZ1(-1, 1, 1), XYZ1(1.f, 0.f, 1.f) },
-    { XYZ1(-1, 1, -1), XYZ1(1.f, 0.f, 1.f) },
-    // cyan face
-    { XYZ1(1, -1, 1), XYZ1(0.f, 1.f, 1.f) },
-    { XYZ1(1, -1, -1), XYZ1(0.f, 1.f, 1.f) },
-    { XYZ1(-1, -1, 1), XYZ1(0.f, 1.f, 1.f) },
-    { XYZ1(-1, -1, 1), XYZ1(0.f, 1.f, 1.f) },
-    { XYZ1(1, -1, -1), XYZ1(0.f, 1.f, 1.f) },
-    { XYZ1(-1, -1, -1), XYZ1(0.f, 1.f, 1.f) },
+static const char* const MESH_NAMES[]            = { "cube", "sphere", "file" };
+static const char* const VERTEX_POSITION_NAMES[] = { "float3", "snorm16" };
+static const char* const VERTEX_COLOR_NAMES[]    = { "float4", "unorm8" };
+static const char* const VERTEX_NORMAL_NAMES[]   = { "none", "float3", "oct16" };
+static const char* const MESH_OPTIMIZE_NAMES[]   = { "none", "vertex-cache", "overdraw" };
+
+enum { MESH_CUBE, MESH_SPHERE, MESH_FILE };
+
+// Dense enough that vertex fetch, not the clear, dominates the GPU frame time.
+#define SPHERE_SEGMENTS 512
+#define SPHERE_RINGS    256
+
+// --instances spreads the copies over a cube of this half-extent, which stays in view as it spins.
+#define INSTANCE_GRID_EXTENT 2.5f
+
+// --bench-cull spreads its objects over a cube of this half-extent, so the bench MVP's frustum
+// keeps some and culls the rest, and culls this many frames' views with each kernel.
+#define CULL_BENCH_EXTENT     10.0f
+#define CULL_BENCH_ITERATIONS 200
+
+// --bench-bvh spreads its objects over a world much larger than the bench MVP's view, times this
+// many builds, then moves the objects and refits every frame, and casts this many rays per frame
+// through a grid of pixels.
+#define BVH_BENCH_EXTENT 50.0f
+#define BVH_BENCH_BUILDS 5
+#define BVH_BENCH_RAYS   64
+
+// --draw-packets gives each instance one of this many fragment shader variants by its index, standing
+// in for materials, so the draw queue has pipelines to sort by.
+#define DRAW_PACKET_VARIANTS 4
+
+// Cycled with C at runtime. Without extended dynamic state each mode is a pipeline the registry
+// compiles the first time it's used, showing the fallback path.
+static const struct {
+    VkCullModeFlags mode;
+    const char*     name;
+} CULL_MODES[] = {
+    { VK_CULL_MODE_BACK_BIT, "Basic pipeline" },
+    { VK_CULL_MODE_FRONT_BIT, "Front-culled pipeline" },
+    { VK_CULL_MODE_NONE, "Unculled pipeline" },
 };
 
+#include "basic.vert.in"
+#include "basic.frag.in"
+#include "instanced.vert.in"
+
+// Specialization constant ids declared in basic.vert and basic.frag. instanced.vert uses basic.vert's.
+enum { BASIC_VERT_VERTEX_FORMAT = 0, BASIC_VERT_NORMAL_FORMAT = 1 };
+enum { BASIC_FRAG_LIGHTING = 0, BASIC_FRAG_FOG = 1, BASIC_FRAG_FOG_DENSITY = 2, BASIC_FRAG_VERTEX_NORMALS = 3 };
+
+#ifndef SHADER_SOURCE_DIR
+#define SHADER_SOURCE_DIR "."
+#endif
+
+// With --hot-reload, edited shaders are compiled into a candidate pipeline that replaces the live
+// shaders at the start of the first frame it is ready in. Until then the old shaders keep drawing.
+// Reloaded modules live until exit, because the registry keys pipelines by module handle and a
+// destroyed handle could be reused.
 typedef struct {
-    float xx, xy, xz, xw;
-    float yx, yy, yz, yw;
-    float zx, zy, zz, zw;
-    float wx, wy, wz, ww;
-} Mat4;
-
-VkPipelineLayout gpu_create_pipeline_layout(GPU* gpu) {
-    VkPushConstantRange push_constant_range = {
-        .stage_flags = VK_SHADER_STAGE_VERTEX_BIT,
-        .offset      = 0,
-        .size        = sizeof(Mat4),
-    };
-    VkPipelineLayoutCreateInfo pipeline_layout_info = {
-        .s_type                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .push_constant_range_count = 1,
-        .p_push_constant_ranges    = &push_constant_range,
-    };
+    ShaderWatcher   watcher;
+    PipelineDesc    candidate;
+    int             has_candidate;
+    VkShaderModule* modules;
+    uint32_t        module_count;
+} HotReload;
 
-    VkPipelineLayout pipeline_layout;
-    vk_create_pipeline_layout(gpu->device, &pipeline_layout_info, NULL, &pipeline_layout);
+enum { HOT_RELOAD_VERT, HOT_RELOAD_FRAG };
+
+static const char* const HOT_RELOAD_SHADERS[] = { "basic.vert", "basic.frag" };
+
+static void hot_reload_update(HotReload* reload, GPU* gpu, PipelineRegistry* pipelines, PipelineDesc* live) {
+    for (uint32_t i = 0; i < ARRAY_SIZE(HOT_RELOAD_SHADERS); i++) {
+        size_t    size;
+        uint32_t* code = shader_watcher_take(&reload->watcher, i, &size);
+        if (!code) {
+            continue;
+        }
+        VkShaderModule module = gpu_create_shader(gpu, code, size);
+        free(code);
+        reload->modules = realloc(reload->modules, sizeof(*reload->modules) * (reload->module_count + 1));
+        reload->modules[reload->module_count++] = module;
 
-    gpu_set_debug_name(gpu, PIPELINE_LAYOUT, pipeline_layout, "Pipeline layout");
+        if (!reload->has_candidate) {
+            reload->candidate     = *live;
+            reload->has_candidate = 1;
+        }
+        if (i == HOT_RELOAD_VERT) {
+            reload->candidate.vertex_shader = module;
+        } else {
+            reload->candidate.fragment_shader = module;
+        }
+        printf("Recompiled %s\n", HOT_RELOAD_SHADERS[i]);
+    }
 
-    return pipeline_layout;
+    if (reload->has_candidate && pipeline_registry_poll(pipelines, &reload->candidate)) {
+        live->vertex_shader   = reload->candidate.vertex_shader;
+        live->fragment_shader = reload->candidate.fragment_shader;
+        reload->has_candidate = 0;
+        printf("Reloaded shaders\n");
+    }
 }
 
-VkShaderModule gpu_create_shader(GPU* gpu, const uint32_t* code, VkDeviceSize size) {
-    VkShaderModuleCreateInfo info = {
-        .s_type    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .code_size = size,
-        .p_code    = code,
+typedef struct {
+    VkSemaphore     image_acquired;
+    VkSemaphore     commands_complete;
+    VkFence         commands_complete_fence;
+    VkCommandBuffer cmd;
+    uint32_t        number;
+    int             has_timestamps;
+    int             has_statistics;
+    int             has_cull_stats;
+    int             has_instance_cull_stats;
+    uint64_t        triangles;
+} Frame;
+
+typedef struct {
+    int               bench;
+    BenchOptions      bench_options;
+    const char*       screenshot_path;
+    uint32_t          screenshot_frame;
+    CaptureOptions    capture_options;
+    const char*       pipeline_cache_path;
+    int               cold_pipeline_cache;
+    uint32_t          startup_bench_iterations;
+    int               hot_reload;
+    int               no_pipeline_library;
+    uint32_t          mesh;
+    const char*       mesh_path;
+    VertexFormat      vertex_format;
+    MeshOptimizeLevel mesh_optimize;
+    uint32_t          load_bench_iterations;
+    const char*       cook_path;
+    uint32_t          lod_levels;
+    float             lod_threshold;
+    float             mesh_scale;
+    int               meshlet_cull;
+    uint32_t          instances;
+    int               gpu_cull;
+    int               hiz;
+    int               draw_packets;
+    uint32_t          cull_bench_objects;
+    uint32_t          bvh_bench_objects;
+    int               bvh;
+} Options;
+
+static void print_usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--bench] [--bench-warmup N] [--bench-frames N] [--bench-seconds S] [--bench-seed N]\n"
+            "       %*s [--bench-csv PATH] [--screenshot PATH] [--screenshot-frame N]\n"
+            "       %*s [--capture PATH] [--capture-format y4m|bgra] [--capture-policy drop|block]\n"
+            "       %*s [--capture-queue N] [--pipeline-cache PATH] [--cold-pipeline-cache]\n"
+            "       %*s [--bench-startup N] [--hot-reload] [--no-pipeline-library] [--mesh cube|sphere|PATH]\n"
+            "       %*s [--vertex-position float3|snorm16] [--vertex-color float4|unorm8] [--bench-load N]\n"
+            "       %*s [--vertex-normal none|float3|oct16] [--mesh-optimize none|vertex-cache|overdraw]\n"
+            "       %*s [--cook PATH] [--lod-levels N] [--lod-threshold PX] [--mesh-scale S] [--meshlet-cull]\n"
+            "       %*s [--instances N] [--gpu-cull] [--hiz] [--draw-packets] [--bench-cull N] [--bvh]\n"
+            "       %*s [--bench-bvh N]\n",
+            program, (int) strlen(program), "", (int) strlen(program), "", (int) strlen(program), "",
+            (int) strlen(program), "", (int) strlen(program), "", (int) strlen(program), "", (int) strlen(program),
+            "", (int) strlen(program), "", (int) strlen(program), "");
+}
+
+static int parse_options(int argc, char** argv, Options* options) {
+    *options = (Options){
+        .bench_options = {
+            .warmup_frames = 120,
+            .frames        = 1000,
+            .seed          = BENCH_DEFAULT_SEED,
+        },
+        .screenshot_frame = 60,
+        .capture_options = {
+            .format      = CAPTURE_Y4M,
+            .policy      = CAPTURE_DROP,
+            .queue_depth = 4,
+            .fps         = 60,
+        },
+        .vertex_format = {
+            .position = VERTEX_POSITION_SNORM16,
+            .color    = VERTEX_COLOR_UNORM8,
+            .normal   = VERTEX_NORMAL_OCT16,
+        },
+        .mesh_optimize = MESH_OPTIMIZE_OVERDRAW,
+        .lod_levels    = 4,
+        .lod_threshold = 1.0f,
+        .mesh_scale    = 1.0f,
     };
-    VkShaderModule shader;
-    vk_create_shader_module(gpu->device, &info, NULL, &shader);
-    return shader;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg   = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(arg, "--bench")) {
+            options->bench = 1;
+            continue;
+        }
+        if (!strcmp(arg, "--cold-pipeline-cache")) {
+            options->cold_pipeline_cache = 1;
+            continue;
+        }
+        if (!strcmp(arg, "--hot-reload")) {
+            options->hot_reload = 1;
+            continue;
+        }
+        if (!strcmp(arg, "--no-pipeline-library")) {
+            options->no_pipeline_library = 1;
+            continue;
+        }
+        if (!strcmp(arg, "--meshlet-cull")) {
+            options->meshlet_cull = 1;
+            continue;
+        }
+        if (!strcmp(arg, "--gpu-cull")) {
+            options->gpu_cull = 1;
+            continue;
+        }
+        if (!strcmp(arg, "--hiz")) {
+            options->hiz = 1;
+            continue;
+        }
+        if (!strcmp(arg, "--draw-packets")) {
+            options->draw_packets = 1;
+            continue;
+        }
+        if (!strcmp(arg, "--bvh")) {
+            options->bvh = 1;
+            continue;
+        }
+        if (!value) {
+            return 0;
+        }
+        i++;
+        if (!strcmp(arg, "--bench-warmup")) {
+            options->bench                       = 1;
+            options->bench_options.warmup_frames = strtoul(value, NULL, 0);
+        } else if (!strcmp(arg, "--bench-frames")) {
+            options->bench                = 1;
+            options->bench_options.frames = strtoul(value, NULL, 0);
+        } else if (!strcmp(arg, "--bench-seconds")) {
+            options->bench                 = 1;
+            options->bench_options.seconds = strtod(value, NULL);
+            options->bench_options.frames  = 0;
+        } else if (!strcmp(arg, "--bench-seed")) {
+            options->bench              = 1;
+            options->bench_options.seed = strtoul(value, NULL, 0);
+        } else if (!strcmp(arg, "--bench-csv")) {
+            options->bench                  = 1;
+            options->bench_options.csv_path = value;
+        } else if (!strcmp(arg, "--screenshot")) {
+            options->screenshot_path = value;
+        } else if (!strcmp(arg, "--screenshot-frame")) {
+            options->screenshot_frame = strtoul(value, NULL, 0);
+        } else if (!strcmp(arg, "--capture")) {
+            options->capture_options.path = value;
+        } else if (!strcmp(arg, "--capture-format") && !strcmp(value, "y4m")) {
+            options->capture_options.format = CAPTURE_Y4M;
+        } else if (!strcmp(arg, "--capture-format") && !strcmp(value, "bgra")) {
+            options->capture_options.format = CAPTURE_RAW_BGRA;
+        } else if (!strcmp(arg, "--capture-policy") && !strcmp(value, "drop")) {
+            options->capture_options.policy = CAPTURE_DROP;
+        } else if (!strcmp(arg, "--capture-policy") && !strcmp(value, "block")) {
+            options->capture_options.policy = CAPTURE_BLOCK;
+        } else if (!strcmp(arg, "--capture-queue")) {
+            options->capture_options.queue_depth = strtoul(value, NULL, 0);
+        } else if (!strcmp(arg, "--pipeline-cache")) {
+            options->pipeline_cache_path = value;
+        } else if (!strcmp(arg, "--bench-startup")) {
+            options->startup_bench_iterations = strtoul(value, NULL, 0);
+        } else if (!strcmp(arg, "--mesh") && !strcmp(value, "cube")) {
+            options->mesh = MESH_CUBE;
+        } else if (!strcmp(arg, "--mesh") && !strcmp(value, "sphere")) {
+            options->mesh = MESH_SPHERE;
+        } else if (!strcmp(arg, "--mesh")) {
+            options->mesh      = MESH_FILE;
+            options->mesh_path = value;
+        } else if (!strcmp(arg, "--vertex-position") && !strcmp(value, "float3")) {
+            options->vertex_format.position = VERTEX_POSITION_FLOAT3;
+        } else if (!strcmp(arg, "--vertex-position") && !strcmp(value, "snorm16")) {
+            options->vertex_format.position = VERTEX_POSITION_SNORM16;
+        } else if (!strcmp(arg, "--vertex-color") && !strcmp(value, "float4")) {
+            options->vertex_format.color = VERTEX_COLOR_FLOAT4;
+        } else if (!strcmp(arg, "--vertex-color") && !strcmp(value, "unorm8")) {
+            options->vertex_format.color = VERTEX_COLOR_UNORM8;
+        } else if (!strcmp(arg, "--vertex-normal") && !strcmp(value, "none")) {
+            options->vertex_format.normal = VERTEX_NORMAL_NONE;
+        } else if (!strcmp(arg, "--vertex-normal") && !strcmp(value, "float3")) {
+            options->vertex_format.normal = VERTEX_NORMAL_FLOAT3;
+        } else if (!strcmp(arg, "--vertex-normal") && !strcmp(value, "oct16")) {
+            options->vertex_format.normal = VERTEX_NORMAL_OCT16;
+        } else if (!strcmp(arg, "--mesh-optimize") && !strcmp(value, "none")) {
+            options->mesh_optimize = MESH_OPTIMIZE_NONE;
+        } else if (!strcmp(arg, "--mesh-optimize") && !strcmp(value, "vertex-cache")) {
+            options->mesh_optimize = MESH_OPTIMIZE_VERTEX_CACHE;
+        } else if (!strcmp(arg, "--mesh-optimize") && !strcmp(value, "overdraw")) {
+            options->mesh_optimize = MESH_OPTIMIZE_OVERDRAW;
+        } else if (!strcmp(arg, "--bench-load")) {
+            options->load_bench_iterations = strtoul(value, NULL, 0);
+        } else if (!strcmp(arg, "--bench-cull")) {
+            options->cull_bench_objects = strtoul(value, NULL, 0);
+        } else if (!strcmp(arg, "--bench-bvh")) {
+            options->bvh_bench_objects = strtoul(value, NULL, 0);
+        } else if (!strcmp(arg, "--cook")) {
+            options->cook_path = value;
+        } else if (!strcmp(arg, "--lod-levels")) {
+            options->lod_levels = strtoul(value, NULL, 0);
+        } else if (!strcmp(arg, "--lod-threshold")) {
+            options->lod_threshold = strtod(value, NULL);
+        } else if (!strcmp(arg, "--mesh-scale")) {
+            options->mesh_scale = strtod(value, NULL);
+        } else if (!strcmp(arg, "--instances")) {
+            options->instances = strtoul(value, NULL, 0);
+        } else {
+            return 0;
+        }
+    }
+
+    return 1;
 }
 
-#include "basic.vert.in"
-#include "basic.frag.in"
+static VkQueryPool create_timestamp_query_pool(GPU* gpu, uint32_t frame_count) {
+    if (!gpu->timestamp_valid_bits) {
+        return VK_NULL_HANDLE;
+    }
 
-static VkPipeline gpu_create_pipeline(GPU* gpu, Window* window, VkShaderModule vertex_shader,
-                                      VkShaderModule fragment_shader, VkPipelineLayout pipeline_layout,
-                                      VkRenderPass render_pass) {
-    VkPipelineShaderStageCreateInfo vertex_stage = {
-        .s_type = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .stage  = VK_SHADER_STAGE_VERTEX_BIT,
-        .module = vertex_shader,
-        .p_name = "main",
+    VkQueryPoolCreateInfo info = {
+        .s_type      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .query_type  = VK_QUERY_TYPE_TIMESTAMP,
+        .query_count = 2 * frame_count,
     };
-    VkPipelineShaderStageCreateInfo fragment_stage = {
-        .s_type = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .stage  = VK_SHADER_STAGE_FRAGMENT_BIT,
-        .module = fragment_shader,
-        .p_name = "main",
-    };
-    VkPipelineShaderStageCreateInfo stages[] = { vertex_stage, fragment_stage };
+    VkQueryPool query_pool;
+    vk_create_query_pool(gpu->device, &info, NULL, &query_pool);
+    gpu_set_debug_name(gpu, QUERY_POOL, query_pool, "Timestamp query pool");
 
-    VkVertexInputBindingDescription vertex_binding = {
-        .binding    = 0,
-        .stride     = sizeof(Vertex),
-        .input_rate = VK_VERTEX_INPUT_RATE_VERTEX,
-    };
-    VkVertexInputAttributeDescription position = {
-        .location = 0,
-        .binding  = 0,
-        .format   = VK_FORMAT_R32G32B32A32_SFLOAT,
-        .offset   = 0,
-    };
-    VkVertexInputAttributeDescription color = {
-        .location = 1,
-        .binding  = 0,
-        .format   = VK_FORMAT_R32G32B32A32_SFLOAT,
-        .offset   = 16,
-    };
-    VkVertexInputAttributeDescription    attributes[]         = { position, color };
-    VkPipelineVertexInputStateCreateInfo pipeline_vertex_info = {
-        .s_type                             = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .vertex_binding_description_count   = 1,
-        .p_vertex_binding_descriptions      = &vertex_binding,
-        .vertex_attribute_description_count = ARRAY_SIZE(attributes),
-        .p_vertex_attribute_descriptions    = attributes,
-    };
-    VkPipelineInputAssemblyStateCreateInfo pipeline_assembly_info = {
-        .s_type                   = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        .topology                 = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .primitive_restart_enable = VK_FALSE,
-    };
-    VkPipelineRasterizationStateCreateInfo pipeline_rasterization_info = {
-        .s_type                     = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-        .depth_clamp_enable         = VK_FALSE,
-        .rasterizer_discard_enable  = VK_FALSE,
-        .polygon_mode               = VK_POLYGON_MODE_FILL,
-        .cull_mode                  = VK_CULL_MODE_BACK_BIT,
-        .front_face                 = VK_FRONT_FACE_CLOCKWISE,
-        .depth_bias_enable          = VK_FALSE,
-        .depth_bias_constant_factor = 0,
-        .depth_bias_clamp           = 0,
-        .depth_bias_slope_factor    = 0,
-        .line_width                 = 1.0f,
-    };
-    VkPipelineColorBlendAttachmentState pipeline_blend_attachment = {
-        .blend_enable           = VK_FALSE,
-        .src_color_blend_factor = VK_BLEND_FACTOR_ZERO,
-        .dst_color_blend_factor = VK_BLEND_FACTOR_ZERO,
-        .color_blend_op         = VK_BLEND_OP_ADD,
-        .src_alpha_blend_factor = VK_BLEND_FACTOR_ZERO,
-        .dst_alpha_blend_factor = VK_BLEND_FACTOR_ZERO,
-        .alpha_blend_op         = VK_BLEND_OP_ADD,
-        .color_write_mask       = 0xf,
-    };
-    VkPipelineColorBlendStateCreateInfo pipeline_blend_info = {
-        .s_type           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .logic_op_enable  = VK_FALSE,
-        .logic_op         = VK_LOGIC_OP_NO_OP,
-        .attachment_count = 1,
-        .p_attachments    = &pipeline_blend_attachment,
-        .blend_constants  = { 1.0f, 1.0f, 1.0f, 1.0f },
-    };
-    VkViewport viewport = {
-        .x         = 0.0f,
-        .y         = 0.0f,
-        .width     = window->width,
-        .height    = window->height,
-        .min_depth = 0.0f,
-        .max_depth = 1.0f,
+    return query_pool;
+}
+
+// Counts the vertex and fragment shader invocations of each frame's draws. Vertex invocations per
+// triangle is the ACMR the GPU actually achieved, with its real cache rather than the FIFO model.
+static VkQueryPool create_statistics_query_pool(GPU* gpu, uint32_t frame_count) {
+    if (!gpu->pipeline_statistics) {
+        return VK_NULL_HANDLE;
+    }
+
+    VkQueryPoolCreateInfo info = {
+        .s_type              = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .query_type          = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+        .query_count         = frame_count,
+        .pipeline_statistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+                               | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,
     };
-    VkRect2D scissor = {
-        .offset = { 0, 0 },
-        .extent = { window->width, window->height },
+    VkQueryPool query_pool;
+    vk_create_query_pool(gpu->device, &info, NULL, &query_pool);
+    gpu_set_debug_name(gpu, QUERY_POOL, query_pool, "Pipeline statistics query pool");
+
+    return query_pool;
+}
+
+typedef struct {
+    uint64_t vertex_invocations;
+    uint64_t fragment_invocations;
+    uint64_t triangles; // Submitted in the frames counted, which vary with the LOD drawn.
+    uint32_t frames;
+} PipelineStatistics;
+
+// Results are in the order of the statistic bits: vertex then fragment invocations.
+static void read_pipeline_statistics(GPU* gpu, VkQueryPool query_pool, uint32_t frame_index, uint64_t triangles,
+                                     PipelineStatistics* statistics) {
+    uint64_t counts[2];
+    VkResult result = vk_get_query_pool_results(gpu->device, query_pool, frame_index, 1, sizeof(counts), counts,
+                                                sizeof(counts), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+    statistics->vertex_invocations += counts[0];
+    statistics->fragment_invocations += counts[1];
+    statistics->triangles += triangles;
+    statistics->frames++;
+}
+
+static double read_gpu_frame_ms(GPU* gpu, VkQueryPool query_pool, uint32_t frame_index) {
+    uint64_t timestamps[2];
+    VkResult result = vk_get_query_pool_results(gpu->device, query_pool, 2 * frame_index, 2, sizeof(timestamps),
+                                                timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return -1.0;
+    }
+
+    uint64_t mask  = gpu->timestamp_valid_bits >= 64 ? UINT64_MAX : (1ull << gpu->timestamp_valid_bits) - 1;
+    uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+    return (double) ticks * gpu->properties.limits.timestamp_period * 1e-6;
+}
+
+// Without --screenshot, frames saved with F12 are named after their frame number.
+static void submit_screenshot(ScreenshotWriter* writer, ReadbackSlot* slot, const char* path) {
+    char name[64];
+    if (!path) {
+        snprintf(name, sizeof(name), "frame-%u.png", slot->frame);
+        path = name;
+    }
+    screenshot_writer_submit(writer, slot, path);
+}
+
+// Fixed-function permutations of `desc`, standing in for the material and pass variants a real
+// scene would compile at startup.
+static uint32_t make_variants(const PipelineDesc* desc, PipelineDesc* variants, uint32_t max_count) {
+    const VkCullModeFlags     cull_modes[] = { VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT };
+    const VkFrontFace         faces[]      = { VK_FRONT_FACE_CLOCKWISE, VK_FRONT_FACE_COUNTER_CLOCKWISE };
+    const VkPrimitiveTopology topologies[] = {
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
     };
-    VkPipelineViewportStateCreateInfo pipeline_viewport_info = {
-        .s_type         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-        .viewport_count = 1,
-        .p_viewports    = &viewport,
-        .scissor_count  = 1,
-        .p_scissors     = &scissor,
+
+    uint32_t count = 0;
+    for (uint32_t c = 0; c < ARRAY_SIZE(cull_modes); c++) {
+        for (uint32_t f = 0; f < ARRAY_SIZE(faces); f++) {
+            for (uint32_t t = 0; t < ARRAY_SIZE(topologies); t++) {
+                for (VkBool32 depth = 0; depth < 2 && count < max_count; depth++) {
+                    PipelineDesc* variant = &variants[count++];
+                    *variant              = *desc;
+                    variant->cull_mode    = cull_modes[c];
+                    variant->front_face   = faces[f];
+                    variant->topology     = topologies[t];
+                    variant->depth_test   = depth;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+// Compares creating the pipeline against an empty cache with creating it against a cache seeded
+// from the persisted data, which is what a cold and a warm launch pay, then compares compiling a
+// batch of variants serially and on the job system. Drivers that keep their own disk cache (Mesa
+// does) make cold numbers look warm; disable it, e.g. with MESA_SHADER_CACHE_DISABLE=true, for a
+// fair comparison.
+static void run_startup_bench(GPU* gpu, JobSystem* jobs, PipelineCache* cache, const PipelineDesc* desc,
+                              uint32_t iterations) {
+    size_t size = 0;
+    vk_get_pipeline_cache_data(gpu->device, cache->handle, &size, NULL);
+    void* data = malloc(size);
+    vk_get_pipeline_cache_data(gpu->device, cache->handle, &size, data);
+
+    PipelineDesc variants[24];
+    uint32_t     variant_count = make_variants(desc, variants, ARRAY_SIZE(variants));
+
+    double* cold     = malloc(sizeof(double) * iterations);
+    double* warm     = malloc(sizeof(double) * iterations);
+    double* serial   = malloc(sizeof(double) * iterations);
+    double* parallel = malloc(sizeof(double) * iterations);
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (int seeded = 0; seeded < 2; seeded++) {
+            uint64_t                  start = bench_time_ns();
+            VkPipelineCacheCreateInfo info  = {
+                .s_type            = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                .initial_data_size = seeded ? size : 0,
+                .p_initial_data    = seeded ? data : NULL,
+            };
+            VkPipelineCache pipeline_cache;
+            vk_create_pipeline_cache(gpu->device, &info, NULL, &pipeline_cache);
+            VkPipeline pipeline = gpu_create_pipeline(gpu, pipeline_cache, desc);
+            double     ms       = bench_elapsed_ms(start);
+            (seeded ? warm : cold)[i] = ms;
+
+            vk_destroy_pipeline(gpu->device, pipeline, NULL);
+            vk_destroy_pipeline_cache(gpu->device, pipeline_cache, NULL);
+        }
+
+        PipelineCache batch_cache;
+        pipeline_cache_create_empty(gpu, &batch_cache);
+        uint64_t   start = bench_time_ns();
+        VkPipeline pipelines[ARRAY_SIZE(variants)];
+        for (uint32_t v = 0; v < variant_count; v++) {
+            pipelines[v] = gpu_create_pipeline(gpu, batch_cache.handle, &variants[v]);
+        }
+        serial[i] = bench_elapsed_ms(start);
+        for (uint32_t v = 0; v < variant_count; v++) {
+            vk_destroy_pipeline(gpu->device, pipelines[v], NULL);
+        }
+        pipeline_cache_destroy(gpu, &batch_cache);
+
+        pipeline_cache_create_empty(gpu, &batch_cache);
+        PipelineFuture futures[ARRAY_SIZE(variants)];
+        start = bench_time_ns();
+        pipeline_build_batch(jobs, gpu, &batch_cache, variants, variant_count, futures);
+        for (uint32_t v = 0; v < variant_count; v++) {
+            pipeline_future_wait(jobs, &futures[v]);
+        }
+        parallel[i] = bench_elapsed_ms(start);
+        for (uint32_t v = 0; v < variant_count; v++) {
+            vk_destroy_pipeline(gpu->device, futures[v].pipeline, NULL);
+        }
+        pipeline_cache_destroy(gpu, &batch_cache);
+    }
+
+    printf("bench-startup: device=\"%s\" iterations=%u cache_bytes=%zu cache_load_ms=%.4f variants=%u threads=%u\n",
+           gpu->properties.device_name, iterations, size, cache->load_ms, variant_count, jobs->thread_count);
+    stats_print_header("pipeline");
+    Stats cold_stats     = stats_compute(cold, iterations);
+    Stats warm_stats     = stats_compute(warm, iterations);
+    Stats serial_stats   = stats_compute(serial, iterations);
+    Stats parallel_stats = stats_compute(parallel, iterations);
+    stats_print("cold_cache_ms", &cold_stats);
+    stats_print("warm_cache_ms", &warm_stats);
+    stats_print("batch_serial_ms", &serial_stats);
+    stats_print("batch_parallel_ms", &parallel_stats);
+
+    free(cold);
+    free(warm);
+    free(serial);
+    free(parallel);
+    free(data);
+}
+
+// Builds the mesh the options ask for, optimizes it for the vertex cache, appends its LOD chain to
+// the indices and splits every level into meshlets. Files are mapped and parsed on the job system;
+// one that fails to load falls back to the cube.
+static Mesh create_mesh(Options* options, JobSystem* jobs, VertexCacheStats* cache_after, MeshLod* lods,
+                        uint32_t* lod_count, Meshlet** meshlets, uint32_t* meshlet_count) {
+    Mesh mesh = {};
+    if (options->mesh == MESH_FILE) {
+        MeshLoadStats load_stats;
+        if (mesh_load(options->mesh_path, jobs, &mesh, &load_stats)) {
+            printf("Loaded '%s': %.1f MiB in %.3f ms (%.0f MiB/s), %u vertices, %u triangles\n", options->mesh_path,
+                   load_stats.file_bytes / (1024.0 * 1024.0), load_stats.ms,
+                   load_stats.file_bytes / (1024.0 * 1024.0) / (load_stats.ms / 1000.0), mesh.vertex_count,
+                   mesh.index_count / 3);
+        } else {
+            options->mesh = MESH_CUBE;
+        }
+    }
+    if (options->mesh == MESH_SPHERE) {
+        mesh = mesh_sphere(SPHERE_SEGMENTS, SPHERE_RINGS, 1.5f);
+    } else if (options->mesh == MESH_CUBE) {
+        mesh = mesh_cube();
+    }
+
+    VertexCacheStats cache_before   = mesh_analyze_vertex_cache(&mesh, VERTEX_CACHE_SIZE);
+    uint64_t         optimize_start = bench_time_ns();
+    mesh_optimize(&mesh, options->mesh_optimize);
+    double optimize_ms = bench_elapsed_ms(optimize_start);
+    *cache_after       = mesh_analyze_vertex_cache(&mesh, VERTEX_CACHE_SIZE);
+    printf("Mesh optimized (%s) in %.3f ms: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+           MESH_OPTIMIZE_NAMES[options->mesh_optimize], optimize_ms, cache_before.acmr, cache_after->acmr,
+           cache_before.atvr, cache_after->atvr);
+
+    uint64_t lod_start = bench_time_ns();
+    *lod_count         = mesh_build_lods(&mesh, options->lod_levels ? options->lod_levels : 1, lods);
+    printf("Built %u LODs in %.3f ms:", *lod_count, bench_elapsed_ms(lod_start));
+    for (uint32_t i = 0; i < *lod_count; i++) {
+        printf(" %u (%g)", lods[i].index_count / 3, lods[i].error);
+    }
+    printf(" triangles (error)\n");
+
+    uint64_t meshlet_start = bench_time_ns();
+    *meshlets              = mesh_build_meshlets(&mesh, lods, *lod_count, meshlet_count);
+    printf("Built %u meshlets in %.3f ms, %.1f triangles each\n", *meshlet_count, bench_elapsed_ms(meshlet_start),
+           (double) mesh.index_count / 3 / *meshlet_count);
+    return mesh;
+}
+
+static void hash_source(void* data, const MappedFile* file) {
+    uint64_t* hash = data;
+    *hash          = mesh_cache_hash(*hash, file->data, file->size);
+}
+
+// --cook builds the mesh exactly as a run would and writes it to a mesh cache with the payloads
+// already encoded, so later runs only map and copy it. The content hash covers the source bytes,
+// glTF buffers included, and every option that shapes the output; a cache that matches is left
+// alone.
+static int cook_mesh(Options* options) {
+    uint32_t settings[] = {
+        MESH_CACHE_VERSION,
+        options->mesh,
+        SPHERE_SEGMENTS,
+        SPHERE_RINGS,
+        options->vertex_format.position,
+        options->vertex_format.color,
+        options->vertex_format.normal,
+        options->mesh_optimize,
+        options->lod_levels,
     };
-    VkStencilOpState stencil_op = {
-        .fail_op       = VK_STENCIL_OP_KEEP,
-        .pass_op       = VK_STENCIL_OP_KEEP,
-        .depth_fail_op = VK_STENCIL_OP_KEEP,
-        .compare_op    = VK_COMPARE_OP_ALWAYS,
-        .compare_mask  = 0,
-        .write_mask    = 0,
-        .reference     = 0,
+    uint64_t hash = mesh_cache_hash(MESH_CACHE_HASH_SEED, settings, sizeof(settings));
+    if (options->mesh == MESH_FILE && !mesh_visit_sources(options->mesh_path, hash_source, &hash)) {
+        return 0;
+    }
+
+    MeshCache existing;
+    if (!access(options->cook_path, F_OK) && mesh_cache_open(options->cook_path, &existing)) {
+        int up_to_date = existing.header->content_hash == hash;
+        mesh_cache_close(&existing);
+        if (up_to_date) {
+            printf("Mesh cache '%s' is up to date\n", options->cook_path);
+            return 1;
+        }
+    }
+
+    JobSystem jobs;
+    job_system_create(&jobs, 0);
+    uint64_t         start  = bench_time_ns();
+    uint32_t         source = options->mesh;
+    VertexCacheStats stats;
+    MeshLod          lods[MESH_LOD_MAX];
+    uint32_t         lod_count;
+    Meshlet*         meshlets;
+    uint32_t         meshlet_count;
+    Mesh             mesh = create_mesh(options, &jobs, &stats, lods, &lod_count, &meshlets, &meshlet_count);
+    MeshCacheDesc    desc = {
+        .mesh          = &mesh,
+        .vertex_format = options->vertex_format,
+        .content_hash  = hash,
+        .cache_stats   = stats,
+        .lods          = lods,
+        .lod_count     = lod_count,
+        .meshlets      = meshlets,
+        .meshlet_count = meshlet_count,
     };
-    VkPipelineDepthStencilStateCreateInfo pipeline_depth_info = {
-        .s_type                   = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-        .depth_test_enable        = VK_TRUE,
-        .depth_write_enable       = VK_TRUE,
-        .depth_compare_op         = VK_COMPARE_OP_LESS_OR_EQUAL,
-        .depth_bounds_test_enable = VK_FALSE,
-        .stencil_test_enable      = VK_FALSE,
-        .front                    = stencil_op,
-        .back                     = stencil_op,
-        .min_depth_bounds         = 0,
-        .max_depth_bounds         = 0,
+    int ok = options->mesh == source && mesh_cache_write(options->cook_path, &desc, &jobs);
+    if (ok) {
+        printf("Cooked '%s' into '%s': %u vertices, %u triangles, %u LODs, %u meshlets in %.3f ms\n",
+               source == MESH_FILE ? options->mesh_path : MESH_NAMES[source], options->cook_path,
+               mesh.vertex_count, lods[0].index_count / 3, lod_count, meshlet_count, bench_elapsed_ms(start));
+    }
+    free(meshlets);
+    mesh_destroy(&mesh);
+    job_system_destroy(&jobs);
+    return ok;
+}
+
+// Loads the mesh file repeatedly on the calling thread and on the job system. Throughput counts the
+// bytes mapped, so glTF includes its buffers. The file's pages are in the page cache after the first
+// load, so this measures parsing and conversion rather than the disk.
+static void run_load_bench(JobSystem* jobs, const char* path, uint32_t iterations, double first_draw_ms) {
+    double*       serial   = malloc(sizeof(double) * iterations);
+    double*       parallel = malloc(sizeof(double) * iterations);
+    MeshLoadStats stats    = {};
+    Mesh          mesh     = {};
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (int threaded = 0; threaded < 2; threaded++) {
+            if (!mesh_load(path, threaded ? jobs : NULL, &mesh, &stats)) {
+                free(serial);
+                free(parallel);
+                return;
+            }
+            (threaded ? parallel : serial)[i] = stats.ms;
+            mesh_destroy(&mesh);
+        }
+    }
+
+    Stats  serial_stats   = stats_compute(serial, iterations);
+    Stats  parallel_stats = stats_compute(parallel, iterations);
+    double mb             = stats.file_bytes / 1e6;
+    printf("bench-load: path=\"%s\" bytes=%zu chunks=%u iterations=%u threads=%u first_draw_ms=%.3f\n", path,
+           stats.file_bytes, stats.chunks, iterations, jobs->thread_count, first_draw_ms);
+    printf("serial_mb_per_s=%.1f parallel_mb_per_s=%.1f\n", mb / (serial_stats.median / 1000.0),
+           mb / (parallel_stats.median / 1000.0));
+    stats_print_header("load");
+    stats_print("serial_ms", &serial_stats);
+    stats_print("parallel_ms", &parallel_stats);
+
+    free(serial);
+    free(parallel);
+}
+
+// Maps a mesh cache and copies its payloads out, as startup does, with the file's pages dropped from
+// the page cache first (cold, which reads the disk) and left in place (warm). Only clean pages can
+// be dropped, so run it on a cache that isn't being written.
+static void run_cache_load_bench(const char* path, uint32_t iterations, double first_draw_ms) {
+    // The destination stands in for mapped buffer memory and is touched up front, so its page
+    // faults aren't counted.
+    MeshCache cache;
+    if (!mesh_cache_open(path, &cache)) {
+        return;
+    }
+    size_t bytes = cache.header->vertices.size + cache.header->indices.size;
+    void*  out   = malloc(bytes ? bytes : 1);
+    memset(out, 0, bytes);
+    mesh_cache_close(&cache);
+
+    double* cold = malloc(sizeof(double) * iterations);
+    double* warm = malloc(sizeof(double) * iterations);
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (int cached = 0; cached < 2; cached++) {
+            int fd = cached ? -1 : open(path, O_RDONLY);
+            if (fd >= 0) {
+                posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+                close(fd);
+            }
+
+            uint64_t start = bench_time_ns();
+            int      ok    = mesh_cache_open(path, &cache);
+            if (ok && cache.header->vertices.size + cache.header->indices.size != bytes) {
+                mesh_cache_close(&cache);
+                ok = 0;
+            }
+            if (!ok) {
+                free(cold);
+                free(warm);
+                free(out);
+                return;
+            }
+            mesh_cache_copy(&cache, out, (uint8_t*) out + cache.header->vertices.size);
+            (cached ? warm : cold)[i] = bench_elapsed_ms(start);
+            mesh_cache_close(&cache);
+        }
+    }
+
+    Stats  cold_stats = stats_compute(cold, iterations);
+    Stats  warm_stats = stats_compute(warm, iterations);
+    double mb         = bytes / 1e6;
+    printf("bench-load: path=\"%s\" bytes=%zu iterations=%u first_draw_ms=%.3f\n", path, bytes, iterations,
+           first_draw_ms);
+    printf("cold_mb_per_s=%.1f warm_mb_per_s=%.1f\n", mb / (cold_stats.median / 1000.0),
+           mb / (warm_stats.median / 1000.0));
+    stats_print_header("load");
+    stats_print("cold_ms", &cold_stats);
+    stats_print("warm_ms", &warm_stats);
+
+    free(cold);
+    free(warm);
+    free(out);
+}
+
+// Object `index` of a cube of `side`^3 grid cells of size `step`, centered on the origin.
+static Vec3 bench_grid_center(uint32_t index, uint32_t side, float step) {
+    float offset = -0.5f * step * side;
+    return (Vec3){
+        offset + step * (index % side + 0.5f),
+        offset + step * (index / side % side + 0.5f),
+        offset + step * (index / side / side + 0.5f),
     };
-    VkPipelineMultisampleStateCreateInfo pipeline_multisample_info = {
-        .s_type                   = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .rasterization_samples    = VK_SAMPLE_COUNT_1_BIT,
-        .sample_shading_enable    = VK_FALSE,
-        .min_sample_shading       = 0.0f,
-        .alpha_to_coverage_enable = VK_FALSE,
-        .alpha_to_one_enable      = VK_FALSE,
+}
+
+static Aabb sphere_bounds(Vec3 center, float radius) {
+    return (Aabb){
+        { center.x - radius, center.y - radius, center.z - radius },
+        { center.x + radius, center.y + radius, center.z + radius },
     };
-    VkGraphicsPipelineCreateInfo pipeline_info = {
-        .s_type                 = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .stage_count            = ARRAY_SIZE(stages),
-        .p_stages               = stages,
-        .p_vertex_input_state   = &pipeline_vertex_info,
-        .p_input_assembly_state = &pipeline_assembly_info,
-        .p_viewport_state       = &pipeline_viewport_info,
-        .p_rasterization_state  = &pipeline_rasterization_info,
-        .p_multisample_state    = &pipeline_multisample_info,
-        .p_depth_stencil_state  = &pipeline_depth_info,
-        .p_color_blend_state    = &pipeline_blend_info,
-        .layout                 = pipeline_layout,
-        .render_pass            = render_pass,
-        .subpass                = 0,
+}
+
+// Spheres of one radius, for picking through bvh_raycast.
+typedef struct {
+    const Vec3* centers;
+    float       radius;
+} PickSpheres;
+
+// A BvhRayTest: where a ray with a normalized direction enters a sphere, zero from inside it.
+static float ray_sphere(void* data, uint32_t object, Vec3 origin, Vec3 direction) {
+    const PickSpheres* spheres = data;
+    Vec3               offset  = vec3_sub(origin, spheres->centers[object]);
+    float              b       = vec3_dot(offset, direction);
+    float              c       = vec3_dot(offset, offset) - spheres->radius * spheres->radius;
+    float              h       = b * b - c;
+    if (h < 0.0f || -b + sqrtf(h) < 0.0f) {
+        return -1.0f;
+    }
+    return fmaxf(-b - sqrtf(h), 0.0f);
+}
+
+// The ray through the center of pixel (x, y) from the near plane, in the space `inverse`, an inverse
+// view-projection, maps clip space back to.
+static void pixel_ray(const Mat4* inverse, float x, float y, uint32_t width, uint32_t height, Vec3* origin,
+                      Vec3* direction) {
+    float ndc_x = 2.0f * (x + 0.5f) / width - 1.0f;
+    float ndc_y = 2.0f * (y + 0.5f) / height - 1.0f;
+    Vec3  points[2];
+    for (int i = 0; i < 2; i++) {
+        const Mat4* m = inverse;
+        float       z = (float) i;
+        float       w = m->xw * ndc_x + m->yw * ndc_y + m->zw * z + m->ww;
+        points[i]     = (Vec3){
+            (m->xx * ndc_x + m->yx * ndc_y + m->zx * z + m->wx) / w,
+            (m->xy * ndc_x + m->yy * ndc_y + m->zy * z + m->wy) / w,
+            (m->xz * ndc_x + m->yz * ndc_y + m->zz * z + m->wz) / w,
+        };
+    }
+    *origin    = points[0];
+    *direction = vec3_normalize(vec3_sub(points[1], points[0]));
+}
+
+// Scales every sphere's radius and refits the BVH over them, if there is one.
+static void refit_instance_bvh(Bvh* bvh, PickSpheres* spheres, float scale) {
+    if (!bvh->node_count) {
+        return;
+    }
+    spheres->radius *= scale;
+
+    Aabb* bounds = malloc(sizeof(Aabb) * bvh->object_count);
+    for (uint32_t i = 0; i < bvh->object_count; i++) {
+        bounds[i] = sphere_bounds(spheres->centers[i], spheres->radius);
+    }
+    uint64_t start = bench_time_ns();
+    bvh_refit(bvh, bounds);
+    printf("Refit the BVH in %.3f ms, SAH cost %.2f\n", bench_elapsed_ms(start), bvh_cost(bvh));
+    free(bounds);
+}
+
+// Casts the ray under the cursor and reports the nearest instance it hits.
+static void pick_instance(const Bvh* bvh, PickSpheres* spheres, const Mat4* view_projection, int32_t x, int32_t y,
+                          uint32_t width, uint32_t height) {
+    Mat4 inverse = mat4_inverse(view_projection);
+    Vec3 origin, direction;
+    pixel_ray(&inverse, (float) x, (float) y, width, height, &origin, &direction);
+    BvhStats stats    = {};
+    float    distance = 0.0f;
+    uint64_t start    = bench_time_ns();
+    uint32_t hit      = bvh_raycast(bvh, origin, direction, 1e30f, ray_sphere, spheres, &distance, &stats);
+    double   us       = bench_elapsed_ms(start) * 1000.0;
+    if (hit == BVH_NONE) {
+        printf("Picked nothing, %llu nodes visited in %.1f us\n", (unsigned long long) stats.nodes_visited, us);
+        return;
+    }
+    printf("Picked instance %u at distance %.3f, %llu nodes visited and %llu spheres tested in %.1f us\n", hit,
+           distance, (unsigned long long) stats.nodes_visited, (unsigned long long) stats.objects_tested, us);
+}
+
+// Culls a grid of bounding spheres under the bench MVP sequence with every kernel the CPU supports,
+// on the calling thread and on the job system. Every result is compared with the scalar kernel's; the
+// FMA kernels round differently, so a sphere within rounding of a plane can make a few results differ.
+// Throughput is objects tested per nanosecond at the median time.
+static void run_cull_bench(const Options* options) {
+    uint32_t    count = options->cull_bench_objects;
+    uint32_t    side  = (uint32_t) ceilf(cbrtf((float) count));
+    float       step  = 2.0f * CULL_BENCH_EXTENT / side;
+    CullSpheres spheres;
+    cull_spheres_create(&spheres, count);
+    for (uint32_t i = 0; i < count; i++) {
+        cull_spheres_set(&spheres, i, bench_grid_center(i, side, step), 0.25f * step);
+    }
+
+    JobSystem jobs;
+    job_system_create(&jobs, 0);
+    Bench     bench     = bench_create(options->bench_options);
+    uint32_t* reference = malloc(sizeof(uint32_t) * spheres.capacity);
+    uint32_t* visible   = malloc(sizeof(uint32_t) * spheres.capacity);
+    double*   samples[CULL_KERNEL_COUNT][2];
+    for (uint32_t k = 0; k < CULL_KERNEL_COUNT; k++) {
+        samples[k][0] = malloc(sizeof(double) * CULL_BENCH_ITERATIONS);
+        samples[k][1] = malloc(sizeof(double) * CULL_BENCH_ITERATIONS);
+    }
+
+    uint64_t visible_total = 0;
+    uint32_t differing     = 0;
+    for (uint32_t i = 0; i < CULL_BENCH_ITERATIONS; i++) {
+        Mat4  mvp = bench_mvp(&bench, i, 1.0f);
+        float planes[6][4];
+        mat4_frustum_planes(&mvp, planes);
+        uint32_t expected = cull_spheres(&spheres, planes, CULL_KERNEL_SCALAR, reference);
+        visible_total += expected;
+        for (CullKernel k = 0; k < CULL_KERNEL_COUNT; k++) {
+            for (int threaded = 0; threaded < 2 && cull_kernel_supported(k); threaded++) {
+                uint64_t start  = bench_time_ns();
+                uint32_t result = threaded ? cull_spheres_parallel(&jobs, &spheres, planes, k, visible)
+                                           : cull_spheres(&spheres, planes, k, visible);
+                samples[k][threaded][i] = bench_elapsed_ms(start);
+                differing += result != expected || memcmp(visible, reference, sizeof(uint32_t) * result);
+            }
+        }
+    }
+
+    double mean_visible = (double) visible_total / CULL_BENCH_ITERATIONS;
+    printf("bench-cull: objects=%u iterations=%u threads=%u best=%s visible=%.0f (%.1f%%) differing=%u\n", count,
+           CULL_BENCH_ITERATIONS, jobs.thread_count + 1, CULL_KERNEL_NAMES[cull_kernel_best()], mean_visible,
+           count ? 100.0 * mean_visible / count : 0.0, differing);
+    stats_print_header("cull");
+    Stats stats[CULL_KERNEL_COUNT][2];
+    for (CullKernel k = 0; k < CULL_KERNEL_COUNT; k++) {
+        for (int threaded = 0; threaded < 2 && cull_kernel_supported(k); threaded++) {
+            char name[32];
+            snprintf(name, sizeof(name), "%s_%s_ms", CULL_KERNEL_NAMES[k], threaded ? "parallel" : "serial");
+            stats[k][threaded] = stats_compute(samples[k][threaded], CULL_BENCH_ITERATIONS);
+            stats_print(name, &stats[k][threaded]);
+        }
+    }
+    printf("%-12s %20s %20s\n", "kernel", "serial_obj_per_ns", "parallel_obj_per_ns");
+    for (CullKernel k = 0; k < CULL_KERNEL_COUNT; k++) {
+        if (cull_kernel_supported(k)) {
+            printf("%-12s %20.3f %20.3f\n", CULL_KERNEL_NAMES[k], count / (stats[k][0].median * 1e6),
+                   count / (stats[k][1].median * 1e6));
+        }
+    }
+
+    for (uint32_t k = 0; k < CULL_KERNEL_COUNT; k++) {
+        free(samples[k][0]);
+        free(samples[k][1]);
+    }
+    free(visible);
+    free(reference);
+    bench_destroy(&bench);
+    job_system_destroy(&jobs);
+    cull_spheres_destroy(&spheres);
+}
+
+// Builds a BVH over a grid of spheres, then for each frame of the bench MVP sequence moves every
+// sphere a little, refits, culls and casts rays through a grid of pixels. Culling is compared with
+// flat SIMD culling of the same spheres; the BVH tests their boxes, so it keeps a few more. Each
+// frame's first ray is checked against testing every sphere. Moving objects keep the tree's shape,
+// so its SAH cost and the nodes visited grow over the run.
+static void run_bvh_bench(const Options* options) {
+    uint32_t count   = options->bvh_bench_objects;
+    uint32_t side    = (uint32_t) ceilf(cbrtf((float) count));
+    float    step    = 2.0f * BVH_BENCH_EXTENT / side;
+    Vec3*    homes   = malloc(sizeof(Vec3) * count);
+    Vec3*    centers = malloc(sizeof(Vec3) * count);
+    Aabb*    bounds  = malloc(sizeof(Aabb) * count);
+    for (uint32_t i = 0; i < count; i++) {
+        homes[i]   = bench_grid_center(i, side, step);
+        centers[i] = homes[i];
+        bounds[i]  = sphere_bounds(homes[i], 0.25f * step);
+    }
+    PickSpheres targets = { centers, 0.25f * step };
+
+    double build_samples[BVH_BENCH_BUILDS];
+    Bvh    bvh;
+    for (uint32_t i = 0; i < BVH_BENCH_BUILDS; i++) {
+        if (i) {
+            bvh_destroy(&bvh);
+        }
+        uint64_t start   = bench_time_ns();
+        bvh_build(&bvh, bounds, count);
+        build_samples[i] = bench_elapsed_ms(start);
+    }
+    float built_cost = bvh_cost(&bvh);
+
+    CullSpheres spheres;
+    cull_spheres_create(&spheres, count);
+    Bench     bench        = bench_create(options->bench_options);
+    uint32_t* visible      = malloc(sizeof(uint32_t) * spheres.capacity);
+    double*   refit        = malloc(sizeof(double) * CULL_BENCH_ITERATIONS);
+    double*   tree_cull    = malloc(sizeof(double) * CULL_BENCH_ITERATIONS);
+    double*   flat_cull    = malloc(sizeof(double) * CULL_BENCH_ITERATIONS);
+    double*   pick         = malloc(sizeof(double) * CULL_BENCH_ITERATIONS);
+    BvhStats  cull_stats   = {};
+    BvhStats  ray_stats    = {};
+    uint64_t  bvh_visible  = 0;
+    uint64_t  flat_visible = 0;
+    uint32_t  hits         = 0;
+    uint32_t  wrong_picks  = 0;
+    for (uint32_t i = 0; i < CULL_BENCH_ITERATIONS; i++) {
+        // Each sphere sways along x by up to a quarter of a cell, out of phase with its neighbours.
+        for (uint32_t j = 0; j < count; j++) {
+            centers[j] = homes[j];
+            centers[j].x += 0.25f * step * sinf(0.05f * i + j);
+            bounds[j] = sphere_bounds(centers[j], targets.radius);
+            cull_spheres_set(&spheres, j, centers[j], targets.radius);
+        }
+        uint64_t start = bench_time_ns();
+        bvh_refit(&bvh, bounds);
+        refit[i] = bench_elapsed_ms(start);
+
+        Mat4  mvp = bench_mvp(&bench, i, 1.0f);
+        float planes[6][4];
+        mat4_frustum_planes(&mvp, planes);
+        start = bench_time_ns();
+        bvh_visible += bvh_cull(&bvh, planes, visible, &cull_stats);
+        tree_cull[i] = bench_elapsed_ms(start);
+        start        = bench_time_ns();
+        flat_visible += cull_spheres(&spheres, planes, cull_kernel_best(), visible);
+        flat_cull[i] = bench_elapsed_ms(start);
+
+        Mat4     inverse = mat4_inverse(&mvp);
+        uint32_t first   = BVH_NONE;
+        Vec3     origin, direction;
+        start = bench_time_ns();
+        for (uint32_t r = 0; r < BVH_BENCH_RAYS; r++) {
+            pixel_ray(&inverse, (r % 8 + 0.5f) * 60.0f, (r / 8 + 0.5f) * 60.0f, 480, 480, &origin, &direction);
+            uint32_t hit = bvh_raycast(&bvh, origin, direction, 1e30f, ray_sphere, &targets, NULL, &ray_stats);
+            first        = r ? first : hit;
+            hits        += hit != BVH_NONE;
+        }
+        pick[i] = bench_elapsed_ms(start) * 1000.0 / BVH_BENCH_RAYS;
+
+        pixel_ray(&inverse, 30.0f, 30.0f, 480, 480, &origin, &direction);
+        uint32_t expected = BVH_NONE;
+        float    nearest  = 1e30f;
+        for (uint32_t j = 0; j < count; j++) {
+            float t = ray_sphere(&targets, j, origin, direction);
+            if (t >= 0.0f && t < nearest) {
+                nearest  = t;
+                expected = j;
+            }
+        }
+        wrong_picks += first != expected;
+    }
+
+    Stats  build_stats = stats_compute(build_samples, BVH_BENCH_BUILDS);
+    double frames      = CULL_BENCH_ITERATIONS;
+    double rays        = frames * BVH_BENCH_RAYS;
+    printf("bench-bvh: objects=%u nodes=%u frames=%u rays_per_frame=%u cost_built=%.2f cost_refit=%.2f\n", count,
+           bvh.node_count, CULL_BENCH_ITERATIONS, BVH_BENCH_RAYS, built_cost, bvh_cost(&bvh));
+    printf("cull: nodes_per_query=%.0f objects_tested=%.0f visible=%.0f flat_visible=%.0f\n",
+           cull_stats.nodes_visited / frames, cull_stats.objects_tested / frames, bvh_visible / frames,
+           flat_visible / frames);
+    printf("pick: nodes_per_query=%.1f spheres_tested=%.1f hit_rate=%.1f%% wrong=%u/%u\n",
+           ray_stats.nodes_visited / rays, ray_stats.objects_tested / rays, 100.0 * hits / rays, wrong_picks,
+           CULL_BENCH_ITERATIONS);
+    stats_print_header("bvh");
+    stats_print("build_ms", &build_stats);
+    Stats stats = stats_compute(refit, CULL_BENCH_ITERATIONS);
+    stats_print("refit_ms", &stats);
+    stats = stats_compute(tree_cull, CULL_BENCH_ITERATIONS);
+    stats_print("bvh_cull_ms", &stats);
+    stats = stats_compute(flat_cull, CULL_BENCH_ITERATIONS);
+    stats_print("flat_cull_ms", &stats);
+    stats = stats_compute(pick, CULL_BENCH_ITERATIONS);
+    stats_print("pick_us", &stats);
+
+    free(pick);
+    free(flat_cull);
+    free(tree_cull);
+    free(refit);
+    free(visible);
+    bench_destroy(&bench);
+    cull_spheres_destroy(&spheres);
+    bvh_destroy(&bvh);
+    free(bounds);
+    free(centers);
+    free(homes);
+}
+
+// What the vertex format saves in vertex fetch, next to the all-float layout with the same
+// attributes. Indexed meshes fetch each unique vertex at least once per frame, and again on every
+// post-transform cache miss, so the frame figures are a lower bound. Comparing gpu_frame_ms between
+// runs with different --vertex-* options shows what the saved bandwidth is worth on this GPU.
+static void report_vertex_bandwidth(const Options* options, const Mesh* mesh, uint32_t frames) {
+    VertexFormat format    = options->vertex_format;
+    VertexFormat reference = {
+        .position = VERTEX_POSITION_FLOAT3,
+        .color    = VERTEX_COLOR_FLOAT4,
+        .normal   = format.normal == VERTEX_NORMAL_NONE ? VERTEX_NORMAL_NONE : VERTEX_NORMAL_FLOAT3,
     };
-    VkPipeline pipeline;
-    vk_create_graphics_pipelines(gpu->device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &pipeline);
-    gpu_set_debug_name(gpu, PIPELINE, pipeline, "Pipeline");
+    VkIndexType index_type       = mesh_index_type(mesh);
+    uint32_t    stride           = vertex_format_stride(format);
+    uint32_t    reference_stride = vertex_format_stride(reference);
+    double      index_mib        = (double) index_type_size(index_type) * mesh->index_count / (1024.0 * 1024.0);
+    double      frame_mib        = (double) stride * mesh->vertex_count / (1024.0 * 1024.0) + index_mib;
+    double      reference_mib    = (double) reference_stride * mesh->vertex_count / (1024.0 * 1024.0) + index_mib;
+    printf("bench-vertices: mesh=%s vertices=%u indices=%u index_type=uint%u position=%s color=%s normal=%s\n",
+           MESH_NAMES[options->mesh], mesh->vertex_count, mesh->index_count, index_type_size(index_type) * 8,
+           VERTEX_POSITION_NAMES[format.position], VERTEX_COLOR_NAMES[format.color],
+           VERTEX_NORMAL_NAMES[format.normal]);
+    printf("%-20s %10s %10s %10s %10s\n", "layout", "bytes", "frame_mib", "total_mib", "saved");
+    printf("%-20s %10u %10.3f %10.1f %9.1f%%\n", "float", reference_stride, reference_mib, reference_mib * frames,
+           0.0);
+    printf("%-20s %10u %10.3f %10.1f %9.1f%%\n", "selected", stride, frame_mib, frame_mib * frames,
+           100.0 * (1.0 - frame_mib / reference_mib));
+}
 
-    return pipeline;
+// Measured vertex invocations per triangle next to the FIFO model's ACMR. Rerun with
+// --mesh-optimize none to see the optimizer's effect on the GPU's own counters, and with
+// --lod-levels 1 to compare against the model, which is for the full-detail level.
+static void report_pipeline_statistics(const PipelineStatistics* statistics, const Mesh* mesh,
+                                       uint32_t instance_count, VertexCacheStats modeled) {
+    if (!statistics->frames) {
+        printf("bench-pipeline-statistics: not supported\n");
+        return;
+    }
+    double vertex   = (double) statistics->vertex_invocations / statistics->frames;
+    double fragment = (double) statistics->fragment_invocations / statistics->frames;
+    printf("bench-pipeline-statistics: frames=%u vertex_invocations=%.0f fragment_invocations=%.0f\n",
+           statistics->frames, vertex, fragment);
+    printf("%-20s %10s %10s\n", "cache", "acmr", "atvr");
+    printf("%-20s %10.4f %10.4f\n", "fifo_model", modeled.acmr, modeled.atvr);
+    double triangles = (double) statistics->triangles / statistics->frames;
+    printf("%-20s %10.4f %10.4f\n", "measured", vertex / triangles,
+           vertex / ((double) mesh->vertex_count * instance_count));
 }
 
+// Triangles drawn per frame and the frames spent at each level. Drawing the full mesh every frame
+// is the baseline; the mean shows what LOD selection saved at this view distance and threshold.
 typedef struct {
-    VkSemaphore     image_acquired;
-    VkSemaphore     commands_complete;
-    VkFence         commands_complete_fence;
-    VkCommandBuffer cmd;
-} Frame;
+    uint64_t triangles;
+    uint32_t min_triangles;
+    uint32_t max_triangles;
+    uint32_t switches;
+    uint32_t frames;
+    uint32_t level_frames[MESH_LOD_MAX];
+} LodStats;
+
+static void lod_stats_record(LodStats* stats, uint32_t lod, uint32_t triangles) {
+    if (!stats->frames || triangles < stats->min_triangles) {
+        stats->min_triangles = triangles;
+    }
+    if (!stats->frames || triangles > stats->max_triangles) {
+        stats->max_triangles = triangles;
+    }
+    stats->triangles += triangles;
+    stats->level_frames[lod]++;
+    stats->frames++;
+}
+
+// Meshlets kept by the culling pass and the triangles they drew, against what was submitted to it.
+typedef struct {
+    uint64_t tested;
+    uint64_t visible;
+    uint64_t triangles;
+    uint32_t frames;
+} MeshletCullTotals;
+
+static void meshlet_cull_totals_add(MeshletCullTotals* totals, MeshletCullStats stats) {
+    totals->tested += stats.tested;
+    totals->visible += stats.visible_meshlets;
+    totals->triangles += stats.triangles;
+    totals->frames++;
+}
+
+static void report_meshlet_cull(const MeshletCullTotals* totals, const LodStats* lod_stats) {
+    if (!totals->frames) {
+        printf("bench-meshlet-cull: off\n");
+        return;
+    }
+    double tested    = (double) totals->tested / totals->frames;
+    double visible   = (double) totals->visible / totals->frames;
+    double triangles = (double) totals->triangles / totals->frames;
+    double submitted = lod_stats->frames ? (double) lod_stats->triangles / lod_stats->frames : 0.0;
+    printf("bench-meshlet-cull: frames=%u meshlets_tested=%.0f meshlets_drawn=%.0f (%.1f%%)\n", totals->frames, tested,
+           visible, tested ? 100.0 * visible / tested : 0.0);
+    printf("triangles_per_frame drawn=%.0f lod=%.0f culled=%.1f%%\n", triangles, submitted,
+           submitted ? 100.0 * (1.0 - triangles / submitted) : 0.0);
+}
+
+// Objects the GPU-driven pass tested and drew, and the triangles of the LODs it picked.
+typedef struct {
+    uint64_t tested;
+    uint64_t visible;
+    uint64_t occluded;
+    uint64_t triangles;
+    uint32_t frames;
+} InstanceCullTotals;
+
+static void instance_cull_totals_add(InstanceCullTotals* totals, InstanceCullStats stats) {
+    totals->tested += stats.tested;
+    totals->visible += stats.visible;
+    totals->occluded += stats.occluded;
+    totals->triangles += stats.triangles;
+    totals->frames++;
+}
+
+// The draw queue --draw-packets fills each frame, and the instances' bounding spheres it culls first.
+typedef struct {
+    DrawQueue   queue;
+    CullSpheres spheres;
+    uint32_t*   visible;
+    float       radius; // Of every sphere.
+} DrawPackets;
+
+static void draw_packets_create(DrawPackets* packets, const Vec3* centers, uint32_t count, float radius) {
+    *packets = (DrawPackets){ .radius = radius };
+    draw_queue_create(&packets->queue, count);
+    cull_spheres_create(&packets->spheres, count);
+    for (uint32_t i = 0; i < count; i++) {
+        cull_spheres_set(&packets->spheres, i, centers[i], radius);
+    }
+    packets->visible = malloc(sizeof(uint32_t) * packets->spheres.capacity);
+}
+
+static void draw_packets_destroy(DrawPackets* packets) {
+    draw_queue_destroy(&packets->queue);
+    cull_spheres_destroy(&packets->spheres);
+    free(packets->visible);
+}
+
+static void draw_packets_set_radius(DrawPackets* packets, float radius) {
+    if (radius == packets->radius) {
+        return;
+    }
+    for (uint32_t i = 0; i < packets->spheres.count; i++) {
+        packets->spheres.radius[i] = radius;
+    }
+    packets->radius = radius;
+}
+
+static PipelineDesc draw_packet_variant(const PipelineDesc* desc, uint32_t variant) {
+    PipelineDesc result = *desc;
+    if (variant & 1) {
+        shader_variant_set_int(&result.fragment_variant, BASIC_FRAG_LIGHTING, 1);
+    }
+    if (variant & 2) {
+        shader_variant_set_bool(&result.fragment_variant, BASIC_FRAG_FOG, VK_TRUE);
+        shader_variant_set_float(&result.fragment_variant, BASIC_FRAG_FOG_DENSITY, 0.08f);
+    }
+    return result;
+}
+
+// Pushes a draw of one instance for every instance inside the frustum, in instance order, as a walk
+// over a scene would find them. Each takes its variant's pipeline and picks its own LOD the way the
+// GPU-driven pass does; `mesh_units` is world units per mesh unit. Instances whose variant hasn't
+// compiled yet are left out. Returns the triangles pushed.
+static uint64_t push_instance_draws(DrawPackets* packets, JobSystem* jobs, const Mat4* view_projection,
+                                    const VkPipeline variants[DRAW_PACKET_VARIANTS], const DrawPacket* base,
+                                    const MeshLod* lods, uint32_t lod_count, float mesh_units, float height,
+                                    float threshold) {
+    const CullSpheres* spheres = &packets->spheres;
+    const Mat4*        m       = view_projection;
+    float              planes[6][4];
+    mat4_frustum_planes(view_projection, planes);
+    uint32_t count = cull_spheres_parallel(jobs, spheres, planes, cull_kernel_best(), packets->visible);
+
+    draw_queue_reset(&packets->queue);
+    uint64_t triangles = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t instance = packets->visible[i];
+        uint32_t variant  = instance % DRAW_PACKET_VARIANTS;
+        if (!variants[variant]) {
+            continue;
+        }
+        Vec3     center = { spheres->x[instance], spheres->y[instance], spheres->z[instance] };
+        float    w      = m->xw * center.x + m->yw * center.y + m->zw * center.z + m->ww;
+        float    pixels = mesh_lod_pixels_per_unit(view_projection, center, height);
+        uint32_t lod    = mesh_lod_select(lods, lod_count, 0, pixels, threshold / mesh_units);
+
+        DrawPacket packet     = *base;
+        packet.pipeline       = variants[variant];
+        packet.index_count    = lods[lod].index_count;
+        packet.first_index    = lods[lod].index_offset;
+        packet.first_instance = instance;
+        draw_queue_push(&packets->queue, draw_key(DRAW_PASS_OPAQUE, variant, lod, w), &packet);
+        triangles += lods[lod].index_count / 3;
+    }
+    return triangles;
+}
+
+// Binds per frame for the packets in the order they were pushed and in sorted order, both without
+// redundant binds, and where the time went.
+typedef struct {
+    uint64_t draws;
+    uint64_t triangles;
+    uint64_t pushed[4]; // Pipelines, descriptor sets, vertex buffers, index buffers.
+    uint64_t sorted[4];
+    double   build_ms;
+    double   sort_ms;
+    double   record_ms;
+    uint32_t frames;
+} DrawPacketTotals;
+
+static void draw_packet_totals_add(DrawPacketTotals* totals, DrawQueueStats pushed, DrawQueueStats sorted,
+                                   uint64_t triangles, double build_ms, double sort_ms, double record_ms) {
+    DrawQueueStats stats[2] = { pushed, sorted };
+    uint64_t*      sums[2]  = { totals->pushed, totals->sorted };
+    for (uint32_t i = 0; i < 2; i++) {
+        sums[i][0] += stats[i].pipelines;
+        sums[i][1] += stats[i].descriptor_sets;
+        sums[i][2] += stats[i].vertex_buffers;
+        sums[i][3] += stats[i].index_buffers;
+    }
+    totals->draws += sorted.draws;
+    totals->triangles += triangles;
+    totals->build_ms += build_ms;
+    totals->sort_ms += sort_ms;
+    totals->record_ms += record_ms;
+    totals->frames++;
+}
+
+// State changes per frame: binding everything for every draw, leaving out redundant binds in the
+// order draws were pushed, and leaving them out after sorting.
+static void report_draw_packets(const DrawPacketTotals* totals) {
+    double frames = totals->frames;
+    double draws  = totals->draws / frames;
+    printf("draw-packets: frames=%u draws_per_frame=%.0f build_ms=%.3f sort_ms=%.3f record_ms=%.3f\n",
+           totals->frames, draws, totals->build_ms / frames, totals->sort_ms / frames, totals->record_ms / frames);
+    printf("%-8s %12s %16s %16s %16s %16s\n", "order", "pipelines", "descriptor_sets", "vertex_buffers",
+           "index_buffers", "state_changes");
+    printf("%-8s %12.0f %16.0f %16.0f %16.0f %16.0f\n", "naive", draws, draws, draws, draws, 4.0 * draws);
+    const char*     names[] = { "pushed", "sorted" };
+    const uint64_t* sums[]  = { totals->pushed, totals->sorted };
+    for (uint32_t i = 0; i < 2; i++) {
+        double binds[4];
+        for (uint32_t j = 0; j < 4; j++) {
+            binds[j] = sums[i][j] / frames;
+        }
+        printf("%-8s %12.0f %16.0f %16.0f %16.0f %16.0f\n", names[i], binds[0], binds[1], binds[2], binds[3],
+               binds[0] + binds[1] + binds[2] + binds[3]);
+    }
+}
+
+// One row per run; rerunning with --instances from 100000 to 1000000 gives CPU and GPU frame time
+// against instance count. The CPU records the same single draw at any count, so cpu_frame_ms should
+// stay flat while gpu_frame_ms grows with the instances' vertex work. With --gpu-cull the CPU still
+// records one dispatch and one draw, and the GPU time includes the culling pass. With --draw-packets
+// the CPU records a draw per visible instance instead, and cpu_frame_ms grows with them.
+static void report_instances(const Bench* bench, uint32_t instance_count, const LodStats* lod_stats,
+                             const InstanceCullTotals* cull, const DrawPacketTotals* packets,
+                             int draw_indirect_count) {
+    if (!instance_count) {
+        printf("bench-instances: off\n");
+        return;
+    }
+    Stats cpu = stats_compute(bench->samples[BENCH_CPU_FRAME], bench->count);
+    Stats gpu = stats_compute(bench->samples[BENCH_GPU_FRAME], bench->count);
+    if (cull->frames) {
+        double tested   = (double) cull->tested / cull->frames;
+        double visible  = (double) cull->visible / cull->frames;
+        double occluded = (double) cull->occluded / cull->frames;
+        printf("bench-instances: instances=%u draws=%s triangles_per_frame=%.0f\n", instance_count,
+               draw_indirect_count ? "indirect-count" : "indirect", (double) cull->triangles / cull->frames);
+        printf("gpu-cull: frames=%u objects_tested=%.0f objects_drawn=%.0f (%.1f%%) objects_occluded=%.0f (%.1f%%)\n",
+               cull->frames, tested, visible, tested ? 100.0 * visible / tested : 0.0, occluded,
+               tested ? 100.0 * occluded / tested : 0.0);
+    } else if (packets->frames) {
+        printf("bench-instances: instances=%u draws=packets triangles_per_frame=%.0f\n", instance_count,
+               (double) packets->triangles / packets->frames);
+        report_draw_packets(packets);
+    } else {
+        double triangles = lod_stats->frames ? (double) lod_stats->triangles / lod_stats->frames : 0.0;
+        printf("bench-instances: instances=%u draws=1 triangles_per_instance=%.0f triangles_per_frame=%.0f\n",
+               instance_count, triangles, triangles * instance_count);
+    }
+    printf("%-12s %14s %14s %16s %16s\n", "instances", "cpu_frame_ms", "gpu_frame_ms", "cpu_ns_per_inst",
+           "gpu_ns_per_inst");
+    printf("%-12u %14.4f %14.4f %16.4f %16.4f\n", instance_count, cpu.median, gpu.median,
+           cpu.median * 1e6 / instance_count, gpu.median * 1e6 / instance_count);
+}
+
+static void report_lod(const Options* options, const LodStats* stats, const MeshLod* lods, uint32_t lod_count) {
+    if (!stats->frames) {
+        return;
+    }
+    double mean = (double) stats->triangles / stats->frames;
+    printf("bench-lod: levels=%u threshold_px=%.2f scale=%.3f switches=%u\n", lod_count, options->lod_threshold,
+           options->mesh_scale, stats->switches);
+    printf("triangles_per_frame mean=%.0f min=%u max=%u full=%u saved=%.1f%%\n", mean, stats->min_triangles,
+           stats->max_triangles, lods[0].index_count / 3, 100.0 * (1.0 - mean / (lods[0].index_count / 3)));
+    printf("%-8s %10s %12s %10s\n", "lod", "triangles", "error", "frames");
+    for (uint32_t i = 0; i < lod_count; i++) {
+        printf("%-8u %10u %12.6f %10u\n", i, lods[i].index_count / 3, lods[i].error, stats->level_frames[i]);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (options.cook_path) {
+        return cook_mesh(&options) ? 0 : 1;
+    }
+    if (options.cull_bench_objects) {
+        run_cull_bench(&options);
+        return 0;
+    }
+    if (options.bvh_bench_objects) {
+        run_bvh_bench(&options);
+        return 0;
+    }
+
+    // A cooked mesh carries the vertex format its payload was encoded in, which the pipelines must
+    // be built for.
+    uint64_t  startup    = bench_time_ns();
+    MeshCache mesh_cache = {};
+    if (options.mesh == MESH_FILE && mesh_cache_is_path(options.mesh_path)) {
+        if (mesh_cache_open(options.mesh_path, &mesh_cache)) {
+            options.vertex_format = mesh_cache.vertex_format;
+            printf("Mapped mesh cache '%s': %u vertices, %u triangles in %.3f ms\n", options.mesh_path,
+                   mesh_cache.header->vertex_count, mesh_cache.header->index_count / 3, bench_elapsed_ms(startup));
+        } else {
+            options.mesh = MESH_CUBE;
+        }
+    }
 
-int main() {
     GPU       gpu       = gpu_create();
     Window    window    = create_window(&gpu, 480, 480);
     Swapchain swapchain = create_swapchain(&gpu, &window);
+    if (options.no_pipeline_library) {
+        gpu.graphics_pipeline_library = 0;
+    }
+
+    VkRenderPass   render_pass = gpu_create_render_pass(&gpu);
+    VkShaderModule basic_vert  = gpu_create_shader(&gpu, BASIC_VERT, sizeof(BASIC_VERT));
+    VkShaderModule basic_frag  = gpu_create_shader(&gpu, BASIC_FRAG, sizeof(BASIC_FRAG));
 
-    VkRenderPass     render_pass     = gpu_create_render_pass(&gpu);
-    VkPipelineLayout pipeline_layout = gpu_create_pipeline_layout(&gpu);
-    VkShaderModule   basic_vert      = gpu_create_shader(&gpu, BASIC_VERT, sizeof(BASIC_VERT));
-    VkShaderModule   basic_frag      = gpu_create_shader(&gpu, BASIC_FRAG, sizeof(BASIC_FRAG));
+    // Pipelines compile on the job system while the rest of the renderer is set up, and the frame
+    // loop draws as soon as they are ready.
+    JobSystem jobs;
+    job_system_create(&jobs, 0);
+    PipelineCache pipeline_cache;
+    pipeline_cache_create(&gpu, &pipeline_cache, options.pipeline_cache_path, options.cold_pipeline_cache);
+    PipelineRegistry pipelines;
+    pipeline_registry_create(&pipelines, &gpu, &jobs, &pipeline_cache, basic_vert, basic_frag);
+
+    PipelineLayoutDesc pipeline_layout_desc = {
+        .push_constant_stages = VK_SHADER_STAGE_VERTEX_BIT,
+        .push_constant_size   = sizeof(Mat4),
+    };
+    VkPipelineLayout pipeline_layout     = pipeline_registry_get_layout(&pipelines, &pipeline_layout_desc);
+    PipelineDesc     basic_pipeline_desc = {
+        .vertex_shader   = basic_vert,
+        .fragment_shader = basic_frag,
+        .vertex_layout   = vertex_format_layout(options.vertex_format),
+        .layout          = pipeline_layout,
+        .render_pass     = render_pass,
+        .topology        = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .cull_mode       = VK_CULL_MODE_BACK_BIT,
+        .front_face      = VK_FRONT_FACE_CLOCKWISE,
+        .depth_test      = VK_TRUE,
+        .name            = "Basic pipeline",
+    };
+    shader_variant_set_int(&basic_pipeline_desc.vertex_variant, BASIC_VERT_VERTEX_FORMAT, 1);
+    shader_variant_set_int(&basic_pipeline_desc.vertex_variant, BASIC_VERT_NORMAL_FORMAT,
+                           options.vertex_format.normal);
+    if (options.vertex_format.normal != VERTEX_NORMAL_NONE) {
+        shader_variant_set_bool(&basic_pipeline_desc.fragment_variant, BASIC_FRAG_VERTEX_NORMALS, VK_TRUE);
+    }
+    pipeline_registry_prefetch(&pipelines, &basic_pipeline_desc);
+
+    // With --instances the mesh is drawn as a grid of copies by one instanced draw, whose pipeline
+    // reads the view and the instances from a descriptor set instead of the MVP push constant.
+    if (options.instances > INSTANCES_MAX) {
+        fprintf(stderr, "--instances is limited to %u\n", INSTANCES_MAX);
+        options.instances = INSTANCES_MAX;
+    }
+    if (options.instances && options.meshlet_cull) {
+        fprintf(stderr, "--meshlet-cull has no effect with --instances\n");
+        options.meshlet_cull = 0;
+    }
+    if (options.gpu_cull && !options.instances) {
+        fprintf(stderr, "--gpu-cull needs --instances\n");
+        options.gpu_cull = 0;
+    }
+    if (options.bvh && !options.instances) {
+        fprintf(stderr, "--bvh needs --instances\n");
+        options.bvh = 0;
+    }
+    if (options.gpu_cull && !instance_cull_supported(&gpu)) {
+        fprintf(stderr, "--gpu-cull needs multi-draw indirect and a first instance in indirect draws\n");
+        options.gpu_cull = 0;
+    }
+    if (options.hiz && !options.gpu_cull) {
+        fprintf(stderr, "--hiz needs --gpu-cull\n");
+        options.hiz = 0;
+    }
+    if (options.draw_packets && !options.instances) {
+        fprintf(stderr, "--draw-packets needs --instances\n");
+        options.draw_packets = 0;
+    }
+    VkShaderModule instanced_vert          = gpu_create_shader(&gpu, INSTANCED_VERT, sizeof(INSTANCED_VERT));
+    Instances      instances               = {};
+    PipelineDesc   instanced_pipeline_desc = basic_pipeline_desc;
+    if (options.instances) {
+        instances_create(&gpu, &instances, options.instances, swapchain.image_count);
+        PipelineLayoutDesc instanced_layout_desc = {
+            .set_layout = instances.set_layout,
+        };
+        instanced_pipeline_desc.vertex_shader = instanced_vert;
+        instanced_pipeline_desc.layout        = pipeline_registry_get_layout(&pipelines, &instanced_layout_desc);
+        instanced_pipeline_desc.name          = "Instanced pipeline";
+        pipeline_registry_prefetch(&pipelines, &instanced_pipeline_desc);
+    }
+
+    PipelineDesc live_pipeline_desc = basic_pipeline_desc;
+    HotReload    hot_reload         = {};
+    int          hot_reloading      = 0;
+    if (options.hot_reload) {
+        hot_reloading = shader_watcher_start(&hot_reload.watcher, SHADER_SOURCE_DIR, HOT_RELOAD_SHADERS,
+                                             ARRAY_SIZE(HOT_RELOAD_SHADERS));
+    }
 
     VkFramebuffer framebuffers[SWAPCHAIN_MAX_IMAGE_COUNT] = {};
     for (uint32_t i = 0; i < swapchain.image_count; i++) {
@@ -282,28 +1507,160 @@ int main() {
         gpu_set_debug_name(&gpu, FRAMEBUFFER, framebuffers[i], name);
     }
 
-    VkBufferCreateInfo buffer_info = {
-        .s_type       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size         = sizeof(CUBE_VERTEX_LIST),
-        .usage        = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        .sharing_mode = VK_SHARING_MODE_EXCLUSIVE,
+    // Cooked meshes are only mapped here; their payloads are copied straight into the buffers below.
+    // Everything else is built on the job system alongside the pipeline compiles started above.
+    Mesh               mesh = {};
+    MeshBounds         bounds;
+    VertexCacheStats   cache_after;
+    VertexQuantization quantization;
+    MeshLod            lods[MESH_LOD_MAX];
+    uint32_t           lod_count;
+    Meshlet*           meshlets;
+    uint32_t           meshlet_count;
+    if (mesh_cache.header) {
+        mesh = (Mesh){
+            .vertex_count = mesh_cache.header->vertex_count,
+            .index_count  = mesh_cache.header->index_count,
+        };
+        bounds        = mesh_cache.header->bounds;
+        cache_after   = mesh_cache.header->cache_stats;
+        quantization  = mesh_cache.header->quantization;
+        lod_count     = mesh_cache.header->lod_count;
+        meshlet_count = mesh_cache.header->meshlet_count;
+        meshlets      = malloc(sizeof(Meshlet) * meshlet_count);
+        memcpy(lods, mesh_cache.lods, sizeof(MeshLod) * lod_count);
+        memcpy(meshlets, mesh_cache.meshlets, sizeof(Meshlet) * meshlet_count);
+    } else {
+        mesh         = create_mesh(&options, &jobs, &cache_after, lods, &lod_count, &meshlets, &meshlet_count);
+        bounds       = mesh_bounds(mesh.vertices, mesh.vertex_count);
+        quantization = vertex_quantization_compute(mesh.vertices, mesh.vertex_count, options.vertex_format);
+    }
+    // LOD errors are in the mesh's own units, so selection projects through the model matrix without
+    // the dequantization, which only undoes the vertex encoding.
+    Vec3 lod_center = {
+        0.5f * (bounds.min.x + bounds.max.x),
+        0.5f * (bounds.min.y + bounds.max.y),
+        0.5f * (bounds.min.z + bounds.max.z),
     };
-    VkBuffer cube_buffer;
-    vk_create_buffer(gpu.device, &buffer_info, NULL, &cube_buffer);
-    gpu_set_debug_name(&gpu, BUFFER, cube_buffer, "Cube buffer");
+    Mat4 fit        = options.mesh == MESH_FILE ? mesh_fit_matrix(&bounds, 1.5f) : mat4_identity();
+    Mat4 dequantize = vertex_quantization_matrix(&quantization);
+
+    Vec3* instance_centers = NULL;
+    float object_radius    = 0.0f;
+    if (options.instances) {
+        Vec3     size       = vec3_sub(bounds.max, bounds.min);
+        uint64_t fill_start = bench_time_ns();
+        object_radius       = 0.5f * sqrtf(vec3_dot(size, size)) * fit.xx;
+        instance_centers    = options.gpu_cull || options.bvh || options.draw_packets
+                                ? malloc(sizeof(Vec3) * options.instances)
+                                : NULL;
+        instances_fill_grid(&instances, INSTANCE_GRID_EXTENT, object_radius, options.bench_options.seed,
+                            instance_centers);
+        printf("Placed %u instances in %.3f ms, %.1f MiB of transforms and colors\n", instances.count,
+               bench_elapsed_ms(fill_start),
+               (sizeof(InstanceTransform) + sizeof(uint32_t)) * (double) instances.count / (1024.0 * 1024.0));
+    }
+
+    MemoryBlock vertex_memory;
+    VkBuffer    vertex_buffer = gpu_create_buffer(
+        &gpu, &gpu.host_visible_heap, (VkDeviceSize) vertex_format_stride(options.vertex_format) * mesh.vertex_count,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertex_memory, "Vertex buffer");
+
+    // The meshlet culling pass reads the indices as 32-bit words, so the size is rounded up to one.
+    VkIndexType index_type = mesh_cache.header ? mesh_cache.header->index_type : mesh_index_type(&mesh);
+    MemoryBlock index_memory;
+    VkBuffer    index_buffer = gpu_create_buffer(
+        &gpu, &gpu.host_visible_heap, ((VkDeviceSize) index_type_size(index_type) * mesh.index_count + 3) & ~3ull,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &index_memory, "Index buffer");
+
+    // Both buffers are filled straight through their mapped memory: cooked payloads are copied, with
+    // the indices checked on the way, and the cache is unmapped; anything else is encoded in parallel
+    // ranges.
+    uint64_t upload_start = bench_time_ns();
+    if (mesh_cache.header) {
+        mesh_cache_copy(&mesh_cache, vertex_memory.mapped, index_memory.mapped);
+        mesh_cache_close(&mesh_cache);
+    } else {
+        mesh_encode_parallel(&jobs, &mesh, options.vertex_format, &quantization, vertex_memory.mapped, index_type,
+                             index_memory.mapped);
+    }
+    printf("Mesh uploaded in %.3f ms\n", bench_elapsed_ms(upload_start));
+
+    // The meshlet culler keeps a device-local 32-bit copy of LOD 0's indices per frame, so it's only
+    // created once meshlet culling is first turned on, by --meshlet-cull or M.
+    MeshletCull meshlet_cull = {};
+
+    // With --gpu-cull every instance is an object bounded by a sphere around its center that draws
+    // one of the mesh's LODs, and the GPU decides which instances are drawn and at which level.
+    // The culling pass can also test objects against a Hi-Z pyramid of the previous frame's depth.
+    InstanceCull instance_cull = {};
+    HiZ          hiz           = {};
+    if (options.gpu_cull) {
+        hiz_create(&gpu, pipeline_cache.handle, &hiz, &swapchain.depth_attachment, window.width, window.height);
+        InstanceCullObject* objects = malloc(sizeof(InstanceCullObject) * instances.count);
+        for (uint32_t i = 0; i < instances.count; i++) {
+            objects[i] = (InstanceCullObject){
+                .center      = instance_centers[i],
+                .radius      = instances.scale * object_radius,
+                .draw_count  = lod_count,
+                .error_scale = instances.scale * fit.xx,
+            };
+        }
+        InstanceCullDraw draws[MESH_LOD_MAX];
+        for (uint32_t i = 0; i < lod_count; i++) {
+            draws[i] = (InstanceCullDraw){
+                .index_count = lods[i].index_count,
+                .first_index = lods[i].index_offset,
+                .error       = lods[i].error,
+            };
+        }
+        instance_cull_create(&gpu, pipeline_cache.handle, &instance_cull, objects, instances.count, draws, lod_count,
+                             swapchain.image_count, &hiz);
+        printf("GPU-driven culling of %u objects, drawn with %s\n", instances.count,
+               gpu.draw_indirect_count ? "vkCmdDrawIndexedIndirectCount" : "vkCmdDrawIndexedIndirect");
+        printf("Hi-Z pyramid of %u levels from %ux%u, occlusion culling %s\n", hiz.level_count,
+               hiz.depth_width, hiz.depth_height, options.hiz ? "on" : "off");
+        free(objects);
+    }
 
-    VkMemoryRequirements cube_reqs;
-    vk_get_buffer_memory_requirements(gpu.device, cube_buffer, &cube_reqs);
-    MemoryBlock cube_memory = gpu_allocate_memory(&gpu, &gpu.host_visible_heap, &cube_reqs);
-    Vertex*     cube_memory_ptr;
-    vk_map_memory(gpu.device, cube_memory.memory, cube_memory.offset, cube_memory.length, 0, (void**) &cube_memory_ptr);
-    for (uint32_t i = 0; i < ARRAY_SIZE(CUBE_VERTEX_LIST); i++) {
-        cube_memory_ptr[i] = CUBE_VERTEX_LIST[i];
+    // With --bvh the instances' bounding spheres go into a BVH, so a click picks the instance under
+    // the cursor without testing every one. Changing the mesh scale refits it.
+    Bvh         bvh             = {};
+    PickSpheres instance_bounds = { instance_centers, instances.scale * object_radius * options.mesh_scale };
+    if (options.bvh) {
+        Aabb* bounds = malloc(sizeof(Aabb) * instances.count);
+        for (uint32_t i = 0; i < instances.count; i++) {
+            bounds[i] = sphere_bounds(instance_centers[i], instance_bounds.radius);
+        }
+        uint64_t start = bench_time_ns();
+        bvh_build(&bvh, bounds, instances.count);
+        printf("Built a BVH of %u nodes over %u instances in %.3f ms, SAH cost %.2f; click to pick\n", bvh.node_count,
+               instances.count, bench_elapsed_ms(start), bvh_cost(&bvh));
+        free(bounds);
     }
-    vk_unmap_memory(gpu.device, cube_memory.memory);
-    vk_bind_buffer_memory(gpu.device, cube_buffer, cube_memory.memory, cube_memory.offset);
 
-    VkPipeline pipeline = gpu_create_pipeline(&gpu, &window, basic_vert, basic_frag, pipeline_layout, render_pass);
+    // With --draw-packets and GPU-driven culling off, every instance inside the frustum is its own
+    // draw, with one of DRAW_PACKET_VARIANTS pipelines, sorted by key before it's recorded.
+    DrawPackets draw_packets = {};
+    if (options.draw_packets) {
+        draw_packets_create(&draw_packets, instance_centers, instances.count, instance_bounds.radius);
+    }
+
+    // Benchmarks, screenshots and captures must see the same frames every run.
+    if (options.bench || options.screenshot_path || options.capture_options.path
+        || options.startup_bench_iterations) {
+        pipeline_registry_wait(&pipelines, &basic_pipeline_desc);
+        if (options.instances) {
+            pipeline_registry_wait(&pipelines, &instanced_pipeline_desc);
+        }
+        for (uint32_t i = 0; options.draw_packets && i < DRAW_PACKET_VARIANTS; i++) {
+            PipelineDesc desc = draw_packet_variant(&instanced_pipeline_desc, i);
+            pipeline_registry_wait(&pipelines, &desc);
+        }
+    }
+    if (options.startup_bench_iterations) {
+        run_startup_bench(&gpu, &jobs, &pipeline_cache, &basic_pipeline_desc, options.startup_bench_iterations);
+    }
 
     VkCommandPoolCreateInfo command_pool_info = {
         .s_type             = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
@@ -326,6 +1683,42 @@ int main() {
             .flags  = VK_FENCE_CREATE_SIGNALED_BIT,
         };
         vk_create_fence(gpu.device, &fence_info, NULL, &frames[i].commands_complete_fence);
+        frames[i].number                  = UINT32_MAX;
+        frames[i].has_timestamps          = 0;
+        frames[i].has_statistics          = 0;
+        frames[i].has_cull_stats          = 0;
+        frames[i].has_instance_cull_stats = 0;
+        frames[i].triangles               = 0;
+    }
+
+    Bench              bench           = bench_create(options.bench_options);
+    VkQueryPool        timestamp_pool  = VK_NULL_HANDLE;
+    VkQueryPool        statistics_pool = VK_NULL_HANDLE;
+    PipelineStatistics statistics      = {};
+    if (options.bench) {
+        timestamp_pool  = create_timestamp_query_pool(&gpu, swapchain.image_count);
+        statistics_pool = create_statistics_query_pool(&gpu, swapchain.image_count);
+    }
+    uint32_t           frame_number         = 0;
+    LodStats           lod_stats            = {};
+    MeshletCullTotals  cull_totals          = {};
+    InstanceCullTotals instance_cull_totals = {};
+    DrawPacketTotals   draw_packet_totals   = {};
+
+    // One slot per frame in flight plus one that can be held by the PNG encoder.
+    Readback         readback = readback_create(&gpu, swapchain.image_count + 1, window.width, window.height);
+    ScreenshotWriter screenshot_writer;
+    screenshot_writer_start(&screenshot_writer);
+
+    Capture capture;
+    int     capturing = 0;
+    if (options.capture_options.path) {
+        if (!(swapchain.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+            fprintf(stderr, "capture: swapchain images can't be used as a transfer source\n");
+        } else {
+            capturing = capture_start(&gpu, &capture, options.capture_options, window.width, window.height,
+                                      swapchain.image_count);
+        }
     }
 
     VkCommandBuffer             cmds[SWAPCHAIN_MAX_IMAGE_COUNT];
@@ -339,25 +1732,197 @@ int main() {
 
     uint32_t frame_index                                     = 0;
     VkFence  image_command_fences[SWAPCHAIN_MAX_IMAGE_COUNT] = {};
+    int      screenshot_requested                            = 0;
+    int      pipeline_logged                                 = 0;
+    double   first_draw_ms                                   = -1.0;
+    uint32_t cull_mode_index                                 = 0;
+    int      lighting                                        = 0;
+    int      fog                                             = 0;
+    uint32_t lod                                             = 0;
+    uint32_t instance_count                                  = options.instances ? options.instances : 1;
+    int      gpu_culling                                     = options.gpu_cull;
+    int      occlusion_culling                               = options.hiz;
+    int      hiz_built                                       = 0;
+    Mat4     hiz_view_projection                             = mat4_identity();
+    Mat4     pick_view_projection                            = mat4_identity();
     for (;;) {
-        int quit = poll_events(&window);
+        int quit = 0;
+        for (WindowEvent event; poll_event(&window, &event);) {
+            switch (event.type) {
+            case WINDOW_EVENT_CLOSE:
+                quit = 1;
+                break;
+            case WINDOW_EVENT_KEY:
+                if (event.key.pressed && event.key.keysym == KEY_ESCAPE) {
+                    quit = 1;
+                }
+                if (event.key.pressed && event.key.keysym == KEY_F12) {
+                    screenshot_requested = 1;
+                }
+                if (event.key.pressed && event.key.keysym == 'c') {
+                    cull_mode_index = (cull_mode_index + 1) % ARRAY_SIZE(CULL_MODES);
+                }
+                if (event.key.pressed && event.key.keysym == 'l') {
+                    lighting = !lighting;
+                }
+                if (event.key.pressed && event.key.keysym == 'f') {
+                    fog = !fog;
+                }
+                if (event.key.pressed && event.key.keysym == '-') {
+                    options.mesh_scale *= 0.5f;
+                    refit_instance_bvh(&bvh, &instance_bounds, 0.5f);
+                }
+                if (event.key.pressed && event.key.keysym == '=') {
+                    options.mesh_scale *= 2.0f;
+                    refit_instance_bvh(&bvh, &instance_bounds, 2.0f);
+                }
+                if (event.key.pressed && event.key.keysym == 'm' && !options.instances) {
+                    options.meshlet_cull = !options.meshlet_cull;
+                    printf("Meshlet culling %s\n", options.meshlet_cull ? "on" : "off");
+                }
+                if (event.key.pressed && event.key.keysym == 'g' && options.gpu_cull) {
+                    gpu_culling = !gpu_culling;
+                    printf("GPU-driven culling %s\n", gpu_culling ? "on" : "off");
+                }
+                if (event.key.pressed && event.key.keysym == 'o' && options.gpu_cull) {
+                    occlusion_culling = !occlusion_culling;
+                    printf("Occlusion culling %s\n", occlusion_culling ? "on" : "off");
+                }
+                break;
+            case WINDOW_EVENT_MOUSE_BUTTON:
+                if (event.mouse.pressed && event.mouse.button == 1 && options.bvh) {
+                    pick_instance(&bvh, &instance_bounds, &pick_view_projection, event.mouse.x, event.mouse.y,
+                                  window.width, window.height);
+                }
+                break;
+            default:
+                break;
+            }
+        }
         if (quit) {
             break;
         }
+        if (options.bench && bench_done(&bench, frame_number)) {
+            break;
+        }
+        if (options.startup_bench_iterations) {
+            break;
+        }
+        if (options.load_bench_iterations && first_draw_ms >= 0.0) {
+            break;
+        }
 
-        Frame* frame = &frames[frame_index];
+        uint64_t frame_start = bench_time_ns();
+        Frame*   frame       = &frames[frame_index];
 
         vk_wait_for_fences(gpu.device, 1, &frame->commands_complete_fence, VK_TRUE, UINT64_MAX);
+        if (frame->has_timestamps) {
+            bench_record(&bench, frame->number, BENCH_GPU_FRAME, read_gpu_frame_ms(&gpu, timestamp_pool, frame_index));
+            frame->has_timestamps = 0;
+        }
+        if (frame->has_cull_stats) {
+            MeshletCullStats cull_stats = meshlet_cull_read_stats(&meshlet_cull, frame_index);
+            frame->triangles            = cull_stats.triangles;
+            meshlet_cull_totals_add(&cull_totals, cull_stats);
+            frame->has_cull_stats = 0;
+        }
+        if (frame->has_instance_cull_stats) {
+            InstanceCullStats cull_stats = instance_cull_read_stats(&instance_cull, frame_index);
+            frame->triangles             = cull_stats.triangles;
+            instance_cull_totals_add(&instance_cull_totals, cull_stats);
+            frame->has_instance_cull_stats = 0;
+        }
+        if (frame->has_statistics) {
+            read_pipeline_statistics(&gpu, statistics_pool, frame_index, frame->triangles, &statistics);
+            frame->has_statistics = 0;
+        }
+        readback_frame_complete(&gpu, &readback, frame->number);
+        for (ReadbackSlot* slot; (slot = readback_acquire(&readback));) {
+            submit_screenshot(&screenshot_writer, slot, options.screenshot_path);
+        }
+        if (capturing) {
+            capture_frame_complete(&gpu, &capture, frame->number);
+        }
 
+        if (hot_reloading) {
+            hot_reload_update(&hot_reload, &gpu, &pipelines, &live_pipeline_desc);
+        }
+
+        uint64_t acquire_start = bench_time_ns();
         uint32_t image_index;
         vk_acquire_next_image_khr(gpu.device, swapchain.handle, UINT64_MAX, frame->image_acquired, VK_NULL_HANDLE,
                                   &image_index);
+        double acquire_ms = bench_elapsed_ms(acquire_start);
 
         vk_reset_command_buffer(cmds[frame_index], 0);
         VkCommandBufferBeginInfo begin_info = {
             .s_type = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         };
         vk_begin_command_buffer(cmds[frame_index], &begin_info);
+        if (timestamp_pool) {
+            vk_cmd_reset_query_pool(cmds[frame_index], timestamp_pool, 2 * frame_index, 2);
+            vk_cmd_write_timestamp(cmds[frame_index], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamp_pool,
+                                   2 * frame_index);
+        }
+        if (statistics_pool) {
+            vk_cmd_reset_query_pool(cmds[frame_index], statistics_pool, frame_index, 1);
+        }
+        Mat4 mvp = {
+            2.159338,  0.279808, 0.432150, 0.431934, 0.000000, 2.331730, -0.259290, -0.259161,
+            -1.079669, 0.559615, 0.864301, 0.863868, 0.000000, 0.000000, 11.531581, 11.575838,
+        };
+        if (options.bench) {
+            mvp = bench_mvp(&bench, frame_number, (float) window.width / (float) window.height);
+        }
+        // The LOD is picked from the MVP about to be pushed, at the center of the mesh's bounds.
+        // Instances all share one LOD, picked for an instance at the center of the grid.
+        Mat4 scale           = mat4_scale(options.mesh_scale);
+        Mat4 model           = mat4_mul(&scale, &fit);
+        Mat4 view_projection = mvp;
+        pick_view_projection = mvp;
+        if (options.instances) {
+            Mat4 instance = mat4_scale(instances.scale);
+            mvp           = mat4_mul(&mvp, &instance);
+        }
+        mvp = mat4_mul(&mvp, &model);
+
+        uint32_t selected = mesh_lod_select(lods, lod_count, lod,
+                                            mesh_lod_pixels_per_unit(&mvp, lod_center, (float) window.height),
+                                            options.lod_threshold);
+        if (selected != lod) {
+            printf("LOD %u: %u triangles\n", selected, lods[selected].index_count / 3);
+            lod = selected;
+            lod_stats.switches++;
+        }
+        if (options.meshlet_cull && !meshlet_cull.pipeline) {
+            meshlet_cull_create(&gpu, pipeline_cache.handle, &meshlet_cull, meshlets, meshlet_count, index_buffer,
+                                index_type, lods[0].index_count, swapchain.image_count);
+        }
+        // Meshlet bounds are in the same space as the LOD errors. Cones only hold while back faces
+        // are culled.
+        if (options.meshlet_cull) {
+            meshlet_cull_record(&meshlet_cull, cmds[frame_index], frame_index, &mvp, lods[lod].meshlet_offset,
+                                lods[lod].meshlet_count, CULL_MODES[cull_mode_index].mode == VK_CULL_MODE_BACK_BIT);
+        }
+        mvp = mat4_mul(&mvp, &dequantize);
+        if (options.instances) {
+            InstanceView view = {
+                .view_projection = view_projection,
+                .model           = mat4_mul(&model, &dequantize),
+            };
+            instances_set_view(&instances, frame_index, &view);
+        }
+        // The pyramid is tested against from the frame after it was built, with the view-projection
+        // its depth was drawn with.
+        if (options.gpu_cull && frame_number == 0) {
+            hiz_record_clear(&hiz, cmds[frame_index]);
+        }
+        if (gpu_culling) {
+            instance_cull_record(&instance_cull, cmds[frame_index], frame_index, &view_projection, options.mesh_scale,
+                                 (float) window.height, options.lod_threshold,
+                                 occlusion_culling && hiz_built ? &hiz_view_projection : NULL);
+        }
+
         VkClearValue          clear_color     = { .color = {
                                          .float32 = { 0.0f, 0.0f, 0.0f, 0.0f },
                                      } };
@@ -372,19 +1937,122 @@ int main() {
             .p_clear_values    = clear_values,
         };
         vk_cmd_begin_render_pass(cmds[frame_index], &pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-        vk_cmd_bind_pipeline(cmds[frame_index], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-        Mat4 mvp = {
-            2.159338,  0.279808, 0.432150, 0.431934, 0.000000, 2.331730, -0.259290, -0.259161,
-            -1.079669, 0.559615, 0.864301, 0.863868, 0.000000, 0.000000, 11.531581, 11.575838,
-        };
 
-        vk_cmd_push_constants(cmds[frame_index], pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Mat4), &mvp);
-        VkBuffer     vertex_buffers[]        = { cube_buffer };
-        VkDeviceSize vertex_buffer_offsets[] = { 0 };
-        vk_cmd_bind_vertex_buffers(cmds[frame_index], 0, ARRAY_SIZE(vertex_buffers), vertex_buffers,
-                                   vertex_buffer_offsets);
-        vk_cmd_draw(cmds[frame_index], 12 * 3, 1, 0, 0);
+        // Pipelines are never waited for in the frame loop. A state change the registry hasn't seen
+        // draws with the basic pipeline while it compiles, and until the basic pipeline itself has
+        // compiled the mesh is skipped and the frame is only cleared. The basic pipeline can't stand
+        // in for instanced ones, whose layout differs, so those skip the mesh until they're ready.
+        PipelineDesc mesh_desc = live_pipeline_desc;
+        if (options.instances) {
+            mesh_desc.vertex_shader = instanced_vert;
+            mesh_desc.layout        = instanced_pipeline_desc.layout;
+            mesh_desc.name          = instanced_pipeline_desc.name;
+        }
+        if (cull_mode_index) {
+            mesh_desc.cull_mode = CULL_MODES[cull_mode_index].mode;
+            mesh_desc.name      = CULL_MODES[cull_mode_index].name;
+        }
+        if (lighting) {
+            shader_variant_set_int(&mesh_desc.fragment_variant, BASIC_FRAG_LIGHTING, 1);
+        }
+        if (fog) {
+            shader_variant_set_bool(&mesh_desc.fragment_variant, BASIC_FRAG_FOG, VK_TRUE);
+            shader_variant_set_float(&mesh_desc.fragment_variant, BASIC_FRAG_FOG_DENSITY, 0.08f);
+        }
+        PipelineMissPolicy miss          = options.instances ? PIPELINE_MISS_SKIP : PIPELINE_MISS_FALLBACK;
+        VkPipeline         mesh_pipeline = pipeline_registry_get(&pipelines, &mesh_desc, miss);
+        if (statistics_pool) {
+            vk_cmd_begin_query(cmds[frame_index], statistics_pool, frame_index, 0);
+        }
+        int      drawing_packets  = options.draw_packets && !gpu_culling;
+        uint64_t packet_triangles = 0;
+        if (mesh_pipeline) {
+            if (!pipeline_logged) {
+                first_draw_ms = bench_elapsed_ms(startup);
+                printf("Mesh first drawn in frame %u, %.3f ms after startup\n", frame_number, first_draw_ms);
+                pipeline_logged = 1;
+            }
+        }
+        if (mesh_pipeline && drawing_packets) {
+            pipeline_cmd_set_state(&gpu, cmds[frame_index], &mesh_desc, (VkExtent2D){ window.width, window.height });
+            VkPipeline variants[DRAW_PACKET_VARIANTS];
+            for (uint32_t i = 0; i < DRAW_PACKET_VARIANTS; i++) {
+                PipelineDesc desc = draw_packet_variant(&mesh_desc, i);
+                variants[i]       = pipeline_registry_get(&pipelines, &desc, PIPELINE_MISS_SKIP);
+            }
+            DrawPacket base = {
+                .layout         = mesh_desc.layout,
+                .set            = instances.sets[frame_index],
+                .vertex_buffer  = vertex_buffer,
+                .index_buffer   = index_buffer,
+                .index_type     = index_type,
+                .instance_count = 1,
+            };
+            uint64_t build_start = bench_time_ns();
+            draw_packets_set_radius(&draw_packets, instances.scale * object_radius * options.mesh_scale);
+            packet_triangles = push_instance_draws(&draw_packets, &jobs, &view_projection, variants, &base, lods,
+                                                   lod_count, instances.scale * options.mesh_scale * fit.xx,
+                                                   (float) window.height, options.lod_threshold);
+            double   build_ms   = bench_elapsed_ms(build_start);
+            uint64_t sort_start = bench_time_ns();
+            draw_queue_sort(&draw_packets.queue, &jobs);
+            double         sort_ms      = bench_elapsed_ms(sort_start);
+            uint64_t       record_start = bench_time_ns();
+            DrawQueueStats sorted       = draw_queue_record(&draw_packets.queue, cmds[frame_index]);
+            double         record_ms    = bench_elapsed_ms(record_start);
+            if (options.bench) {
+                draw_packet_totals_add(&draw_packet_totals, draw_queue_unsorted_stats(&draw_packets.queue), sorted,
+                                       packet_triangles, build_ms, sort_ms, record_ms);
+            }
+        } else if (mesh_pipeline) {
+            vk_cmd_bind_pipeline(cmds[frame_index], VK_PIPELINE_BIND_POINT_GRAPHICS, mesh_pipeline);
+            pipeline_cmd_set_state(&gpu, cmds[frame_index], &mesh_desc, (VkExtent2D){ window.width, window.height });
+            if (options.instances) {
+                instances_bind(&instances, cmds[frame_index], mesh_desc.layout, frame_index);
+            } else {
+                vk_cmd_push_constants(cmds[frame_index], pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Mat4),
+                                      &mvp);
+            }
+            VkBuffer     vertex_buffers[]        = { vertex_buffer };
+            VkDeviceSize vertex_buffer_offsets[] = { 0 };
+            vk_cmd_bind_vertex_buffers(cmds[frame_index], 0, ARRAY_SIZE(vertex_buffers), vertex_buffers,
+                                       vertex_buffer_offsets);
+            if (options.meshlet_cull) {
+                meshlet_cull_draw(&meshlet_cull, cmds[frame_index], frame_index);
+            } else if (gpu_culling) {
+                vk_cmd_bind_index_buffer(cmds[frame_index], index_buffer, 0, index_type);
+                instance_cull_draw(&instance_cull, &gpu, cmds[frame_index], frame_index);
+            } else {
+                vk_cmd_bind_index_buffer(cmds[frame_index], index_buffer, 0, index_type);
+                vk_cmd_draw_indexed(cmds[frame_index], lods[lod].index_count, instance_count, lods[lod].index_offset,
+                                    0, 0);
+            }
+        }
+        if (statistics_pool) {
+            vk_cmd_end_query(cmds[frame_index], statistics_pool, frame_index);
+        }
         vk_cmd_end_render_pass(cmds[frame_index]);
+        hiz_built = gpu_culling && occlusion_culling;
+        if (hiz_built) {
+            hiz_record(&hiz, cmds[frame_index]);
+            hiz_view_projection = view_projection;
+        }
+        if (options.screenshot_path && frame_number == options.screenshot_frame) {
+            screenshot_requested = 1;
+        }
+        if (screenshot_requested && swapchain.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+            screenshot_requested = !readback_copy_image(&readback, cmds[frame_index], swapchain.images[image_index],
+                                                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, window.width, window.height,
+                                                        frame_number);
+        }
+        if (capturing) {
+            capture_frame(&capture, cmds[frame_index], swapchain.images[image_index], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                          frame_number);
+        }
+        if (timestamp_pool) {
+            vk_cmd_write_timestamp(cmds[frame_index], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamp_pool,
+                                   2 * frame_index + 1);
+        }
         vk_end_command_buffer(cmds[frame_index]);
 
         if (image_command_fences[image_index])
@@ -414,17 +2082,139 @@ int main() {
             .p_swapchains         = &swapchain.handle,
             .p_image_indices      = &image_index,
         };
+        uint64_t present_start = bench_time_ns();
         vk_queue_present_khr(gpu.queue, &present_info);
+        double present_ms = bench_elapsed_ms(present_start);
+
+        uint32_t lod_triangles = mesh_pipeline ? lods[lod].index_count / 3 : 0;
+        frame->number          = frame_number;
+        frame->triangles       = drawing_packets ? packet_triangles : (uint64_t) lod_triangles * instance_count;
+        if (options.bench) {
+            // The GPU, or each draw packet, picks each instance's LOD itself, so the CPU's pick isn't
+            // what's drawn.
+            if (!gpu_culling && !drawing_packets) {
+                lod_stats_record(&lod_stats, lod, lod_triangles);
+            }
+            frame->has_cull_stats          = options.meshlet_cull && mesh_pipeline;
+            frame->has_instance_cull_stats = gpu_culling && mesh_pipeline;
+            frame->has_timestamps          = timestamp_pool != VK_NULL_HANDLE;
+            frame->has_statistics          = statistics_pool != VK_NULL_HANDLE;
+            bench_record(&bench, frame_number, BENCH_CPU_FRAME, bench_elapsed_ms(frame_start));
+            bench_record(&bench, frame_number, BENCH_ACQUIRE_WAIT, acquire_ms);
+            bench_record(&bench, frame_number, BENCH_PRESENT_WAIT, present_ms);
+        }
+        if (frame_number == 0) {
+            printf("First frame presented %.3f ms after startup\n", bench_elapsed_ms(startup));
+        }
 
+        frame_number++;
         frame_index = (frame_index + 1) % swapchain.image_count;
     }
 
     vk_device_wait_idle(gpu.device);
 
+    if (options.load_bench_iterations && options.mesh == MESH_FILE && mesh_cache_is_path(options.mesh_path)) {
+        run_cache_load_bench(options.mesh_path, options.load_bench_iterations, first_draw_ms);
+    } else if (options.load_bench_iterations && options.mesh == MESH_FILE) {
+        run_load_bench(&jobs, options.mesh_path, options.load_bench_iterations, first_draw_ms);
+    } else if (options.load_bench_iterations) {
+        fprintf(stderr, "--bench-load needs a mesh file, e.g. --mesh model.glb\n");
+    }
+
+    for (uint32_t i = 0; i < swapchain.image_count; i++) {
+        readback_frame_complete(&gpu, &readback, frames[i].number);
+    }
+    for (ReadbackSlot* slot; (slot = readback_acquire(&readback));) {
+        submit_screenshot(&screenshot_writer, slot, options.screenshot_path);
+    }
+    screenshot_writer_stop(&screenshot_writer);
+    readback_destroy(&gpu, &readback);
+
+    if (capturing) {
+        // Oldest frame first, so the file stays in frame order.
+        for (uint32_t i = 0; i < swapchain.image_count; i++) {
+            capture_frame_complete(&gpu, &capture, frames[(frame_index + i) % swapchain.image_count].number);
+        }
+        capture_stop(&gpu, &capture, frame_number);
+    }
+
+    if (options.bench) {
+        for (uint32_t i = 0; i < swapchain.image_count; i++) {
+            if (frames[i].has_timestamps) {
+                bench_record(&bench, frames[i].number, BENCH_GPU_FRAME, read_gpu_frame_ms(&gpu, timestamp_pool, i));
+            }
+            if (frames[i].has_cull_stats) {
+                MeshletCullStats cull_stats = meshlet_cull_read_stats(&meshlet_cull, i);
+                frames[i].triangles         = cull_stats.triangles;
+                meshlet_cull_totals_add(&cull_totals, cull_stats);
+            }
+            if (frames[i].has_instance_cull_stats) {
+                InstanceCullStats cull_stats = instance_cull_read_stats(&instance_cull, i);
+                frames[i].triangles          = cull_stats.triangles;
+                instance_cull_totals_add(&instance_cull_totals, cull_stats);
+            }
+            if (frames[i].has_statistics) {
+                read_pipeline_statistics(&gpu, statistics_pool, i, frames[i].triangles, &statistics);
+            }
+        }
+        bench_report(&bench, gpu.properties.device_name, window.width, window.height);
+        Mesh full        = mesh;
+        full.index_count = lods[0].index_count;
+        report_vertex_bandwidth(&options, &full, bench.count);
+        report_pipeline_statistics(&statistics, &mesh, instance_count, cache_after);
+        report_lod(&options, &lod_stats, lods, lod_count);
+        report_meshlet_cull(&cull_totals, &lod_stats);
+        report_instances(&bench, options.instances, &lod_stats, &instance_cull_totals, &draw_packet_totals,
+                         gpu.draw_indirect_count);
+    }
+    bench_destroy(&bench);
+    if (timestamp_pool) {
+        vk_destroy_query_pool(gpu.device, timestamp_pool, NULL);
+    }
+    if (statistics_pool) {
+        vk_destroy_query_pool(gpu.device, statistics_pool, NULL);
+    }
+
+    if (hot_reloading) {
+        shader_watcher_stop(&hot_reload.watcher);
+    }
+    // Destroying the registry waits for every compile and relink still queued, which all build
+    // through the cache, so the cache is saved after them and destroyed once nothing can use it.
+    pipeline_registry_report(&pipelines);
+    pipeline_registry_destroy(&pipelines);
+    pipeline_cache_save(&gpu, &pipeline_cache);
+    pipeline_cache_destroy(&gpu, &pipeline_cache);
+    for (uint32_t i = 0; i < hot_reload.module_count; i++) {
+        vk_destroy_shader_module(gpu.device, hot_reload.modules[i], NULL);
+    }
+    free(hot_reload.modules);
+    job_system_destroy(&jobs);
+
+    vk_destroy_buffer(gpu.device, vertex_buffer, NULL);
+    vk_destroy_buffer(gpu.device, index_buffer, NULL);
+    if (meshlet_cull.pipeline) {
+        meshlet_cull_destroy(&gpu, &meshlet_cull);
+    }
+    free(meshlets);
+    if (options.instances) {
+        instances_destroy(&gpu, &instances);
+    }
+    if (options.gpu_cull) {
+        instance_cull_destroy(&gpu, &instance_cull);
+        hiz_destroy(&gpu, &hiz);
+    }
+    if (options.bvh) {
+        bvh_destroy(&bvh);
+    }
+    if (options.draw_packets) {
+        draw_packets_destroy(&draw_packets);
+    }
+    free(instance_centers);
+    mesh_destroy(&mesh);
     vk_destroy_shader_module(gpu.device, basic_vert, NULL);
     vk_destroy_shader_module(gpu.device, basic_frag, NULL);
+    vk_destroy_shader_module(gpu.device, instanced_vert, NULL);
     vk_destroy_render_pass(gpu.device, render_pass, NULL);
-    vk_destroy_pipeline_layout(gpu.device, pipeline_layout, NULL);
 
     destroy_swapchain(&gpu, &swapchain);
     destroy_window(&gpu, &window);
@@ -0,0 +1,362 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mesh.h"
+
+// The cube's faces in the order and winding the renderer has always drawn them: two clockwise
+// triangles per face, seen from outside.
+static const struct {
+    Vec3  corners[6];
+    Vec3  normal;
+    float color[4];
+} CUBE_FACES[] = {
+    { { { -1, -1, 1 }, { -1, 1, 1 }, { 1, -1, 1 }, { 1, -1, 1 }, { -1, 1, 1 }, { 1, 1, 1 } },
+      { 0, 0, 1 },
+      { 1, 0, 0, 1 } },
+    { { { -1, -1, -1 }, { 1, -1, -1 }, { -1, 1, -1 }, { -1, 1, -1 }, { 1, -1, -1 }, { 1, 1, -1 } },
+      { 0, 0, -1 },
+      { 0, 1, 0, 1 } },
+    { { { -1, 1, 1 }, { -1, -1, 1 }, { -1, 1, -1 }, { -1, 1, -1 }, { -1, -1, 1 }, { -1, -1, -1 } },
+      { -1, 0, 0 },
+      { 0, 0, 1, 1 } },
+    { { { 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 }, { 1, -1, 1 }, { 1, 1, -1 }, { 1, -1, -1 } },
+      { 1, 0, 0 },
+      { 1, 1, 0, 1 } },
+    { { { 1, 1, 1 }, { -1, 1, 1 }, { 1, 1, -1 }, { 1, 1, -1 }, { -1, 1, 1 }, { -1, 1, -1 } },
+      { 0, 1, 0 },
+      { 1, 0, 1, 1 } },
+    { { { 1, -1, 1 }, { 1, -1, -1 }, { -1, -1, 1 }, { -1, -1, 1 }, { 1, -1, -1 }, { -1, -1, -1 } },
+      { 0, -1, 0 },
+      { 0, 1, 1, 1 } },
+};
+
+Mesh mesh_cube() {
+    uint32_t    count    = sizeof(CUBE_FACES) / sizeof(CUBE_FACES[0]) * 6;
+    MeshVertex* vertices = malloc(sizeof(MeshVertex) * count);
+    for (uint32_t i = 0; i < count; i++) {
+        MeshVertex* vertex = &vertices[i];
+        vertex->position   = CUBE_FACES[i / 6].corners[i % 6];
+        vertex->normal     = CUBE_FACES[i / 6].normal;
+        memcpy(vertex->color, CUBE_FACES[i / 6].color, sizeof(vertex->color));
+    }
+    Mesh mesh = mesh_weld(vertices, count);
+    free(vertices);
+    return mesh;
+}
+
+static MeshVertex sphere_vertex(uint32_t segment, uint32_t ring, uint32_t segments, uint32_t rings, float radius) {
+    float theta = (float) M_PI * (float) ring / (float) rings;
+    float phi   = 2.0f * (float) M_PI * (float) (segment % segments) / (float) segments;
+    // sinf(M_PI) isn't exactly zero, which would keep the south pole's vertices from welding.
+    float s = ring == 0 || ring == rings ? 0.0f : sinf(theta);
+    Vec3  n = { s * cosf(phi), cosf(theta), s * sinf(phi) };
+    return (MeshVertex){
+        .position = { n.x * radius, n.y * radius, n.z * radius },
+        .normal   = n,
+        .color    = { n.x * 0.5f + 0.5f, n.y * 0.5f + 0.5f, n.z * 0.5f + 0.5f, 1.0f },
+    };
+}
+
+// A UV sphere with smooth normals, colored by its normals. The triangles that would be degenerate
+// at the poles are left out.
+Mesh mesh_sphere(uint32_t segments, uint32_t rings, float radius) {
+    uint32_t    count    = segments * (2 * rings - 2) * 3;
+    MeshVertex* vertices = malloc(sizeof(MeshVertex) * count);
+
+    MeshVertex* out = vertices;
+    for (uint32_t ring = 0; ring < rings; ring++) {
+        for (uint32_t segment = 0; segment < segments; segment++) {
+            MeshVertex a = sphere_vertex(segment, ring, segments, rings, radius);
+            MeshVertex b = sphere_vertex(segment + 1, ring, segments, rings, radius);
+            MeshVertex c = sphere_vertex(segment, ring + 1, segments, rings, radius);
+            MeshVertex d = sphere_vertex(segment + 1, ring + 1, segments, rings, radius);
+            if (ring > 0) {
+                *out++ = a;
+                *out++ = c;
+                *out++ = b;
+            }
+            if (ring < rings - 1) {
+                *out++ = b;
+                *out++ = c;
+                *out++ = d;
+            }
+        }
+    }
+    Mesh mesh = mesh_weld(vertices, count);
+    free(vertices);
+    return mesh;
+}
+
+// The vertex's bytes with negative zero made positive, so vertices that compare equal as floats
+// weld. The sphere's pole vertices differ only in the sign of their zeros.
+typedef struct {
+    uint32_t words[sizeof(MeshVertex) / sizeof(uint32_t)];
+} VertexKey;
+
+static VertexKey vertex_key(const MeshVertex* vertex) {
+    VertexKey key;
+    memcpy(key.words, vertex, sizeof(key.words));
+    for (uint32_t i = 0; i < sizeof(key.words) / sizeof(key.words[0]); i++) {
+        if ((key.words[i] & 0x7fffffffu) == 0) {
+            key.words[i] = 0;
+        }
+    }
+    return key;
+}
+
+static uint64_t vertex_key_hash(const VertexKey* key) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (uint32_t i = 0; i < sizeof(key->words) / sizeof(key->words[0]); i++) {
+        h = (h ^ key->words[i]) * 0x100000001b3ull;
+    }
+    return h ^ (h >> 32);
+}
+
+#define WELD_EMPTY UINT32_MAX
+
+// Builds an indexed mesh from a triangle list, keeping the first copy of each distinct vertex in
+// the order it is first referenced. Unique vertices are found with an open-addressing table of
+// vertex indices, sized to at most half full so probes stay short.
+Mesh mesh_weld(const MeshVertex* vertices, uint32_t count) {
+    uint32_t capacity = 16;
+    while (capacity < 2 * count) {
+        capacity *= 2;
+    }
+    uint32_t* slots = malloc(sizeof(uint32_t) * capacity);
+    memset(slots, 0xff, sizeof(uint32_t) * capacity);
+
+    Mesh mesh = {
+        .vertices    = malloc(sizeof(MeshVertex) * (count ? count : 1)),
+        .indices     = malloc(sizeof(uint32_t) * (count ? count : 1)),
+        .index_count = count,
+    };
+    for (uint32_t i = 0; i < count; i++) {
+        VertexKey key  = vertex_key(&vertices[i]);
+        uint32_t  slot = (uint32_t) vertex_key_hash(&key) & (capacity - 1);
+        for (; slots[slot] != WELD_EMPTY; slot = (slot + 1) & (capacity - 1)) {
+            VertexKey existing = vertex_key(&mesh.vertices[slots[slot]]);
+            if (!memcmp(&existing, &key, sizeof(key))) {
+                break;
+            }
+        }
+        if (slots[slot] == WELD_EMPTY) {
+            slots[slot]                        = mesh.vertex_count;
+            mesh.vertices[mesh.vertex_count++] = vertices[i];
+        }
+        mesh.indices[i] = slots[slot];
+    }
+    free(slots);
+
+    mesh.vertices = realloc(mesh.vertices, sizeof(MeshVertex) * (mesh.vertex_count ? mesh.vertex_count : 1));
+    return mesh;
+}
+
+void mesh_destroy(Mesh* mesh) {
+    free(mesh->vertices);
+    free(mesh->indices);
+    *mesh = (Mesh){};
+}
+
+// 16-bit indices halve index fetch and memory when every vertex is addressable with them.
+// Primitive restart is never enabled, so 0xffff is a valid index.
+VkIndexType mesh_index_type(const Mesh* mesh) {
+    return mesh->vertex_count <= UINT16_MAX + 1u ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+uint32_t index_type_size(VkIndexType type) {
+    return type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void mesh_encode_indices(const Mesh* mesh, VkIndexType type, void* out) {
+    if (type == VK_INDEX_TYPE_UINT32) {
+        memcpy(out, mesh->indices, sizeof(uint32_t) * mesh->index_count);
+        return;
+    }
+    uint16_t* indices = out;
+    for (uint32_t i = 0; i < mesh->index_count; i++) {
+        indices[i] = (uint16_t) mesh->indices[i];
+    }
+}
+
+typedef struct {
+    uint32_t color;
+    uint32_t normal;
+    uint32_t stride;
+} VertexOffsets;
+
+static VertexOffsets vertex_format_offsets(VertexFormat format) {
+    static const uint32_t position_sizes[] = { [VERTEX_POSITION_FLOAT3] = 12, [VERTEX_POSITION_SNORM16] = 8 };
+    static const uint32_t color_sizes[]    = { [VERTEX_COLOR_FLOAT4] = 16, [VERTEX_COLOR_UNORM8] = 4 };
+    static const uint32_t normal_sizes[]   = {
+        [VERTEX_NORMAL_NONE]   = 0,
+        [VERTEX_NORMAL_FLOAT3] = 12,
+        [VERTEX_NORMAL_OCT16]  = 4,
+    };
+
+    VertexOffsets offsets;
+    offsets.color  = position_sizes[format.position];
+    offsets.normal = offsets.color + color_sizes[format.color];
+    offsets.stride = offsets.normal + normal_sizes[format.normal];
+    return offsets;
+}
+
+uint32_t vertex_format_stride(VertexFormat format) {
+    return vertex_format_offsets(format).stride;
+}
+
+// Snorm16 positions use four components because three-component 16-bit formats are rarely
+// supported for vertex buffers. The fourth holds 1.0 and pads the position to 8 bytes.
+VertexLayout vertex_format_layout(VertexFormat format) {
+    static const VkFormat position_formats[] = {
+        [VERTEX_POSITION_FLOAT3]  = VK_FORMAT_R32G32B32_SFLOAT,
+        [VERTEX_POSITION_SNORM16] = VK_FORMAT_R16G16B16A16_SNORM,
+    };
+    static const VkFormat color_formats[] = {
+        [VERTEX_COLOR_FLOAT4] = VK_FORMAT_R32G32B32A32_SFLOAT,
+        [VERTEX_COLOR_UNORM8] = VK_FORMAT_R8G8B8A8_UNORM,
+    };
+    static const VkFormat normal_formats[] = {
+        [VERTEX_NORMAL_NONE]   = VK_FORMAT_R16G16_SNORM,
+        [VERTEX_NORMAL_FLOAT3] = VK_FORMAT_R32G32B32_SFLOAT,
+        [VERTEX_NORMAL_OCT16]  = VK_FORMAT_R16G16_SNORM,
+    };
+
+    // The vertex shader always declares the normal input. Without normals it reads the start of
+    // the vertex instead, which costs no bandwidth, and ignores the value.
+    VertexOffsets offsets = vertex_format_offsets(format);
+    return (VertexLayout){
+        .stride          = offsets.stride,
+        .attribute_count = 3,
+        .attributes      = {
+            { .location = 0, .binding = 0, .format = position_formats[format.position], .offset = 0 },
+            { .location = 1, .binding = 0, .format = color_formats[format.color], .offset = offsets.color },
+            {
+                .location = 2,
+                .binding  = 0,
+                .format   = normal_formats[format.normal],
+                .offset   = format.normal == VERTEX_NORMAL_NONE ? 0 : offsets.normal,
+            },
+        },
+    };
+}
+
+MeshBounds mesh_bounds(const MeshVertex* vertices, uint32_t count) {
+    if (!count) {
+        return (MeshBounds){};
+    }
+    MeshBounds bounds = { vertices[0].position, vertices[0].position };
+    for (uint32_t i = 1; i < count; i++) {
+        Vec3 p     = vertices[i].position;
+        bounds.min = (Vec3){ fminf(bounds.min.x, p.x), fminf(bounds.min.y, p.y), fminf(bounds.min.z, p.z) };
+        bounds.max = (Vec3){ fmaxf(bounds.max.x, p.x), fmaxf(bounds.max.y, p.y), fmaxf(bounds.max.z, p.z) };
+    }
+    return bounds;
+}
+
+// Floats aren't quantized and get the identity mapping.
+VertexQuantization vertex_quantization_compute(const MeshVertex* vertices, uint32_t count, VertexFormat format) {
+    VertexQuantization quantization = { .scale = 1.0f };
+    if (format.position != VERTEX_POSITION_SNORM16 || !count) {
+        return quantization;
+    }
+
+    MeshBounds bounds = mesh_bounds(vertices, count);
+    Vec3       min    = bounds.min;
+    Vec3       max    = bounds.max;
+
+    quantization.offset = (Vec3){ (min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f };
+    quantization.scale  = fmaxf(fmaxf(max.x - min.x, max.y - min.y), max.z - min.z) * 0.5f;
+    if (quantization.scale == 0.0f) {
+        quantization.scale = 1.0f;
+    }
+    return quantization;
+}
+
+// Dequantization as a model matrix. Folding it into the MVP leaves the vertex shader no extra work.
+Mat4 vertex_quantization_matrix(const VertexQuantization* quantization) {
+    float s = quantization->scale;
+    Vec3  o = quantization->offset;
+    return (Mat4){
+        s, 0, 0, 0, 0, s, 0, 0, 0, 0, s, 0, o.x, o.y, o.z, 1,
+    };
+}
+
+// Loaded meshes come in any unit and placement; this centers the bounds and scales the largest
+// half-extent to `radius` so they fill the view like the built-in meshes.
+Mat4 mesh_fit_matrix(const MeshBounds* bounds, float radius) {
+    Vec3  size   = vec3_sub(bounds->max, bounds->min);
+    float extent = fmaxf(fmaxf(size.x, size.y), size.z) * 0.5f;
+    float s      = extent > 0.0f ? radius / extent : 1.0f;
+    Vec3  o      = { (bounds->min.x + bounds->max.x) * 0.5f, (bounds->min.y + bounds->max.y) * 0.5f,
+                     (bounds->min.z + bounds->max.z) * 0.5f };
+    return (Mat4){
+        s, 0, 0, 0, 0, s, 0, 0, 0, 0, s, 0, -o.x * s, -o.y * s, -o.z * s, 1,
+    };
+}
+
+static int16_t encode_snorm16(float v) {
+    v = fminf(fmaxf(v, -1.0f), 1.0f);
+    return (int16_t) roundf(v * 32767.0f);
+}
+
+static uint8_t encode_unorm8(float v) {
+    v = fminf(fmaxf(v, 0.0f), 1.0f);
+    return (uint8_t) roundf(v * 255.0f);
+}
+
+// Projects the unit normal onto an octahedron and unfolds the lower half over the upper one.
+// basic.vert inverts this.
+static void encode_oct16(Vec3 n, int16_t out[2]) {
+    float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    float x  = n.x / l1;
+    float y  = n.y / l1;
+    if (n.z < 0.0f) {
+        float folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x              = folded_x;
+        y              = folded_y;
+    }
+    out[0] = encode_snorm16(x);
+    out[1] = encode_snorm16(y);
+}
+
+void mesh_encode_vertices(const MeshVertex* vertices, uint32_t count, VertexFormat format,
+                          const VertexQuantization* quantization, void* out) {
+    VertexOffsets offsets = vertex_format_offsets(format);
+    float         inv     = 1.0f / quantization->scale;
+    Vec3          o       = quantization->offset;
+    for (uint32_t i = 0; i < count; i++) {
+        const MeshVertex* v    = &vertices[i];
+        char*             dest = (char*) out + (size_t) i * offsets.stride;
+
+        if (format.position == VERTEX_POSITION_SNORM16) {
+            int16_t position[4] = {
+                encode_snorm16((v->position.x - o.x) * inv),
+                encode_snorm16((v->position.y - o.y) * inv),
+                encode_snorm16((v->position.z - o.z) * inv),
+                INT16_MAX,
+            };
+            memcpy(dest, position, sizeof(position));
+        } else {
+            memcpy(dest, &v->position, sizeof(v->position));
+        }
+
+        if (format.color == VERTEX_COLOR_UNORM8) {
+            uint8_t color[4];
+            for (int c = 0; c < 4; c++) {
+                color[c] = encode_unorm8(v->color[c]);
+            }
+            memcpy(dest + offsets.color, color, sizeof(color));
+        } else {
+            memcpy(dest + offsets.color, v->color, sizeof(v->color));
+        }
+
+        if (format.normal == VERTEX_NORMAL_OCT16) {
+            int16_t normal[2];
+            encode_oct16(v->normal, normal);
+            memcpy(dest + offsets.normal, normal, sizeof(normal));
+        } else if (format.normal == VERTEX_NORMAL_FLOAT3) {
+            memcpy(dest + offsets.normal, &v->normal, sizeof(v->normal));
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef mesh_h
+#define mesh_h
+#include <stddef.h>
+#include <stdint.h>
+#include "linalg.h"
+#include "pipeline.h"
+
+// Full-precision vertices as meshes are generated or loaded. They are encoded into one of the
+// VertexFormats below before upload.
+typedef struct {
+    Vec3  position;
+    Vec3  normal;
+    float color[4];
+} MeshVertex;
+
+// An indexed triangle list, three indices per triangle, wound clockwise seen from outside.
+typedef struct {
+    MeshVertex* vertices;
+    uint32_t    vertex_count;
+    uint32_t*   indices;
+    uint32_t    index_count;
+} Mesh;
+
+typedef enum {
+    VERTEX_POSITION_FLOAT3,
+    VERTEX_POSITION_SNORM16, // Quantized to the mesh bounds, see VertexQuantization.
+} VertexPositionFormat;
+
+typedef enum {
+    VERTEX_COLOR_FLOAT4,
+    VERTEX_COLOR_UNORM8,
+} VertexColorFormat;
+
+typedef enum {
+    VERTEX_NORMAL_NONE,
+    VERTEX_NORMAL_FLOAT3,
+    VERTEX_NORMAL_OCT16, // Octahedral encoding in two snorm16 components.
+} VertexNormalFormat;
+
+// Attributes are interleaved in one binding: position at location 0, color at 1, normal at 2.
+typedef struct {
+    VertexPositionFormat position;
+    VertexColorFormat    color;
+    VertexNormalFormat   normal;
+} VertexFormat;
+
+typedef struct {
+    Vec3 min;
+    Vec3 max;
+} MeshBounds;
+
+// Maps quantized positions in [-1, 1] back to object space: position = offset + scale * encoded.
+// The scale is uniform so that derivative normals computed from quantized positions stay correct.
+typedef struct {
+    float scale;
+    Vec3  offset;
+} VertexQuantization;
+
+Mesh mesh_cube();
+Mesh mesh_sphere(uint32_t segments, uint32_t rings, float radius);
+Mesh mesh_weld(const MeshVertex* vertices, uint32_t count);
+void mesh_destroy(Mesh* mesh);
+MeshBounds mesh_bounds(const MeshVertex* vertices, uint32_t count);
+Mat4       mesh_fit_matrix(const MeshBounds* bounds, float radius);
+
+VkIndexType mesh_index_type(const Mesh* mesh);
+uint32_t    index_type_size(VkIndexType type);
+void        mesh_encode_indices(const Mesh* mesh, VkIndexType type, void* out);
+
+uint32_t           vertex_format_stride(VertexFormat format);
+VertexLayout       vertex_format_layout(VertexFormat format);
+VertexQuantization vertex_quantization_compute(const MeshVertex* vertices, uint32_t count, VertexFormat format);
+Mat4               vertex_quantization_matrix(const VertexQuantization* quantization);
+void               mesh_encode_vertices(const MeshVertex* vertices, uint32_t count, VertexFormat format,
+                                        const VertexQuantization* quantization, void* out);
+
+#endif
@@ -0,0 +1,206 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mesh_cache.h"
+
+uint64_t mesh_cache_hash(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+int mesh_cache_is_path(const char* path) {
+    size_t length = strlen(path);
+    size_t suffix = strlen(MESH_CACHE_EXTENSION);
+    return length >= suffix && !strcmp(path + length - suffix, MESH_CACHE_EXTENSION);
+}
+
+static uint64_t align_section(uint64_t offset) {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+}
+
+// Lays the sections out one after another, each on its own page.
+static MeshCacheSection next_section(uint64_t* end, uint64_t size) {
+    MeshCacheSection section = { .offset = align_section(*end), .size = size };
+    *end                     = section.offset + size;
+    return section;
+}
+
+int mesh_cache_write(const char* path, const MeshCacheDesc* desc, JobSystem* jobs) {
+    const Mesh*     mesh       = desc->mesh;
+    VkIndexType     index_type = mesh_index_type(mesh);
+    MeshCacheHeader header     = {
+        .magic           = MESH_CACHE_MAGIC,
+        .version         = MESH_CACHE_VERSION,
+        .content_hash    = desc->content_hash,
+        .vertex_position = desc->vertex_format.position,
+        .vertex_color    = desc->vertex_format.color,
+        .vertex_normal   = desc->vertex_format.normal,
+        .index_type      = index_type,
+        .vertex_count    = mesh->vertex_count,
+        .index_count     = mesh->index_count,
+        .lod_count       = desc->lod_count,
+        .meshlet_count   = desc->meshlet_count,
+        .bounds          = mesh_bounds(mesh->vertices, mesh->vertex_count),
+        .quantization    = vertex_quantization_compute(mesh->vertices, mesh->vertex_count, desc->vertex_format),
+        .cache_stats     = desc->cache_stats,
+    };
+    uint64_t vertex_size = (uint64_t) vertex_format_stride(desc->vertex_format) * mesh->vertex_count;
+    uint64_t end         = sizeof(header);
+    header.vertices      = next_section(&end, vertex_size);
+    header.indices       = next_section(&end, (uint64_t) index_type_size(index_type) * mesh->index_count);
+    header.lods          = next_section(&end, sizeof(MeshLod) * desc->lod_count);
+    header.meshlets      = next_section(&end, sizeof(Meshlet) * desc->meshlet_count);
+
+    // The whole file is assembled in memory so the payloads go out in a few large writes.
+    uint8_t* data = calloc(1, end);
+    memcpy(data, &header, sizeof(header));
+    mesh_encode_parallel(jobs, mesh, desc->vertex_format, &header.quantization, data + header.vertices.offset,
+                         index_type, data + header.indices.offset);
+    memcpy(data + header.lods.offset, desc->lods, header.lods.size);
+    memcpy(data + header.meshlets.offset, desc->meshlets, header.meshlets.size);
+
+    char temp_path[4096];
+    snprintf(temp_path, sizeof(temp_path), "%s.%d.tmp", path, (int) getpid());
+    FILE* file = fopen(temp_path, "wb");
+    int   ok   = file != NULL;
+    if (ok) {
+        ok = fwrite(data, 1, end, file) == end;
+        ok = fflush(file) == 0 && ok;
+        ok = fsync(fileno(file)) == 0 && ok;
+        ok = fclose(file) == 0 && ok;
+    }
+    ok = ok && rename(temp_path, path) == 0;
+    free(data);
+
+    if (!ok) {
+        fprintf(stderr, "Could not write mesh cache '%s': %s\n", path, strerror(errno));
+        unlink(temp_path);
+        return 0;
+    }
+    return 1;
+}
+
+static int section_valid(const MeshCacheSection* section, uint64_t expected_size, size_t file_size) {
+    return section->size == expected_size && section->offset % MESH_CACHE_ALIGNMENT == 0
+        && section->offset <= file_size && section->size <= file_size - section->offset;
+}
+
+int mesh_cache_open(const char* path, MeshCache* cache) {
+    *cache = (MeshCache){};
+
+    MappedFile file;
+    if (!map_file(path, &file)) {
+        fprintf(stderr, "Could not open mesh cache '%s': could not map file\n", path);
+        return 0;
+    }
+
+    // Mappings are page-aligned, so the header and every table can be used in place.
+    const MeshCacheHeader* header = (const void*) file.data;
+    const char*            reason = NULL;
+    if (file.size < sizeof(MeshCacheHeader) || header->magic != MESH_CACHE_MAGIC) {
+        reason = "not a mesh cache";
+    } else if (header->version != MESH_CACHE_VERSION) {
+        reason = "cache format version changed, cook it again";
+    } else if (header->vertex_position > VERTEX_POSITION_SNORM16 || header->vertex_color > VERTEX_COLOR_UNORM8
+               || header->vertex_normal > VERTEX_NORMAL_OCT16
+               || (header->index_type != VK_INDEX_TYPE_UINT16 && header->index_type != VK_INDEX_TYPE_UINT32)) {
+        reason = "unknown vertex or index format";
+    } else {
+        VertexFormat format = {
+            .position = header->vertex_position,
+            .color    = header->vertex_color,
+            .normal   = header->vertex_normal,
+        };
+        uint64_t vertex_size = (uint64_t) vertex_format_stride(format) * header->vertex_count;
+        uint64_t index_size  = (uint64_t) index_type_size(header->index_type) * header->index_count;
+        if (!section_valid(&header->vertices, vertex_size, file.size)
+            || !section_valid(&header->indices, index_size, file.size)
+            || !section_valid(&header->lods, sizeof(MeshLod) * header->lod_count, file.size)
+            || !section_valid(&header->meshlets, sizeof(Meshlet) * header->meshlet_count, file.size)) {
+            reason = "truncated or corrupt section table";
+        } else {
+            *cache = (MeshCache){
+                .file          = file,
+                .header        = header,
+                .vertex_format = format,
+                .vertices      = file.data + header->vertices.offset,
+                .indices       = file.data + header->indices.offset,
+                .lods          = (const void*) (file.data + header->lods.offset),
+                .meshlets      = (const void*) (file.data + header->meshlets.offset),
+            };
+        }
+    }
+    if (!reason && (header->lod_count < 1 || header->lod_count > MESH_LOD_MAX)) {
+        reason = "LOD count out of range";
+    }
+    if (!reason && (header->vertex_count == 0 || header->index_count % 3)) {
+        reason = "not a triangle list";
+    }
+    for (uint32_t i = 0; !reason && i < header->lod_count; i++) {
+        const MeshLod* lod = &cache->lods[i];
+        if (lod->index_offset > header->index_count || lod->index_count > header->index_count - lod->index_offset
+            || lod->index_offset % 3 || lod->index_count % 3 || lod->meshlet_offset > header->meshlet_count
+            || lod->meshlet_count > header->meshlet_count - lod->meshlet_offset) {
+            reason = "LOD out of range";
+        }
+    }
+    for (uint32_t i = 0; !reason && i < header->meshlet_count; i++) {
+        const Meshlet* meshlet = &cache->meshlets[i];
+        if (meshlet->index_offset > header->index_count
+            || meshlet->index_count > header->index_count - meshlet->index_offset || meshlet->index_offset % 3
+            || meshlet->index_count % 3) {
+            reason = "meshlet out of range";
+        }
+    }
+
+    if (reason) {
+        fprintf(stderr, "Could not open mesh cache '%s': %s\n", path, reason);
+        unmap_file(&file);
+        *cache = (MeshCache){};
+        return 0;
+    }
+    return 1;
+}
+
+// Copies the indices and returns the largest, so checking them costs no extra pass over the payload.
+static uint32_t copy_indices(const MeshCache* cache, void* out) {
+    uint32_t count   = cache->header->index_count;
+    uint32_t largest = 0;
+    if (cache->header->index_type == VK_INDEX_TYPE_UINT16) {
+        const uint16_t* in  = cache->indices;
+        uint16_t*       dst = out;
+        for (uint32_t i = 0; i < count; i++) {
+            dst[i]  = in[i];
+            largest = in[i] > largest ? in[i] : largest;
+        }
+    } else {
+        const uint32_t* in  = cache->indices;
+        uint32_t*       dst = out;
+        for (uint32_t i = 0; i < count; i++) {
+            dst[i]  = in[i];
+            largest = in[i] > largest ? in[i] : largest;
+        }
+    }
+    return largest;
+}
+
+int mesh_cache_copy(const MeshCache* cache, void* vertices, void* indices) {
+    memcpy(vertices, cache->vertices, cache->header->vertices.size);
+    if (cache->header->index_count && copy_indices(cache, indices) >= cache->header->vertex_count) {
+        fprintf(stderr, "Mesh cache has indices past its %u vertices, dropping its triangles\n",
+                cache->header->vertex_count);
+        memset(indices, 0, cache->header->indices.size);
+        return 0;
+    }
+    return 1;
+}
+
+void mesh_cache_close(MeshCache* cache) {
+    unmap_file(&cache->file);
+    *cache = (MeshCache){};
+}
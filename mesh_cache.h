@@ -0,0 +1,88 @@
+#ifndef mesh_cache_h
+#define mesh_cache_h
+#include "job.h"
+#include "mesh.h"
+#include "mesh_load.h"
+#include "mesh_lod.h"
+#include "mesh_meshlet.h"
+#include "mesh_optimize.h"
+
+#define MESH_CACHE_MAGIC     0x4853454du // "MESH"
+#define MESH_CACHE_VERSION   2
+#define MESH_CACHE_ALIGNMENT 4096
+#define MESH_CACHE_EXTENSION ".mesh"
+
+// Byte range of a payload in the file. Payloads start on page boundaries so each can be mapped,
+// read or copied on its own.
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+} MeshCacheSection;
+
+// Everything a renderer needs to upload the mesh without touching its source. Payloads are already
+// in the GPU vertex and index formats, so loading is a copy into mapped memory. Fields are
+// fixed-size and little-endian.
+typedef struct {
+    uint32_t           magic;
+    uint32_t           version;
+    uint64_t           content_hash; // Of the source and the settings it was cooked with.
+    uint32_t           vertex_position;
+    uint32_t           vertex_color;
+    uint32_t           vertex_normal;
+    uint32_t           index_type;
+    uint32_t           vertex_count;
+    uint32_t           index_count; // Every LOD's indices.
+    uint32_t           lod_count;
+    uint32_t           meshlet_count;
+    MeshBounds         bounds;
+    VertexQuantization quantization;
+    VertexCacheStats   cache_stats; // Of the full-detail LOD as cooked.
+    MeshCacheSection   vertices;
+    MeshCacheSection   indices;
+    MeshCacheSection   lods;
+    MeshCacheSection   meshlets;
+} MeshCacheHeader;
+
+typedef struct {
+    MappedFile             file;
+    const MeshCacheHeader* header;
+    VertexFormat           vertex_format;
+    const void*            vertices;
+    const void*            indices;
+    const MeshLod*         lods;
+    const Meshlet*         meshlets;
+} MeshCache;
+
+// What the cooker writes. The mesh's indices hold every LOD back to back, as the table describes.
+typedef struct {
+    const Mesh*      mesh;
+    VertexFormat     vertex_format;
+    uint64_t         content_hash;
+    VertexCacheStats cache_stats;
+    const MeshLod*   lods;
+    uint32_t         lod_count;
+    const Meshlet*   meshlets;
+    uint32_t         meshlet_count;
+} MeshCacheDesc;
+
+// FNV-1a, chained by passing the previous result as `hash`. Start from MESH_CACHE_HASH_SEED.
+#define MESH_CACHE_HASH_SEED 0xcbf29ce484222325ull
+uint64_t mesh_cache_hash(uint64_t hash, const void* data, size_t size);
+
+int mesh_cache_is_path(const char* path);
+
+// Encodes the payloads on `jobs` and writes them through a temporary file, renamed into place.
+int mesh_cache_write(const char* path, const MeshCacheDesc* desc, JobSystem* jobs);
+
+// Maps the file and checks that its sections fit in it and that the LOD and meshlet tables are
+// triangle ranges within the indices. The payloads aren't read, so they're left to be paged in by
+// mesh_cache_copy. Returns 0 and prints why on failure.
+int  mesh_cache_open(const char* path, MeshCache* cache);
+void mesh_cache_close(MeshCache* cache);
+
+// Copies the payloads into buffer memory, checking every index against the vertex count on the way,
+// since an index past the vertices is an out of bounds GPU read. If one is, the indices are zeroed,
+// so every triangle is degenerate, and it returns 0 after printing why.
+int mesh_cache_copy(const MeshCache* cache, void* vertices, void* indices);
+
+#endif
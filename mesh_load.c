@@ -0,0 +1,968 @@
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bench.h"
+#include "json.h"
+#include "mesh_load.h"
+
+// Text is split into pieces of about this size, so every worker gets several.
+#define OBJ_CHUNK_BYTES (1u << 20)
+// Vertices or triangles converted per job when loading glTF and encoding.
+#define RANGE_SIZE (1u << 16)
+
+static const float DEFAULT_COLOR[4] = { 0.8f, 0.8f, 0.8f, 1.0f };
+
+// Pages are read on first touch by whichever worker parses them, so the read itself is spread
+// across threads too.
+int map_file(const char* path, MappedFile* file) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+    madvise(data, st.st_size, MADV_WILLNEED);
+    *file = (MappedFile){ .data = data, .size = st.st_size };
+    return 1;
+}
+
+void unmap_file(MappedFile* file) {
+    if (file->data) {
+        munmap((void*) file->data, file->size);
+    }
+    *file = (MappedFile){};
+}
+
+typedef void (*RangeFunction)(void* data, uint32_t index);
+
+typedef struct {
+    Job           job;
+    RangeFunction function;
+    void*         data;
+    uint32_t      index;
+} RangeJob;
+
+static void run_range_job(void* data) {
+    RangeJob* range = data;
+    range->function(range->data, range->index);
+}
+
+// Runs function(data, i) for every i below `count` on the job system and waits for all of them,
+// helping out meanwhile. Without a job system everything runs on the calling thread.
+static void parallel_for(JobSystem* jobs, uint32_t count, RangeFunction function, void* data) {
+    if (!jobs) {
+        for (uint32_t i = 0; i < count; i++) {
+            function(data, i);
+        }
+        return;
+    }
+    RangeJob* ranges = malloc(sizeof(RangeJob) * (count ? count : 1));
+    for (uint32_t i = 0; i < count; i++) {
+        ranges[i] = (RangeJob){ .function = function, .data = data, .index = i };
+        job_submit(jobs, &ranges[i].job, run_range_job, &ranges[i]);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        job_wait(jobs, &ranges[i].job);
+    }
+    free(ranges);
+}
+
+static void* grow(void* array, uint32_t* capacity, uint32_t count, size_t element_size) {
+    if (count < *capacity) {
+        return array;
+    }
+    *capacity = *capacity ? 2 * *capacity : 1024;
+    return realloc(array, element_size * *capacity);
+}
+
+static Vec3 face_normal(Vec3 a, Vec3 b, Vec3 c) {
+    // Clockwise winding, so this points out of the mesh.
+    Vec3  n      = vec3_cross(vec3_sub(c, a), vec3_sub(b, a));
+    float length = sqrtf(vec3_dot(n, n));
+    return length > 0.0f ? (Vec3){ n.x / length, n.y / length, n.z / length } : (Vec3){ 0.0f, 0.0f, 1.0f };
+}
+
+// Wavefront OBJ
+//
+// Chunks are parsed independently. Faces may use negative indices relative to the vertices read so
+// far, which a chunk can only resolve locally; those are flagged and offset once every chunk's
+// vertex counts are known.
+
+#define OBJ_NO_INDEX INT32_MIN
+
+typedef struct {
+    int32_t position;
+    int32_t normal;
+    uint8_t position_relative;
+    uint8_t normal_relative;
+} ObjCorner;
+
+typedef struct {
+    const char* begin;
+    const char* end;
+    Vec3*       positions;
+    Vec3*       colors;
+    uint32_t    position_count;
+    uint32_t    position_capacity;
+    Vec3*       normals;
+    uint32_t    normal_count;
+    uint32_t    normal_capacity;
+    ObjCorner*  corners;
+    uint32_t    corner_count;
+    uint32_t    corner_capacity;
+    uint32_t*   face_sizes;
+    uint32_t    face_count;
+    uint32_t    face_capacity;
+    uint32_t    triangle_count;
+    uint32_t    position_base; // Totals of the chunks before this one.
+    uint32_t    normal_base;
+    uint32_t    triangle_base;
+    int         error;
+} ObjChunk;
+
+typedef struct {
+    ObjChunk*   chunks;
+    uint32_t    chunk_count;
+    Vec3*       positions;
+    Vec3*       colors;
+    uint32_t    position_count;
+    Vec3*       normals;
+    uint32_t    normal_count;
+    MeshVertex* triangles;
+} ObjLoad;
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// strtof is locale dependent and slow enough to dominate loading.
+static const char* parse_float(const char* p, const char* end, float* out) {
+    while (p < end && is_space(*p)) {
+        p++;
+    }
+    int negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+    const char* digits   = p;
+    uint64_t    mantissa = 0;
+    int         exponent = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        if (mantissa < 1000000000000000000ull) {
+            mantissa = mantissa * 10 + (*p - '0');
+        } else {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (mantissa < 1000000000000000000ull) {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if (p == digits) {
+        return NULL;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        int exponent_negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) {
+            p++;
+        }
+        int value = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            value = value < 10000 ? value * 10 + (*p - '0') : value;
+        }
+        exponent += exponent_negative ? -value : value;
+    }
+    double value = (double) mantissa * pow(10.0, exponent);
+    *out         = (float) (negative ? -value : value);
+    return p;
+}
+
+static const char* parse_int(const char* p, const char* end, int32_t* out) {
+    int negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+    const char* digits = p;
+    int64_t     value  = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        value = value < INT32_MAX ? value * 10 + (*p - '0') : value;
+    }
+    if (p == digits || value > INT32_MAX) {
+        return NULL;
+    }
+    *out = (int32_t) (negative ? -value : value);
+    return p;
+}
+
+// OBJ indices are 1-based, or negative to count back from the last vertex read.
+static int resolve_local(int32_t index, uint32_t count, int32_t* out, uint8_t* relative) {
+    if (index > 0) {
+        *out      = index - 1;
+        *relative = 0;
+        return 1;
+    }
+    if (index < 0) {
+        *out      = (int32_t) count + index;
+        *relative = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static int parse_face(ObjChunk* chunk, const char* p, const char* end) {
+    uint32_t size = 0;
+    for (;;) {
+        while (p < end && is_space(*p)) {
+            p++;
+        }
+        if (p == end) {
+            break;
+        }
+        int32_t   position;
+        int32_t   unused;
+        int32_t   normal = 0;
+        ObjCorner corner = { .normal = OBJ_NO_INDEX };
+        if (!(p = parse_int(p, end, &position))) {
+            return 0;
+        }
+        if (p < end && *p == '/') {
+            p++;
+            if (p < end && *p != '/' && !(p = parse_int(p, end, &unused))) {
+                return 0;
+            }
+            if (p < end && *p == '/') {
+                if (!(p = parse_int(p + 1, end, &normal))) {
+                    return 0;
+                }
+            }
+        }
+        if (!resolve_local(position, chunk->position_count, &corner.position, &corner.position_relative)) {
+            return 0;
+        }
+        if (normal && !resolve_local(normal, chunk->normal_count, &corner.normal, &corner.normal_relative)) {
+            return 0;
+        }
+        chunk->corners = grow(chunk->corners, &chunk->corner_capacity, chunk->corner_count, sizeof(ObjCorner));
+        chunk->corners[chunk->corner_count++] = corner;
+        size++;
+    }
+    if (size < 3) {
+        return 0;
+    }
+    chunk->face_sizes = grow(chunk->face_sizes, &chunk->face_capacity, chunk->face_count, sizeof(uint32_t));
+    chunk->face_sizes[chunk->face_count++] = size;
+    chunk->triangle_count += size - 2;
+    return 1;
+}
+
+// Positions may carry a color, "v x y z r g b", as many exporters write.
+static void parse_obj_chunk(void* data, uint32_t index) {
+    ObjChunk* chunk = &((ObjLoad*) data)->chunks[index];
+    for (const char* line = chunk->begin; line < chunk->end && !chunk->error;) {
+        const char* end  = memchr(line, '\n', chunk->end - line);
+        const char* next = end ? end + 1 : chunk->end;
+        end              = end ? end : chunk->end;
+
+        size_t length = end - line;
+        if (length > 2 && line[0] == 'v' && is_space(line[1])) {
+            Vec3        p;
+            Vec3        color = { DEFAULT_COLOR[0], DEFAULT_COLOR[1], DEFAULT_COLOR[2] };
+            const char* at    = line + 2;
+            if (!(at = parse_float(at, end, &p.x)) || !(at = parse_float(at, end, &p.y))
+                || !(at = parse_float(at, end, &p.z))) {
+                chunk->error = 1;
+                break;
+            }
+            Vec3        rgb;
+            const char* c = parse_float(at, end, &rgb.x);
+            if (c && (c = parse_float(c, end, &rgb.y)) && (c = parse_float(c, end, &rgb.z))) {
+                color = rgb;
+            }
+            uint32_t capacity = chunk->position_capacity;
+            chunk->positions  = grow(chunk->positions, &chunk->position_capacity, chunk->position_count, sizeof(Vec3));
+            chunk->colors     = grow(chunk->colors, &capacity, chunk->position_count, sizeof(Vec3));
+            chunk->positions[chunk->position_count] = p;
+            chunk->colors[chunk->position_count++]  = color;
+        } else if (length > 3 && line[0] == 'v' && line[1] == 'n' && is_space(line[2])) {
+            Vec3        n;
+            const char* at = line + 3;
+            if (!(at = parse_float(at, end, &n.x)) || !(at = parse_float(at, end, &n.y))
+                || !parse_float(at, end, &n.z)) {
+                chunk->error = 1;
+                break;
+            }
+            chunk->normals = grow(chunk->normals, &chunk->normal_capacity, chunk->normal_count, sizeof(Vec3));
+            chunk->normals[chunk->normal_count++] = n;
+        } else if (length > 2 && line[0] == 'f' && is_space(line[1])) {
+            chunk->error = !parse_face(chunk, line + 2, end);
+        }
+        line = next;
+    }
+}
+
+static void gather_obj_chunk(void* data, uint32_t index) {
+    ObjLoad*  load  = data;
+    ObjChunk* chunk = &load->chunks[index];
+    memcpy(load->positions + chunk->position_base, chunk->positions, sizeof(Vec3) * chunk->position_count);
+    memcpy(load->colors + chunk->position_base, chunk->colors, sizeof(Vec3) * chunk->position_count);
+    memcpy(load->normals + chunk->normal_base, chunk->normals, sizeof(Vec3) * chunk->normal_count);
+}
+
+static int resolve_global(int32_t index, uint8_t relative, uint32_t base, uint32_t count, uint32_t* out) {
+    int64_t global = relative ? (int64_t) base + index : index;
+    if (global < 0 || global >= count) {
+        return 0;
+    }
+    *out = (uint32_t) global;
+    return 1;
+}
+
+// Fans each polygon into triangles and flips them from OBJ's counter-clockwise winding. Corners
+// without a normal get their triangle's face normal.
+static void triangulate_obj_chunk(void* data, uint32_t index) {
+    ObjLoad*    load   = data;
+    ObjChunk*   chunk  = &load->chunks[index];
+    MeshVertex* out    = load->triangles + 3 * (size_t) chunk->triangle_base;
+    ObjCorner*  corner = chunk->corners;
+    for (uint32_t f = 0; f < chunk->face_count; f++) {
+        uint32_t size = chunk->face_sizes[f];
+        for (uint32_t t = 1; t + 1 < size; t++) {
+            const ObjCorner* corners[3] = { &corner[0], &corner[t + 1], &corner[t] };
+            MeshVertex       vertices[3];
+            int              has_normals = 1;
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t p;
+                uint32_t n;
+                if (!resolve_global(corners[k]->position, corners[k]->position_relative, chunk->position_base,
+                                    load->position_count, &p)) {
+                    chunk->error = 1;
+                    return;
+                }
+                vertices[k].position = load->positions[p];
+                memcpy(vertices[k].color, &load->colors[p], sizeof(Vec3));
+                vertices[k].color[3] = 1.0f;
+                if (corners[k]->normal == OBJ_NO_INDEX) {
+                    has_normals = 0;
+                } else if (!resolve_global(corners[k]->normal, corners[k]->normal_relative, chunk->normal_base,
+                                           load->normal_count, &n)) {
+                    chunk->error = 1;
+                    return;
+                } else {
+                    vertices[k].normal = load->normals[n];
+                }
+            }
+            if (!has_normals) {
+                Vec3 n = face_normal(vertices[0].position, vertices[1].position, vertices[2].position);
+                for (uint32_t k = 0; k < 3; k++) {
+                    vertices[k].normal = n;
+                }
+            }
+            memcpy(out, vertices, sizeof(vertices));
+            out += 3;
+        }
+        corner += size;
+    }
+}
+
+static const char* load_obj(const MappedFile* file, JobSystem* jobs, Mesh* mesh, MeshLoadStats* stats) {
+    uint32_t chunk_count = (uint32_t) ((file->size + OBJ_CHUNK_BYTES - 1) / OBJ_CHUNK_BYTES);
+    ObjLoad  load        = {
+        .chunks      = calloc(chunk_count, sizeof(ObjChunk)),
+        .chunk_count = chunk_count,
+    };
+
+    // Chunks end after a newline so no line is split.
+    const char* begin = file->data;
+    const char* end   = file->data + file->size;
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        const char* chunk_end = i + 1 == chunk_count ? end : file->data + (size_t) (i + 1) * OBJ_CHUNK_BYTES;
+        if (chunk_end < begin) {
+            chunk_end = begin;
+        }
+        const char* newline = chunk_end < end ? memchr(chunk_end, '\n', end - chunk_end) : NULL;
+        chunk_end           = newline ? newline + 1 : end;
+        load.chunks[i]      = (ObjChunk){ .begin = begin, .end = chunk_end };
+        begin               = chunk_end;
+    }
+    parallel_for(jobs, chunk_count, parse_obj_chunk, &load);
+
+    const char* reason         = NULL;
+    uint32_t    triangle_count = 0;
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        ObjChunk* chunk      = &load.chunks[i];
+        chunk->position_base = load.position_count;
+        chunk->normal_base   = load.normal_count;
+        chunk->triangle_base = triangle_count;
+        load.position_count += chunk->position_count;
+        load.normal_count += chunk->normal_count;
+        triangle_count += chunk->triangle_count;
+        if (chunk->error) {
+            reason = "malformed line";
+        }
+    }
+    if (!reason && !triangle_count) {
+        reason = "no faces";
+    }
+    if (!reason) {
+        load.positions = malloc(sizeof(Vec3) * (load.position_count ? load.position_count : 1));
+        load.colors    = malloc(sizeof(Vec3) * (load.position_count ? load.position_count : 1));
+        load.normals   = malloc(sizeof(Vec3) * (load.normal_count ? load.normal_count : 1));
+        load.triangles = malloc(sizeof(MeshVertex) * 3 * (size_t) triangle_count);
+        parallel_for(jobs, chunk_count, gather_obj_chunk, &load);
+        parallel_for(jobs, chunk_count, triangulate_obj_chunk, &load);
+        for (uint32_t i = 0; i < chunk_count; i++) {
+            if (load.chunks[i].error) {
+                reason = "face index out of range";
+            }
+        }
+    }
+    if (!reason) {
+        *mesh = mesh_weld(load.triangles, 3 * triangle_count);
+    }
+
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        free(load.chunks[i].positions);
+        free(load.chunks[i].colors);
+        free(load.chunks[i].normals);
+        free(load.chunks[i].corners);
+        free(load.chunks[i].face_sizes);
+    }
+    free(load.chunks);
+    free(load.positions);
+    free(load.colors);
+    free(load.normals);
+    free(load.triangles);
+    stats->chunks = chunk_count;
+    return reason;
+}
+
+// glTF 2.0
+//
+// Every triangle primitive of every mesh is appended to one mesh, in the meshes' own space; node
+// transforms and scenes aren't applied. Vertices and indices are converted in parallel ranges.
+
+#define GLTF_MAX_BUFFERS 16
+
+enum {
+    GLTF_BYTE           = 5120,
+    GLTF_UNSIGNED_BYTE  = 5121,
+    GLTF_SHORT          = 5122,
+    GLTF_UNSIGNED_SHORT = 5123,
+    GLTF_UNSIGNED_INT   = 5125,
+    GLTF_FLOAT          = 5126,
+};
+
+enum { GLTF_TRIANGLES = 4 };
+
+typedef struct {
+    const uint8_t* data;
+    uint32_t       count;
+    uint32_t       stride;
+    uint32_t       component_type;
+    uint32_t       components;
+} GltfAccessor;
+
+typedef struct {
+    GltfAccessor position;
+    GltfAccessor normal; // Zero count when missing.
+    GltfAccessor color;
+    GltfAccessor indices;
+    uint32_t     vertex_base;
+    uint32_t     index_base;
+    uint32_t     index_count;
+} GltfPrimitive;
+
+typedef struct {
+    GltfPrimitive* primitive;
+    uint32_t       begin;
+    uint32_t       end;
+    int            indices; // Converts triangles begin..end rather than vertices.
+} GltfRange;
+
+typedef struct {
+    GltfRange* ranges;
+    Mesh*      mesh;
+} GltfLoad;
+
+static uint32_t component_size(uint32_t type) {
+    switch (type) {
+    case GLTF_BYTE:
+    case GLTF_UNSIGNED_BYTE:
+        return 1;
+    case GLTF_SHORT:
+    case GLTF_UNSIGNED_SHORT:
+        return 2;
+    case GLTF_UNSIGNED_INT:
+    case GLTF_FLOAT:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static uint32_t type_components(const Json* json, uint32_t type) {
+    return json_equals(json, type, "SCALAR") ? 1
+         : json_equals(json, type, "VEC2")   ? 2
+         : json_equals(json, type, "VEC3")   ? 3
+         : json_equals(json, type, "VEC4")   ? 4
+                                             : 0;
+}
+
+static int resolve_accessor(const Json* json, const MappedFile* buffers, uint32_t buffer_count, uint32_t index,
+                            GltfAccessor* accessor) {
+    uint32_t token = json_at(json, json_get(json, 0, "accessors"), index);
+    uint32_t view  = json_at(json, json_get(json, 0, "bufferViews"),
+                             json_index(json, json_get(json, token, "bufferView"), JSON_NONE));
+    if (token == JSON_NONE || view == JSON_NONE || json_get(json, token, "sparse") != JSON_NONE) {
+        return 0;
+    }
+    uint32_t buffer = json_index(json, json_get(json, view, "buffer"), JSON_NONE);
+    if (buffer >= buffer_count || !buffers[buffer].data) {
+        return 0;
+    }
+
+    *accessor = (GltfAccessor){
+        .count          = json_index(json, json_get(json, token, "count"), 0),
+        .component_type = json_index(json, json_get(json, token, "componentType"), 0),
+        .components     = type_components(json, json_get(json, token, "type")),
+    };
+    uint32_t element = component_size(accessor->component_type) * accessor->components;
+    accessor->stride = json_index(json, json_get(json, view, "byteStride"), element);
+    size_t offset    = (size_t) json_index(json, json_get(json, view, "byteOffset"), 0)
+                     + (size_t) json_index(json, json_get(json, token, "byteOffset"), 0);
+    size_t view_end  = (size_t) json_index(json, json_get(json, view, "byteOffset"), 0)
+                     + (size_t) json_index(json, json_get(json, view, "byteLength"), 0);
+    if (!element || !accessor->count || view_end > buffers[buffer].size
+        || offset + (size_t) accessor->stride * (accessor->count - 1) + element > view_end) {
+        return 0;
+    }
+    accessor->data = (const uint8_t*) buffers[buffer].data + offset;
+    return 1;
+}
+
+static float read_component(const GltfAccessor* accessor, uint32_t element, uint32_t component) {
+    const uint8_t* p = accessor->data + (size_t) element * accessor->stride;
+    switch (accessor->component_type) {
+    case GLTF_FLOAT: {
+        float value;
+        memcpy(&value, p + 4 * component, sizeof(value));
+        return value;
+    }
+    case GLTF_UNSIGNED_BYTE:
+        return p[component] / 255.0f;
+    case GLTF_UNSIGNED_SHORT: {
+        uint16_t value;
+        memcpy(&value, p + 2 * component, sizeof(value));
+        return value / 65535.0f;
+    }
+    case GLTF_BYTE:
+        return fmaxf((int8_t) p[component] / 127.0f, -1.0f);
+    case GLTF_SHORT: {
+        int16_t value;
+        memcpy(&value, p + 2 * component, sizeof(value));
+        return fmaxf(value / 32767.0f, -1.0f);
+    }
+    default:
+        return 0.0f;
+    }
+}
+
+static uint32_t read_index(const GltfAccessor* accessor, uint32_t element) {
+    if (!accessor->count) {
+        return element;
+    }
+    const uint8_t* p = accessor->data + (size_t) element * accessor->stride;
+    if (accessor->component_type == GLTF_UNSIGNED_BYTE) {
+        return *p;
+    }
+    if (accessor->component_type == GLTF_UNSIGNED_SHORT) {
+        uint16_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Triangles are flipped from glTF's counter-clockwise winding. Indices past the primitive's vertices
+// are clamped rather than left to read out of bounds on the GPU.
+static void convert_gltf_range(void* data, uint32_t index) {
+    GltfLoad*      load      = data;
+    GltfRange*     range     = &load->ranges[index];
+    GltfPrimitive* primitive = range->primitive;
+    Mesh*          mesh      = load->mesh;
+    if (range->indices) {
+        uint32_t  last = primitive->position.count - 1;
+        uint32_t* out  = mesh->indices + primitive->index_base;
+        for (uint32_t t = range->begin; t < range->end; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t v               = read_index(&primitive->indices, 3 * t + k);
+                out[3 * t + (3 - k) % 3] = primitive->vertex_base + (v > last ? last : v);
+            }
+        }
+        return;
+    }
+
+    for (uint32_t v = range->begin; v < range->end; v++) {
+        MeshVertex* vertex = &mesh->vertices[primitive->vertex_base + v];
+        vertex->position   = (Vec3){ read_component(&primitive->position, v, 0),
+                                     read_component(&primitive->position, v, 1),
+                                     read_component(&primitive->position, v, 2) };
+        vertex->normal     = (Vec3){};
+        if (primitive->normal.count) {
+            vertex->normal = (Vec3){ read_component(&primitive->normal, v, 0), read_component(&primitive->normal, v, 1),
+                                     read_component(&primitive->normal, v, 2) };
+        }
+        memcpy(vertex->color, DEFAULT_COLOR, sizeof(vertex->color));
+        for (uint32_t c = 0; primitive->color.count && c < primitive->color.components; c++) {
+            vertex->color[c] = read_component(&primitive->color, v, c);
+        }
+    }
+}
+
+// Smooth normals for primitives without them: each vertex gets the area-weighted sum of its
+// triangles' normals.
+static void generate_normals(Mesh* mesh, const GltfPrimitive* primitive) {
+    for (uint32_t i = primitive->index_base; i < primitive->index_base + primitive->index_count; i += 3) {
+        MeshVertex* a = &mesh->vertices[mesh->indices[i + 0]];
+        MeshVertex* b = &mesh->vertices[mesh->indices[i + 1]];
+        MeshVertex* c = &mesh->vertices[mesh->indices[i + 2]];
+        Vec3        n = vec3_cross(vec3_sub(c->position, a->position), vec3_sub(b->position, a->position));
+        a->normal     = (Vec3){ a->normal.x + n.x, a->normal.y + n.y, a->normal.z + n.z };
+        b->normal     = (Vec3){ b->normal.x + n.x, b->normal.y + n.y, b->normal.z + n.z };
+        c->normal     = (Vec3){ c->normal.x + n.x, c->normal.y + n.y, c->normal.z + n.z };
+    }
+    for (uint32_t v = primitive->vertex_base; v < primitive->vertex_base + primitive->position.count; v++) {
+        Vec3 n = mesh->vertices[v].normal;
+        if (vec3_dot(n, n) > 0.0f) {
+            mesh->vertices[v].normal = vec3_normalize(n);
+        }
+    }
+}
+
+// Finds the JSON text of a .gltf or .glb, and the BIN chunk holding buffer 0 of a .glb.
+static const char* gltf_split(const MappedFile* file, const char** text, size_t* text_size, MappedFile* binary) {
+    *text      = file->data;
+    *text_size = file->size;
+    *binary    = (MappedFile){};
+
+    // A .glb is a 12-byte header, a JSON chunk and an optional BIN chunk holding buffer 0.
+    uint32_t header[5];
+    if (file->size >= sizeof(header) && !memcmp(file->data, "glTF", 4)) {
+        memcpy(header, file->data, sizeof(header));
+        if (header[1] != 2 || header[4] != 0x4e4f534a || 20 + (size_t) header[3] > file->size) {
+            return "unsupported binary glTF";
+        }
+        *text      = file->data + 20;
+        *text_size = header[3];
+
+        size_t   at = 20 + ((size_t) header[3] + 3) / 4 * 4;
+        uint32_t chunk[2];
+        if (at + sizeof(chunk) <= file->size) {
+            memcpy(chunk, file->data + at, sizeof(chunk));
+            if (chunk[1] == 0x004e4942 && at + sizeof(chunk) + chunk[0] <= file->size) {
+                *binary = (MappedFile){ .data = file->data + at + sizeof(chunk), .size = chunk[0] };
+            }
+        }
+    }
+    return NULL;
+}
+
+// Maps every buffer, external ones resolved next to the .gltf and those without a URI from the
+// .glb's BIN chunk. Embedded base64 data isn't supported. `buffers` must be zeroed, and is unmapped
+// by gltf_unmap_buffers even on failure.
+static const char* gltf_map_buffers(const char* path, const Json* json, const char* text, MappedFile binary,
+                                    MappedFile buffers[GLTF_MAX_BUFFERS], uint32_t* buffer_count) {
+    uint32_t buffer_list = json_get(json, 0, "buffers");
+    *buffer_count        = json_count(json, buffer_list);
+    if (*buffer_count > GLTF_MAX_BUFFERS) {
+        return "too many buffers";
+    }
+    for (uint32_t i = 0; i < *buffer_count; i++) {
+        uint32_t uri = json_get(json, json_at(json, buffer_list, i), "uri");
+        if (uri == JSON_NONE) {
+            buffers[i] = binary;
+            continue;
+        }
+        const JsonToken* token = &json->tokens[uri];
+        const char*      slash = strrchr(path, '/');
+        int              dir   = slash ? (int) (slash - path + 1) : 0;
+        char             buffer_path[4096];
+        if (token->type != JSON_STRING || (token->length >= 5 && !memcmp(text + token->start, "data:", 5))) {
+            return "embedded buffers aren't supported";
+        }
+        if (snprintf(buffer_path, sizeof(buffer_path), "%.*s%.*s", dir, path, (int) token->length,
+                     text + token->start)
+                >= (int) sizeof(buffer_path)
+            || !map_file(buffer_path, &buffers[i])) {
+            return "could not map buffer";
+        }
+    }
+    return NULL;
+}
+
+static void gltf_unmap_buffers(MappedFile buffers[GLTF_MAX_BUFFERS], uint32_t buffer_count, MappedFile binary) {
+    for (uint32_t i = 0; i < buffer_count && i < GLTF_MAX_BUFFERS; i++) {
+        if (buffers[i].data != binary.data) {
+            unmap_file(&buffers[i]);
+        }
+    }
+}
+
+static const char* load_gltf(const char* path, const MappedFile* file, JobSystem* jobs, Mesh* mesh,
+                             MeshLoadStats* stats) {
+    MappedFile  buffers[GLTF_MAX_BUFFERS] = {};
+    uint32_t    buffer_count              = 0;
+    const char* text;
+    size_t      text_size;
+    MappedFile  binary;
+    const char* reason = gltf_split(file, &text, &text_size, &binary);
+    if (reason) {
+        return reason;
+    }
+
+    Json json;
+    if (!json_parse(&json, text, text_size)) {
+        return "malformed JSON";
+    }
+
+    reason = gltf_map_buffers(path, &json, text, binary, buffers, &buffer_count);
+    for (uint32_t i = 0; !reason && i < buffer_count; i++) {
+        if (buffers[i].data != binary.data) {
+            stats->file_bytes += buffers[i].size;
+        }
+    }
+
+    GltfPrimitive* primitives      = NULL;
+    uint32_t       primitive_count = 0;
+    uint32_t       capacity        = 0;
+    uint32_t       mesh_list       = json_get(&json, 0, "meshes");
+    for (uint32_t m = 0; !reason && m < json_count(&json, mesh_list); m++) {
+        uint32_t list = json_get(&json, json_at(&json, mesh_list, m), "primitives");
+        for (uint32_t p = 0; !reason && p < json_count(&json, list); p++) {
+            uint32_t primitive  = json_at(&json, list, p);
+            uint32_t attributes = json_get(&json, primitive, "attributes");
+            if (json_number(&json, json_get(&json, primitive, "mode"), GLTF_TRIANGLES) != GLTF_TRIANGLES) {
+                continue;
+            }
+            primitives = grow(primitives, &capacity, primitive_count, sizeof(GltfPrimitive));
+            GltfPrimitive* out = &primitives[primitive_count];
+            *out               = (GltfPrimitive){};
+            uint32_t position  = json_index(&json, json_get(&json, attributes, "POSITION"), JSON_NONE);
+            uint32_t normal    = json_index(&json, json_get(&json, attributes, "NORMAL"), JSON_NONE);
+            uint32_t color     = json_index(&json, json_get(&json, attributes, "COLOR_0"), JSON_NONE);
+            uint32_t indices   = json_index(&json, json_get(&json, primitive, "indices"), JSON_NONE);
+            if (!resolve_accessor(&json, buffers, buffer_count, position, &out->position)
+                || out->position.component_type != GLTF_FLOAT || out->position.components != 3) {
+                reason = "primitive without float3 positions";
+            } else if (normal != UINT32_MAX
+                       && (!resolve_accessor(&json, buffers, buffer_count, normal, &out->normal)
+                           || out->normal.components != 3 || out->normal.count != out->position.count)) {
+                reason = "bad normals";
+            } else if (color != UINT32_MAX
+                       && (!resolve_accessor(&json, buffers, buffer_count, color, &out->color)
+                           || out->color.components < 3 || out->color.count != out->position.count)) {
+                reason = "bad colors";
+            } else if (indices != UINT32_MAX
+                       && (!resolve_accessor(&json, buffers, buffer_count, indices, &out->indices)
+                           || out->indices.components != 1
+                           || (out->indices.component_type != GLTF_UNSIGNED_BYTE
+                               && out->indices.component_type != GLTF_UNSIGNED_SHORT
+                               && out->indices.component_type != GLTF_UNSIGNED_INT))) {
+                reason = "bad indices";
+            } else {
+                uint32_t count   = out->indices.count ? out->indices.count : out->position.count;
+                out->index_count = count / 3 * 3;
+                primitive_count++;
+            }
+        }
+    }
+    if (!reason && !primitive_count) {
+        reason = "no triangle primitives";
+    }
+
+    if (!reason) {
+        uint32_t range_count = 0;
+        *mesh                = (Mesh){};
+        for (uint32_t p = 0; p < primitive_count; p++) {
+            primitives[p].vertex_base = mesh->vertex_count;
+            primitives[p].index_base  = mesh->index_count;
+            mesh->vertex_count += primitives[p].position.count;
+            mesh->index_count += primitives[p].index_count;
+            range_count += (primitives[p].position.count + RANGE_SIZE - 1) / RANGE_SIZE;
+            range_count += (primitives[p].index_count / 3 + RANGE_SIZE - 1) / RANGE_SIZE;
+        }
+        mesh->vertices = malloc(sizeof(MeshVertex) * mesh->vertex_count);
+        mesh->indices  = malloc(sizeof(uint32_t) * (mesh->index_count ? mesh->index_count : 1));
+
+        GltfLoad load = { .ranges = malloc(sizeof(GltfRange) * range_count), .mesh = mesh };
+        uint32_t r    = 0;
+        for (uint32_t p = 0; p < primitive_count; p++) {
+            for (uint32_t v = 0; v < primitives[p].position.count; v += RANGE_SIZE) {
+                uint32_t end      = v + RANGE_SIZE < primitives[p].position.count ? v + RANGE_SIZE
+                                                                                  : primitives[p].position.count;
+                load.ranges[r++] = (GltfRange){ .primitive = &primitives[p], .begin = v, .end = end };
+            }
+            uint32_t triangles = primitives[p].index_count / 3;
+            for (uint32_t t = 0; t < triangles; t += RANGE_SIZE) {
+                uint32_t end      = t + RANGE_SIZE < triangles ? t + RANGE_SIZE : triangles;
+                load.ranges[r++] = (GltfRange){ .primitive = &primitives[p], .begin = t, .end = end, .indices = 1 };
+            }
+        }
+        parallel_for(jobs, range_count, convert_gltf_range, &load);
+        for (uint32_t p = 0; p < primitive_count; p++) {
+            if (!primitives[p].normal.count) {
+                generate_normals(mesh, &primitives[p]);
+            }
+        }
+        free(load.ranges);
+        stats->chunks = range_count;
+    }
+
+    free(primitives);
+    gltf_unmap_buffers(buffers, buffer_count, binary);
+    json_destroy(&json);
+    return reason;
+}
+
+static int has_extension(const char* path, const char* extension) {
+    size_t length = strlen(path);
+    size_t suffix = strlen(extension);
+    return length >= suffix && !strcasecmp(path + length - suffix, extension);
+}
+
+int mesh_load(const char* path, JobSystem* jobs, Mesh* mesh, MeshLoadStats* stats) {
+    uint64_t start = bench_time_ns();
+    *stats         = (MeshLoadStats){};
+
+    MappedFile  file;
+    const char* reason = NULL;
+    if (!has_extension(path, ".obj") && !has_extension(path, ".gltf") && !has_extension(path, ".glb")) {
+        reason = "unknown extension, expected .obj, .gltf or .glb";
+    } else if (!map_file(path, &file)) {
+        reason = "could not map file";
+    } else {
+        stats->file_bytes = file.size;
+        reason            = has_extension(path, ".obj") ? load_obj(&file, jobs, mesh, stats)
+                                                         : load_gltf(path, &file, jobs, mesh, stats);
+        unmap_file(&file);
+    }
+    stats->ms = bench_elapsed_ms(start);
+
+    if (reason) {
+        fprintf(stderr, "Could not load mesh '%s': %s\n", path, reason);
+        return 0;
+    }
+    return 1;
+}
+
+static const char* visit_gltf_buffers(const char* path, const MappedFile* file, MeshSourceVisitor visit,
+                                      void* data) {
+    const char* text;
+    size_t      text_size;
+    MappedFile  binary;
+    const char* reason = gltf_split(file, &text, &text_size, &binary);
+    if (reason) {
+        return reason;
+    }
+    Json json;
+    if (!json_parse(&json, text, text_size)) {
+        return "malformed JSON";
+    }
+    MappedFile buffers[GLTF_MAX_BUFFERS] = {};
+    uint32_t   buffer_count              = 0;
+    reason                               = gltf_map_buffers(path, &json, text, binary, buffers, &buffer_count);
+    for (uint32_t i = 0; !reason && i < buffer_count; i++) {
+        if (buffers[i].data != binary.data) {
+            visit(data, &buffers[i]);
+        }
+    }
+    gltf_unmap_buffers(buffers, buffer_count, binary);
+    json_destroy(&json);
+    return reason;
+}
+
+int mesh_visit_sources(const char* path, MeshSourceVisitor visit, void* data) {
+    MappedFile  file;
+    const char* reason = NULL;
+    if (!map_file(path, &file)) {
+        reason = "could not map file";
+    } else {
+        visit(data, &file);
+        if (!has_extension(path, ".obj")) {
+            reason = visit_gltf_buffers(path, &file, visit, data);
+        }
+        unmap_file(&file);
+    }
+
+    if (reason) {
+        fprintf(stderr, "Could not read mesh '%s': %s\n", path, reason);
+        return 0;
+    }
+    return 1;
+}
+
+typedef struct {
+    const Mesh*               mesh;
+    VertexFormat              format;
+    const VertexQuantization* quantization;
+    uint8_t*                  vertices;
+    VkIndexType               index_type;
+    uint8_t*                  indices;
+    uint32_t                  vertex_ranges;
+} EncodeJob;
+
+static void encode_range(void* data, uint32_t index) {
+    EncodeJob*  encode = data;
+    const Mesh* mesh   = encode->mesh;
+    if (index < encode->vertex_ranges) {
+        uint32_t begin = index * RANGE_SIZE;
+        uint32_t count = mesh->vertex_count - begin < RANGE_SIZE ? mesh->vertex_count - begin : RANGE_SIZE;
+        mesh_encode_vertices(mesh->vertices + begin, count, encode->format, encode->quantization,
+                             encode->vertices + (size_t) begin * vertex_format_stride(encode->format));
+        return;
+    }
+    uint32_t begin = (index - encode->vertex_ranges) * RANGE_SIZE;
+    Mesh     range = {
+        .indices     = mesh->indices + begin,
+        .index_count = mesh->index_count - begin < RANGE_SIZE ? mesh->index_count - begin : RANGE_SIZE,
+    };
+    mesh_encode_indices(&range, encode->index_type,
+                        encode->indices + (size_t) begin * index_type_size(encode->index_type));
+}
+
+void mesh_encode_parallel(JobSystem* jobs, const Mesh* mesh, VertexFormat format,
+                          const VertexQuantization* quantization, void* vertices, VkIndexType index_type,
+                          void* indices) {
+    EncodeJob encode = {
+        .mesh          = mesh,
+        .format        = format,
+        .quantization  = quantization,
+        .vertices      = vertices,
+        .index_type    = index_type,
+        .indices       = indices,
+        .vertex_ranges = (mesh->vertex_count + RANGE_SIZE - 1) / RANGE_SIZE,
+    };
+    uint32_t index_ranges = (mesh->index_count + RANGE_SIZE - 1) / RANGE_SIZE;
+    parallel_for(jobs, encode.vertex_ranges + index_ranges, encode_range, &encode);
+}
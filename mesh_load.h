@@ -0,0 +1,39 @@
+#ifndef mesh_load_h
+#define mesh_load_h
+#include "job.h"
+#include "mesh.h"
+
+// A read-only private mapping of a whole file.
+typedef struct {
+    const char* data;
+    size_t      size;
+} MappedFile;
+
+typedef struct {
+    size_t   file_bytes; // Every file read, including glTF buffers.
+    double   ms;
+    uint32_t chunks; // Pieces parsed in parallel.
+} MeshLoadStats;
+
+// Loads a Wavefront OBJ, glTF (.gltf) or binary glTF (.glb) file, chosen by extension, into an
+// indexed mesh in the renderer's winding. Files are mapped rather than read, and parsed in parallel
+// on `jobs`, or on the calling thread if `jobs` is NULL. Returns 0 and prints why on failure.
+int mesh_load(const char* path, JobSystem* jobs, Mesh* mesh, MeshLoadStats* stats);
+
+typedef void (*MeshSourceVisitor)(void* data, const MappedFile* file);
+
+// Calls `visit` with every file loading `path` reads: the file itself and, for glTF, each external
+// buffer, in the order the file lists them. Returns 0 and prints why on failure.
+int mesh_visit_sources(const char* path, MeshSourceVisitor visit, void* data);
+
+// Fails on missing or empty files.
+int  map_file(const char* path, MappedFile* file);
+void unmap_file(MappedFile* file);
+
+// mesh_encode_vertices and mesh_encode_indices split across `jobs`, writing straight into mapped
+// buffer memory.
+void mesh_encode_parallel(JobSystem* jobs, const Mesh* mesh, VertexFormat format,
+                          const VertexQuantization* quantization, void* vertices, VkIndexType index_type,
+                          void* indices);
+
+#endif
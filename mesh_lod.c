@@ -0,0 +1,400 @@
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mesh_lod.h"
+#include "mesh_optimize.h"
+
+// The chain ends before a level would drop below this many triangles, or once simplification
+// stalls and removes less than a tenth of them.
+#define LOD_MIN_TRIANGLES 64
+#define LOD_MIN_REDUCTION 0.9f
+// A coarser level is only chosen once its projected error is within this fraction of the threshold.
+#define LOD_HYSTERESIS 0.75f
+// Collapses that turn a neighboring triangle by more than 60 degrees are rejected. Turns add up
+// over passes, so a looser bound lets triangles fold over a few steps at a time.
+#define FLIP_MIN_COS 0.5f
+
+// Garland and Heckbert's error quadric: the symmetric 4x4 matrix summing the squared distances to a
+// set of planes, weighted by the area of the triangles they came from. Dividing by the total weight
+// gives a mean squared distance, which is what the LOD error is measured in.
+typedef struct {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double weight;
+} Quadric;
+
+static void quadric_add_plane(Quadric* q, Vec3 n, float d, float weight) {
+    q->a2 += weight * n.x * n.x;
+    q->ab += weight * n.x * n.y;
+    q->ac += weight * n.x * n.z;
+    q->ad += weight * n.x * d;
+    q->b2 += weight * n.y * n.y;
+    q->bc += weight * n.y * n.z;
+    q->bd += weight * n.y * d;
+    q->c2 += weight * n.z * n.z;
+    q->cd += weight * n.z * d;
+    q->d2 += weight * d * d;
+    q->weight += weight;
+}
+
+static void quadric_add(Quadric* q, const Quadric* other) {
+    q->a2 += other->a2;
+    q->ab += other->ab;
+    q->ac += other->ac;
+    q->ad += other->ad;
+    q->b2 += other->b2;
+    q->bc += other->bc;
+    q->bd += other->bd;
+    q->c2 += other->c2;
+    q->cd += other->cd;
+    q->d2 += other->d2;
+    q->weight += other->weight;
+}
+
+// Rounding can take the sum slightly below zero.
+static double quadric_error(const Quadric* q, Vec3 p) {
+    double x = p.x;
+    double y = p.y;
+    double z = p.z;
+    double e = q->a2 * x * x + 2 * q->ab * x * y + 2 * q->ac * x * z + 2 * q->ad * x + q->b2 * y * y
+             + 2 * q->bc * y * z + 2 * q->bd * y + q->c2 * z * z + 2 * q->cd * z + q->d2;
+    return q->weight > 0.0 ? fabs(e) / q->weight : 0.0;
+}
+
+static uint32_t position_hash(Vec3 p) {
+    // Negative zero hashes like zero so that positions comparing equal land in the same slot.
+    float    coordinates[3] = { p.x == 0.0f ? 0.0f : p.x, p.y == 0.0f ? 0.0f : p.y, p.z == 0.0f ? 0.0f : p.z };
+    uint32_t words[3];
+    memcpy(words, coordinates, sizeof(words));
+    uint32_t h = words[0] * 73856093u ^ words[1] * 19349663u ^ words[2] * 83492791u;
+    return h * 0x9e3779b1u;
+}
+
+// Welded vertices that still share a position differ in normal or color: they sit on a hard edge
+// or a color boundary, and moving one without the others would tear the surface open.
+static void lock_seams(const Mesh* mesh, uint8_t* locked) {
+    uint32_t capacity = 16;
+    while (capacity < 2 * mesh->vertex_count) {
+        capacity *= 2;
+    }
+    uint32_t* slots = malloc(sizeof(uint32_t) * capacity);
+    memset(slots, 0xff, sizeof(uint32_t) * capacity);
+    for (uint32_t v = 0; v < mesh->vertex_count; v++) {
+        Vec3     p    = mesh->vertices[v].position;
+        uint32_t slot = position_hash(p) & (capacity - 1);
+        for (; slots[slot] != UINT32_MAX; slot = (slot + 1) & (capacity - 1)) {
+            Vec3 q = mesh->vertices[slots[slot]].position;
+            if (p.x == q.x && p.y == q.y && p.z == q.z) {
+                locked[v]           = 1;
+                locked[slots[slot]] = 1;
+                break;
+            }
+        }
+        if (slots[slot] == UINT32_MAX) {
+            slots[slot] = v;
+        }
+    }
+    free(slots);
+}
+
+typedef struct {
+    uint32_t a; // The lower vertex index.
+    uint32_t b;
+} Edge;
+
+static int compare_edges(const void* a, const void* b) {
+    const Edge* x = a;
+    const Edge* y = b;
+    if (x->a != y->a) {
+        return x->a < y->a ? -1 : 1;
+    }
+    return x->b < y->b ? -1 : x->b > y->b;
+}
+
+// Every triangle edge, sorted so that the copies of each edge are adjacent.
+static uint32_t collect_edges(const uint32_t* indices, uint32_t index_count, Edge* edges) {
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t a   = indices[i + k];
+            uint32_t b   = indices[i + (k + 1) % 3];
+            edges[i + k] = a < b ? (Edge){ a, b } : (Edge){ b, a };
+        }
+    }
+    qsort(edges, index_count, sizeof(Edge), compare_edges);
+    return index_count;
+}
+
+typedef struct {
+    uint32_t source;
+    uint32_t target;
+    double   cost;
+} Collapse;
+
+static int compare_collapses(const void* a, const void* b) {
+    const Collapse* x = a;
+    const Collapse* y = b;
+    return x->cost < y->cost ? -1 : x->cost > y->cost;
+}
+
+// Triangles around each vertex, as offsets into one list.
+typedef struct {
+    uint32_t* first;
+    uint32_t* triangles;
+} Adjacency;
+
+static void build_adjacency(Adjacency* adjacency, const uint32_t* indices, uint32_t index_count,
+                            uint32_t vertex_count) {
+    memset(adjacency->first, 0, sizeof(uint32_t) * (vertex_count + 1));
+    for (uint32_t i = 0; i < index_count; i++) {
+        adjacency->first[indices[i] + 1]++;
+    }
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        adjacency->first[v + 1] += adjacency->first[v];
+    }
+    for (uint32_t i = 0; i < index_count; i++) {
+        adjacency->triangles[adjacency->first[indices[i]]++] = i / 3;
+    }
+    for (uint32_t v = vertex_count; v > 0; v--) {
+        adjacency->first[v] = adjacency->first[v - 1];
+    }
+    adjacency->first[0] = 0;
+}
+
+// Checks the triangles that would move with `source`, through the collapses already made in this
+// pass, for ones that would fold over.
+static int collapse_flips(const Mesh* mesh, const uint32_t* indices, const uint32_t* remap,
+                          const Adjacency* adjacency, uint32_t source, uint32_t target) {
+    for (uint32_t i = adjacency->first[source]; i < adjacency->first[source + 1]; i++) {
+        const uint32_t* triangle = &indices[3 * adjacency->triangles[i]];
+        uint32_t        v[3]     = { remap[triangle[0]], remap[triangle[1]], remap[triangle[2]] };
+        if (v[0] == target || v[1] == target || v[2] == target) {
+            continue;
+        }
+        Vec3 before[3];
+        Vec3 after[3];
+        for (uint32_t k = 0; k < 3; k++) {
+            before[k] = mesh->vertices[v[k]].position;
+            after[k]  = v[k] == source ? mesh->vertices[target].position : before[k];
+        }
+        Vec3  n0 = vec3_cross(vec3_sub(before[2], before[0]), vec3_sub(before[1], before[0]));
+        Vec3  n1 = vec3_cross(vec3_sub(after[2], after[0]), vec3_sub(after[1], after[0]));
+        float d  = vec3_dot(n0, n1);
+        // Triangles squashed to zero area count as flipped: collapsing onto a vertex that shares a
+        // position with another seam vertex would leave one with no normal to check later moves against.
+        if (d <= FLIP_MIN_COS * sqrtf(vec3_dot(n0, n0) * vec3_dot(n1, n1))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Each pass ranks every edge's cheaper allowed direction by quadric error and applies collapses
+// from the cheapest up, at most one per vertex, until enough triangles are gone; then the indices
+// are rewritten and degenerate triangles dropped.
+uint32_t mesh_simplify(const Mesh* mesh, const uint32_t* indices, uint32_t index_count, uint32_t target_index_count,
+                       uint32_t* out, float* error) {
+    uint32_t   vertex_count = mesh->vertex_count;
+    uint8_t*   locked       = calloc(vertex_count ? vertex_count : 1, 1);
+    uint8_t*   touched      = malloc(vertex_count ? vertex_count : 1);
+    uint32_t*  remap        = malloc(sizeof(uint32_t) * (vertex_count ? vertex_count : 1));
+    Quadric*   quadrics     = calloc(vertex_count ? vertex_count : 1, sizeof(Quadric));
+    Edge*      edges        = malloc(sizeof(Edge) * (index_count ? index_count : 1));
+    Collapse*  collapses    = malloc(sizeof(Collapse) * (index_count ? index_count : 1));
+    Adjacency  adjacency    = {
+        .first     = malloc(sizeof(uint32_t) * (vertex_count + 1)),
+        .triangles = malloc(sizeof(uint32_t) * (index_count ? index_count : 1)),
+    };
+    uint32_t count    = index_count;
+    double   max_cost = 0.0;
+    memcpy(out, indices, sizeof(uint32_t) * index_count);
+
+    lock_seams(mesh, locked);
+    for (uint32_t i = 0; i < count; i += 3) {
+        Vec3  a      = mesh->vertices[out[i + 0]].position;
+        Vec3  b      = mesh->vertices[out[i + 1]].position;
+        Vec3  c      = mesh->vertices[out[i + 2]].position;
+        Vec3  n      = vec3_cross(vec3_sub(c, a), vec3_sub(b, a));
+        float length = sqrtf(vec3_dot(n, n));
+        if (length == 0.0f) {
+            continue;
+        }
+        n = (Vec3){ n.x / length, n.y / length, n.z / length };
+        for (uint32_t k = 0; k < 3; k++) {
+            quadric_add_plane(&quadrics[out[i + k]], n, -vec3_dot(n, a), 0.5f * length);
+        }
+    }
+    // Edges used by only one triangle are on an open border, which would shrink if its vertices
+    // moved.
+    uint32_t edge_count = collect_edges(out, count, edges);
+    for (uint32_t i = 0; i < edge_count;) {
+        uint32_t j = i + 1;
+        while (j < edge_count && edges[j].a == edges[i].a && edges[j].b == edges[i].b) {
+            j++;
+        }
+        if (j - i == 1) {
+            locked[edges[i].a] = 1;
+            locked[edges[i].b] = 1;
+        }
+        i = j;
+    }
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        remap[v] = v;
+    }
+
+    while (count > target_index_count) {
+        edge_count              = collect_edges(out, count, edges);
+        uint32_t collapse_count = 0;
+        for (uint32_t i = 0; i < edge_count; i++) {
+            if (i && edges[i].a == edges[i - 1].a && edges[i].b == edges[i - 1].b) {
+                continue;
+            }
+            uint32_t a = edges[i].a;
+            uint32_t b = edges[i].b;
+            Quadric  q = quadrics[a];
+            quadric_add(&q, &quadrics[b]);
+            // The build uses -ffast-math, so locked directions are skipped by flag rather than by an
+            // infinite cost.
+            if (locked[a] && locked[b]) {
+                continue;
+            }
+            double to_b = locked[a] ? 0.0 : quadric_error(&q, mesh->vertices[b].position);
+            double to_a = locked[b] ? 0.0 : quadric_error(&q, mesh->vertices[a].position);
+            if (locked[b] || (!locked[a] && to_b <= to_a)) {
+                collapses[collapse_count++] = (Collapse){ a, b, to_b };
+            } else {
+                collapses[collapse_count++] = (Collapse){ b, a, to_a };
+            }
+        }
+        if (!collapse_count) {
+            break;
+        }
+        qsort(collapses, collapse_count, sizeof(Collapse), compare_collapses);
+        build_adjacency(&adjacency, out, count, vertex_count);
+        memset(touched, 0, vertex_count);
+
+        uint32_t goal    = (count - target_index_count) / 3;
+        uint32_t removed = 0;
+        uint32_t applied = 0;
+        for (uint32_t i = 0; i < collapse_count && removed < goal; i++) {
+            Collapse c = collapses[i];
+            if (touched[c.source] || touched[c.target]
+                || collapse_flips(mesh, out, remap, &adjacency, c.source, c.target)) {
+                continue;
+            }
+            for (uint32_t t = adjacency.first[c.source]; t < adjacency.first[c.source + 1]; t++) {
+                const uint32_t* triangle = &out[3 * adjacency.triangles[t]];
+                removed += triangle[0] == c.target || triangle[1] == c.target || triangle[2] == c.target;
+            }
+            remap[c.source]   = c.target;
+            touched[c.source] = 1;
+            touched[c.target] = 1;
+            quadric_add(&quadrics[c.target], &quadrics[c.source]);
+            max_cost = fmax(max_cost, c.cost);
+            applied++;
+        }
+        if (!applied) {
+            break;
+        }
+
+        uint32_t write = 0;
+        for (uint32_t i = 0; i < count; i += 3) {
+            uint32_t a = remap[out[i + 0]];
+            uint32_t b = remap[out[i + 1]];
+            uint32_t c = remap[out[i + 2]];
+            if (a != b && b != c && a != c) {
+                out[write++] = a;
+                out[write++] = b;
+                out[write++] = c;
+            }
+        }
+        count = write;
+        for (uint32_t v = 0; v < vertex_count; v++) {
+            remap[v] = v;
+        }
+    }
+
+    free(locked);
+    free(touched);
+    free(remap);
+    free(quadrics);
+    free(edges);
+    free(collapses);
+    free(adjacency.first);
+    free(adjacency.triangles);
+    *error = (float) sqrt(max_cost);
+    return count;
+}
+
+// Each level is simplified from the one before, which is cheaper than starting over from the full
+// mesh every time; its error bound is the sum of the steps' errors.
+uint32_t mesh_build_lods(Mesh* mesh, uint32_t max_levels, MeshLod* lods) {
+    uint32_t  lod_count = 1;
+    uint32_t  total     = mesh->index_count;
+    uint32_t* indices   = mesh->indices;
+    lods[0]             = (MeshLod){ .index_count = mesh->index_count };
+    while (lod_count < max_levels && lod_count < MESH_LOD_MAX) {
+        const MeshLod* previous = &lods[lod_count - 1];
+        uint32_t       target   = previous->index_count / 6 * 3;
+        if (target / 3 < LOD_MIN_TRIANGLES) {
+            break;
+        }
+
+        float     error;
+        uint32_t* level = malloc(sizeof(uint32_t) * previous->index_count);
+        uint32_t  count = mesh_simplify(mesh, indices + previous->index_offset, previous->index_count, target, level,
+                                        &error);
+        if (count > previous->index_count * LOD_MIN_REDUCTION) {
+            free(level);
+            break;
+        }
+        Mesh view = {
+            .vertices     = mesh->vertices,
+            .vertex_count = mesh->vertex_count,
+            .indices      = level,
+            .index_count  = count,
+        };
+        mesh_optimize_vertex_cache(&view, VERTEX_CACHE_SIZE, 0);
+
+        indices = realloc(indices, sizeof(uint32_t) * ((size_t) total + count));
+        memcpy(indices + total, view.indices, sizeof(uint32_t) * count);
+        free(view.indices);
+        lods[lod_count] = (MeshLod){
+            .index_offset = total,
+            .index_count  = count,
+            .error        = lods[lod_count - 1].error + error,
+        };
+        total += count;
+        lod_count++;
+    }
+    mesh->indices     = indices;
+    mesh->index_count = total;
+    return lod_count;
+}
+
+// The clip-space y row of the MVP scales object-space lengths onto the screen, independent of the
+// direction they point in as long as the model matrix scales uniformly.
+float mesh_lod_pixels_per_unit(const Mat4* mvp, Vec3 center, float height) {
+    float w = mvp->xw * center.x + mvp->yw * center.y + mvp->zw * center.z + mvp->ww;
+    if (w <= 0.0f) {
+        return FLT_MAX;
+    }
+    float scale = sqrtf(mvp->xy * mvp->xy + mvp->yy * mvp->yy + mvp->zy * mvp->zy);
+    return scale * 0.5f * height / w;
+}
+
+uint32_t mesh_lod_select(const MeshLod* lods, uint32_t lod_count, uint32_t current, float pixels_per_unit,
+                         float threshold) {
+    // Behind the eye, before any multiply: error * FLT_MAX would overflow, which -ffast-math assumes
+    // never happens.
+    if (pixels_per_unit >= FLT_MAX) {
+        return 0;
+    }
+    uint32_t lod = current < lod_count ? current : lod_count - 1;
+    while (lod > 0 && lods[lod].error * pixels_per_unit > threshold) {
+        lod--;
+    }
+    while (lod + 1 < lod_count && lods[lod + 1].error * pixels_per_unit <= threshold * LOD_HYSTERESIS) {
+        lod++;
+    }
+    return lod;
+}
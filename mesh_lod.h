@@ -0,0 +1,41 @@
+#ifndef mesh_lod_h
+#define mesh_lod_h
+#include "mesh.h"
+
+#define MESH_LOD_MAX 8
+
+// One level of detail: a range of the mesh's indices over its shared vertices, and the meshlets
+// that split it.
+typedef struct {
+    uint32_t index_offset;
+    uint32_t index_count;
+    uint32_t meshlet_offset;
+    uint32_t meshlet_count;
+    float    error; // Object-space distance the level may deviate from the full mesh; zero for level 0.
+    uint32_t pad;
+} MeshLod;
+
+// Collapses edges in order of quadric error until at most `target_index_count` indices remain or
+// no collapse is left that keeps the surface from folding over. Vertices only ever collapse onto
+// other vertices, so the result indexes `mesh->vertices` like the original. Vertices on open
+// borders and attribute seams stay put. Returns the index count written to `out`, which must hold
+// `index_count` indices, and the object-space error in `error`.
+uint32_t mesh_simplify(const Mesh* mesh, const uint32_t* indices, uint32_t index_count, uint32_t target_index_count,
+                       uint32_t* out, float* error);
+
+// Appends up to `max_levels - 1` levels to the mesh's indices, each with about half the triangles
+// of the one before and optimized for the vertex cache, and describes all of them in `lods`.
+// Level 0 is the mesh as given. Returns the level count.
+uint32_t mesh_build_lods(Mesh* mesh, uint32_t max_levels, MeshLod* lods);
+
+// Pixels covered by one object-space unit at `center` under `mvp`, for a viewport `height` pixels
+// tall. FLT_MAX when the center is at or behind the eye, which selects level 0.
+float mesh_lod_pixels_per_unit(const Mat4* mvp, Vec3 center, float height);
+
+// The coarsest level whose projected error stays within `threshold` pixels. Moving to a coarser
+// level needs its error to be clearly inside the threshold, so a mesh hovering at a boundary
+// doesn't flicker between levels.
+uint32_t mesh_lod_select(const MeshLod* lods, uint32_t lod_count, uint32_t current, float pixels_per_unit,
+                         float threshold);
+
+#endif
@@ -0,0 +1,111 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mesh_meshlet.h"
+
+// The cluster's bounding sphere, centered on its box, and the cone around the mean triangle normal
+// that contains every triangle normal.
+static Meshlet meshlet_bounds(const Mesh* mesh, const uint32_t* indices, uint32_t index_offset,
+                              uint32_t index_count) {
+    Vec3 min = mesh->vertices[indices[0]].position;
+    Vec3 max = min;
+    for (uint32_t i = 1; i < index_count; i++) {
+        Vec3 p = mesh->vertices[indices[i]].position;
+        min    = (Vec3){ fminf(min.x, p.x), fminf(min.y, p.y), fminf(min.z, p.z) };
+        max    = (Vec3){ fmaxf(max.x, p.x), fmaxf(max.y, p.y), fmaxf(max.z, p.z) };
+    }
+    Meshlet meshlet = {
+        .center       = { 0.5f * (min.x + max.x), 0.5f * (min.y + max.y), 0.5f * (min.z + max.z) },
+        .cone_cutoff  = 1.0f,
+        .index_offset = index_offset,
+        .index_count  = index_count,
+    };
+    for (uint32_t i = 0; i < index_count; i++) {
+        Vec3 d         = vec3_sub(mesh->vertices[indices[i]].position, meshlet.center);
+        meshlet.radius = fmaxf(meshlet.radius, sqrtf(vec3_dot(d, d)));
+    }
+
+    Vec3     normals[MESHLET_MAX_TRIANGLES];
+    uint32_t normal_count = 0;
+    Vec3     axis         = {};
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        Vec3  a      = mesh->vertices[indices[i + 0]].position;
+        Vec3  b      = mesh->vertices[indices[i + 1]].position;
+        Vec3  c      = mesh->vertices[indices[i + 2]].position;
+        Vec3  n      = vec3_cross(vec3_sub(c, a), vec3_sub(b, a));
+        float length = sqrtf(vec3_dot(n, n));
+        if (length > 0.0f) {
+            n                       = (Vec3){ n.x / length, n.y / length, n.z / length };
+            normals[normal_count++] = n;
+            axis                    = (Vec3){ axis.x + n.x, axis.y + n.y, axis.z + n.z };
+        }
+    }
+    float axis_length = sqrtf(vec3_dot(axis, axis));
+    if (!normal_count || axis_length == 0.0f) {
+        return meshlet;
+    }
+    meshlet.cone_axis = (Vec3){ axis.x / axis_length, axis.y / axis_length, axis.z / axis_length };
+
+    // Normals spread over a hemisphere or more leave no direction the whole cluster faces away from.
+    float min_dot = 1.0f;
+    for (uint32_t i = 0; i < normal_count; i++) {
+        min_dot = fminf(min_dot, vec3_dot(normals[i], meshlet.cone_axis));
+    }
+    if (min_dot > 0.0f) {
+        meshlet.cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+    }
+    return meshlet;
+}
+
+// Triangles are taken in index order, which the vertex cache optimizer has already made local, and
+// a meshlet is closed as soon as the next triangle would break either limit.
+static uint32_t build_level(const Mesh* mesh, const MeshLod* lod, uint32_t* vertex_meshlet, uint32_t meshlet_base,
+                            Meshlet* meshlets) {
+    const uint32_t* indices       = mesh->indices;
+    uint32_t        count         = 0;
+    uint32_t        start         = lod->index_offset;
+    uint32_t        vertex_count  = 0;
+    uint32_t        end           = lod->index_offset + lod->index_count;
+    uint32_t        meshlet_stamp = meshlet_base + 1;
+    for (uint32_t i = start; i < end; i += 3) {
+        uint32_t new_vertices = 0;
+        for (uint32_t k = 0; k < 3; k++) {
+            new_vertices += vertex_meshlet[indices[i + k]] != meshlet_stamp;
+        }
+        if (vertex_count + new_vertices > MESHLET_MAX_VERTICES || i - start == 3 * MESHLET_MAX_TRIANGLES) {
+            meshlets[count++] = meshlet_bounds(mesh, indices + start, start, i - start);
+            start             = i;
+            vertex_count      = 0;
+            meshlet_stamp     = meshlet_base + count + 1;
+        }
+        for (uint32_t k = 0; k < 3; k++) {
+            if (vertex_meshlet[indices[i + k]] != meshlet_stamp) {
+                vertex_meshlet[indices[i + k]] = meshlet_stamp;
+                vertex_count++;
+            }
+        }
+    }
+    if (end > start) {
+        meshlets[count++] = meshlet_bounds(mesh, indices + start, start, end - start);
+    }
+    return count;
+}
+
+Meshlet* mesh_build_meshlets(const Mesh* mesh, MeshLod* lods, uint32_t lod_count, uint32_t* meshlet_count) {
+    // Every meshlet but a level's last holds at least a third of the vertex limit in triangles.
+    uint32_t capacity = 0;
+    for (uint32_t l = 0; l < lod_count; l++) {
+        capacity += lods[l].index_count / 3 / (MESHLET_MAX_VERTICES / 3) + 1;
+    }
+    Meshlet*  meshlets       = malloc(sizeof(Meshlet) * capacity);
+    uint32_t* vertex_meshlet = calloc(mesh->vertex_count ? mesh->vertex_count : 1, sizeof(uint32_t));
+    uint32_t  count          = 0;
+    for (uint32_t l = 0; l < lod_count; l++) {
+        lods[l].meshlet_offset = count;
+        lods[l].meshlet_count  = build_level(mesh, &lods[l], vertex_meshlet, count, meshlets + count);
+        count += lods[l].meshlet_count;
+    }
+    free(vertex_meshlet);
+    *meshlet_count = count;
+    return meshlets;
+}
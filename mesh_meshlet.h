@@ -0,0 +1,29 @@
+#ifndef mesh_meshlet_h
+#define mesh_meshlet_h
+#include "mesh.h"
+#include "mesh_lod.h"
+
+// Small enough for the post-transform cache and for a mesh shader's output limits.
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+// A cluster of consecutive triangles that is culled as a unit, laid out for std430 storage buffers.
+// The cluster is back-facing from every point in the cone
+// `dot(center - eye, cone_axis) >= cone_cutoff * length(center - eye) + radius`; a cutoff of 1
+// never culls.
+typedef struct {
+    Vec3     center;
+    float    radius;
+    Vec3     cone_axis;
+    float    cone_cutoff;
+    uint32_t index_offset;
+    uint32_t index_count;
+    uint32_t pad[2];
+} Meshlet;
+
+// Splits every LOD's indices, in their vertex cache order, into meshlets of at most
+// MESHLET_MAX_VERTICES unique vertices and MESHLET_MAX_TRIANGLES triangles, and records each
+// level's range of them in `lods`. Returns the meshlets, which the caller frees.
+Meshlet* mesh_build_meshlets(const Mesh* mesh, MeshLod* lods, uint32_t lod_count, uint32_t* meshlet_count);
+
+#endif
@@ -0,0 +1,332 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mesh_optimize.h"
+
+// A FIFO post-transform cache, the model most GPUs approximate. `cached` flags the vertices in
+// the ring so lookups are O(1) and a reset only touches the ring.
+typedef struct {
+    uint32_t* ring;
+    uint32_t  size;
+    uint32_t  head;
+    uint32_t  count;
+    uint8_t*  cached;
+} FifoCache;
+
+static FifoCache fifo_cache_create(uint32_t size, uint32_t vertex_count) {
+    return (FifoCache){
+        .ring   = malloc(sizeof(uint32_t) * size),
+        .size   = size,
+        .cached = calloc(vertex_count ? vertex_count : 1, 1),
+    };
+}
+
+static void fifo_cache_destroy(FifoCache* cache) {
+    free(cache->ring);
+    free(cache->cached);
+}
+
+static void fifo_cache_reset(FifoCache* cache) {
+    for (uint32_t i = 0; i < cache->count; i++) {
+        cache->cached[cache->ring[i]] = 0;
+    }
+    cache->head  = 0;
+    cache->count = 0;
+}
+
+// Returns 1 if `v` had to be transformed.
+static int fifo_cache_access(FifoCache* cache, uint32_t v) {
+    if (cache->cached[v]) {
+        return 0;
+    }
+    if (cache->count == cache->size) {
+        cache->cached[cache->ring[cache->head]] = 0;
+    } else {
+        cache->count++;
+    }
+    cache->ring[cache->head] = v;
+    cache->head              = (cache->head + 1) % cache->size;
+    cache->cached[v]         = 1;
+    return 1;
+}
+
+VertexCacheStats mesh_analyze_vertex_cache(const Mesh* mesh, uint32_t cache_size) {
+    VertexCacheStats stats = {};
+    if (mesh->index_count < 3) {
+        return stats;
+    }
+
+    FifoCache cache      = fifo_cache_create(cache_size, mesh->vertex_count);
+    uint8_t*  referenced = calloc(mesh->vertex_count, 1);
+    uint32_t  misses     = 0;
+    uint32_t  unique     = 0;
+    for (uint32_t i = 0; i < mesh->index_count; i++) {
+        uint32_t v = mesh->indices[i];
+        if (!referenced[v]) {
+            referenced[v] = 1;
+            unique++;
+        }
+        misses += fifo_cache_access(&cache, v);
+    }
+    fifo_cache_destroy(&cache);
+    free(referenced);
+
+    stats.acmr = (double) misses / (mesh->index_count / 3);
+    stats.atvr = (double) misses / unique;
+    return stats;
+}
+
+// For each vertex, the triangles using it: triangles[offsets[v]] up to triangles[offsets[v + 1]].
+typedef struct {
+    uint32_t* offsets;
+    uint32_t* triangles;
+} Adjacency;
+
+static Adjacency build_adjacency(const Mesh* mesh) {
+    Adjacency adjacency = {
+        .offsets   = calloc(mesh->vertex_count + 1, sizeof(uint32_t)),
+        .triangles = malloc(sizeof(uint32_t) * (mesh->index_count ? mesh->index_count : 1)),
+    };
+    for (uint32_t i = 0; i < mesh->index_count; i++) {
+        adjacency.offsets[mesh->indices[i] + 1]++;
+    }
+    for (uint32_t v = 0; v < mesh->vertex_count; v++) {
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+    }
+    uint32_t* fill = malloc(sizeof(uint32_t) * (mesh->vertex_count ? mesh->vertex_count : 1));
+    memcpy(fill, adjacency.offsets, sizeof(uint32_t) * mesh->vertex_count);
+    for (uint32_t i = 0; i < mesh->index_count; i++) {
+        adjacency.triangles[fill[mesh->indices[i]]++] = i / 3;
+    }
+    free(fill);
+    return adjacency;
+}
+
+// Tipsify, from Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and
+// Reduced Overdraw". It fans around one vertex at a time, emitting all its remaining triangles, and
+// moves to the neighbour that will still be in the cache once its own triangles are emitted. When no
+// neighbour qualifies it restarts from a recently used vertex, or the next one in index order;
+// those restarts are returned as `boundaries`, the triangle positions where the cache runs cold.
+static uint32_t* tipsify(const Mesh* mesh, uint32_t cache_size, uint32_t* boundaries, uint32_t* boundary_count) {
+    uint32_t  triangle_count = mesh->index_count / 3;
+    Adjacency adjacency      = build_adjacency(mesh);
+    uint32_t* live           = malloc(sizeof(uint32_t) * (mesh->vertex_count ? mesh->vertex_count : 1));
+    uint32_t* timestamps     = calloc(mesh->vertex_count ? mesh->vertex_count : 1, sizeof(uint32_t));
+    uint8_t*  emitted        = calloc(triangle_count ? triangle_count : 1, 1);
+    uint32_t* dead_ends      = malloc(sizeof(uint32_t) * (mesh->index_count ? mesh->index_count : 1));
+    uint32_t* output         = malloc(sizeof(uint32_t) * (mesh->index_count ? mesh->index_count : 1));
+    for (uint32_t v = 0; v < mesh->vertex_count; v++) {
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    }
+
+    uint32_t dead_end_count = 0;
+    uint32_t output_count   = 0;
+    uint32_t time           = cache_size + 1;
+    uint32_t cursor         = 0;
+    uint32_t fan            = 0;
+    *boundary_count         = 0;
+    while (mesh->vertex_count && output_count < triangle_count) {
+        uint32_t candidates_start = dead_end_count;
+        for (uint32_t a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; a++) {
+            uint32_t t = adjacency.triangles[a];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = 1;
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t v                   = mesh->indices[3 * t + k];
+                output[3 * output_count + k] = v;
+                dead_ends[dead_end_count++]  = v;
+                live[v]--;
+                if (time - timestamps[v] > cache_size) {
+                    timestamps[v] = time++;
+                }
+            }
+            output_count++;
+        }
+
+        // The best candidate entered the cache longest ago but will still be cached after its own
+        // triangles add up to two new vertices each.
+        uint32_t next     = UINT32_MAX;
+        uint32_t priority = 0;
+        for (uint32_t c = candidates_start; c < dead_end_count; c++) {
+            uint32_t v = dead_ends[c];
+            if (!live[v]) {
+                continue;
+            }
+            uint32_t p = 0;
+            if (time - timestamps[v] + 2 * live[v] <= cache_size) {
+                p = time - timestamps[v];
+            }
+            if (p > priority) {
+                priority = p;
+                next     = v;
+            }
+        }
+        if (next == UINT32_MAX) {
+            while (dead_end_count && next == UINT32_MAX) {
+                uint32_t v = dead_ends[--dead_end_count];
+                if (live[v]) {
+                    next = v;
+                }
+            }
+            for (; next == UINT32_MAX && cursor < mesh->vertex_count; cursor++) {
+                if (live[cursor]) {
+                    next = cursor;
+                }
+            }
+            if (next == UINT32_MAX) {
+                break;
+            }
+            if (boundaries) {
+                boundaries[(*boundary_count)++] = output_count;
+            }
+        }
+        fan = next;
+    }
+
+    free(adjacency.offsets);
+    free(adjacency.triangles);
+    free(live);
+    free(timestamps);
+    free(emitted);
+    free(dead_ends);
+    return output;
+}
+
+typedef struct {
+    uint32_t first; // Triangle offset into the Tipsify order.
+    uint32_t count;
+    float    sort_key;
+} Cluster;
+
+static int compare_clusters(const void* a, const void* b) {
+    float ka = ((const Cluster*) a)->sort_key;
+    float kb = ((const Cluster*) b)->sort_key;
+    return ka < kb ? 1 : ka > kb ? -1 : 0;
+}
+
+// Clusters are runs of the Tipsify order that start with a cold cache. Runs too short to pay for
+// their cold start are merged with the next, so reordering them costs at most OVERDRAW_ACMR_SLACK
+// in cache efficiency.
+#define OVERDRAW_ACMR_SLACK 1.05
+
+static uint32_t build_clusters(const Mesh* mesh, const uint32_t* boundaries, uint32_t boundary_count,
+                               uint32_t cache_size, Cluster* clusters) {
+    uint32_t         triangle_count = mesh->index_count / 3;
+    VertexCacheStats whole          = mesh_analyze_vertex_cache(mesh, cache_size);
+    FifoCache        cache          = fifo_cache_create(cache_size, mesh->vertex_count);
+    uint32_t         count          = 0;
+    uint32_t         first          = 0;
+    uint32_t         misses         = 0;
+    uint32_t         t              = 0;
+    for (uint32_t b = 0; b <= boundary_count; b++) {
+        uint32_t end = b < boundary_count ? boundaries[b] : triangle_count;
+        for (; t < end; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                misses += fifo_cache_access(&cache, mesh->indices[3 * t + k]);
+            }
+        }
+        if (end == first || (end < triangle_count && misses > OVERDRAW_ACMR_SLACK * whole.acmr * (end - first))) {
+            continue;
+        }
+        clusters[count++] = (Cluster){ .first = first, .count = end - first };
+        first             = end;
+        misses            = 0;
+        fifo_cache_reset(&cache);
+    }
+    fifo_cache_destroy(&cache);
+    return count;
+}
+
+// Sander et al.'s view-independent overdraw order: clusters whose area-weighted normal points away
+// from the mesh centroid are likely to occlude the rest, so they are drawn first.
+static void sort_clusters(const Mesh* mesh, Cluster* clusters, uint32_t cluster_count) {
+    Vec3 centroid = {};
+    for (uint32_t v = 0; v < mesh->vertex_count; v++) {
+        centroid = (Vec3){ centroid.x + mesh->vertices[v].position.x, centroid.y + mesh->vertices[v].position.y,
+                           centroid.z + mesh->vertices[v].position.z };
+    }
+    float inv = mesh->vertex_count ? 1.0f / mesh->vertex_count : 0.0f;
+    centroid  = (Vec3){ centroid.x * inv, centroid.y * inv, centroid.z * inv };
+
+    for (uint32_t c = 0; c < cluster_count; c++) {
+        Vec3  center = {};
+        Vec3  normal = {};
+        float area   = 0.0f;
+        for (uint32_t t = clusters[c].first; t < clusters[c].first + clusters[c].count; t++) {
+            Vec3 a = mesh->vertices[mesh->indices[3 * t + 0]].position;
+            Vec3 b = mesh->vertices[mesh->indices[3 * t + 1]].position;
+            Vec3 d = mesh->vertices[mesh->indices[3 * t + 2]].position;
+            // Clockwise winding, so this cross product points out of the mesh. Its length is twice
+            // the triangle's area.
+            Vec3  n = vec3_cross(vec3_sub(d, a), vec3_sub(b, a));
+            float w = sqrtf(vec3_dot(n, n));
+            normal  = (Vec3){ normal.x + n.x, normal.y + n.y, normal.z + n.z };
+            center  = (Vec3){ center.x + w * (a.x + b.x + d.x), center.y + w * (a.y + b.y + d.y),
+                              center.z + w * (a.z + b.z + d.z) };
+            area += 3.0f * w;
+        }
+        if (area > 0.0f) {
+            center = (Vec3){ center.x / area, center.y / area, center.z / area };
+        }
+        clusters[c].sort_key = vec3_dot(vec3_sub(center, centroid), normal);
+    }
+    qsort(clusters, cluster_count, sizeof(Cluster), compare_clusters);
+}
+
+void mesh_optimize_vertex_cache(Mesh* mesh, uint32_t cache_size, int reduce_overdraw) {
+    uint32_t  triangle_count = mesh->index_count / 3;
+    uint32_t* boundaries     = reduce_overdraw ? malloc(sizeof(uint32_t) * (triangle_count + 1)) : NULL;
+    uint32_t  boundary_count = 0;
+    uint32_t* order          = tipsify(mesh, cache_size, boundaries, &boundary_count);
+    free(mesh->indices);
+    mesh->indices = order;
+    if (!reduce_overdraw) {
+        return;
+    }
+
+    Cluster* clusters      = malloc(sizeof(Cluster) * (boundary_count + 1));
+    uint32_t cluster_count = build_clusters(mesh, boundaries, boundary_count, cache_size, clusters);
+    sort_clusters(mesh, clusters, cluster_count);
+
+    uint32_t* sorted = malloc(sizeof(uint32_t) * (mesh->index_count ? mesh->index_count : 1));
+    uint32_t* out    = sorted;
+    for (uint32_t c = 0; c < cluster_count; c++) {
+        memcpy(out, mesh->indices + 3 * clusters[c].first, sizeof(uint32_t) * 3 * clusters[c].count);
+        out += 3 * clusters[c].count;
+    }
+    free(mesh->indices);
+    mesh->indices = sorted;
+    free(clusters);
+    free(boundaries);
+}
+
+// Renumbers vertices in the order the index buffer first uses them, so vertex fetch walks memory
+// forward. Vertices no triangle uses are dropped.
+void mesh_optimize_vertex_fetch(Mesh* mesh) {
+    uint32_t* remap = malloc(sizeof(uint32_t) * (mesh->vertex_count ? mesh->vertex_count : 1));
+    memset(remap, 0xff, sizeof(uint32_t) * mesh->vertex_count);
+    MeshVertex* vertices = malloc(sizeof(MeshVertex) * (mesh->vertex_count ? mesh->vertex_count : 1));
+    uint32_t    count    = 0;
+    for (uint32_t i = 0; i < mesh->index_count; i++) {
+        uint32_t v = mesh->indices[i];
+        if (remap[v] == UINT32_MAX) {
+            remap[v]          = count;
+            vertices[count++] = mesh->vertices[v];
+        }
+        mesh->indices[i] = remap[v];
+    }
+    free(remap);
+    free(mesh->vertices);
+    mesh->vertices     = vertices;
+    mesh->vertex_count = count;
+}
+
+void mesh_optimize(Mesh* mesh, MeshOptimizeLevel level) {
+    if (level == MESH_OPTIMIZE_NONE) {
+        return;
+    }
+    mesh_optimize_vertex_cache(mesh, VERTEX_CACHE_SIZE, level == MESH_OPTIMIZE_OVERDRAW);
+    mesh_optimize_vertex_fetch(mesh);
+}
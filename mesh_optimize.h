@@ -0,0 +1,25 @@
+#ifndef mesh_optimize_h
+#define mesh_optimize_h
+#include "mesh.h"
+
+// FIFO entries assumed for the post-transform cache. Real caches vary by GPU; orders optimized for
+// a small cache stay good on larger ones.
+#define VERTEX_CACHE_SIZE 16
+
+typedef struct {
+    double acmr; // Average cache miss ratio: transformed vertices per triangle, 0.5 to 3.
+    double atvr; // Average transformed vertex ratio: transformed vertices per unique vertex, 1 is ideal.
+} VertexCacheStats;
+
+typedef enum {
+    MESH_OPTIMIZE_NONE,
+    MESH_OPTIMIZE_VERTEX_CACHE, // Tipsify triangle order, then vertices in fetch order.
+    MESH_OPTIMIZE_OVERDRAW,     // As above, with clusters sorted so outward-facing ones draw first.
+} MeshOptimizeLevel;
+
+VertexCacheStats mesh_analyze_vertex_cache(const Mesh* mesh, uint32_t cache_size);
+void             mesh_optimize_vertex_cache(Mesh* mesh, uint32_t cache_size, int reduce_overdraw);
+void             mesh_optimize_vertex_fetch(Mesh* mesh);
+void             mesh_optimize(Mesh* mesh, MeshOptimizeLevel level);
+
+#endif
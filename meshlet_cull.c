@@ -0,0 +1,237 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "meshlet_cull.h"
+#include "pipeline.h"
+
+#include "meshlet_cull.comp.in"
+
+#define WORKGROUP_MAX 65535
+#define DRAW_SIZE     (sizeof(VkDrawIndexedIndirectCommand) + sizeof(uint32_t))
+
+enum { FLAG_INDEX_16 = 1, FLAG_CONE = 2 };
+enum { BINDING_MESHLETS, BINDING_SOURCE_INDICES, BINDING_INDICES, BINDING_DRAW, BINDING_COUNT };
+
+// Matches the push constant block in meshlet_cull.comp.
+typedef struct {
+    float    planes[6][4];
+    Vec3     eye;
+    uint32_t meshlet_offset;
+    uint32_t meshlet_count;
+    uint32_t flags;
+} CullConstants;
+
+void meshlet_cull_create(GPU* gpu, VkPipelineCache cache, MeshletCull* cull, const Meshlet* meshlets,
+                         uint32_t meshlet_count, VkBuffer index_buffer, VkIndexType index_type,
+                         uint32_t max_index_count, uint32_t frame_count) {
+    assert(frame_count <= MESHLET_CULL_MAX_FRAMES);
+    *cull = (MeshletCull){ .source_index_type = index_type, .frame_count = frame_count };
+
+    VkDescriptorSetLayoutBinding bindings[BINDING_COUNT];
+    for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+        bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding          = i,
+            .descriptor_type  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptor_count = 1,
+            .stage_flags      = VK_SHADER_STAGE_COMPUTE_BIT,
+        };
+    }
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {
+        .s_type        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .binding_count = BINDING_COUNT,
+        .p_bindings    = bindings,
+    };
+    vk_create_descriptor_set_layout(gpu->device, &set_layout_info, NULL, &cull->set_layout);
+
+    VkPushConstantRange push_constant_range = {
+        .stage_flags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .size        = sizeof(CullConstants),
+    };
+    VkPipelineLayoutCreateInfo layout_info = {
+        .s_type                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .set_layout_count          = 1,
+        .p_set_layouts             = &cull->set_layout,
+        .push_constant_range_count = 1,
+        .p_push_constant_ranges    = &push_constant_range,
+    };
+    vk_create_pipeline_layout(gpu->device, &layout_info, NULL, &cull->layout);
+    gpu_set_debug_name(gpu, PIPELINE_LAYOUT, cull->layout, "Meshlet cull pipeline layout");
+
+    // One small compute pipeline, compiled up front rather than through the registry, which only
+    // knows graphics pipelines.
+    cull->shader                     = gpu_create_shader(gpu, MESHLET_CULL_COMP, sizeof(MESHLET_CULL_COMP));
+    VkComputePipelineCreateInfo info = {
+        .s_type = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage  = {
+            .s_type = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = cull->shader,
+            .p_name = "main",
+        },
+        .layout = cull->layout,
+    };
+    vk_create_compute_pipelines(gpu->device, cache, 1, &info, NULL, &cull->pipeline);
+    gpu_set_debug_name(gpu, PIPELINE, cull->pipeline, "Meshlet cull pipeline");
+
+    VkDescriptorPoolSize pool_size = {
+        .type             = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptor_count = BINDING_COUNT * frame_count,
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .s_type          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .max_sets        = frame_count,
+        .pool_size_count = 1,
+        .p_pool_sizes    = &pool_size,
+    };
+    vk_create_descriptor_pool(gpu->device, &pool_info, NULL, &cull->pool);
+
+    VkDeviceSize meshlet_size = sizeof(Meshlet) * (meshlet_count ? meshlet_count : 1);
+    cull->meshlets = gpu_create_buffer(gpu, &gpu->host_visible_heap, meshlet_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                       &cull->meshlet_memory, "Meshlet buffer");
+    memcpy(cull->meshlet_memory.mapped, meshlets, sizeof(Meshlet) * meshlet_count);
+
+    for (uint32_t i = 0; i < frame_count; i++) {
+        MeshletCullFrame* frame = &cull->frames[i];
+        char              name[48];
+        sprintf(name, "Culled index buffer %u", i);
+        frame->indices = gpu_create_buffer(gpu, &gpu->device_local_heap,
+                                           sizeof(uint32_t) * (VkDeviceSize) (max_index_count ? max_index_count : 1),
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                           &frame->index_memory, name);
+        // Host visible so the visible meshlet count can be read back for the statistics.
+        sprintf(name, "Culled draw buffer %u", i);
+        frame->draw = gpu_create_buffer(gpu, &gpu->host_visible_heap, DRAW_SIZE,
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                                            | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                        &frame->draw_memory, name);
+        memset(frame->draw_memory.mapped, 0, DRAW_SIZE);
+
+        VkDescriptorSetAllocateInfo set_info = {
+            .s_type               = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptor_pool      = cull->pool,
+            .descriptor_set_count = 1,
+            .p_set_layouts        = &cull->set_layout,
+        };
+        vk_allocate_descriptor_sets(gpu->device, &set_info, &frame->set);
+
+        VkDescriptorBufferInfo buffers[BINDING_COUNT] = {
+            [BINDING_MESHLETS]       = { cull->meshlets, 0, VK_WHOLE_SIZE },
+            [BINDING_SOURCE_INDICES] = { index_buffer, 0, VK_WHOLE_SIZE },
+            [BINDING_INDICES]        = { frame->indices, 0, VK_WHOLE_SIZE },
+            [BINDING_DRAW]           = { frame->draw, 0, VK_WHOLE_SIZE },
+        };
+        VkWriteDescriptorSet writes[BINDING_COUNT];
+        for (uint32_t b = 0; b < BINDING_COUNT; b++) {
+            writes[b] = (VkWriteDescriptorSet){
+                .s_type           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dst_set          = frame->set,
+                .dst_binding      = b,
+                .descriptor_count = 1,
+                .descriptor_type  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .p_buffer_info    = &buffers[b],
+            };
+        }
+        vk_update_descriptor_sets(gpu->device, BINDING_COUNT, writes, 0, NULL);
+    }
+}
+
+void meshlet_cull_destroy(GPU* gpu, MeshletCull* cull) {
+    for (uint32_t i = 0; i < cull->frame_count; i++) {
+        vk_destroy_buffer(gpu->device, cull->frames[i].indices, NULL);
+        vk_destroy_buffer(gpu->device, cull->frames[i].draw, NULL);
+    }
+    vk_destroy_buffer(gpu->device, cull->meshlets, NULL);
+    vk_destroy_descriptor_pool(gpu->device, cull->pool, NULL);
+    vk_destroy_pipeline(gpu->device, cull->pipeline, NULL);
+    vk_destroy_shader_module(gpu->device, cull->shader, NULL);
+    vk_destroy_pipeline_layout(gpu->device, cull->layout, NULL);
+    vk_destroy_descriptor_set_layout(gpu->device, cull->set_layout, NULL);
+}
+
+// The eye is the one point a perspective MVP sends to x = y = w = 0, so it can be recovered without
+// the view matrix by solving those three rows.
+static Vec3 extract_eye(const Mat4* m) {
+    Vec3  r0  = { m->xx, m->yx, m->zx };
+    Vec3  r1  = { m->xy, m->yy, m->zy };
+    Vec3  r2  = { m->xw, m->yw, m->zw };
+    Vec3  c12 = vec3_cross(r1, r2);
+    Vec3  c20 = vec3_cross(r2, r0);
+    Vec3  c01 = vec3_cross(r0, r1);
+    float det = vec3_dot(r0, c12);
+    float d0  = -m->wx / det;
+    float d1  = -m->wy / det;
+    float d2  = -m->ww / det;
+    return (Vec3){
+        d0 * c12.x + d1 * c20.x + d2 * c01.x,
+        d0 * c12.y + d1 * c20.y + d2 * c01.y,
+        d0 * c12.z + d1 * c20.z + d2 * c01.z,
+    };
+}
+
+void meshlet_cull_record(MeshletCull* cull, VkCommandBuffer cmd, uint32_t frame_index, const Mat4* mvp,
+                         uint32_t meshlet_offset, uint32_t meshlet_count, int cull_back_faces) {
+    MeshletCullFrame* frame = &cull->frames[frame_index];
+    frame->tested           = meshlet_count;
+
+    // An empty draw of one instance and no visible meshlets. The previous draw from this buffer
+    // finished before its frame's fence was signaled.
+    uint32_t reset[DRAW_SIZE / sizeof(uint32_t)] = { 0, 1 };
+    vk_cmd_update_buffer(cmd, frame->draw, 0, DRAW_SIZE, reset);
+
+    VkBufferMemoryBarrier to_compute = {
+        .s_type                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .src_access_mask        = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dst_access_mask        = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        .src_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .dst_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .buffer                 = frame->draw,
+        .size                   = VK_WHOLE_SIZE,
+    };
+    vk_cmd_pipeline_barrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 1,
+                            &to_compute, 0, NULL);
+
+    uint32_t      flags     = cull->source_index_type == VK_INDEX_TYPE_UINT16 ? FLAG_INDEX_16 : 0;
+    CullConstants constants = {
+        .eye            = extract_eye(mvp),
+        .meshlet_offset = meshlet_offset,
+        .meshlet_count  = meshlet_count,
+        .flags          = cull_back_faces ? flags | FLAG_CONE : flags,
+    };
+    mat4_frustum_planes(mvp, constants.planes);
+    vk_cmd_bind_pipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull->pipeline);
+    vk_cmd_bind_descriptor_sets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull->layout, 0, 1, &frame->set, 0, NULL);
+    vk_cmd_push_constants(cmd, cull->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    // Workgroup counts are only guaranteed up to 65535 per dimension, so large meshes spill into y.
+    uint32_t groups_x = meshlet_count < WORKGROUP_MAX ? meshlet_count : WORKGROUP_MAX;
+    if (groups_x) {
+        vk_cmd_dispatch(cmd, groups_x, (meshlet_count + groups_x - 1) / groups_x, 1);
+    }
+
+    VkBufferMemoryBarrier to_draw[2] = { to_compute, to_compute };
+    to_draw[0].src_access_mask       = VK_ACCESS_SHADER_WRITE_BIT;
+    to_draw[0].dst_access_mask       = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    to_draw[1].src_access_mask       = VK_ACCESS_SHADER_WRITE_BIT;
+    to_draw[1].dst_access_mask       = VK_ACCESS_INDEX_READ_BIT;
+    to_draw[1].buffer                = frame->indices;
+    vk_cmd_pipeline_barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                                | VK_PIPELINE_STAGE_HOST_BIT,
+                            0, 0, NULL, 2, to_draw, 0, NULL);
+}
+
+void meshlet_cull_draw(MeshletCull* cull, VkCommandBuffer cmd, uint32_t frame_index) {
+    MeshletCullFrame* frame = &cull->frames[frame_index];
+    vk_cmd_bind_index_buffer(cmd, frame->indices, 0, VK_INDEX_TYPE_UINT32);
+    vk_cmd_draw_indexed_indirect(cmd, frame->draw, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+MeshletCullStats meshlet_cull_read_stats(const MeshletCull* cull, uint32_t frame_index) {
+    // Host coherent, so nothing needs invalidating.
+    const uint32_t* draw = cull->frames[frame_index].draw_memory.mapped;
+    return (MeshletCullStats){
+        .tested           = cull->frames[frame_index].tested,
+        .visible_meshlets = draw[5],
+        .triangles        = draw[0] / 3,
+    };
+}
@@ -0,0 +1,61 @@
+#ifndef meshlet_cull_h
+#define meshlet_cull_h
+#include "gpu.h"
+#include "linalg.h"
+#include "mesh_meshlet.h"
+
+#define MESHLET_CULL_MAX_FRAMES 8
+
+// Per frame in flight, so a frame's output isn't overwritten while an earlier one still draws it.
+typedef struct {
+    VkBuffer        indices; // Compacted uint32 indices of the visible meshlets.
+    MemoryBlock     index_memory;
+    VkBuffer        draw; // VkDrawIndexedIndirectCommand, then the visible meshlet count.
+    MemoryBlock     draw_memory;
+    VkDescriptorSet set;
+    uint32_t        tested; // Meshlets the last recorded pass tested.
+} MeshletCullFrame;
+
+// A compute pass that culls meshlets against the frustum and by normal cone and compacts the
+// surviving meshlets' indices into a list drawn with one vkCmdDrawIndexedIndirect. Storage buffers,
+// compute and a single indirect draw are core Vulkan 1.0, so it runs everywhere, software
+// rasterizers included; multi-draw indirect and draw count buffers aren't needed.
+typedef struct {
+    VkDescriptorSetLayout set_layout;
+    VkPipelineLayout      layout;
+    VkShaderModule        shader;
+    VkPipeline            pipeline;
+    VkDescriptorPool      pool;
+    VkBuffer              meshlets;
+    MemoryBlock           meshlet_memory;
+    VkIndexType           source_index_type;
+    MeshletCullFrame      frames[MESHLET_CULL_MAX_FRAMES];
+    uint32_t              frame_count;
+} MeshletCull;
+
+typedef struct {
+    uint32_t tested;
+    uint32_t visible_meshlets;
+    uint32_t triangles;
+} MeshletCullStats;
+
+// `index_buffer` holds the mesh's indices in `index_type` and must have been created with
+// VK_BUFFER_USAGE_STORAGE_BUFFER_BIT and a size rounded up to 4 bytes. Outputs are sized for the
+// largest LOD, `max_index_count` indices.
+void meshlet_cull_create(GPU* gpu, VkPipelineCache cache, MeshletCull* cull, const Meshlet* meshlets,
+                         uint32_t meshlet_count, VkBuffer index_buffer, VkIndexType index_type,
+                         uint32_t max_index_count, uint32_t frame_count);
+void meshlet_cull_destroy(GPU* gpu, MeshletCull* cull);
+
+// Records the culling of `meshlet_count` meshlets from `meshlet_offset` under `mvp`, the
+// object-space MVP. Must be outside a render pass.
+void meshlet_cull_record(MeshletCull* cull, VkCommandBuffer cmd, uint32_t frame_index, const Mat4* mvp,
+                         uint32_t meshlet_offset, uint32_t meshlet_count, int cull_back_faces);
+
+// Binds the compacted indices and draws them. Vertex buffers and the pipeline are the caller's.
+void meshlet_cull_draw(MeshletCull* cull, VkCommandBuffer cmd, uint32_t frame_index);
+
+// What the pass recorded for `frame_index` kept, once that frame's fence has been waited on.
+MeshletCullStats meshlet_cull_read_stats(const MeshletCull* cull, uint32_t frame_index);
+
+#endif
@@ -0,0 +1,542 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "pipeline.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+// Setting a constant twice replaces its value, so variants can be derived from each other.
+static SpecializationConstant* variant_constant(ShaderVariant* variant, uint32_t id, SpecializationType type) {
+    SpecializationConstant* constant = NULL;
+    for (uint32_t i = 0; i < variant->count && !constant; i++) {
+        if (variant->constants[i].id == id) {
+            constant = &variant->constants[i];
+        }
+    }
+    if (!constant) {
+        assert(variant->count < SHADER_VARIANT_MAX_CONSTANTS);
+        constant = &variant->constants[variant->count++];
+    }
+    memset(constant, 0, sizeof(*constant));
+    constant->id   = id;
+    constant->type = type;
+    return constant;
+}
+
+void shader_variant_set_bool(ShaderVariant* variant, uint32_t id, VkBool32 value) {
+    variant_constant(variant, id, SPECIALIZATION_BOOL)->value.b = value ? VK_TRUE : VK_FALSE;
+}
+
+void shader_variant_set_int(ShaderVariant* variant, uint32_t id, int32_t value) {
+    variant_constant(variant, id, SPECIALIZATION_INT)->value.i = value;
+}
+
+void shader_variant_set_uint(ShaderVariant* variant, uint32_t id, uint32_t value) {
+    variant_constant(variant, id, SPECIALIZATION_UINT)->value.u = value;
+}
+
+void shader_variant_set_float(ShaderVariant* variant, uint32_t id, float value) {
+    variant_constant(variant, id, SPECIALIZATION_FLOAT)->value.f = value;
+}
+
+// Each constant is 4 bytes at 4 * its index in `data`.
+static VkSpecializationInfo specialization_info(const ShaderVariant* variant, VkSpecializationMapEntry* entries,
+                                                uint32_t* data) {
+    for (uint32_t i = 0; i < variant->count; i++) {
+        const SpecializationConstant* constant = &variant->constants[i];
+        entries[i] = (VkSpecializationMapEntry){
+            .constant_id = constant->id,
+            .offset      = i * sizeof(*data),
+            .size        = sizeof(*data),
+        };
+        memcpy(&data[i], &constant->value, sizeof(*data));
+    }
+    return (VkSpecializationInfo){
+        .map_entry_count = variant->count,
+        .p_map_entries   = entries,
+        .data_size       = variant->count * sizeof(*data),
+        .p_data          = data,
+    };
+}
+
+VkPipelineLayout gpu_create_pipeline_layout(GPU* gpu, const PipelineLayoutDesc* desc) {
+    VkPushConstantRange push_constant_range = {
+        .stage_flags = desc->push_constant_stages,
+        .offset      = 0,
+        .size        = desc->push_constant_size,
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .s_type                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .set_layout_count          = desc->set_layout ? 1 : 0,
+        .p_set_layouts             = &desc->set_layout,
+        .push_constant_range_count = desc->push_constant_size ? 1 : 0,
+        .p_push_constant_ranges    = &push_constant_range,
+    };
+
+    VkPipelineLayout pipeline_layout;
+    vk_create_pipeline_layout(gpu->device, &pipeline_layout_info, NULL, &pipeline_layout);
+
+    gpu_set_debug_name(gpu, PIPELINE_LAYOUT, pipeline_layout, "Pipeline layout");
+
+    return pipeline_layout;
+}
+
+VkShaderModule gpu_create_shader(GPU* gpu, const uint32_t* code, VkDeviceSize size) {
+    VkShaderModuleCreateInfo info = {
+        .s_type    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .code_size = size,
+        .p_code    = code,
+    };
+    VkShaderModule shader;
+    vk_create_shader_module(gpu->device, &info, NULL, &shader);
+    return shader;
+}
+
+// Creates the complete pipeline for `desc` when `library` is 0, or else the graphics pipeline
+// library holding just that part of it.
+static VkPipeline create_pipeline(GPU* gpu, VkPipelineCache cache, const PipelineDesc* desc,
+                                  VkGraphicsPipelineLibraryFlagsEXT library) {
+    VkSpecializationMapEntry vertex_entries[SHADER_VARIANT_MAX_CONSTANTS];
+    uint32_t                 vertex_data[SHADER_VARIANT_MAX_CONSTANTS];
+    VkSpecializationInfo     vertex_specialization =
+        specialization_info(&desc->vertex_variant, vertex_entries, vertex_data);
+    VkSpecializationMapEntry fragment_entries[SHADER_VARIANT_MAX_CONSTANTS];
+    uint32_t                 fragment_data[SHADER_VARIANT_MAX_CONSTANTS];
+    VkSpecializationInfo     fragment_specialization =
+        specialization_info(&desc->fragment_variant, fragment_entries, fragment_data);
+
+    VkPipelineShaderStageCreateInfo vertex_stage = {
+        .s_type                = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage                 = VK_SHADER_STAGE_VERTEX_BIT,
+        .module                = desc->vertex_shader,
+        .p_name                = "main",
+        .p_specialization_info = desc->vertex_variant.count ? &vertex_specialization : NULL,
+    };
+    VkPipelineShaderStageCreateInfo fragment_stage = {
+        .s_type                = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage                 = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .module                = desc->fragment_shader,
+        .p_name                = "main",
+        .p_specialization_info = desc->fragment_variant.count ? &fragment_specialization : NULL,
+    };
+    VkPipelineShaderStageCreateInfo stages[] = { vertex_stage, fragment_stage };
+
+    VkVertexInputBindingDescription vertex_binding = {
+        .binding    = 0,
+        .stride     = desc->vertex_layout.stride,
+        .input_rate = VK_VERTEX_INPUT_RATE_VERTEX,
+    };
+    VkPipelineVertexInputStateCreateInfo pipeline_vertex_info = {
+        .s_type                             = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertex_binding_description_count   = 1,
+        .p_vertex_binding_descriptions      = &vertex_binding,
+        .vertex_attribute_description_count = desc->vertex_layout.attribute_count,
+        .p_vertex_attribute_descriptions    = desc->vertex_layout.attributes,
+    };
+    VkPipelineInputAssemblyStateCreateInfo pipeline_assembly_info = {
+        .s_type                   = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology                 = desc->topology,
+        .primitive_restart_enable = VK_FALSE,
+    };
+    VkPipelineRasterizationStateCreateInfo pipeline_rasterization_info = {
+        .s_type                     = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depth_clamp_enable         = VK_FALSE,
+        .rasterizer_discard_enable  = VK_FALSE,
+        .polygon_mode               = VK_POLYGON_MODE_FILL,
+        .cull_mode                  = desc->cull_mode,
+        .front_face                 = desc->front_face,
+        .depth_bias_enable          = VK_FALSE,
+        .depth_bias_constant_factor = 0,
+        .depth_bias_clamp           = 0,
+        .depth_bias_slope_factor    = 0,
+        .line_width                 = 1.0f,
+    };
+    VkPipelineColorBlendAttachmentState pipeline_blend_attachment = {
+        .blend_enable           = VK_FALSE,
+        .src_color_blend_factor = VK_BLEND_FACTOR_ZERO,
+        .dst_color_blend_factor = VK_BLEND_FACTOR_ZERO,
+        .color_blend_op         = VK_BLEND_OP_ADD,
+        .src_alpha_blend_factor = VK_BLEND_FACTOR_ZERO,
+        .dst_alpha_blend_factor = VK_BLEND_FACTOR_ZERO,
+        .alpha_blend_op         = VK_BLEND_OP_ADD,
+        .color_write_mask       = 0xf,
+    };
+    VkPipelineColorBlendStateCreateInfo pipeline_blend_info = {
+        .s_type           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logic_op_enable  = VK_FALSE,
+        .logic_op         = VK_LOGIC_OP_NO_OP,
+        .attachment_count = 1,
+        .p_attachments    = &pipeline_blend_attachment,
+        .blend_constants  = { 1.0f, 1.0f, 1.0f, 1.0f },
+    };
+    // Viewport and scissor are set when drawing, so pipelines survive a resize.
+    VkPipelineViewportStateCreateInfo pipeline_viewport_info = {
+        .s_type         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewport_count = 1,
+        .scissor_count  = 1,
+    };
+    VkDynamicState dynamic_states[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+        VK_DYNAMIC_STATE_CULL_MODE_EXT,
+        VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+        VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT,
+        VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+        VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+    };
+    VkPipelineDynamicStateCreateInfo pipeline_dynamic_info = {
+        .s_type              = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamic_state_count = gpu->extended_dynamic_state ? ARRAY_SIZE(dynamic_states) : 2,
+        .p_dynamic_states    = dynamic_states,
+    };
+    VkStencilOpState stencil_op = {
+        .fail_op       = VK_STENCIL_OP_KEEP,
+        .pass_op       = VK_STENCIL_OP_KEEP,
+        .depth_fail_op = VK_STENCIL_OP_KEEP,
+        .compare_op    = VK_COMPARE_OP_ALWAYS,
+        .compare_mask  = 0,
+        .write_mask    = 0,
+        .reference     = 0,
+    };
+    VkPipelineDepthStencilStateCreateInfo pipeline_depth_info = {
+        .s_type                   = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depth_test_enable        = desc->depth_test,
+        .depth_write_enable       = desc->depth_test,
+        .depth_compare_op         = VK_COMPARE_OP_LESS_OR_EQUAL,
+        .depth_bounds_test_enable = VK_FALSE,
+        .stencil_test_enable      = VK_FALSE,
+        .front                    = stencil_op,
+        .back                     = stencil_op,
+        .min_depth_bounds         = 0,
+        .max_depth_bounds         = 0,
+    };
+    VkPipelineMultisampleStateCreateInfo pipeline_multisample_info = {
+        .s_type                   = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterization_samples    = VK_SAMPLE_COUNT_1_BIT,
+        .sample_shading_enable    = VK_FALSE,
+        .min_sample_shading       = 0.0f,
+        .alpha_to_coverage_enable = VK_FALSE,
+        .alpha_to_one_enable      = VK_FALSE,
+    };
+    VkGraphicsPipelineCreateInfo pipeline_info = {
+        .s_type                 = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stage_count            = ARRAY_SIZE(stages),
+        .p_stages               = stages,
+        .p_vertex_input_state   = &pipeline_vertex_info,
+        .p_input_assembly_state = &pipeline_assembly_info,
+        .p_viewport_state       = &pipeline_viewport_info,
+        .p_rasterization_state  = &pipeline_rasterization_info,
+        .p_multisample_state    = &pipeline_multisample_info,
+        .p_depth_stencil_state  = &pipeline_depth_info,
+        .p_color_blend_state    = &pipeline_blend_info,
+        .p_dynamic_state        = &pipeline_dynamic_info,
+        .layout                 = desc->layout,
+        .render_pass            = desc->render_pass,
+        .subpass                = 0,
+    };
+
+    // Each library part takes only its own state. Dynamic state is given to every part, and each
+    // uses the states that belong to it.
+    VkGraphicsPipelineLibraryCreateInfoEXT library_info = {
+        .s_type = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+        .flags  = library,
+    };
+    if (library) {
+        assert(gpu->graphics_pipeline_library);
+        pipeline_info.p_next = &library_info;
+        pipeline_info.flags =
+            VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+        if (!(library & VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT)) {
+            pipeline_info.p_vertex_input_state   = NULL;
+            pipeline_info.p_input_assembly_state = NULL;
+        }
+        if (!(library & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT)) {
+            pipeline_info.p_viewport_state      = NULL;
+            pipeline_info.p_rasterization_state = NULL;
+        }
+        if (!(library & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT)) {
+            pipeline_info.p_depth_stencil_state = NULL;
+        }
+        if (!(library & (VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT
+                         | VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT))) {
+            pipeline_info.p_multisample_state = NULL;
+        }
+        if (!(library & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)) {
+            pipeline_info.p_color_blend_state = NULL;
+        }
+        if (!(library & (VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT
+                         | VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT))) {
+            pipeline_info.layout = VK_NULL_HANDLE;
+        }
+        if (library == VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT) {
+            pipeline_info.render_pass = VK_NULL_HANDLE;
+        }
+        uint32_t stage_count = 0;
+        if (library & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT) {
+            stages[stage_count++] = vertex_stage;
+        }
+        if (library & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT) {
+            stages[stage_count++] = fragment_stage;
+        }
+        pipeline_info.stage_count = stage_count;
+        pipeline_info.p_stages    = stage_count ? stages : NULL;
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    vk_create_graphics_pipelines(gpu->device, cache, 1, &pipeline_info, NULL, &pipeline);
+    gpu_set_debug_name(gpu, PIPELINE, pipeline, desc->name ? desc->name : "Pipeline");
+
+    return pipeline;
+}
+
+VkPipeline gpu_create_pipeline(GPU* gpu, VkPipelineCache cache, const PipelineDesc* desc) {
+    return create_pipeline(gpu, cache, desc, 0);
+}
+
+VkPipeline gpu_create_pipeline_library(GPU* gpu, VkPipelineCache cache, const PipelineDesc* desc,
+                                       VkGraphicsPipelineLibraryFlagsEXT library) {
+    return create_pipeline(gpu, cache, desc, library);
+}
+
+// Links complete libraries into a pipeline. Without `optimize` this only stitches the parts
+// together, which is what makes it fast; with it the driver recompiles across the parts.
+VkPipeline gpu_link_pipeline(GPU* gpu, VkPipelineCache cache, VkPipelineLayout layout, const VkPipeline* libraries,
+                             uint32_t library_count, int optimize) {
+    VkPipelineLibraryCreateInfoKHR library_info = {
+        .s_type        = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+        .library_count = library_count,
+        .p_libraries   = libraries,
+    };
+    VkGraphicsPipelineCreateInfo pipeline_info = {
+        .s_type = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .p_next = &library_info,
+        .flags  = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0,
+        .layout = layout,
+    };
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    vk_create_graphics_pipelines(gpu->device, cache, 1, &pipeline_info, NULL, &pipeline);
+    gpu_set_debug_name(gpu, PIPELINE, pipeline, optimize ? "Optimized linked pipeline" : "Linked pipeline");
+
+    return pipeline;
+}
+
+static VkPrimitiveTopology topology_class(VkPrimitiveTopology topology) {
+    switch (topology) {
+    case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+        return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+        return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+        return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+    default:
+        return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    }
+}
+
+// Resets the state that is dynamic on this GPU, so descriptions that differ only in it map to the
+// same pipeline. Dynamic topology must stay within the class the pipeline was created with.
+PipelineDesc pipeline_desc_canonical(const GPU* gpu, const PipelineDesc* desc) {
+    PipelineDesc canonical = *desc;
+    if (gpu->extended_dynamic_state) {
+        canonical.topology   = topology_class(desc->topology);
+        canonical.cull_mode  = VK_CULL_MODE_NONE;
+        canonical.front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        canonical.depth_test = VK_FALSE;
+    }
+    return canonical;
+}
+
+// Copies `variant` sorted by constant id, so the order constants were set in doesn't matter.
+static void variant_key(ShaderVariant* key, const ShaderVariant* variant) {
+    key->count = variant->count;
+    for (uint32_t i = 0; i < variant->count; i++) {
+        SpecializationConstant constant = variant->constants[i];
+        uint32_t               j        = i;
+        for (; j > 0 && key->constants[j - 1].id > constant.id; j--) {
+            key->constants[j] = key->constants[j - 1];
+        }
+        key->constants[j] = constant;
+    }
+}
+
+PipelineKey pipeline_key(const GPU* gpu, const PipelineDesc* desc) {
+    PipelineDesc canonical = pipeline_desc_canonical(gpu, desc);
+    PipelineKey  key;
+    memset(&key, 0, sizeof(key));
+    key.vertex_shader          = (uint64_t) canonical.vertex_shader;
+    key.fragment_shader        = (uint64_t) canonical.fragment_shader;
+    key.layout                 = (uint64_t) canonical.layout;
+    key.render_pass            = (uint64_t) canonical.render_pass;
+    key.topology               = canonical.topology;
+    key.cull_mode              = canonical.cull_mode;
+    key.front_face             = canonical.front_face;
+    key.depth_test             = canonical.depth_test;
+    key.vertex_stride          = canonical.vertex_layout.stride;
+    key.vertex_attribute_count = canonical.vertex_layout.attribute_count;
+    for (uint32_t i = 0; i < canonical.vertex_layout.attribute_count; i++) {
+        key.vertex_attributes[i] = canonical.vertex_layout.attributes[i];
+    }
+    variant_key(&key.vertex_variant, &canonical.vertex_variant);
+    variant_key(&key.fragment_variant, &canonical.fragment_variant);
+    return key;
+}
+
+// The key of one library part keeps only the state that part is built from, so e.g. every pipeline
+// with the same vertex shader and raster state shares its pre-rasterization library.
+PipelineKey pipeline_library_key(const GPU* gpu, const PipelineDesc* desc, VkGraphicsPipelineLibraryFlagsEXT library) {
+    PipelineKey full = pipeline_key(gpu, desc);
+    PipelineKey key;
+    memset(&key, 0, sizeof(key));
+    key.library = library;
+    switch (library) {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+        key.topology               = full.topology;
+        key.vertex_stride          = full.vertex_stride;
+        key.vertex_attribute_count = full.vertex_attribute_count;
+        memcpy(key.vertex_attributes, full.vertex_attributes, sizeof(key.vertex_attributes));
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+        key.vertex_shader  = full.vertex_shader;
+        key.vertex_variant = full.vertex_variant;
+        key.layout         = full.layout;
+        key.render_pass    = full.render_pass;
+        key.cull_mode      = full.cull_mode;
+        key.front_face     = full.front_face;
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+        key.fragment_shader  = full.fragment_shader;
+        key.fragment_variant = full.fragment_variant;
+        key.layout           = full.layout;
+        key.render_pass      = full.render_pass;
+        key.depth_test       = full.depth_test;
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+        key.render_pass = full.render_pass;
+        break;
+    }
+    return key;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+// A word-at-a-time multiply-rotate hash, a few cycles per 8 bytes. Keys are fixed-size and short,
+// so there's no need for anything stronger.
+uint64_t pipeline_hash(const void* key, size_t size) {
+    const uint8_t* bytes = key;
+    uint64_t       hash  = 0x9e3779b97f4a7c15ull ^ size;
+    for (; size >= 8; bytes += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        hash ^= word * 0x87c37b91114253d5ull;
+        hash = ((hash << 31) | (hash >> 33)) * 0x4cf5ad432745937full;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes, size);
+    return mix64(hash ^ tail);
+}
+
+// Sets the dynamic state for drawing with `desc`. Must follow every pipeline bind that may have
+// been created from a different description.
+void pipeline_cmd_set_state(const GPU* gpu, VkCommandBuffer cmd, const PipelineDesc* desc, VkExtent2D extent) {
+    VkViewport viewport = {
+        .x         = 0.0f,
+        .y         = 0.0f,
+        .width     = extent.width,
+        .height    = extent.height,
+        .min_depth = 0.0f,
+        .max_depth = 1.0f,
+    };
+    VkRect2D scissor = {
+        .offset = { 0, 0 },
+        .extent = extent,
+    };
+    vk_cmd_set_viewport(cmd, 0, 1, &viewport);
+    vk_cmd_set_scissor(cmd, 0, 1, &scissor);
+    if (gpu->extended_dynamic_state) {
+        gpu_cmd_set_extended_dynamic_state(gpu, cmd, desc->cull_mode, desc->front_face, desc->topology,
+                                           desc->depth_test);
+    }
+}
+
+static void build_pipeline(void* data) {
+    PipelineFuture* future = data;
+    uint64_t        start  = bench_time_ns();
+
+    VkPipelineCache cache = pipeline_cache_begin_use(future->cache);
+    switch (future->build) {
+    case PIPELINE_BUILD_COMPLETE:
+        future->pipeline = gpu_create_pipeline(future->gpu, cache, &future->desc);
+        break;
+    case PIPELINE_BUILD_LIBRARY:
+        future->pipeline = gpu_create_pipeline_library(future->gpu, cache, &future->desc, future->library);
+        break;
+    case PIPELINE_BUILD_OPTIMIZED_LINK:
+        future->pipeline = gpu_link_pipeline(future->gpu, cache, future->desc.layout, future->libraries,
+                                             future->library_count, 1);
+        break;
+    }
+    pipeline_cache_end_use(future->cache);
+
+    future->compile_ms = bench_elapsed_ms(start);
+}
+
+// Queues every description for compilation on the job system. Each future can be waited on or
+// polled on its own, so callers can start using pipelines as they finish.
+void pipeline_build_batch(JobSystem* jobs, GPU* gpu, PipelineCache* cache, const PipelineDesc* descs, uint32_t count,
+                          PipelineFuture* futures) {
+    for (uint32_t i = 0; i < count; i++) {
+        futures[i] = (PipelineFuture){
+            .desc  = descs[i],
+            .gpu   = gpu,
+            .cache = cache,
+        };
+        job_submit(jobs, &futures[i].job, build_pipeline, &futures[i]);
+    }
+}
+
+void pipeline_build_library(JobSystem* jobs, GPU* gpu, PipelineCache* cache, const PipelineDesc* desc,
+                            VkGraphicsPipelineLibraryFlagsEXT library, PipelineFuture* future) {
+    *future = (PipelineFuture){
+        .desc    = *desc,
+        .gpu     = gpu,
+        .cache   = cache,
+        .build   = PIPELINE_BUILD_LIBRARY,
+        .library = library,
+    };
+    job_submit(jobs, &future->job, build_pipeline, future);
+}
+
+// The libraries must stay alive until the future is done.
+void pipeline_build_optimized_link(JobSystem* jobs, GPU* gpu, PipelineCache* cache, const PipelineDesc* desc,
+                                   const VkPipeline* libraries, uint32_t library_count, PipelineFuture* future) {
+    assert(library_count <= PIPELINE_LIBRARY_PARTS);
+    *future = (PipelineFuture){
+        .desc          = *desc,
+        .gpu           = gpu,
+        .cache         = cache,
+        .build         = PIPELINE_BUILD_OPTIMIZED_LINK,
+        .library_count = library_count,
+    };
+    memcpy(future->libraries, libraries, sizeof(*libraries) * library_count);
+    job_submit(jobs, &future->job, build_pipeline, future);
+}
+
+int pipeline_future_ready(const PipelineFuture* future) {
+    return job_done(&future->job);
+}
+
+VkPipeline pipeline_future_wait(JobSystem* jobs, PipelineFuture* future) {
+    job_wait(jobs, &future->job);
+    return future->pipeline;
+}
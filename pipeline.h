@@ -0,0 +1,134 @@
+#ifndef pipeline_h
+#define pipeline_h
+#include "gpu.h"
+#include "job.h"
+#include "pipeline_cache.h"
+
+#define VERTEX_LAYOUT_MAX_ATTRIBUTES 4
+#define SHADER_VARIANT_MAX_CONSTANTS 8
+#define PIPELINE_LIBRARY_PARTS       4
+
+typedef struct {
+    uint32_t                          stride;
+    uint32_t                          attribute_count;
+    VkVertexInputAttributeDescription attributes[VERTEX_LAYOUT_MAX_ATTRIBUTES];
+} VertexLayout;
+
+typedef enum {
+    SPECIALIZATION_BOOL,
+    SPECIALIZATION_INT,
+    SPECIALIZATION_UINT,
+    SPECIALIZATION_FLOAT,
+} SpecializationType;
+
+// Every type is 4 bytes, matching the SPIR-V scalar the constant specializes.
+typedef struct {
+    uint32_t           id; // The shader's layout(constant_id = ...).
+    SpecializationType type;
+    union {
+        VkBool32 b;
+        int32_t  i;
+        uint32_t u;
+        float    f;
+    } value;
+} SpecializationConstant;
+
+// Compile-time feature toggles for one shader stage. Constants that aren't set keep the default
+// declared in the shader, so the zero value is the shader's default variant.
+typedef struct {
+    uint32_t               count;
+    SpecializationConstant constants[SHADER_VARIANT_MAX_CONSTANTS];
+} ShaderVariant;
+
+typedef struct {
+    VkShaderStageFlags    push_constant_stages;
+    uint32_t              push_constant_size;
+    VkDescriptorSetLayout set_layout; // Set 0, or VK_NULL_HANDLE for none.
+} PipelineLayoutDesc;
+
+// Everything that distinguishes one graphics pipeline from another. Descriptions are plain values
+// so they can be copied into jobs and compared. Cull mode, front face, topology and depth test are
+// dynamic when the GPU supports extended dynamic state, see pipeline_desc_canonical.
+typedef struct {
+    VkShaderModule      vertex_shader;
+    VkShaderModule      fragment_shader;
+    ShaderVariant       vertex_variant;
+    ShaderVariant       fragment_variant;
+    VertexLayout        vertex_layout;
+    VkPipelineLayout    layout;
+    VkRenderPass        render_pass;
+    VkPrimitiveTopology topology;
+    VkCullModeFlags     cull_mode;
+    VkFrontFace         front_face;
+    VkBool32            depth_test;
+    const char*         name;
+} PipelineDesc;
+
+// The identity of a pipeline as plain bytes. Keys are built field by field into zeroed storage and
+// leave out names, so equal pipelines have equal bytes and keys can be hashed and compared with
+// memcmp.
+typedef struct {
+    uint64_t                          vertex_shader;
+    uint64_t                          fragment_shader;
+    uint64_t                          layout;
+    uint64_t                          render_pass;
+    uint32_t                          library; // The VkGraphicsPipelineLibraryFlagsEXT part, or 0.
+    uint32_t                          topology;
+    uint32_t                          cull_mode;
+    uint32_t                          front_face;
+    uint32_t                          depth_test;
+    uint32_t                          vertex_stride;
+    uint32_t                          vertex_attribute_count;
+    VkVertexInputAttributeDescription vertex_attributes[VERTEX_LAYOUT_MAX_ATTRIBUTES];
+    ShaderVariant                     vertex_variant; // Sorted by constant id.
+    ShaderVariant                     fragment_variant;
+} PipelineKey;
+
+typedef enum {
+    PIPELINE_BUILD_COMPLETE,
+    PIPELINE_BUILD_LIBRARY,        // The graphics pipeline library part `library` of `desc`.
+    PIPELINE_BUILD_OPTIMIZED_LINK, // `libraries` linked with link-time optimization.
+} PipelineBuild;
+
+typedef struct {
+    Job                               job;
+    PipelineDesc                      desc;
+    GPU*                              gpu;
+    PipelineCache*                    cache;
+    PipelineBuild                     build;
+    VkGraphicsPipelineLibraryFlagsEXT library;
+    VkPipeline                        libraries[PIPELINE_LIBRARY_PARTS];
+    uint32_t                          library_count;
+    VkPipeline                        pipeline;
+    double                            compile_ms;
+} PipelineFuture;
+
+void shader_variant_set_bool(ShaderVariant* variant, uint32_t id, VkBool32 value);
+void shader_variant_set_int(ShaderVariant* variant, uint32_t id, int32_t value);
+void shader_variant_set_uint(ShaderVariant* variant, uint32_t id, uint32_t value);
+void shader_variant_set_float(ShaderVariant* variant, uint32_t id, float value);
+
+VkPipelineLayout gpu_create_pipeline_layout(GPU* gpu, const PipelineLayoutDesc* desc);
+VkShaderModule   gpu_create_shader(GPU* gpu, const uint32_t* code, VkDeviceSize size);
+VkPipeline       gpu_create_pipeline(GPU* gpu, VkPipelineCache cache, const PipelineDesc* desc);
+VkPipeline       gpu_create_pipeline_library(GPU* gpu, VkPipelineCache cache, const PipelineDesc* desc,
+                                             VkGraphicsPipelineLibraryFlagsEXT library);
+VkPipeline       gpu_link_pipeline(GPU* gpu, VkPipelineCache cache, VkPipelineLayout layout,
+                                   const VkPipeline* libraries, uint32_t library_count, int optimize);
+
+PipelineDesc pipeline_desc_canonical(const GPU* gpu, const PipelineDesc* desc);
+PipelineKey  pipeline_key(const GPU* gpu, const PipelineDesc* desc);
+PipelineKey  pipeline_library_key(const GPU* gpu, const PipelineDesc* desc, VkGraphicsPipelineLibraryFlagsEXT library);
+uint64_t     pipeline_hash(const void* key, size_t size);
+void         pipeline_cmd_set_state(const GPU* gpu, VkCommandBuffer cmd, const PipelineDesc* desc, VkExtent2D extent);
+
+void       pipeline_build_batch(JobSystem* jobs, GPU* gpu, PipelineCache* cache, const PipelineDesc* descs,
+                                uint32_t count, PipelineFuture* futures);
+void       pipeline_build_library(JobSystem* jobs, GPU* gpu, PipelineCache* cache, const PipelineDesc* desc,
+                                  VkGraphicsPipelineLibraryFlagsEXT library, PipelineFuture* future);
+void       pipeline_build_optimized_link(JobSystem* jobs, GPU* gpu, PipelineCache* cache, const PipelineDesc* desc,
+                                         const VkPipeline* libraries, uint32_t library_count, PipelineFuture* future);
+int        pipeline_future_ready(const PipelineFuture* future);
+VkPipeline pipeline_future_wait(JobSystem* jobs, PipelineFuture* future);
+
+#endif
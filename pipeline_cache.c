@@ -0,0 +1,228 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bench.h"
+#include "pipeline_cache.h"
+
+#define CACHE_MAGIC   0x43503344u // "D3PC"
+#define CACHE_VERSION 1
+
+// Our own header in front of the driver's blob. The driver validates its blob too, but checking
+// first lets a stale file be reported and replaced instead of silently ignored.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t  uuid[VK_UUID_SIZE];
+    uint32_t pad;
+    uint64_t data_size;
+    uint64_t checksum;
+} CacheFileHeader;
+
+// The leading fields of every blob returned by vkGetPipelineCacheData.
+typedef struct {
+    uint32_t header_size;
+    uint32_t header_version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint8_t  uuid[VK_UUID_SIZE];
+} CacheDataHeader;
+
+static uint64_t fnv1a(const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    uint64_t       hash  = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static void default_path(char* path, size_t size) {
+    const char* xdg  = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (xdg && *xdg) {
+        snprintf(path, size, "%s/3d", xdg);
+    } else if (home && *home) {
+        snprintf(path, size, "%s/.cache", home);
+        mkdir(path, 0755);
+        snprintf(path, size, "%s/.cache/3d", home);
+    } else {
+        snprintf(path, size, "/tmp/3d");
+    }
+    mkdir(path, 0755);
+
+    size_t length = strlen(path);
+    snprintf(path + length, size - length, "/pipeline_cache.bin");
+}
+
+static CacheFileHeader make_header(const GPU* gpu, const void* data, size_t size) {
+    CacheFileHeader header = {
+        .magic          = CACHE_MAGIC,
+        .version        = CACHE_VERSION,
+        .vendor_id      = gpu->properties.vendor_id,
+        .device_id      = gpu->properties.device_id,
+        .driver_version = gpu->properties.driver_version,
+        .data_size      = size,
+        .checksum       = fnv1a(data, size),
+    };
+    memcpy(header.uuid, gpu->properties.pipeline_cache_uuid, VK_UUID_SIZE);
+    return header;
+}
+
+// Returns the cache blob if the file exists and matches this device, or NULL.
+static void* read_cache_file(const GPU* gpu, const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    CacheFileHeader header;
+    struct stat     info;
+    uint64_t        file_size = fstat(fileno(file), &info) == 0 ? (uint64_t) info.st_size : 0;
+    void*           data      = NULL;
+    const char*     reason    = NULL;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != CACHE_MAGIC) {
+        reason = "not a pipeline cache";
+    } else if (header.version != CACHE_VERSION) {
+        reason = "cache format version changed";
+    } else if (header.vendor_id != gpu->properties.vendor_id || header.device_id != gpu->properties.device_id
+               || header.driver_version != gpu->properties.driver_version
+               || memcmp(header.uuid, gpu->properties.pipeline_cache_uuid, VK_UUID_SIZE)) {
+        reason = "written by a different device or driver";
+    } else if (header.data_size < sizeof(CacheDataHeader) || file_size < sizeof(header)
+               || header.data_size > file_size - sizeof(header)) {
+        reason = "truncated";
+    } else if (!(data = malloc(header.data_size))) {
+        reason = "out of memory";
+    } else if (fread(data, 1, header.data_size, file) != header.data_size) {
+        reason = "truncated";
+    } else if (fnv1a(data, header.data_size) != header.checksum) {
+        reason = "checksum mismatch";
+    } else {
+        const CacheDataHeader* blob = data;
+        if (blob->header_version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            || blob->vendor_id != gpu->properties.vendor_id || blob->device_id != gpu->properties.device_id
+            || memcmp(blob->uuid, gpu->properties.pipeline_cache_uuid, VK_UUID_SIZE)) {
+            reason = "driver blob doesn't match this device";
+        }
+    }
+    fclose(file);
+
+    if (reason) {
+        printf("Ignoring pipeline cache '%s': %s\n", path, reason);
+        free(data);
+        return NULL;
+    }
+
+    *size = header.data_size;
+    return data;
+}
+
+void pipeline_cache_create(GPU* gpu, PipelineCache* cache, const char* path, int cold) {
+    memset(cache, 0, sizeof(*cache));
+    pthread_rwlock_init(&cache->lock, NULL);
+    if (path) {
+        snprintf(cache->path, sizeof(cache->path), "%s", path);
+    } else {
+        default_path(cache->path, sizeof(cache->path));
+    }
+
+    uint64_t start = bench_time_ns();
+    size_t   size  = 0;
+    void*    data  = cold ? NULL : read_cache_file(gpu, cache->path, &size);
+
+    VkPipelineCacheCreateInfo info = {
+        .s_type            = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initial_data_size = size,
+        .p_initial_data    = data,
+    };
+    vk_create_pipeline_cache(gpu->device, &info, NULL, &cache->handle);
+    gpu_set_debug_name(gpu, PIPELINE_CACHE, cache->handle, "Pipeline cache");
+    free(data);
+
+    cache->loaded_size = size;
+    cache->load_ms     = bench_elapsed_ms(start);
+    printf("Pipeline cache '%s': %s, %zu bytes in %.3f ms\n", cache->path, size ? "warm" : "cold", size,
+           cache->load_ms);
+}
+
+// An in-memory cache that is never loaded or saved.
+void pipeline_cache_create_empty(GPU* gpu, PipelineCache* cache) {
+    memset(cache, 0, sizeof(*cache));
+    pthread_rwlock_init(&cache->lock, NULL);
+
+    VkPipelineCacheCreateInfo info = {
+        .s_type = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+    };
+    vk_create_pipeline_cache(gpu->device, &info, NULL, &cache->handle);
+}
+
+void pipeline_cache_destroy(GPU* gpu, PipelineCache* cache) {
+    vk_destroy_pipeline_cache(gpu->device, cache->handle, NULL);
+    pthread_rwlock_destroy(&cache->lock);
+}
+
+// Writes to a temporary file next to the cache and renames it into place, so a crash mid-write
+// never leaves a torn cache behind.
+int pipeline_cache_save(GPU* gpu, PipelineCache* cache) {
+    pthread_rwlock_wrlock(&cache->lock);
+    size_t size = 0;
+    vk_get_pipeline_cache_data(gpu->device, cache->handle, &size, NULL);
+    void* data = malloc(size);
+    vk_get_pipeline_cache_data(gpu->device, cache->handle, &size, data);
+    pthread_rwlock_unlock(&cache->lock);
+
+    char temp_path[sizeof(cache->path) + 16];
+    snprintf(temp_path, sizeof(temp_path), "%s.%d.tmp", cache->path, (int) getpid());
+
+    CacheFileHeader header = make_header(gpu, data, size);
+    FILE*           file   = fopen(temp_path, "wb");
+    int             ok     = file != NULL;
+    if (ok) {
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data, 1, size, file) == size;
+        ok = fflush(file) == 0 && ok;
+        ok = fsync(fileno(file)) == 0 && ok;
+        ok = fclose(file) == 0 && ok;
+    }
+    ok = ok && rename(temp_path, cache->path) == 0;
+    free(data);
+
+    if (!ok) {
+        fprintf(stderr, "Could not save pipeline cache '%s': %s\n", cache->path, strerror(errno));
+        unlink(temp_path);
+        return 0;
+    }
+    printf("Saved %zu byte pipeline cache to '%s'\n", size, cache->path);
+    return 1;
+}
+
+VkPipelineCache pipeline_cache_create_worker(GPU* gpu) {
+    VkPipelineCacheCreateInfo info = {
+        .s_type = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+    };
+    VkPipelineCache worker;
+    vk_create_pipeline_cache(gpu->device, &info, NULL, &worker);
+    return worker;
+}
+
+VkPipelineCache pipeline_cache_begin_use(PipelineCache* cache) {
+    pthread_rwlock_rdlock(&cache->lock);
+    return cache->handle;
+}
+
+void pipeline_cache_end_use(PipelineCache* cache) {
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+// Merges and destroys `worker`. Safe to call from any thread.
+void pipeline_cache_merge(GPU* gpu, PipelineCache* cache, VkPipelineCache worker) {
+    pthread_rwlock_wrlock(&cache->lock);
+    vk_merge_pipeline_caches(gpu->device, cache->handle, 1, &worker);
+    pthread_rwlock_unlock(&cache->lock);
+    vk_destroy_pipeline_cache(gpu->device, worker, NULL);
+}
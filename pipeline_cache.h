@@ -0,0 +1,30 @@
+#ifndef pipeline_cache_h
+#define pipeline_cache_h
+#include <pthread.h>
+#include "gpu.h"
+
+typedef struct {
+    VkPipelineCache  handle;
+    pthread_rwlock_t lock;
+    char             path[512];
+    size_t           loaded_size; // Zero when starting cold.
+    double           load_ms;
+} PipelineCache;
+
+// Loads the cache from `path`, or from the user cache directory when `path` is NULL. Data written
+// by a different device, driver or cache format is discarded and the cache starts empty, as it
+// does when `cold` is set.
+void pipeline_cache_create(GPU* gpu, PipelineCache* cache, const char* path, int cold);
+void pipeline_cache_create_empty(GPU* gpu, PipelineCache* cache);
+void pipeline_cache_destroy(GPU* gpu, PipelineCache* cache);
+int  pipeline_cache_save(GPU* gpu, PipelineCache* cache);
+
+// Pipeline creation may use the shared cache from any number of threads at once, since the driver
+// synchronizes it internally, but merging into it must exclude them. Bracket creation with
+// begin/end use, or compile into a private worker cache and merge it back when done.
+VkPipelineCache pipeline_cache_begin_use(PipelineCache* cache);
+void            pipeline_cache_end_use(PipelineCache* cache);
+VkPipelineCache pipeline_cache_create_worker(GPU* gpu);
+void            pipeline_cache_merge(GPU* gpu, PipelineCache* cache, VkPipelineCache worker);
+
+#endif
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "pipeline_registry.h"
+
+// Returns the slot holding `key`, or the empty slot where it belongs. Every value starts with its
+// key.
+static RegistrySlot* table_find(RegistryTable* table, const void* key, size_t key_size, uint64_t hash,
+                                uint64_t* probes) {
+    uint32_t mask = table->capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        RegistrySlot* slot = &table->slots[i];
+        (*probes)++;
+        if (!slot->value || (slot->hash == hash && !memcmp(slot->value, key, key_size))) {
+            return slot;
+        }
+    }
+}
+
+// Grows the table if inserting one more value would push it over three quarters full.
+static void table_reserve(RegistryTable* table) {
+    if (4 * (table->count + 1) <= 3 * table->capacity) {
+        return;
+    }
+    RegistryTable grown = {
+        .capacity = table->capacity ? 2 * table->capacity : 64,
+        .count    = table->count,
+    };
+    grown.slots = calloc(grown.capacity, sizeof(*grown.slots));
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        RegistrySlot* slot = &table->slots[i];
+        if (slot->value) {
+            uint32_t j = slot->hash & (grown.capacity - 1);
+            while (grown.slots[j].value) {
+                j = (j + 1) & (grown.capacity - 1);
+            }
+            grown.slots[j] = *slot;
+        }
+    }
+    free(table->slots);
+    *table = grown;
+}
+
+void pipeline_registry_create(PipelineRegistry* registry, GPU* gpu, JobSystem* jobs, PipelineCache* cache,
+                              VkShaderModule fallback_vertex_shader, VkShaderModule fallback_fragment_shader) {
+    *registry = (PipelineRegistry){
+        .gpu                      = gpu,
+        .jobs                     = jobs,
+        .cache                    = cache,
+        .fallback_vertex_shader   = fallback_vertex_shader,
+        .fallback_fragment_shader = fallback_fragment_shader,
+    };
+    table_reserve(&registry->pipelines);
+    table_reserve(&registry->layouts);
+}
+
+// Linked pipelines and relinks go first, since they are built from the libraries.
+void pipeline_registry_destroy(PipelineRegistry* registry) {
+    for (int libraries = 0; libraries < 2; libraries++) {
+        for (uint32_t i = 0; i < registry->pipelines.capacity; i++) {
+            PipelineEntry* entry = registry->pipelines.slots[i].value;
+            if (!entry || !entry->key.library != !libraries) {
+                continue;
+            }
+            if (entry->submitted) {
+                vk_destroy_pipeline(registry->gpu->device, pipeline_future_wait(registry->jobs, &entry->future), NULL);
+            }
+            vk_destroy_pipeline(registry->gpu->device, entry->linked, NULL);
+        }
+    }
+    for (uint32_t i = 0; i < registry->pipelines.capacity; i++) {
+        free(registry->pipelines.slots[i].value);
+    }
+    for (uint32_t i = 0; i < registry->layouts.capacity; i++) {
+        PipelineLayoutEntry* entry = registry->layouts.slots[i].value;
+        if (entry) {
+            vk_destroy_pipeline_layout(registry->gpu->device, entry->layout, NULL);
+            free(entry);
+        }
+    }
+    free(registry->pipelines.slots);
+    free(registry->layouts.slots);
+}
+
+// Layouts are cheap to create, so they are created on first request rather than in the background.
+VkPipelineLayout pipeline_registry_get_layout(PipelineRegistry* registry, const PipelineLayoutDesc* desc) {
+    PipelineLayoutDesc key;
+    memset(&key, 0, sizeof(key));
+    key.push_constant_stages = desc->push_constant_stages;
+    key.push_constant_size   = desc->push_constant_size;
+    key.set_layout           = desc->set_layout;
+
+    table_reserve(&registry->layouts);
+    uint64_t      probes = 0;
+    uint64_t      hash   = pipeline_hash(&key, sizeof(key));
+    RegistrySlot* slot   = table_find(&registry->layouts, &key, sizeof(key), hash, &probes);
+    if (!slot->value) {
+        PipelineLayoutEntry* entry = malloc(sizeof(*entry));
+        entry->key                 = key;
+        entry->layout              = gpu_create_pipeline_layout(registry->gpu, &key);
+        *slot                      = (RegistrySlot){ .hash = hash, .value = entry };
+        registry->layouts.count++;
+    }
+    return ((PipelineLayoutEntry*) slot->value)->layout;
+}
+
+// Returns the entry for `key`, or a new zeroed one with `*created` set.
+static PipelineEntry* find_entry(PipelineRegistry* registry, const PipelineKey* key, int* created) {
+    registry->stats.lookups++;
+    uint64_t hash = pipeline_hash(key, sizeof(*key));
+    table_reserve(&registry->pipelines);
+    RegistrySlot* slot = table_find(&registry->pipelines, key, sizeof(*key), hash, &registry->stats.probes);
+    *created           = !slot->value;
+    if (*created) {
+        PipelineEntry* entry = calloc(1, sizeof(*entry));
+        entry->key           = *key;
+        *slot                = (RegistrySlot){ .hash = hash, .value = entry };
+        registry->pipelines.count++;
+    }
+    return slot->value;
+}
+
+static const VkGraphicsPipelineLibraryFlagsEXT LIBRARY_PARTS[PIPELINE_LIBRARY_PARTS] = {
+    VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+};
+
+// Descriptions that differ only in name or dynamic state share an entry, and with graphics
+// pipeline libraries, pipelines share the parts they have in common.
+static PipelineEntry* find_or_submit(PipelineRegistry* registry, const PipelineDesc* desc) {
+    PipelineKey    key = pipeline_key(registry->gpu, desc);
+    int            created;
+    PipelineEntry* entry = find_entry(registry, &key, &created);
+    if (!created) {
+        return entry;
+    }
+
+    PipelineDesc canonical = pipeline_desc_canonical(registry->gpu, desc);
+    if (!registry->gpu->graphics_pipeline_library) {
+        pipeline_build_batch(registry->jobs, registry->gpu, registry->cache, &canonical, 1, &entry->future);
+        entry->submitted = 1;
+        return entry;
+    }
+    for (uint32_t i = 0; i < PIPELINE_LIBRARY_PARTS; i++) {
+        PipelineKey    library_key = pipeline_library_key(registry->gpu, &canonical, LIBRARY_PARTS[i]);
+        PipelineEntry* library     = find_entry(registry, &library_key, &created);
+        if (created) {
+            pipeline_build_library(registry->jobs, registry->gpu, registry->cache, &canonical, LIBRARY_PARTS[i],
+                                   &library->future);
+            library->submitted = 1;
+        }
+        entry->libraries[i] = library;
+    }
+    entry->future.desc = canonical;
+
+    return entry;
+}
+
+static void count_compile(PipelineRegistryStats* stats, double ms) {
+    stats->compiled++;
+    stats->compile_ms_total += ms;
+    stats->compile_ms_max = ms > stats->compile_ms_max ? ms : stats->compile_ms_max;
+}
+
+static int library_ready(PipelineRegistry* registry, PipelineEntry* library) {
+    if (!pipeline_future_ready(&library->future)) {
+        return 0;
+    }
+    if (!library->counted) {
+        count_compile(&registry->stats, library->future.compile_ms);
+        library->counted = 1;
+    }
+    return 1;
+}
+
+// Once every part is compiled, links them without optimization, which is cheap enough for the
+// render thread, and queues the optimized relink.
+static int link_entry(PipelineRegistry* registry, PipelineEntry* entry) {
+    VkPipeline libraries[PIPELINE_LIBRARY_PARTS];
+    for (uint32_t i = 0; i < PIPELINE_LIBRARY_PARTS; i++) {
+        if (!library_ready(registry, entry->libraries[i])) {
+            return 0;
+        }
+        libraries[i] = entry->libraries[i]->future.pipeline;
+    }
+
+    const PipelineDesc* desc  = &entry->future.desc;
+    uint64_t            start = bench_time_ns();
+    VkPipelineCache     cache = pipeline_cache_begin_use(registry->cache);
+    entry->linked = gpu_link_pipeline(registry->gpu, cache, desc->layout, libraries, PIPELINE_LIBRARY_PARTS, 0);
+    pipeline_cache_end_use(registry->cache);
+    double ms = bench_elapsed_ms(start);
+
+    PipelineRegistryStats* stats = &registry->stats;
+    stats->links++;
+    stats->link_ms_total += ms;
+    stats->link_ms_max = ms > stats->link_ms_max ? ms : stats->link_ms_max;
+    printf("%s linked in %.1f us\n", desc->name ? desc->name : "Pipeline", 1000.0 * ms);
+
+    pipeline_build_optimized_link(registry->jobs, registry->gpu, registry->cache, desc, libraries,
+                                  PIPELINE_LIBRARY_PARTS, &entry->future);
+    entry->submitted = 1;
+
+    return 1;
+}
+
+static int entry_ready(PipelineRegistry* registry, PipelineEntry* entry) {
+    if (entry->libraries[0]) {
+        return entry->linked || link_entry(registry, entry);
+    }
+    if (!pipeline_future_ready(&entry->future)) {
+        return 0;
+    }
+    if (!entry->counted) {
+        double ms = entry->future.compile_ms;
+        count_compile(&registry->stats, ms);
+        entry->counted = 1;
+        printf("%s compiled in %.3f ms\n", entry->future.desc.name ? entry->future.desc.name : "Pipeline", ms);
+    }
+    return 1;
+}
+
+// The optimized relink replaces the fast-linked pipeline as soon as it's done. The fast-linked one
+// may still be in use by frames in flight, so it lives until the registry is destroyed.
+static VkPipeline entry_pipeline(PipelineRegistry* registry, PipelineEntry* entry) {
+    if (!entry->libraries[0]) {
+        return entry->future.pipeline;
+    }
+    if (!pipeline_future_ready(&entry->future)) {
+        return entry->linked;
+    }
+    if (!entry->optimized) {
+        registry->stats.optimized++;
+        entry->optimized = 1;
+        printf("%s optimized in %.3f ms\n", entry->future.desc.name ? entry->future.desc.name : "Pipeline",
+               entry->future.compile_ms);
+    }
+    return entry->future.pipeline ? entry->future.pipeline : entry->linked;
+}
+
+// Starts compiling `desc` without asking for it yet, e.g. at startup or when a level loads.
+void pipeline_registry_prefetch(PipelineRegistry* registry, const PipelineDesc* desc) {
+    find_or_submit(registry, desc);
+}
+
+// The generic pipeline only has to agree with the draw on vertex layout, pipeline layout, pass and
+// topology, so one fallback serves every material and state combination sharing those. The vertex
+// variant is kept because it may select how the vertex layout is read.
+static PipelineDesc fallback_desc(const PipelineRegistry* registry, const PipelineDesc* desc) {
+    PipelineDesc fallback     = *desc;
+    fallback.vertex_shader    = registry->fallback_vertex_shader;
+    fallback.fragment_shader  = registry->fallback_fragment_shader;
+    fallback.fragment_variant = (ShaderVariant){};
+    fallback.cull_mode        = VK_CULL_MODE_BACK_BIT;
+    fallback.front_face       = VK_FRONT_FACE_CLOCKWISE;
+    fallback.depth_test       = VK_TRUE;
+    fallback.name             = "Fallback pipeline";
+    return fallback;
+}
+
+// Returns the pipeline for `desc` if it has been compiled. Otherwise its compile is started if
+// needed, and the fallback (when ready) or VK_NULL_HANDLE is returned. Call from the render thread,
+// and set the dynamic state from `desc` with pipeline_cmd_set_state after binding.
+VkPipeline pipeline_registry_get(PipelineRegistry* registry, const PipelineDesc* desc, PipelineMissPolicy policy) {
+    PipelineEntry* entry = find_or_submit(registry, desc);
+    if (entry_ready(registry, entry)) {
+        return entry_pipeline(registry, entry);
+    }
+    registry->stats.stalls_avoided++;
+
+    if (policy == PIPELINE_MISS_FALLBACK) {
+        PipelineDesc   fallback       = fallback_desc(registry, desc);
+        PipelineEntry* fallback_entry = find_or_submit(registry, &fallback);
+        if (entry_ready(registry, fallback_entry)) {
+            registry->stats.fallback_draws++;
+            return entry_pipeline(registry, fallback_entry);
+        }
+    }
+
+    registry->stats.skipped_draws++;
+    return VK_NULL_HANDLE;
+}
+
+// Like pipeline_registry_get without a fallback, for callers that check on a pipeline they are
+// not drawing with yet. Nothing is counted as a stall.
+VkPipeline pipeline_registry_poll(PipelineRegistry* registry, const PipelineDesc* desc) {
+    PipelineEntry* entry = find_or_submit(registry, desc);
+    return entry_ready(registry, entry) ? entry_pipeline(registry, entry) : VK_NULL_HANDLE;
+}
+
+// Blocks until the pipeline for `desc` is compiled, for callers that need exact output.
+VkPipeline pipeline_registry_wait(PipelineRegistry* registry, const PipelineDesc* desc) {
+    PipelineEntry* entry = find_or_submit(registry, desc);
+    for (uint32_t i = 0; i < PIPELINE_LIBRARY_PARTS && entry->libraries[i]; i++) {
+        pipeline_future_wait(registry->jobs, &entry->libraries[i]->future);
+    }
+    if (!entry->libraries[0]) {
+        pipeline_future_wait(registry->jobs, &entry->future);
+    }
+    entry_ready(registry, entry);
+    return entry_pipeline(registry, entry);
+}
+
+void pipeline_registry_report(const PipelineRegistry* registry) {
+    const PipelineRegistryStats* stats = &registry->stats;
+    printf("pipelines: %llu lookups for %u pipelines and %u layouts, %.2f probes per lookup\n",
+           (unsigned long long) stats->lookups, registry->pipelines.count, registry->layouts.count,
+           stats->lookups ? (double) stats->probes / stats->lookups : 0.0);
+    printf("pipelines: %u compiled in the background, mean %.3f ms, max %.3f ms\n", stats->compiled,
+           stats->compiled ? stats->compile_ms_total / stats->compiled : 0.0, stats->compile_ms_max);
+    if (stats->links) {
+        printf("pipelines: %u fast links, mean %.1f us, max %.1f us, %u replaced by optimized relinks\n",
+               stats->links, 1000.0 * stats->link_ms_total / stats->links, 1000.0 * stats->link_ms_max,
+               stats->optimized);
+    }
+    printf("pipelines: %llu stalls avoided, %llu fallback draws, %llu skipped draws\n",
+           (unsigned long long) stats->stalls_avoided, (unsigned long long) stats->fallback_draws,
+           (unsigned long long) stats->skipped_draws);
+}
@@ -0,0 +1,84 @@
+#ifndef pipeline_registry_h
+#define pipeline_registry_h
+#include "pipeline.h"
+
+typedef enum {
+    PIPELINE_MISS_FALLBACK, // Draw with the generic pipeline for the same vertex layout and pass.
+    PIPELINE_MISS_SKIP,     // Don't draw until the pipeline is ready.
+} PipelineMissPolicy;
+
+// With graphics pipeline libraries, a pipeline is fast-linked from its library parts as soon as
+// they are all compiled, and `future` becomes the optimized relink that replaces it once done.
+// Otherwise `future` compiles the complete pipeline.
+typedef struct PipelineEntry PipelineEntry;
+struct PipelineEntry {
+    PipelineKey    key; // First, so the table can compare keys without knowing the entry type.
+    PipelineFuture future;
+    int            submitted;
+    PipelineEntry* libraries[PIPELINE_LIBRARY_PARTS];
+    VkPipeline     linked;
+    int            counted;
+    int            optimized;
+};
+
+typedef struct {
+    PipelineLayoutDesc key;
+    VkPipelineLayout   layout;
+} PipelineLayoutEntry;
+
+typedef struct {
+    uint64_t hash;
+    void*    value; // NULL for an empty slot.
+} RegistrySlot;
+
+// Open addressing with linear probing. The capacity is a power of two and at most three quarters
+// of the slots are in use, so probe sequences stay short.
+typedef struct {
+    RegistrySlot* slots;
+    uint32_t      capacity;
+    uint32_t      count;
+} RegistryTable;
+
+typedef struct {
+    uint64_t lookups;
+    uint64_t probes;
+    uint32_t compiled;
+    double   compile_ms_total;
+    double   compile_ms_max;
+    uint32_t links;
+    double   link_ms_total;
+    double   link_ms_max;
+    uint32_t optimized;
+    uint64_t stalls_avoided; // Lookups that would have blocked on a compile.
+    uint64_t fallback_draws;
+    uint64_t skipped_draws;
+} PipelineRegistryStats;
+
+// Pipelines and pipeline layouts by description, so callers can ask for one per draw and only pay
+// for creating it once. Pipelines are compiled in the background the first time they are asked
+// for and lookups never block, so a new material or state combination mid-session costs a fallback
+// draw or a skipped draw instead of a hitch. Entries are individually allocated because their
+// futures are linked into the job queue and must not move.
+typedef struct {
+    GPU*                  gpu;
+    JobSystem*            jobs;
+    PipelineCache*        cache;
+    VkShaderModule        fallback_vertex_shader;
+    VkShaderModule        fallback_fragment_shader;
+    RegistryTable         pipelines;
+    RegistryTable         layouts;
+    PipelineRegistryStats stats;
+} PipelineRegistry;
+
+void             pipeline_registry_create(PipelineRegistry* registry, GPU* gpu, JobSystem* jobs, PipelineCache* cache,
+                                          VkShaderModule fallback_vertex_shader,
+                                          VkShaderModule fallback_fragment_shader);
+void             pipeline_registry_destroy(PipelineRegistry* registry);
+VkPipelineLayout pipeline_registry_get_layout(PipelineRegistry* registry, const PipelineLayoutDesc* desc);
+void             pipeline_registry_prefetch(PipelineRegistry* registry, const PipelineDesc* desc);
+VkPipeline       pipeline_registry_get(PipelineRegistry* registry, const PipelineDesc* desc, PipelineMissPolicy policy);
+VkPipeline       pipeline_registry_poll(PipelineRegistry* registry, const PipelineDesc* desc);
+VkPipeline       pipeline_registry_wait(PipelineRegistry* registry, const PipelineDesc* desc);
+void             pipeline_registry_report(const PipelineRegistry* registry);
+
+#endif
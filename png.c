@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "png.h"
+
+// Minimal encoder: scanlines are unfiltered and stored in uncompressed deflate blocks. It trades
+// file size for speed and for not needing zlib, which is the right trade for screenshots.
+
+#define DEFLATE_MAX_STORED 65535
+
+static uint32_t crc_table[256];
+
+static void init_crc_table() {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void put_u32(uint8_t* out, uint32_t value) {
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static void write_chunk(FILE* file, const char* type, const uint8_t* data, uint32_t length) {
+    uint8_t header[8];
+    put_u32(header, length);
+    memcpy(header + 4, type, 4);
+
+    uint32_t crc = crc_update(0xffffffffu, header + 4, 4);
+    crc          = crc_update(crc, data, length);
+
+    uint8_t footer[4];
+    put_u32(footer, crc ^ 0xffffffffu);
+
+    fwrite(header, 1, sizeof(header), file);
+    fwrite(data, 1, length, file);
+    fwrite(footer, 1, sizeof(footer), file);
+}
+
+int png_write_bgra(const char* path, uint32_t width, uint32_t height, const uint8_t* pixels, uint32_t stride) {
+    if (!crc_table[1]) {
+        init_crc_table();
+    }
+
+    // One filter byte per scanline followed by RGB triples.
+    size_t   row_size = 1 + (size_t) width * 3;
+    size_t   raw_size = row_size * height;
+    uint8_t* raw      = malloc(raw_size);
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* src = pixels + (size_t) y * stride;
+        uint8_t*       dst = raw + y * row_size;
+        *dst++             = 0;
+        for (uint32_t x = 0; x < width; x++) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst += 3;
+            src += 4;
+        }
+    }
+
+    size_t   block_count = (raw_size + DEFLATE_MAX_STORED - 1) / DEFLATE_MAX_STORED;
+    size_t   idat_size   = 2 + block_count * 5 + raw_size + 4;
+    uint8_t* idat        = malloc(idat_size);
+    uint8_t* out         = idat;
+    *out++               = 0x78; // zlib header: deflate, 32K window, no preset dictionary.
+    *out++               = 0x01;
+
+    uint32_t adler_a = 1, adler_b = 0;
+    for (size_t offset = 0; offset < raw_size; offset += DEFLATE_MAX_STORED) {
+        size_t length = raw_size - offset < DEFLATE_MAX_STORED ? raw_size - offset : DEFLATE_MAX_STORED;
+        *out++        = offset + length == raw_size;
+        *out++        = length;
+        *out++        = length >> 8;
+        *out++        = ~length;
+        *out++        = ~length >> 8;
+        memcpy(out, raw + offset, length);
+        out += length;
+
+        for (size_t i = 0; i < length; i++) {
+            adler_a = (adler_a + raw[offset + i]) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+    }
+    put_u32(out, adler_b << 16 | adler_a);
+    free(raw);
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        free(idat);
+        return 0;
+    }
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    fwrite(signature, 1, sizeof(signature), file);
+
+    uint8_t ihdr[13];
+    put_u32(ihdr, width);
+    put_u32(ihdr + 4, height);
+    ihdr[8]  = 8; // Bit depth
+    ihdr[9]  = 2; // Truecolor
+    ihdr[10] = 0; // Deflate
+    ihdr[11] = 0; // Adaptive filtering
+    ihdr[12] = 0; // No interlace
+    write_chunk(file, "IHDR", ihdr, sizeof(ihdr));
+    write_chunk(file, "IDAT", idat, idat_size);
+    write_chunk(file, "IEND", NULL, 0);
+
+    free(idat);
+    return fclose(file) == 0;
+}
@@ -0,0 +1,8 @@
+#ifndef png_h
+#define png_h
+#include <stdint.h>
+
+// Writes 8-bit BGRA pixels as an RGB PNG. Returns 0 on failure.
+int png_write_bgra(const char* path, uint32_t width, uint32_t height, const uint8_t* pixels, uint32_t stride);
+
+#endif
@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <stdio.h>
+#include "readback.h"
+
+#define BYTES_PER_PIXEL 4
+
+Readback readback_create(GPU* gpu, uint32_t slot_count, uint32_t width, uint32_t height) {
+    assert(slot_count <= READBACK_MAX_SLOTS);
+
+    Readback readback = { .slot_count = slot_count };
+    for (uint32_t i = 0; i < slot_count; i++) {
+        ReadbackSlot* slot = &readback.slots[i];
+
+        VkBufferCreateInfo info = {
+            .s_type       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size         = (VkDeviceSize) width * height * BYTES_PER_PIXEL,
+            .usage        = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .sharing_mode = VK_SHARING_MODE_EXCLUSIVE,
+        };
+        vk_create_buffer(gpu->device, &info, NULL, &slot->buffer);
+
+        char name[32];
+        sprintf(name, "Readback buffer %u", i);
+        gpu_set_debug_name(gpu, BUFFER, slot->buffer, name);
+
+        VkMemoryRequirements requirements;
+        vk_get_buffer_memory_requirements(gpu->device, slot->buffer, &requirements);
+        slot->memory = gpu_allocate_memory(gpu, &gpu->host_cached_heap, &requirements);
+        vk_bind_buffer_memory(gpu->device, slot->buffer, slot->memory.memory, slot->memory.offset);
+
+        slot->width  = width;
+        slot->height = height;
+        atomic_init(&slot->state, READBACK_FREE);
+    }
+
+    return readback;
+}
+
+void readback_destroy(GPU* gpu, Readback* readback) {
+    for (uint32_t i = 0; i < readback->slot_count; i++) {
+        assert(atomic_load(&readback->slots[i].state) != READBACK_BUSY);
+        vk_destroy_buffer(gpu->device, readback->slots[i].buffer, NULL);
+    }
+}
+
+// Records a copy of `image`, which must have been rendered as a color attachment and be in
+// `layout`, into the next free slot. The image is returned to `layout` afterwards. Returns 0 if
+// every slot is still in flight or being consumed.
+int readback_copy_image(Readback* readback, VkCommandBuffer cmd, VkImage image, VkImageLayout layout,
+                        uint32_t width, uint32_t height, uint32_t frame) {
+    ReadbackSlot* slot = &readback->slots[readback->next];
+    if (atomic_load(&slot->state) != READBACK_FREE) {
+        return 0;
+    }
+    assert(width == slot->width && height == slot->height);
+    readback->next = (readback->next + 1) % readback->slot_count;
+
+    VkImageSubresourceRange range = {
+        .aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .level_count = 1,
+        .layer_count = 1,
+    };
+    VkImageMemoryBarrier to_transfer = {
+        .s_type                 = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .src_access_mask        = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dst_access_mask        = VK_ACCESS_TRANSFER_READ_BIT,
+        .old_layout             = layout,
+        .new_layout             = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .src_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .dst_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .image                  = image,
+        .subresource_range      = range,
+    };
+    vk_cmd_pipeline_barrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                            NULL, 0, NULL, 1, &to_transfer);
+
+    VkBufferImageCopy region = {
+        .image_subresource = { .aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT, .layer_count = 1 },
+        .image_extent      = { width, height, 1 },
+    };
+    vk_cmd_copy_image_to_buffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+    VkImageMemoryBarrier from_transfer = to_transfer;
+    from_transfer.src_access_mask      = 0;
+    from_transfer.dst_access_mask      = 0;
+    from_transfer.old_layout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    from_transfer.new_layout           = layout;
+
+    VkBufferMemoryBarrier to_host = {
+        .s_type                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .src_access_mask        = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dst_access_mask        = VK_ACCESS_HOST_READ_BIT,
+        .src_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .dst_queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        .buffer                 = slot->buffer,
+        .offset                 = 0,
+        .size                   = VK_WHOLE_SIZE,
+    };
+    vk_cmd_pipeline_barrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &to_host,
+                            1, &from_transfer);
+
+    slot->frame = frame;
+    atomic_store(&slot->state, READBACK_RECORDED);
+    return 1;
+}
+
+// Called after waiting on the fence of `frame`, which makes its copies safe to read.
+void readback_frame_complete(GPU* gpu, Readback* readback, uint32_t frame) {
+    for (uint32_t i = 0; i < readback->slot_count; i++) {
+        ReadbackSlot* slot = &readback->slots[i];
+        if (atomic_load(&slot->state) == READBACK_RECORDED && slot->frame == frame) {
+            gpu_invalidate_memory(gpu, &slot->memory, 0, (VkDeviceSize) slot->width * slot->height * BYTES_PER_PIXEL);
+            atomic_store(&slot->state, READBACK_READY);
+        }
+    }
+}
+
+// Returns the oldest completed copy, or NULL. Its pixels are BGRA8 at `slot->memory.mapped`.
+ReadbackSlot* readback_acquire(Readback* readback) {
+    ReadbackSlot* oldest = NULL;
+    for (uint32_t i = 0; i < readback->slot_count; i++) {
+        ReadbackSlot* slot = &readback->slots[i];
+        if (atomic_load(&slot->state) == READBACK_READY && (!oldest || slot->frame < oldest->frame)) {
+            oldest = slot;
+        }
+    }
+    if (oldest) {
+        atomic_store(&oldest->state, READBACK_BUSY);
+    }
+    return oldest;
+}
+
+// May be called from any thread.
+void readback_release(ReadbackSlot* slot) {
+    atomic_store(&slot->state, READBACK_FREE);
+}
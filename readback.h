@@ -0,0 +1,40 @@
+#ifndef readback_h
+#define readback_h
+#include <stdatomic.h>
+#include "gpu.h"
+
+#define READBACK_MAX_SLOTS 16
+
+typedef enum {
+    READBACK_FREE,
+    READBACK_RECORDED, // Copy recorded into a frame whose fence hasn't been waited on yet.
+    READBACK_READY,    // Copy complete and visible to the host.
+    READBACK_BUSY,     // Handed to a consumer, which must call readback_release.
+} ReadbackState;
+
+typedef struct {
+    VkBuffer    buffer;
+    MemoryBlock memory;
+    atomic_int  state;
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    frame;
+} ReadbackSlot;
+
+// A ring of host cached buffers. A copy is recorded at the end of a frame and becomes readable once
+// that frame's fence has been waited on, which is a few frames later, so the GPU never idles.
+typedef struct {
+    ReadbackSlot slots[READBACK_MAX_SLOTS];
+    uint32_t     slot_count;
+    uint32_t     next;
+} Readback;
+
+Readback      readback_create(GPU* gpu, uint32_t slot_count, uint32_t width, uint32_t height);
+void          readback_destroy(GPU* gpu, Readback* readback);
+int           readback_copy_image(Readback* readback, VkCommandBuffer cmd, VkImage image, VkImageLayout layout,
+                                  uint32_t width, uint32_t height, uint32_t frame);
+void          readback_frame_complete(GPU* gpu, Readback* readback, uint32_t frame);
+ReadbackSlot* readback_acquire(Readback* readback);
+void          readback_release(ReadbackSlot* slot);
+
+#endif
@@ -0,0 +1,68 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "png.h"
+#include "screenshot.h"
+
+static void* writer_main(void* arg) {
+    ScreenshotWriter* writer = arg;
+
+    pthread_mutex_lock(&writer->mutex);
+    for (;;) {
+        while (!writer->count && !writer->quit) {
+            pthread_cond_wait(&writer->cond, &writer->mutex);
+        }
+        if (!writer->count) {
+            break;
+        }
+        ScreenshotJob job = writer->jobs[writer->head];
+        writer->head      = (writer->head + 1) % READBACK_MAX_SLOTS;
+        writer->count--;
+        pthread_mutex_unlock(&writer->mutex);
+
+        ReadbackSlot* slot = job.slot;
+        if (png_write_bgra(job.path, slot->width, slot->height, slot->memory.mapped, slot->width * 4)) {
+            printf("Saved frame %u to '%s'\n", slot->frame, job.path);
+        } else {
+            fprintf(stderr, "Could not write screenshot '%s'\n", job.path);
+        }
+        readback_release(slot);
+
+        pthread_mutex_lock(&writer->mutex);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+
+    return NULL;
+}
+
+void screenshot_writer_start(ScreenshotWriter* writer) {
+    memset(writer, 0, sizeof(*writer));
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    pthread_create(&writer->thread, NULL, writer_main, writer);
+}
+
+void screenshot_writer_submit(ScreenshotWriter* writer, ReadbackSlot* slot, const char* path) {
+    pthread_mutex_lock(&writer->mutex);
+    assert(writer->count < READBACK_MAX_SLOTS);
+
+    ScreenshotJob* job = &writer->jobs[(writer->head + writer->count) % READBACK_MAX_SLOTS];
+    job->slot          = slot;
+    snprintf(job->path, sizeof(job->path), "%s", path);
+    writer->count++;
+
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+// Finishes every queued job before returning.
+void screenshot_writer_stop(ScreenshotWriter* writer) {
+    pthread_mutex_lock(&writer->mutex);
+    writer->quit = 1;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+
+    pthread_join(writer->thread, NULL);
+    pthread_mutex_destroy(&writer->mutex);
+    pthread_cond_destroy(&writer->cond);
+}
@@ -0,0 +1,28 @@
+#ifndef screenshot_h
+#define screenshot_h
+#include <pthread.h>
+#include "readback.h"
+
+typedef struct {
+    ReadbackSlot* slot;
+    char          path[256];
+} ScreenshotJob;
+
+// Encodes completed readback slots to PNG on a worker thread and releases them when done. The
+// queue can't overflow: every queued job holds a busy slot, and there are at most
+// READBACK_MAX_SLOTS of those.
+typedef struct {
+    pthread_t       thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    ScreenshotJob   jobs[READBACK_MAX_SLOTS];
+    uint32_t        head;
+    uint32_t        count;
+    int             quit;
+} ScreenshotWriter;
+
+void screenshot_writer_start(ScreenshotWriter* writer);
+void screenshot_writer_submit(ScreenshotWriter* writer, ReadbackSlot* slot, const char* path);
+void screenshot_writer_stop(ScreenshotWriter* writer);
+
+#endif
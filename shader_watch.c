@@ -0,0 +1,211 @@
+#include <errno.h>
+#include <poll.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "shader_watch.h"
+
+#ifndef GLSLANG_VALIDATOR
+#define GLSLANG_VALIDATOR "glslangValidator"
+#endif
+
+// Editors often write a file several times per save. Changes are collected until the directory has
+// been quiet this long, then compiled once.
+#define SETTLE_MS 50
+
+extern char** environ;
+
+static void* read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    void* data = NULL;
+    if (length > 0 && length % 4 == 0) {
+        data = malloc(length);
+        if (fread(data, 1, length, file) == (size_t) length) {
+            *size = length;
+        } else {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+
+    return data;
+}
+
+// Runs the compiler as a child process; its diagnostics go straight to our stdout and stderr.
+static uint32_t* compile_shader(const char* source, size_t* size) {
+    char output[] = "/tmp/3d-shader-XXXXXX";
+    int  fd       = mkstemp(output);
+    if (fd < 0) {
+        perror("mkstemp");
+        return NULL;
+    }
+    close(fd);
+
+    char* argv[] = { GLSLANG_VALIDATOR, "-V", "-o", output, (char*) source, NULL };
+    pid_t pid;
+    int   status = -1;
+    int   error  = posix_spawnp(&pid, argv[0], NULL, NULL, argv, environ);
+    if (error) {
+        fprintf(stderr, "Could not run %s: %s\n", argv[0], strerror(error));
+    } else {
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+
+    uint32_t* code = NULL;
+    if (!error && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        code = read_file(output, size);
+    }
+    unlink(output);
+
+    return code;
+}
+
+static void compile_dirty_shaders(ShaderWatcher* watcher) {
+    for (uint32_t i = 0; i < watcher->shader_count; i++) {
+        WatchedShader* shader = &watcher->shaders[i];
+        pthread_mutex_lock(&watcher->mutex);
+        int dirty     = shader->dirty;
+        shader->dirty = 0;
+        pthread_mutex_unlock(&watcher->mutex);
+        if (!dirty) {
+            continue;
+        }
+
+        char path[sizeof(watcher->directory) + sizeof(shader->name) + 1];
+        snprintf(path, sizeof(path), "%s/%s", watcher->directory, shader->name);
+        size_t    size = 0;
+        uint32_t* code = compile_shader(path, &size);
+        if (!code) {
+            fprintf(stderr, "Could not compile '%s', keeping the previous version\n", path);
+            continue;
+        }
+
+        pthread_mutex_lock(&watcher->mutex);
+        free(shader->code);
+        shader->code = code;
+        shader->size = size;
+        pthread_mutex_unlock(&watcher->mutex);
+    }
+}
+
+// Returns 0 when woken through the pipe to quit.
+static int read_events(ShaderWatcher* watcher) {
+    struct pollfd fds[2] = {
+        { .fd = watcher->inotify_fd, .events = POLLIN },
+        { .fd = watcher->wake_pipe[0], .events = POLLIN },
+    };
+    int timeout = -1;
+    int changed = 0;
+    for (;;) {
+        int ready = poll(fds, 2, timeout);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (fds[1].revents) {
+            return 0;
+        }
+        if (ready <= 0) {
+            break; // Settled.
+        }
+
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t length = read(watcher->inotify_fd, buffer, sizeof(buffer));
+        for (char* p = buffer; length > 0 && p < buffer + length;) {
+            const struct inotify_event* event = (const struct inotify_event*) p;
+            for (uint32_t i = 0; event->len && i < watcher->shader_count; i++) {
+                if (!strcmp(event->name, watcher->shaders[i].name)) {
+                    pthread_mutex_lock(&watcher->mutex);
+                    watcher->shaders[i].dirty = 1;
+                    pthread_mutex_unlock(&watcher->mutex);
+                    changed = 1;
+                }
+            }
+            p += sizeof(*event) + event->len;
+        }
+        if (changed) {
+            timeout = SETTLE_MS;
+        }
+    }
+
+    return 1;
+}
+
+static void* watcher_main(void* arg) {
+    ShaderWatcher* watcher = arg;
+    while (read_events(watcher)) {
+        compile_dirty_shaders(watcher);
+    }
+    return NULL;
+}
+
+// Returns 0 if the directory can't be watched.
+int shader_watcher_start(ShaderWatcher* watcher, const char* directory, const char* const* names, uint32_t count) {
+    memset(watcher, 0, sizeof(*watcher));
+    snprintf(watcher->directory, sizeof(watcher->directory), "%s", directory);
+    for (uint32_t i = 0; i < count && i < SHADER_WATCH_MAX_SHADERS; i++) {
+        snprintf(watcher->shaders[i].name, sizeof(watcher->shaders[i].name), "%s", names[i]);
+        watcher->shader_count++;
+    }
+
+    watcher->inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (watcher->inotify_fd < 0
+        || inotify_add_watch(watcher->inotify_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        fprintf(stderr, "Could not watch '%s': %s\n", directory, strerror(errno));
+        if (watcher->inotify_fd >= 0) {
+            close(watcher->inotify_fd);
+        }
+        return 0;
+    }
+    if (pipe(watcher->wake_pipe)) {
+        perror("pipe");
+        close(watcher->inotify_fd);
+        return 0;
+    }
+
+    pthread_mutex_init(&watcher->mutex, NULL);
+    pthread_create(&watcher->thread, NULL, watcher_main, watcher);
+    printf("Watching shaders in '%s'\n", directory);
+
+    return 1;
+}
+
+void shader_watcher_stop(ShaderWatcher* watcher) {
+    char quit = 0;
+    if (write(watcher->wake_pipe[1], &quit, 1) != 1) {
+        perror("write");
+    }
+    pthread_join(watcher->thread, NULL);
+    pthread_mutex_destroy(&watcher->mutex);
+
+    close(watcher->wake_pipe[0]);
+    close(watcher->wake_pipe[1]);
+    close(watcher->inotify_fd);
+    for (uint32_t i = 0; i < watcher->shader_count; i++) {
+        free(watcher->shaders[i].code);
+    }
+}
+
+// Returns SPIR-V compiled for shader `index` since the last call, or NULL. The caller frees it.
+uint32_t* shader_watcher_take(ShaderWatcher* watcher, uint32_t index, size_t* size) {
+    WatchedShader* shader = &watcher->shaders[index];
+    pthread_mutex_lock(&watcher->mutex);
+    uint32_t* code = shader->code;
+    *size          = shader->size;
+    shader->code   = NULL;
+    pthread_mutex_unlock(&watcher->mutex);
+
+    return code;
+}
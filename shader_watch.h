@@ -0,0 +1,34 @@
+#ifndef shader_watch_h
+#define shader_watch_h
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHADER_WATCH_MAX_SHADERS 16
+
+typedef struct {
+    char      name[64]; // File name within the watched directory, e.g. "basic.vert".
+    int       dirty;
+    uint32_t* code; // SPIR-V compiled since the last shader_watcher_take, or NULL.
+    size_t    size;
+} WatchedShader;
+
+// Watches GLSL sources with inotify and recompiles them with glslangValidator on its own thread,
+// so editing a shader never stalls the render loop. The directory is watched rather than the
+// files, because most editors save by renaming a new file over the old one.
+typedef struct {
+    char            directory[512];
+    int             inotify_fd;
+    int             wake_pipe[2];
+    pthread_t       thread;
+    pthread_mutex_t mutex;
+    WatchedShader   shaders[SHADER_WATCH_MAX_SHADERS];
+    uint32_t        shader_count;
+} ShaderWatcher;
+
+int       shader_watcher_start(ShaderWatcher* watcher, const char* directory, const char* const* names,
+                               uint32_t count);
+void      shader_watcher_stop(ShaderWatcher* watcher);
+uint32_t* shader_watcher_take(ShaderWatcher* watcher, uint32_t index, size_t* size);
+
+#endif
@@ -4,10 +4,10 @@
 #include "vulkan.h"
 #include "swapchain.h"
 
-static uint32_t get_min_image_count(VkPhysicalDevice physical_device, VkSurfaceKHR surface) {
+static VkSurfaceCapabilitiesKHR get_capabilities(VkPhysicalDevice physical_device, VkSurfaceKHR surface) {
     VkSurfaceCapabilitiesKHR capabilities;
     vk_get_physical_device_surface_capabilities_khr(physical_device, surface, &capabilities);
-    return capabilities.min_image_count;
+    return capabilities;
 }
 
 static Attachment create_depth_attachment(GPU* gpu, uint32_t width, uint32_t height) {
@@ -22,7 +22,8 @@ static Attachment create_depth_attachment(GPU* gpu, uint32_t width, uint32_t hei
         .array_layers   = 1,
         .samples        = VK_SAMPLE_COUNT_1_BIT,
         .tiling         = VK_IMAGE_TILING_OPTIMAL,
-        .usage          = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        // Sampled by the Hi-Z pass, see hiz.h.
+        .usage          = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
         .initial_layout = VK_IMAGE_LAYOUT_UNDEFINED,
     };
 
@@ -62,9 +63,14 @@ static Attachment create_depth_attachment(GPU* gpu, uint32_t width, uint32_t hei
 }
 
 Swapchain create_swapchain(GPU* gpu, Window* window) {
-    uint32_t min_image_count = get_min_image_count(gpu->physical_device, window->surface);
+    VkSurfaceCapabilitiesKHR capabilities    = get_capabilities(gpu->physical_device, window->surface);
+    uint32_t                 min_image_count = capabilities.min_image_count;
     assert(min_image_count <= SWAPCHAIN_MAX_IMAGE_COUNT);
 
+    // Transfer source lets frames be read back for screenshots; it's optional for presentation.
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    usage |= capabilities.supported_usage_flags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
     VkSwapchainCreateInfoKHR info = {
         .s_type             = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         .surface            = window->surface,
@@ -73,7 +79,7 @@ Swapchain create_swapchain(GPU* gpu, Window* window) {
         .image_color_space  = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
         .image_extent       = { window->width, window->height },
         .image_array_layers = 1,
-        .image_usage        = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .image_usage        = usage,
         .image_sharing_mode = VK_SHARING_MODE_EXCLUSIVE,
         .pre_transform      = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
         .composite_alpha    = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
@@ -81,7 +87,7 @@ Swapchain create_swapchain(GPU* gpu, Window* window) {
         .clipped            = VK_TRUE,
     };
 
-    Swapchain swapchain = {};
+    Swapchain swapchain = { .usage = usage };
     vk_create_swapchain_khr(gpu->device, &info, NULL, &swapchain.handle);
     set_debug_name(gpu, SWAPCHAIN_KHR, swapchain.handle, "Swapchain");
 
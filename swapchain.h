@@ -13,11 +13,12 @@ typedef struct {
 } Attachment;
 
 typedef struct {
-    VkSwapchainKHR handle;
-    VkImage        images[SWAPCHAIN_MAX_IMAGE_COUNT];
-    VkImageView    views[SWAPCHAIN_MAX_IMAGE_COUNT];
-    uint32_t       image_count;
-    Attachment     depth_attachment;
+    VkSwapchainKHR    handle;
+    VkImage           images[SWAPCHAIN_MAX_IMAGE_COUNT];
+    VkImageView       views[SWAPCHAIN_MAX_IMAGE_COUNT];
+    uint32_t          image_count;
+    VkImageUsageFlags usage;
+    Attachment        depth_attachment;
 } Swapchain;
 
 Swapchain create_swapchain(GPU* gpu, Window* window);
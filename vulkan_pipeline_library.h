@@ -0,0 +1,62 @@
+#ifndef VULKAN_PIPELINE_LIBRARY_H_
+#define VULKAN_PIPELINE_LIBRARY_H_ 1
+
+// VK_KHR_pipeline_library and VK_EXT_graphics_pipeline_library postdate the vendored
+// vulkan_core.h (header version 154). These definitions follow the Khronos registry, renamed the
+// same way as the rest of the vendored headers.
+#include "vulkan_core.h"
+
+#ifndef VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME
+#define vk_khr_pipeline_library 1
+#define VK_KHR_PIPELINE_LIBRARY_SPEC_VERSION   1
+#define VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME "VK_KHR_pipeline_library"
+typedef struct VkPipelineLibraryCreateInfoKHR {
+    VkStructureType   s_type;
+    const void*       p_next;
+    uint32_t          library_count;
+    const VkPipeline* p_libraries;
+} VkPipelineLibraryCreateInfoKHR;
+#endif
+
+#ifndef VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME
+#define vk_ext_graphics_pipeline_library 1
+#define VK_EXT_GRAPHICS_PIPELINE_LIBRARY_SPEC_VERSION   1
+#define VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME "VK_EXT_graphics_pipeline_library"
+
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT   ((VkStructureType) 1000320000)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT ((VkStructureType) 1000320001)
+#define VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT                ((VkStructureType) 1000320002)
+
+#define VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT               0x00000400
+#define VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT   0x00800000
+
+typedef enum VkGraphicsPipelineLibraryFlagBitsEXT {
+    VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT    = 0x00000001,
+    VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT = 0x00000002,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT           = 0x00000004,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT = 0x00000008,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FLAG_BITS_MAX_ENUM_EXT            = 0x7fffffff
+} VkGraphicsPipelineLibraryFlagBitsEXT;
+typedef VkFlags VkGraphicsPipelineLibraryFlagsEXT;
+
+typedef struct VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT {
+    VkStructureType s_type;
+    void*           p_next;
+    VkBool32        graphics_pipeline_library;
+} VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT;
+
+typedef struct VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT {
+    VkStructureType s_type;
+    void*           p_next;
+    VkBool32        graphics_pipeline_library_fast_linking;
+    VkBool32        graphics_pipeline_library_independent_interpolation_decoration;
+} VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT;
+
+typedef struct VkGraphicsPipelineLibraryCreateInfoEXT {
+    VkStructureType                   s_type;
+    void*                             p_next;
+    VkGraphicsPipelineLibraryFlagsEXT flags;
+} VkGraphicsPipelineLibraryCreateInfoEXT;
+#endif
+
+#endif
@@ -1,12 +1,75 @@
 #ifndef window_h
 #define window_h
+#include <stdatomic.h>
+#include <stdint.h>
+
+typedef enum {
+    WINDOW_EVENT_CLOSE,
+    WINDOW_EVENT_RESIZE,
+    WINDOW_EVENT_KEY,
+    WINDOW_EVENT_MOUSE_BUTTON,
+    WINDOW_EVENT_MOUSE_MOTION,
+    WINDOW_EVENT_EXPOSE,
+    WINDOW_EVENT_VISIBILITY,
+} WindowEventType;
+
+#define KEY_ESCAPE 0xff1b
+#define KEY_F12    0xffc9
+
+typedef struct {
+    WindowEventType type;
+    uint64_t        time_ns; // CLOCK_MONOTONIC when the event thread received the event.
+    union {
+        struct {
+            uint32_t width;
+            uint32_t height;
+        } resize;
+        struct {
+            uint32_t keysym; // X keysym, e.g. KEY_ESCAPE, or the character code for Latin-1 keys.
+            uint32_t keycode;
+            int      pressed;
+        } key;
+        struct {
+            int32_t  x;
+            int32_t  y;
+            uint32_t button; // Zero for motion events.
+            int      pressed;
+        } mouse;
+        struct {
+            int visible;
+        } visibility;
+    };
+} WindowEvent;
+
+#define WINDOW_EVENT_QUEUE_SIZE 1024
+
+// Single producer (the event thread), single consumer (the render loop). Head and tail only ever
+// increase; the slot is the index modulo the queue size.
+typedef struct {
+    WindowEvent events[WINDOW_EVENT_QUEUE_SIZE];
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+} WindowEventQueue;
 
 #ifdef __linux__
+#include <pthread.h>
 #include <xcb/xcb.h>
 
 #define VK_USE_PLATFORM_XCB_KHR
 #include "gpu.h"
 
+typedef struct {
+    xcb_connection_t* connection;
+    xcb_window_t      window;
+    xcb_atom_t        wm_delete_window;
+    xcb_atom_t        wake;
+    uint32_t          width;
+    uint32_t          height;
+    xcb_keysym_t      keysyms[256];
+    atomic_int        stopping; // Set by destroy_window, so a full queue stops holding the thread.
+    WindowEventQueue  queue;
+} WindowEvents;
+
 typedef struct {
     uint32_t                 width;
     uint32_t                 height;
@@ -15,6 +78,8 @@ typedef struct {
     xcb_window_t             window;
     xcb_intern_atom_reply_t* wm_delete_window;
     VkSurfaceKHR             surface;
+    WindowEvents*            events;
+    pthread_t                event_thread;
 } Window;
 
 #elif _WIN32
@@ -24,7 +89,7 @@ typedef struct {
 #endif
 
 Window create_window(GPU* gpu, uint32_t width, uint32_t height);
-int    poll_events(Window* window);
+int    poll_event(Window* window, WindowEvent* event);
 void   destroy_window(GPU* gpu, Window* window);
 
 #endif
@@ -1,5 +1,7 @@
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <xcb/xcb_event.h>
 #include "window.h"
 
@@ -29,21 +31,161 @@ static VkBool32 surface_supported(const GPU* gpu, VkSurfaceKHR surface) {
     return surface_supported;
 }
 
+static void load_keysyms(xcb_connection_t* connection, xcb_keysym_t keysyms[256]) {
+    const xcb_setup_t*                setup  = xcb_get_setup(connection);
+    uint8_t                           count  = setup->max_keycode - setup->min_keycode + 1;
+    xcb_get_keyboard_mapping_cookie_t cookie = xcb_get_keyboard_mapping(connection, setup->min_keycode, count);
+    xcb_get_keyboard_mapping_reply_t* reply  = xcb_get_keyboard_mapping_reply(connection, cookie, NULL);
+    if (!reply) {
+        return;
+    }
+
+    // Only the unshifted keysym of each key is kept.
+    xcb_keysym_t* mapping = xcb_get_keyboard_mapping_keysyms(reply);
+    for (uint32_t i = 0; i < count; i++) {
+        keysyms[setup->min_keycode + i] = mapping[i * reply->keysyms_per_keycode];
+    }
+    free(reply);
+}
+
+static uint64_t time_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+// Returns 0 if the queue is full.
+static int push_event(WindowEventQueue* queue, const WindowEvent* event) {
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head == WINDOW_EVENT_QUEUE_SIZE) {
+        return 0;
+    }
+    queue->events[tail % WINDOW_EVENT_QUEUE_SIZE] = *event;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+static void push_event_blocking(WindowEvents* events, const WindowEvent* event) {
+    // Motion is the only event that's cheap to lose; anything else waits for the render loop, unless
+    // the window is being destroyed and nothing will drain the queue again.
+    while (!push_event(&events->queue, event) && event->type != WINDOW_EVENT_MOUSE_MOTION
+           && !atomic_load_explicit(&events->stopping, memory_order_relaxed)) {
+        struct timespec delay = { 0, 1000000 };
+        nanosleep(&delay, NULL);
+    }
+}
+
+// Translates an X event. Returns 0 for events the render loop doesn't care about.
+static int translate_event(WindowEvents* events, xcb_generic_event_t* generic_event, WindowEvent* event) {
+    switch (XCB_EVENT_RESPONSE_TYPE(generic_event)) {
+    case XCB_CLIENT_MESSAGE: {
+        xcb_client_message_event_t* client_message = (xcb_client_message_event_t*) generic_event;
+        if (client_message->data.data32[0] != events->wm_delete_window) {
+            return 0;
+        }
+        event->type = WINDOW_EVENT_CLOSE;
+        return 1;
+    }
+    case XCB_CONFIGURE_NOTIFY: {
+        xcb_configure_notify_event_t* configure = (xcb_configure_notify_event_t*) generic_event;
+        if (configure->width == events->width && configure->height == events->height) {
+            return 0;
+        }
+        events->width        = configure->width;
+        events->height       = configure->height;
+        event->type          = WINDOW_EVENT_RESIZE;
+        event->resize.width  = configure->width;
+        event->resize.height = configure->height;
+        return 1;
+    }
+    case XCB_KEY_PRESS:
+    case XCB_KEY_RELEASE: {
+        xcb_key_press_event_t* key = (xcb_key_press_event_t*) generic_event;
+        event->type                = WINDOW_EVENT_KEY;
+        event->key.keysym          = events->keysyms[key->detail];
+        event->key.keycode         = key->detail;
+        event->key.pressed         = XCB_EVENT_RESPONSE_TYPE(generic_event) == XCB_KEY_PRESS;
+        return 1;
+    }
+    case XCB_BUTTON_PRESS:
+    case XCB_BUTTON_RELEASE: {
+        xcb_button_press_event_t* button = (xcb_button_press_event_t*) generic_event;
+        event->type                      = WINDOW_EVENT_MOUSE_BUTTON;
+        event->mouse.x                   = button->event_x;
+        event->mouse.y                   = button->event_y;
+        event->mouse.button              = button->detail;
+        event->mouse.pressed             = XCB_EVENT_RESPONSE_TYPE(generic_event) == XCB_BUTTON_PRESS;
+        return 1;
+    }
+    case XCB_MOTION_NOTIFY: {
+        xcb_motion_notify_event_t* motion = (xcb_motion_notify_event_t*) generic_event;
+        event->type                       = WINDOW_EVENT_MOUSE_MOTION;
+        event->mouse.x                    = motion->event_x;
+        event->mouse.y                    = motion->event_y;
+        return 1;
+    }
+    case XCB_EXPOSE:
+        event->type = WINDOW_EVENT_EXPOSE;
+        return 1;
+    case XCB_VISIBILITY_NOTIFY: {
+        xcb_visibility_notify_event_t* visibility = (xcb_visibility_notify_event_t*) generic_event;
+        event->type                               = WINDOW_EVENT_VISIBILITY;
+        event->visibility.visible                 = visibility->state != XCB_VISIBILITY_FULLY_OBSCURED;
+        return 1;
+    }
+    }
+    return 0;
+}
+
+// Owns every X read after the window is created. Blocks in xcb_wait_for_event, so it costs nothing
+// while the window is idle, and stops on the wake message sent by destroy_window.
+static void* event_thread_main(void* arg) {
+    WindowEvents*        events = arg;
+    xcb_generic_event_t* generic_event;
+    while ((generic_event = xcb_wait_for_event(events->connection))) {
+        uint64_t time_ns = time_now_ns();
+
+        if (XCB_EVENT_RESPONSE_TYPE(generic_event) == XCB_CLIENT_MESSAGE
+            && ((xcb_client_message_event_t*) generic_event)->type == events->wake) {
+            free(generic_event);
+            return NULL;
+        }
+
+        WindowEvent event = { .time_ns = time_ns };
+        if (translate_event(events, generic_event, &event)) {
+            push_event_blocking(events, &event);
+        }
+        free(generic_event);
+    }
+
+    // The connection broke; there is nothing left to render to.
+    WindowEvent event = { .type = WINDOW_EVENT_CLOSE, .time_ns = time_now_ns() };
+    push_event_blocking(events, &event);
+    return NULL;
+}
+
 Window create_window(GPU* gpu, uint32_t width, uint32_t height) {
     xcb_connection_t*     connection     = xcb_connect(NULL, NULL);
     const xcb_setup_t*    setup          = xcb_get_setup(connection);
     xcb_screen_iterator_t roots_iterator = xcb_setup_roots_iterator(setup);
     xcb_screen_t*         screen         = roots_iterator.data;
     uint32_t              value_mask     = XCB_CW_EVENT_MASK;
-    uint32_t              value_list[]   = { XCB_EVENT_MASK_EXPOSURE };
-    xcb_window_t          window         = xcb_generate_id(connection);
+    uint32_t              value_list[]   = {
+        XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_VISIBILITY_CHANGE
+        | XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_KEY_RELEASE | XCB_EVENT_MASK_BUTTON_PRESS
+        | XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_POINTER_MOTION,
+    };
+    xcb_window_t window = xcb_generate_id(connection);
     xcb_create_window(connection, XCB_COPY_FROM_PARENT, window, screen->root, 0, 0, width, height, 0,
                       XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, value_mask, value_list);
 
     xcb_intern_atom_reply_t* wm_protocols     = intern_atom(connection, 1, "WM_PROTOCOLS");
     xcb_intern_atom_reply_t* wm_delete_window = intern_atom(connection, 0, "WM_DELETE_WINDOW");
+    xcb_intern_atom_reply_t* wake             = intern_atom(connection, 0, "_3D_WAKE_EVENT_THREAD");
     xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, wm_protocols->atom, 4, 32, 1,
                         &wm_delete_window->atom);
+    free(wm_protocols);
 
     xcb_map_window(connection, window);
     xcb_flush(connection);
@@ -53,29 +195,50 @@ Window create_window(GPU* gpu, uint32_t width, uint32_t height) {
 
     set_debug_name(gpu, SURFACE_KHR, surface, "surface");
 
-    return (Window){ width, height, connection, screen, window, wm_delete_window, surface };
+    WindowEvents* events = calloc(1, sizeof(*events));
+    events->connection       = connection;
+    events->window           = window;
+    events->wm_delete_window = wm_delete_window->atom;
+    events->wake             = wake->atom;
+    events->width            = width;
+    events->height           = height;
+    load_keysyms(connection, events->keysyms);
+    free(wake);
+
+    pthread_t event_thread;
+    pthread_create(&event_thread, NULL, event_thread_main, events);
+
+    return (Window){ width, height, connection, screen, window, wm_delete_window, surface, events, event_thread };
 }
 
-int poll_events(Window* window) {
-    xcb_generic_event_t*        generic_event        = NULL;
-    xcb_client_message_event_t* client_message_event = NULL;
-    xcb_atom_t                  delete_window_atom   = window->wm_delete_window->atom;
-
-    while ((generic_event = xcb_poll_for_event(window->connection))) {
-        switch (XCB_EVENT_RESPONSE_TYPE(generic_event)) {
-        case XCB_CLIENT_MESSAGE:
-            client_message_event = (xcb_client_message_event_t*) generic_event;
-            if (client_message_event->data.data32[0] == delete_window_atom) {
-                return 1;
-            }
-            break;
-        }
+// Called from the render loop. Never touches the X connection.
+int poll_event(Window* window, WindowEvent* event) {
+    WindowEventQueue* queue = &window->events->queue;
+    unsigned          head  = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned          tail  = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail) {
+        return 0;
     }
-    return 0;
+    *event = queue->events[head % WINDOW_EVENT_QUEUE_SIZE];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return 1;
 }
 
 void destroy_window(GPU* gpu, Window* window) {
+    xcb_client_message_event_t wake = {
+        .response_type = XCB_CLIENT_MESSAGE,
+        .format        = 32,
+        .window        = window->window,
+        .type          = window->events->wake,
+    };
+    atomic_store_explicit(&window->events->stopping, 1, memory_order_relaxed);
+    xcb_send_event(window->connection, 0, window->window, XCB_EVENT_MASK_NO_EVENT, (const char*) &wake);
+    xcb_flush(window->connection);
+    pthread_join(window->event_thread, NULL);
+    free(window->events);
+
     vk_destroy_surface_khr(gpu->instance, window->surface, NULL);
     xcb_destroy_window(window->connection, window->window);
+    free(window->wm_delete_window);
     xcb_disconnect(window->connection);
 }